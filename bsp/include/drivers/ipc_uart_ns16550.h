@@ -46,10 +46,19 @@
  * This driver manages the communication between BLE Core and Quark through UART.
  * It also addresses power management.
  *
+ * Received frames are stored in place in a ring (see @ref ipc_uart_rx):
+ * the channel callback gets @ref IPC_MSG_TYPE_RX_READY when frames are
+ * pending, and its owner calls ipc_uart_ns16550_rx_drain() from task context
+ * to process all of them. Only when the ring overflows are frames delivered
+ * one by one with @ref IPC_MSG_TYPE_MESSAGE, and they must be returned with
+ * ipc_uart_ns16550_rx_free().
+ *
  * @ingroup soc_drivers
  * @{
  */
 
+struct ipc_uart_rx_stats;
+
 /**
  * IPC UART power management driver.
  */
@@ -80,6 +89,7 @@ enum IPC_UART_RESULT_CODES {
  */
 enum ipc_channels {
 	RPC_CHANNEL=0, /**< RPC channel */
+	RPC_PACKED_CHANNEL, /**< RPC channel, several RPC buffers per frame */
 	IPC_UART_MAX_CHANNEL
 };
 
@@ -114,7 +124,7 @@ struct ipc_uart_channels {
 	uint16_t index; /**< Channel number */
 	uint16_t state; /**< @ref ipc_channel_state */
 	int (*cb)(int chan, int request, int len, void *data);
-	/**< Callback of the channel.
+	/**< Callback of the channel, called in interrupt context.
 	 * @param chan Channel index used
 	 * @param request Request id (defined in ipc_requests.h)
 	 * @param len Payload size
@@ -184,6 +194,45 @@ void *ipc_uart_channel_open(int channel,
 			    int (*cb)(int chan, int request, int len,
 				      void *data));
 
+/**
+ * Process the frames pending in the reception ring.
+ *
+ * To be called from task context once the channel callback got
+ * @ref IPC_MSG_TYPE_RX_READY. Each frame is passed to cb then returned to the
+ * ring: its data must not be used after cb returns. The callback is called
+ * again with @ref IPC_MSG_TYPE_RX_READY for the frames received after this
+ * function was entered.
+ *
+ * @param dev IPC UART device to use
+ * @param cb  Function processing a frame
+ *            - 1st parameter `chan` is the IPC UART channel index
+ *            - 2nd parameter `len` is the length of the frame
+ *            - 3rd parameter `data` points to the frame content
+ *
+ * @return the number of frames processed
+ */
+int ipc_uart_ns16550_rx_drain(struct td_device *dev,
+			      void (*cb)(int chan, int len, void *data));
+
+/**
+ * Free a frame delivered with @ref IPC_MSG_TYPE_MESSAGE.
+ *
+ * @param dev    IPC UART device to use
+ * @param p_data Frame content
+ */
+void ipc_uart_ns16550_rx_free(struct td_device *dev, void *p_data);
+
+/**
+ * Get the reception statistics.
+ *
+ * @param dev   IPC UART device to use
+ * @param stats Filled with the statistics
+ * @param reset true to clear the statistics
+ */
+void ipc_uart_ns16550_get_rx_stats(struct td_device *dev,
+				   struct ipc_uart_rx_stats *stats,
+				   bool reset);
+
 /** @} */
 
 #endif /* _IPC_UART_NS16550_H_ */
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _IPC_UART_RX_H_
+#define _IPC_UART_RX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "util/spsc_ring.h"
+#include "drivers/ipc_uart_ns16550.h"
+
+/**
+ * @defgroup ipc_uart_rx IPC UART reception
+ * Framing state machine and frame ring of the IPC UART reception.
+ *
+ * The receive interrupt reads the UART FIFO directly at ipc_uart_rx::ptr,
+ * up to ipc_uart_rx::size bytes, and reports the count to
+ * ipc_uart_rx_recv(). Once the header of a frame is complete, its payload
+ * is received in place into a record of a preallocated ring: no memory is
+ * allocated in the interrupt. The consumer gets the frames with
+ * ipc_uart_rx_get() and hands each of them back with ipc_uart_rx_release()
+ * once processed.
+ *
+ * The consumer only needs to be woken up when it may have drained the ring:
+ * ipc_uart_rx_recv() reports @ref IPC_UART_RX_NOTIFY the first time a frame
+ * is queued after ipc_uart_rx_rearm(), so one wakeup event is outstanding at
+ * most and all the frames queued meanwhile are handled on that wakeup.
+ *
+ * A frame larger than @ref SPSC_RING_MAX_RECORD or arriving while the ring is
+ * full is received into a buffer from balloc(), which is queued in the ring
+ * once the frame is complete and freed by ipc_uart_rx_release(). If the ring
+ * is still full at that time, the frame is reported with
+ * @ref IPC_UART_RX_ALLOC, to be delivered separately and returned with
+ * ipc_uart_rx_free(): the following frames are allocated and reported the
+ * same way until all of them have been returned, so frames are always
+ * processed in their reception order.
+ *
+ * This module does not touch the hardware and can be built on the host.
+ *
+ * <table>
+ * <tr><th><b>Include file</b><td><tt> \#include "drivers/ipc_uart_rx.h"</tt>
+ * <tr><th><b>Source path</b> <td><tt>bsp/src/drivers/ipc</tt>
+ * </table>
+ *
+ * @ingroup ipc_uart_ns16550
+ * @{
+ */
+
+/** The first bytes of a frame were received */
+#define IPC_UART_RX_START       0x1
+/** A frame was completely received */
+#define IPC_UART_RX_DONE        0x2
+/** The completed frame was queued in the ring, the consumer must be woken */
+#define IPC_UART_RX_NOTIFY      0x4
+/** The completed frame is in ipc_uart_rx::frame, allocated with balloc() */
+#define IPC_UART_RX_ALLOC       0x8
+
+/** Reception statistics */
+struct ipc_uart_rx_stats {
+	/** Frames queued in the ring */
+	uint32_t frames;
+	/** Frames received into an allocated buffer */
+	uint32_t allocated;
+	/** Frames reported with @ref IPC_UART_RX_ALLOC */
+	uint32_t overflows;
+	/** Wakeups of the consumer requested */
+	uint32_t notified;
+};
+
+/** Reception state */
+struct ipc_uart_rx {
+	/** Ring of received frames */
+	struct spsc_ring ring;
+	/** Header of the frame being received */
+	struct ipc_uart_header hdr;
+	/** Where the next received bytes must be written */
+	uint8_t *ptr;
+	/** Number of bytes expected at ptr */
+	uint16_t size;
+	/** Framing state, private */
+	uint8_t state;
+	/** Payload of the frame being received */
+	uint8_t *frame;
+	/** Set once the consumer has been woken up */
+	uint32_t notified;
+	/** Number of allocated frames not returned yet */
+	uint32_t backlog;
+	/** Statistics */
+	struct ipc_uart_rx_stats stats;
+};
+
+/**
+ * Initialize the reception state.
+ *
+ * @param rx   reception state to initialize
+ * @param buf  storage of the frame ring, 4-byte aligned
+ * @param size size of buf, a power of two
+ *
+ * @return 0 if no error, -1 if size or buf are not valid
+ */
+int ipc_uart_rx_init(struct ipc_uart_rx *rx, uint8_t *buf, uint32_t size);
+
+/**
+ * Account for bytes received at ipc_uart_rx::ptr. Producer side.
+ *
+ * @param rx    reception state
+ * @param count number of bytes received, at most ipc_uart_rx::size
+ *
+ * @return a combination of @ref IPC_UART_RX_START, @ref IPC_UART_RX_DONE,
+ *         @ref IPC_UART_RX_NOTIFY and @ref IPC_UART_RX_ALLOC. On
+ *         @ref IPC_UART_RX_ALLOC, ipc_uart_rx::hdr and ipc_uart_rx::frame
+ *         describe the frame until the next call.
+ */
+int ipc_uart_rx_recv(struct ipc_uart_rx *rx, int count);
+
+/**
+ * Allow the next queued frame to request a wakeup. Consumer side.
+ *
+ * To be called when handling a wakeup, before draining the ring.
+ *
+ * @param rx reception state
+ */
+void ipc_uart_rx_rearm(struct ipc_uart_rx *rx);
+
+/**
+ * Get the oldest frame of the ring. Consumer side.
+ *
+ * The frame stays in the ring until ipc_uart_rx_release() is called.
+ *
+ * @param rx  reception state
+ * @param hdr filled with the header of the frame
+ *
+ * @return pointer on the payload of the frame, or NULL if the ring is empty
+ */
+void *ipc_uart_rx_get(struct ipc_uart_rx *rx, struct ipc_uart_header *hdr);
+
+/**
+ * Return the frame obtained with ipc_uart_rx_get() to the ring, or free it
+ * if it was allocated. Consumer side.
+ *
+ * @param rx reception state
+ */
+void ipc_uart_rx_release(struct ipc_uart_rx *rx);
+
+/**
+ * Free a frame reported with @ref IPC_UART_RX_ALLOC. Consumer side.
+ *
+ * @param rx    reception state
+ * @param frame payload of the frame
+ */
+void ipc_uart_rx_free(struct ipc_uart_rx *rx, void *frame);
+
+/**
+ * Get the reception statistics.
+ *
+ * @param rx    reception state
+ * @param stats filled with the statistics
+ * @param reset true to clear the statistics
+ */
+void ipc_uart_rx_get_stats(struct ipc_uart_rx *rx,
+			   struct ipc_uart_rx_stats *stats, bool reset);
+
+/** @} */
+
+#endif /* _IPC_UART_RX_H_ */
@@ -100,6 +100,24 @@ struct sensor_sba_req {
 	volatile int complete_flag;
 };
 
+/**
+ * Maximum number of segments of a chained sensor bus access
+ */
+#define SENSOR_BUS_MAX_SEGS 4
+
+/**
+ * Segment of a chained sensor bus access
+ *
+ * A segment with a rx_len of 0 is a write, otherwise tx_buffer is written
+ * then rx_len bytes are read.
+ */
+struct sensor_bus_seg {
+	uint8_t *tx_buffer;
+	uint32_t tx_len;
+	uint8_t *rx_buffer;
+	uint32_t rx_len;
+};
+
 /**
  * SBA information for sensor
  */
@@ -110,6 +128,7 @@ struct sensor_sba_info {
 	BLOCK_TYPE block_type;
 	SENSOR_BUS_TYPE bus_type;
 	uint8_t dev_id;
+	SBA_PRIORITY prio;      /*!< Queue priority of the accesses, SBA_PRIO_NORMAL by default */
 };
 
 /**
@@ -130,6 +149,57 @@ DRIVER_API_RC sensor_bus_access(struct sensor_sba_info *info,
 				bool req_read,
 				int slave_addr);
 
+/**
+ *  Chained accesses on sensor bus.
+ *
+ *  The segments are executed back-to-back in one bus session, see @ref sba_exec_chain,
+ *  and the caller is woken up once when the last one completes.
+ *
+ *  @param info       Configuration information as returned by \ref sensor_config_bus
+ *  @param segs       Segments to execute, in order
+ *  @param count      Number of segments, up to SENSOR_BUS_MAX_SEGS
+ *  @param slave_addr Usually, this field is -1 unless multiple devices related to the struct sensor_sba_info
+ *  @return see @ref DRIVER_API_RC\n
+ */
+DRIVER_API_RC sensor_bus_access_chain(struct sensor_sba_info *info,
+				      const struct sensor_bus_seg *segs,
+				      uint8_t count, int slave_addr);
+
+/**
+ *  Read single registers in one bus session.
+ *
+ *  For sensors taking a one byte register address, with bit 7 set for a read
+ *  on SPI.
+ *
+ *  @param info       Configuration information as returned by \ref sensor_config_bus
+ *  @param reg_addr   Addresses of the registers
+ *  @param reg_data   One byte per register read
+ *  @param n          Number of registers, up to SENSOR_BUS_MAX_SEGS
+ *  @param slave_addr Usually, this field is -1 unless multiple devices related to the struct sensor_sba_info
+ *  @return see @ref DRIVER_API_RC\n
+ */
+DRIVER_API_RC sensor_bus_read_regs(struct sensor_sba_info *info,
+				   const uint8_t *reg_addr, uint8_t *reg_data,
+				   uint8_t n, int slave_addr);
+
+/**
+ *  Write single registers in one bus session, in order.
+ *
+ *  For sensors taking a one byte register address, with bit 7 cleared for a
+ *  write on SPI.
+ *
+ *  @param info       Configuration information as returned by \ref sensor_config_bus
+ *  @param reg_addr   Addresses of the registers
+ *  @param reg_data   One byte per register to write
+ *  @param n          Number of registers, up to SENSOR_BUS_MAX_SEGS
+ *  @param slave_addr Usually, this field is -1 unless multiple devices related to the struct sensor_sba_info
+ *  @return see @ref DRIVER_API_RC\n
+ */
+DRIVER_API_RC sensor_bus_write_regs(struct sensor_sba_info *info,
+				    const uint8_t *reg_addr,
+				    const uint8_t *reg_data, uint8_t n,
+				    int slave_addr);
+
 /**
  *  Configure a sensor bus before any access.
  *
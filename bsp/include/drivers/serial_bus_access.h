@@ -53,6 +53,10 @@
  * It offers the possibility to queue transactions. All transactions are asynchronous and
  * a callback is called on transaction completion.
  *
+ * Several requests can be chained to be executed back-to-back in one bus session, see
+ * @ref sba_exec_chain. Each bus has one FIFO queue per priority, the queue of highest
+ * priority is served first when the current session completes.
+ *
  * In the device tree, there should be:
  * - one SBA bus device per used SPI/I2C bus with attached struct sba_master_cfg_data
  * - for each bus device, one or more SBA device with attached struct sba_device
@@ -69,6 +73,15 @@ typedef enum {
 	SBA_TRANSFER          /*!< Read and write */
 } SBA_REQUEST_TYPE;
 
+/**
+ * Priority of a request in the bus queues
+ */
+typedef enum {
+	SBA_PRIO_NORMAL = 0,  /*!< Default priority */
+	SBA_PRIO_HIGH,        /*!< Served before all pending normal requests */
+	SBA_PRIO_COUNT
+} SBA_PRIORITY;
+
 /**
  * List of all serial controllers in system
  */
@@ -105,8 +118,28 @@ typedef struct sba_request {
 	int8_t status;                              /*!< 0 if ok, -1 if error */
 	void *priv_data;                            /*!< User private data */
 	void (*callback)(struct sba_request *);     /*!< Callback to notify transaction completion */
+	struct sba_request *chain;                  /*!< Next segment of the session, see sba_exec_chain() */
+	uint32_t submit_time;                       /*!< Internal: submission time in 32kHz ticks */
 }sba_request_t;
 
+/**
+ *  Bus usage counters.
+ *
+ *  Times are in 32kHz ticks. The bus utilisation over a period is busy_ticks
+ *  divided by the duration of the period.
+ */
+struct sba_bus_stats {
+	uint32_t sessions;                          /*!< Requests and chains completed */
+	uint32_t segments;                          /*!< Transfers started on the bus */
+	uint32_t errors;                            /*!< Sessions completed with an error */
+	uint32_t bytes;                             /*!< Bytes written and read */
+	uint32_t busy_ticks;                        /*!< Time spent executing sessions */
+	uint32_t wait_ticks;                        /*!< Sum of submission to completion latencies */
+	uint32_t max_wait_ticks;                    /*!< Maximum submission to completion latency */
+	uint16_t queued;                            /*!< Sessions currently waiting in the queues */
+	uint16_t max_queued;                        /*!< Maximum number of sessions waiting */
+};
+
 /**
  *  SPI controller configuration.
  */
@@ -145,8 +178,11 @@ struct sba_master_cfg_data {
 	SBA_BUSID bus_id;                       /*!< Controller ID */
 	union sba_config config;                /*!< SBA config*/
 	/* internal fields */
-	list_head_t request_list;               /*!< List to pending requests */
+	list_head_t request_list[SBA_PRIO_COUNT]; /*!< Lists of pending requests, per priority */
 	sba_request_t *current_request;         /*!< Current request pointer */
+	sba_request_t *current_segment;         /*!< Segment of the current request on the bus */
+	uint32_t session_start;                 /*!< Start time of the current request */
+	struct sba_bus_stats stats;             /*!< Bus usage counters */
 	uint8_t controller_initialised;         /*!< Controller initialized flag */
 	struct pm_wakelock sba_wakelock;        /*!< Power manager wakelock */
 	struct clk_gate_info_s *clk_gate_info;  /*!< Clock gate data */
@@ -203,6 +239,41 @@ DRIVER_API_RC sba_exec_request(sba_request_t *request);
 DRIVER_API_RC sba_exec_dev_request(struct sba_device *	dev,
 				   struct sba_request * req);
 
+/**
+ *  Request a chain of SBA transfers executed in one bus session.
+ *
+ *  The segments are linked through their chain field, the last one has a NULL chain.
+ *  They are executed back-to-back: no other request is started on the bus before the
+ *  chain completes, and the next segment is started from the completion interrupt of
+ *  the previous one. Only the callback of the first segment is called, once, when the
+ *  last segment completes or when a segment fails; its status is set to -1 if any
+ *  segment failed. The bus_id of the first segment is used for all of them, the
+ *  request type, buffers and address are per segment.
+ *
+ *  @param head  First segment of the chain
+ *  @param prio  Queue priority of the chain, see @ref SBA_PRIORITY
+ *
+ *  @return
+ *           - DRV_RC_OK on success,
+ *           - DRV_RC_INVALID_CONFIG        - if any configuration parameter is not valid
+ *           - DRV_RC_FAIL                  otherwise
+ */
+DRIVER_API_RC sba_exec_chain(sba_request_t *head, SBA_PRIORITY prio);
+
+/**
+ *  Get the usage counters of a bus.
+ *
+ *  @param bus_id  Bus identifier
+ *  @param stats   Filled with the counters
+ *  @param reset   Clear the counters once read, except queued
+ *
+ *  @return
+ *           - DRV_RC_OK on success,
+ *           - DRV_RC_FAIL if the bus is not initialized
+ */
+DRIVER_API_RC sba_get_stats(SBA_BUSID bus_id, struct sba_bus_stats *stats,
+			    bool reset);
+
 /**
  *  Get physical bus id from logical bus id.
  *
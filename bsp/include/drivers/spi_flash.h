@@ -50,6 +50,11 @@
  *
  * The SPI Flash driver provides erase/read/write accesses to SPI flash.
  *
+ * Each call takes the device, wakes the flash up from deep power down and puts
+ * it back to sleep. A batch of operations can instead be done in a session,
+ * see @ref spi_flash_session_open: the flash stays awake and the device is
+ * held until @ref spi_flash_session_close.
+ *
  * @ingroup ext_drivers
  * @{
  */
@@ -64,6 +69,21 @@
 #define STORAGE_BLOCK_SIZE              (0x4)
 #define STORAGE_LARGE_BLOCK_SIZE        (0x5)
 
+/**
+ * SPI Flash session, see @ref spi_flash_session_open
+ */
+struct spi_flash_session {
+	struct td_device *dev;  /*!< Device held by the session */
+};
+
+/**
+ * Buffer of a scatter-gather read, see @ref spi_flash_session_readv
+ */
+struct spi_flash_iovec {
+	uint8_t *buf;           /*!< Buffer where to store read data */
+	unsigned int len;       /*!< Number of bytes to read in buf */
+};
+
 /**
  *  Read dwords data on SPI flash
  *
@@ -204,6 +224,83 @@ DRIVER_API_RC spi_flash_get_rdid(struct td_device *dev, uint32_t *rdid);
 DRIVER_API_RC spi_flash_ioctl(struct td_device *dev, uint32_t *result,
 			      uint8_t ioctl);
 
+/**
+ *  Open a session on SPI flash
+ *
+ *  Take the device and wake the flash up. The device is held until the
+ *  session is closed: only the spi_flash_session_* functions can be called
+ *  meanwhile by the owner of the session, other calls on the device block.
+ *
+ *  @param  dev             SPI flash device to use
+ *  @param  session         Session to open
+ *
+ *  @return  DRV_RC_OK on success else DRIVER_API_RC error code
+ */
+DRIVER_API_RC spi_flash_session_open(struct td_device *		dev,
+				     struct spi_flash_session * session);
+
+/**
+ *  Close a session on SPI flash
+ *
+ *  Put the flash to sleep and give the device back.
+ *
+ *  @param  session         Session opened by @ref spi_flash_session_open
+ */
+void spi_flash_session_close(struct spi_flash_session *session);
+
+/**
+ *  Read contiguous bytes of SPI flash into several buffers
+ *
+ *  The data is read straight into the caller buffers, in order, starting
+ *  from address. Up to 4 buffers are read per bus session.
+ *
+ *  @param  session         Open session
+ *  @param  address         Address (in bytes) where to read
+ *  @param  iov             Buffers where to store read data
+ *  @param  iovcnt          Number of buffers
+ *  @param  retlen          Pointer where to return the number of read bytes
+ *
+ *  @return  DRV_RC_OK on success else DRIVER_API_RC error code
+ */
+DRIVER_API_RC spi_flash_session_readv(struct spi_flash_session *	session,
+				      uint32_t				address,
+				      const struct spi_flash_iovec *	iov,
+				      unsigned int			iovcnt,
+				      unsigned int *			retlen);
+
+/**
+ *  Write bytes into SPI flash memory
+ *
+ *  The pages are programmed one after the other, the next page is prepared
+ *  while the flash programs the current one and the task sleeps while
+ *  polling for completion.
+ *
+ *  @param  session         Open session
+ *  @param  address         Address (in bytes) where to write
+ *  @param  len             Number of bytes to write
+ *  @param  retlen          Pointer where to return the number of written bytes
+ *  @param  data            Data to write
+ *
+ *  @return  DRV_RC_OK on success else DRIVER_API_RC error code
+ */
+DRIVER_API_RC spi_flash_session_write(struct spi_flash_session *session,
+				      uint32_t address, unsigned int len,
+				      unsigned int *retlen,
+				      const uint8_t *data);
+
+/**
+ *  Erase sectors of SPI flash memory
+ *
+ *  @param  session         Open session
+ *  @param  start_sector    First sector to erase
+ *  @param  sector_count    Number of sectors to erase
+ *
+ *  @return  DRV_RC_OK on success else DRIVER_API_RC error code
+ */
+DRIVER_API_RC spi_flash_session_sector_erase(struct spi_flash_session *session,
+					     unsigned int		start_sector,
+					     unsigned int		sector_count);
+
 /*! Forward declaration for spi_flash drivers */
 struct spi_flash_driver;
 
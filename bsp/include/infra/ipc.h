@@ -113,6 +113,30 @@ void ipc_request_notify_panic(int core_id);
  */
 void ipc_handle_message();
 
+struct ipc_ring;
+
+/**
+ * Set up the shared memory rings carrying messages and remote frees.
+ *
+ * Initializes the receive ring: it must be called before the remote core
+ * starts sending. Requests fall back to the mailbox until the remote core
+ * has done the same.
+ *
+ * @param tx_ring Ring to the remote core.
+ * @param rx_ring Ring from the remote core.
+ * @param tx_doorbell_channel Mailbox notifying the remote core.
+ * @param rx_doorbell_channel Mailbox notified by the remote core.
+ */
+void ipc_ring_setup(struct ipc_ring *tx_ring, struct ipc_ring *rx_ring,
+		    int tx_doorbell_channel, int rx_doorbell_channel);
+
+/**
+ * Handle the requests posted to the receive ring.
+ *
+ * To be called from the interrupt of the receive doorbell mailbox.
+ */
+void ipc_handle_ring(void);
+
 /**
  * Synchronous callback run on received IPC request
  *
@@ -160,6 +184,14 @@ int ipc_async_send_message(struct message *message);
  */
 void ipc_async_free_message(struct message *message);
 
+/**
+ * Called by port implementation when a list of messages that come from a
+ * different CPU than the current one has to be freed.
+ *
+ * @param list First message of the list.
+ */
+void ipc_async_free_list(struct message *list);
+
 /**
  * Initialize the asynchrounous message send/free mechanism for remote
  * message sending and freeing.
@@ -56,6 +56,14 @@
  * Set the MessageBox as synchronized.
  */
 #define IPC_MSG_TYPE_SYNC    0x3
+/**
+ * Request to free a list of messages, see message_free_list().
+ */
+#define IPC_MSG_TYPE_FREE_LIST 0x4
+/**
+ * Frames are pending in a reception ring, see ipc_uart_ns16550_rx_drain().
+ */
+#define IPC_MSG_TYPE_RX_READY  0x5
 
 /**
  * Allocate a port.
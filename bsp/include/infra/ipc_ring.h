@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __IPC_RING_H__
+#define __IPC_RING_H__
+
+#include <stdint.h>
+#include "util/compiler.h"
+#include "util/spsc_ring.h"
+
+/**
+ * @defgroup ipc_ring IPC shared memory ring
+ * Descriptor ring carrying IPC requests from one core to another.
+ *
+ * One ring is used per direction. It lies in memory shared by both cores,
+ * the sending core being the only producer and the receiving core the only
+ * consumer. Each descriptor is a request id (@ref IPC_MSG_TYPE_MESSAGE or
+ * @ref IPC_MSG_TYPE_FREE) and a pointer: posting one does not wait for the
+ * remote core.
+ *
+ * The remote core only needs to be notified when the ring goes from empty
+ * to non-empty: ipc_ring_post() tells the caller when this doorbell must be
+ * rung, and the receiving side calls ipc_ring_get() until the ring is empty.
+ * A doorbell may be reported for a descriptor the consumer has already seen,
+ * never the other way round.
+ *
+ * This module does not touch the hardware and can be built on the host.
+ *
+ * <table>
+ * <tr><th><b>Include file</b><td><tt> \#include "infra/ipc_ring.h"</tt>
+ * <tr><th><b>Source path</b> <td><tt>bsp/src/infra</tt>
+ * </table>
+ *
+ * @ingroup ipc
+ * @{
+ */
+
+/** Size of the storage of a ring, 21 descriptors on the 32-bit cores */
+#define IPC_RING_SIZE           256
+
+/** IPC descriptor */
+struct ipc_ring_desc {
+	/** Request id */
+	uint32_t request;
+	/** Request parameter, usually a message */
+	void *ptr;
+};
+
+/** IPC ring, to be placed in shared memory */
+struct ipc_ring {
+	/** Descriptor ring */
+	struct spsc_ring ring;
+	/** Set by the consumer once the ring is initialized */
+	uint32_t ready;
+	/** Ring storage */
+	uint8_t __aligned(4) buf[IPC_RING_SIZE];
+};
+
+/**
+ * Initialize a ring and allow the remote core to post to it.
+ *
+ * Called by the consumer before the producer can run.
+ *
+ * @param ipc_ring ring to initialize
+ */
+void ipc_ring_init(struct ipc_ring *ipc_ring);
+
+/**
+ * Post a descriptor. Producer side.
+ *
+ * Posts from several contexts of the producing core must be serialized by
+ * the caller.
+ *
+ * @param ipc_ring ring to post to
+ * @param request  request id
+ * @param ptr      request parameter
+ *
+ * @return 1 if the remote core must be notified, 0 if it will find the
+ *         descriptor by itself, -1 if the ring is full or not initialized
+ */
+int ipc_ring_post(struct ipc_ring *ipc_ring, uint32_t request, void *ptr);
+
+/**
+ * Get the oldest descriptor of the ring. Consumer side.
+ *
+ * @param ipc_ring ring to read from
+ * @param desc     filled with the descriptor
+ *
+ * @return 0 if a descriptor was read, -1 if the ring is empty
+ */
+int ipc_ring_get(struct ipc_ring *ipc_ring, struct ipc_ring_desc *desc);
+
+/** @} */
+
+#endif /* __IPC_RING_H__ */
@@ -167,6 +167,19 @@ void log_suspend();
  */
 void log_resume();
 
+#ifdef CONFIG_LOG_CBUFFER_DEFERRED
+/**
+ * Enable or disable deferred formatting of log messages.
+ *
+ * When enabled, which is the default, messages are stored unformatted and
+ * formatted by the logger task. Disabling it is mostly useful to compare
+ * both modes.
+ *
+ * @param enable true to defer message formatting to the logger task
+ */
+void log_set_deferred(bool enable);
+#endif
+
 /**
  * Log an error message.
  *
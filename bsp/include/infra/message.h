@@ -100,10 +100,12 @@ typedef enum {
  */
 struct msg_flags {
 	uint16_t f_prio : 8;            /*!< Priority */
-	uint16_t f_class : 3;           /*!< Class */
+	uint16_t f_class : 2;           /*!< Class */
 	uint16_t f_type : 2;            /*!< Type */
 	uint16_t f_queue_head : 1;      /*!< Insert at the queue head */
 	uint16_t f_is_job : 1;          /*!< Message is a job */
+	uint16_t f_is_shared : 1;       /*!< Message is reference counted */
+	uint16_t f_is_ref : 1;          /*!< Message is a reference on a shared message */
 };
 
 /**
@@ -139,6 +141,12 @@ struct message {
 #define MESSAGE_PRIO(msg)   (msg)->flags.f_prio
 /** Retrieve f_class flag of message */
 #define MESSAGE_CLASS(msg)  (msg)->flags.f_class
+
+/** Priority of regular messages */
+#define MESSAGE_PRIO_NORMAL 0
+/** Priority of latency critical messages (e.g. shutdown), dispatched before
+ * the pending regular messages of the destination port */
+#define MESSAGE_PRIO_HIGH   2
 /** Retrieve f_queue_head flag of message */
 #define MESSAGE_QUEUE_HEAD(msg)  (msg)->flags.f_queue_head
 
@@ -159,9 +167,30 @@ struct message *message_alloc(int size, OS_ERR_TYPE *err);
 /**
  * Free an allocated message
  *
- * @param message Message allocated with message_alloc()
+ * A shared message is only freed when its last reference is released.
+ *
+ * @param message Message allocated with message_alloc() or
+ *                message_alloc_shared()
  */
 void message_free(struct message *message);
 
+/**
+ * Allocate a reference counted message
+ *
+ * A shared message is delivered to several ports without being copied,
+ * using port_send_shared_message(). It holds one reference for the caller,
+ * to be released with message_free() once all the references are sent.
+ *
+ * @param size Size of the message to allocate.
+ *             This includes the header and the following data.
+ * @param err Pointer where to return the return code.
+ *            If `err` is NULL, the function will panic in case of allocation
+ *            failure.
+ *
+ * @return Address of the allocated message or
+ *         NULL if allocation failed and `err` != NULL
+ */
+struct message *message_alloc_shared(int size, OS_ERR_TYPE *err);
+
 /** @} */
 #endif /* __INFRA_MESSAGE_H_ */
@@ -100,6 +100,22 @@ void port_set_handler(uint16_t port_id, void (*handler)(struct	message *,
 							void *	priv),
 		      void *param);
 
+/**
+ * Get the message to process from a message retrieved from a queue.
+ *
+ * Messages sent with port_send_shared_message() are queued as references:
+ * the reference is freed and the shared message is returned. Other messages
+ * are returned as is. The returned message is freed with message_free().
+ *
+ * port_process_message() already does this, it is only needed when reading
+ * a port queue directly.
+ *
+ * @param msg Message retrieved from a queue
+ *
+ * @return the message to process
+ */
+struct message *port_resolve_message(struct message *msg);
+
 /**
  * Call the message handler attached to this port.
  *
@@ -112,6 +128,9 @@ void port_process_message(struct message *msg);
 /**
  * Send a message to the destination port set in the message.
  *
+ * The message is queued according to its priority (see MESSAGE_PRIO()), or
+ * at the queue head if its f_queue_head flag is set.
+ *
  * @param msg Message to send
  *
  * @return OS_ERR_TYPE error code
@@ -121,6 +140,20 @@ void port_process_message(struct message *msg);
  */
 int port_send_message(struct message *msg);
 
+/**
+ * Send a shared message to a port without copying it.
+ *
+ * A small reference on the message is sent instead, and the handler of the
+ * destination port receives the shared message itself. The shared message
+ * is freed when all the receivers and the sender have called message_free().
+ *
+ * @param msg Message allocated with message_alloc_shared()
+ * @param dst_port_id Port to send the message to
+ *
+ * @return OS_ERR_TYPE error code, see port_send_message()
+ */
+int port_send_shared_message(struct message *msg, uint16_t dst_port_id);
+
 /**
  * Set the port identifier of the given port.
  *
@@ -227,5 +260,51 @@ void set_cpu_message_sender(uint8_t cpu_id, int (*handler)(struct message *msg))
  * @param free_handler Callback used to request message free.
  */
 void set_cpu_free_handler(uint8_t cpu_id, void (*free_handler)(struct message *));
+
+/**
+ * Set the callback to be used to return a list of messages to a CPU.
+ *
+ * Once set, the messages of this CPU freed locally, except shared messages,
+ * are not returned one at a time: they are chained, then returned together
+ * when CONFIG_PORT_REMOTE_FREE_BATCH of them are pending, after
+ * CONFIG_PORT_REMOTE_FREE_DELAY_MS, or just before the next message sent to
+ * this CPU. The receiving CPU releases them with message_free_list().
+ *
+ * @param cpu_id CPU Id for which to set the handler.
+ * @param free_list_handler Callback used to return a list of messages.
+ */
+void set_cpu_free_list_handler(uint8_t cpu_id,
+			       void (*free_list_handler)(struct message *));
+
+/**
+ * Free a list of messages returned by another CPU.
+ *
+ * @param list First message of the list passed to the callback set by
+ *             set_cpu_free_list_handler().
+ */
+void message_free_list(struct message *list);
+
+/**
+ * Statistics of the messages returned to another CPU.
+ */
+struct port_remote_free_stats {
+	uint32_t pending;       /*!< Messages waiting to be returned */
+	uint32_t deferred;      /*!< Messages returned in a list */
+	uint32_t lists;         /*!< Lists returned */
+	uint32_t on_threshold;  /*!< Lists returned once full */
+	uint32_t on_timer;      /*!< Lists returned on timeout */
+	uint32_t on_send;       /*!< Lists returned ahead of a message */
+};
+
+/**
+ * Get the statistics of the messages returned to a CPU.
+ *
+ * @param cpu_id CPU Id owning the messages.
+ * @param[out] stats Address where to return the statistics.
+ * @param reset Reset the counters after reading them, except pending.
+ */
+void port_get_remote_free_stats(uint8_t cpu_id,
+				struct port_remote_free_stats *stats,
+				bool reset);
 /**@} */
 #endif /* __INFRA_PORT_H_ */
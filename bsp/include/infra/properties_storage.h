@@ -69,7 +69,9 @@ typedef enum {
 #define PROPERTIES_STORAGE_MAX_VALUE_LEN 512
 
 /** Maximum number of properties that can be stored in the store  */
+#ifndef PROPERTIES_STORAGE_MAX_NB_PROPERTIES
 #define PROPERTIES_STORAGE_MAX_NB_PROPERTIES 32
+#endif
 
 /**
  * Initialize the property storage.
@@ -160,6 +162,71 @@ properties_storage_status_t properties_storage_get_info(
  */
 properties_storage_status_t properties_storage_delete(uint32_t key);
 
+/**
+ * Statistics of one block of a properties storage partition.
+ */
+struct properties_storage_block_stats {
+	/** Sequence number of the block, 0xffffffff if the block is free */
+	uint32_t seq;
+	/** Bytes used by up-to-date properties */
+	uint32_t live_bytes;
+	/** Bytes used by obsolete entries, to be reclaimed by the compaction */
+	uint32_t obsolete_bytes;
+	/** Bytes which can still be written */
+	uint32_t free_bytes;
+	/** Number of erases of this block since boot */
+	uint32_t erase_count;
+};
+
+/**
+ * Statistics of a properties storage partition.
+ *
+ * The write amplification is (user_bytes + copied_bytes) / user_bytes.
+ */
+struct properties_storage_stats {
+	/** Number of blocks of the partition */
+	uint16_t nb_blocks;
+	/** Bytes which can be written before a synchronous compaction */
+	uint32_t free_bytes;
+	/** Bytes written by properties_storage_set() since boot */
+	uint32_t user_bytes;
+	/** Bytes copied by the compaction since boot */
+	uint32_t copied_bytes;
+	/** Number of compactions done synchronously in properties_storage_set()
+	 * because the background compaction didn't keep up */
+	uint32_t sync_compactions;
+};
+
+/**
+ * Run one step of the background compaction.
+ *
+ * The compaction reclaims the space used by obsolete entries once the free
+ * space drops below the configured low watermark. Each step copies at most one
+ * property, or erases one block, so that the caller can interleave it with
+ * other requests. It should be called until it returns false whenever the
+ * store has been modified.
+ *
+ * @return true if some compaction work remains to be done
+ */
+bool properties_storage_compact_step(void);
+
+/**
+ * Get usage and wear statistics of a properties storage partition.
+ *
+ * This function scans the whole partition, it is meant for diagnostics only.
+ *
+ * @param factory_reset_persistent Select the reset persistent partition
+ * @param stats Address where to return the partition statistics
+ * @param blocks Array where to return the statistics of each block
+ * @param nb_blocks Number of elements of blocks
+ *
+ * @return
+ *  - PROPERTIES_STORAGE_SUCCESS: Statistics returned
+ */
+properties_storage_status_t properties_storage_get_stats(
+	bool factory_reset_persistent, struct properties_storage_stats *stats,
+	struct properties_storage_block_stats *blocks, uint16_t nb_blocks);
+
 /** @} */
 
 #endif /* __PROPERTIES_STORAGE_H */
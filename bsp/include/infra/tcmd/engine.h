@@ -74,6 +74,25 @@ typedef void (*tcmd_rsp_cb_t)(const struct tcmd_response *);
  */
 void tcmd_send(char *command, tcmd_rsp_cb_t callback, void *data);
 
+/**
+ * Send several test commands synchronously
+ *
+ * The commands are separated by ';', CR or LF in the buffer, and are sent
+ * in turn as with @ref tcmd_send. Their responses are all passed to the
+ * callback, each command keeping its own invocation id. Only the last
+ * response of the batch is a final or error one: the completion of other
+ * commands is passed as a provisional "OK" or "ERROR" response.
+ *
+ * A buffer with a single command is sent as is.
+ *
+ * @param commands a null-terminated buffer containing the commands
+ * @param callback the function to call repeatedly until all commands are
+ *                 complete
+ * @param data opaque data to be passed back to the caller on each response
+ *
+ */
+void tcmd_send_batch(char *commands, tcmd_rsp_cb_t callback, void *data);
+
 #ifdef CONFIG_TCMD_ASYNC
 
 /**
@@ -96,8 +115,10 @@ void tcmd_async_init(T_QUEUE queue
 /**
  * Send a test command asynchronously
  *
- * Post a message in the queue provided at initialization to invoke tcmd_send
- * asynchronously.
+ * Post a message in the queue provided at initialization to invoke
+ * tcmd_send_batch asynchronously: a single message is posted for all the
+ * commands of a batch. On a master engine, a batch whose first command is
+ * prefixed by a slave name is sent as a whole to that slave.
  *
  * @param command a null-terminated buffer containing the command
  * @param callback the function to call repeatedly until command is complete
@@ -31,6 +31,8 @@
 #ifndef _TCMD_INFRA_HANDLER_H
 #define _TCMD_INFRA_HANDLER_H
 
+#include <stdint.h>
+
 #include "infra/tcmd/defines.h"
 #include "util/compiler.h"
 
@@ -76,6 +78,10 @@ struct tcmd_handler {
 	const char *group;
 	const char *name;
 	void (*run)(int, char **, struct tcmd_handler_ctx *);
+	/** Length of group, computed at build time */
+	uint8_t group_len;
+	/** Length of name, computed at build time */
+	uint8_t name_len;
 };
 
 /**
@@ -93,6 +99,10 @@ struct tcmd_handler {
  *         }
  *     }
  *     INSERT BEFORE .rodata;
+ *
+ * Each handler is stored in a ".test_cmds.<group>.<name>" section: as '.'
+ * sorts before any character of a C identifier, SORT() builds a table
+ * ordered by group, then by name, that the engine looks up by dichotomy.
  */
 
 #ifdef CONFIG_TCMD
@@ -112,8 +122,9 @@ struct tcmd_handler {
  * either the group or name */
 #define _DECLARE_TEST_COMMAND_PRESCAN(group, name, handler) \
 	const struct tcmd_handler __test_cmd_ ## group ## _ ## name   \
-	__section(".test_cmds." # group # name)	   \
-		= { # group, # name, handler }
+	__section(".test_cmds." # group "." # name)	   \
+		= { # group, # name, handler,		   \
+		    sizeof(# group) - 1, sizeof(# name) - 1 }
 
 #else
 /**
@@ -33,6 +33,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "util/compiler.h"
+#include "infra/ipc_ring.h"
 
 #define CPU_ID_QUARK  0
 #define CPU_ID_ARC  1
@@ -113,6 +114,13 @@ struct platform_shared_block_ {
 
 	/** reserved for user application */
 	uint8_t user_reverved;
+
+	/** IPC descriptor rings, see @ref ipc_ring.
+	 * The QRK to ARC ring is initialized by ARC before it sets arc_ready,
+	 * the ARC to QRK ring by QRK before it starts ARC.
+	 */
+	struct ipc_ring ipc_ring_qrk_ss;
+	struct ipc_ring ipc_ring_ss_qrk;
 };
 
 #define RAM_START           0xA8000000
@@ -159,6 +167,10 @@ static volatile uint32_t __unused *board_features =
 #define IPC_QRK_SS_ACK 1
 #define IPC_QRK_SS_ASYNC 7
 
+/* IPC ring doorbells */
+#define IPC_QRK_SS_RING 2
+#define IPC_SS_QRK_RING 3
+
 /* I2C */
 /*!
  * List of all controllers in system ( IA and SS )
@@ -43,6 +43,8 @@ typedef struct flash_partition {
 	uint16_t start_block;   /* within the flash */
 	uint16_t end_block;     /* must fit within the same flash*/
 	uint8_t factory_reset_state; /* partition data status during factory erase */
+	uint8_t cacheable;      /* only written through the ll_storage service,
+				 * its reads may be cached */
 } flash_partition_t;
 
 typedef struct flash_device {
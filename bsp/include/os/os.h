@@ -597,13 +597,18 @@ void enable_scheduling(void);
  *
  * The maximum number of mutexes is defined by \c QUEUE_POOL_SIZE.
  *
+ * Messages are dequeued by decreasing priority, and in FIFO order within a
+ * priority. There are \c QUEUE_PRIO_COUNT priorities.
+ *
  * Function name                | Task ctxt | Fiber ctxt| Interrupt |
  * -----------------------------|:---------:|:---------:|:---------:|
  * @ref queue_delete            |     X     |     X     |           |
  * @ref queue_create            |     X     |     X     |           |
  * @ref queue_get_message       |     X     |     X     |           |
  * @ref queue_send_message      |     X     |     X     |     X     |
+ * @ref queue_send_message_prio |     X     |     X     |     X     |
  * @ref queue_send_message_head |     X     |     X     |     X     |
+ * @ref queue_get_stats         |     X     |     X     |     X     |
  *
  * @{
  */
@@ -611,6 +616,25 @@ void enable_scheduling(void);
 /** Maximum number of queues */
 #define QUEUE_POOL_SIZE             (10)
 
+/** Number of message priorities */
+#define QUEUE_PRIO_COUNT            (4)
+
+/** Priority of the messages sent with @ref queue_send_message */
+#define QUEUE_PRIO_DEFAULT          (0)
+
+/**
+ * Queue statistics, since the queue creation or the last reset.
+ *
+ * Latencies are the time spent by messages in the queue, in 32kHz ticks.
+ */
+struct queue_stats {
+	uint32_t depth;                         /**< Current number of messages */
+	uint32_t high_watermark;                /**< Maximum number of messages */
+	uint32_t count[QUEUE_PRIO_COUNT];       /**< Dequeued messages per priority */
+	uint32_t total_latency[QUEUE_PRIO_COUNT]; /**< Sum of latencies per priority */
+	uint32_t max_latency[QUEUE_PRIO_COUNT]; /**< Maximum latency per priority */
+};
+
 /**
  * Create a message queue.
  *
@@ -720,6 +744,49 @@ void queue_send_message(T_QUEUE queue, T_QUEUE_MESSAGE message,
 void queue_send_message_head(T_QUEUE queue, T_QUEUE_MESSAGE message,
 			     OS_ERR_TYPE *err);
 
+/**
+ * Send a message to a queue with a priority.
+ *
+ * Send/queue a message after all the messages of the same or higher priority,
+ * and before the messages of lower priority.
+ *
+ * @warning This service may panic if err parameter is NULL and:
+ * - queue parameter is invalid, or
+ * - the queue is already full.
+ *
+ * <b>Authorized execution levels:</b>  task, fiber, ISR.
+ *
+ * @param queue Handle of the queue (as returned by @ref queue_create).
+ *
+ * @param[in] message  Pointer to the message to send.
+ *
+ * @param prio Priority of the message, from @ref QUEUE_PRIO_DEFAULT (lowest)
+ *             to QUEUE_PRIO_COUNT - 1 (highest). Higher values are saturated.
+ *
+ * @param[out] err   Execution status:
+ *          - E_OS_OK  The message was sent,
+ *          - E_OS_ERR_OVERFLOW The queue is full (message was not posted),
+ *          - E_OS_ERR Invalid parameter.
+ */
+void queue_send_message_prio(T_QUEUE queue, T_QUEUE_MESSAGE message,
+			     uint8_t prio, OS_ERR_TYPE *err);
+
+#ifdef CONFIG_QUEUE_STATS
+/**
+ * Get the statistics of a queue.
+ *
+ * <b>Authorized execution levels:</b>  task, fiber, ISR.
+ *
+ * @param queue Handle of the queue (as returned by @ref queue_create).
+ *
+ * @param[out] stats Address where to return the statistics.
+ *
+ * @param reset Reset the high watermark and latency counters after reading
+ *              them.
+ */
+void queue_get_stats(T_QUEUE queue, struct queue_stats *stats, bool reset);
+#endif
+
 /**
  * @}
  */
@@ -877,6 +944,7 @@ void timer_delete(T_TIMER tmr);
  * --------------------|:---------:|:---------:|:---------:|
  * @ref balloc         |     X     |     X     |     X     |
  * @ref bfree          |     X     |     X     |     X     |
+ * @ref bfree_bulk     |     X     |     X     |     X     |
  *
  * @{
  */
@@ -928,6 +996,23 @@ void *balloc(uint32_t size, OS_ERR_TYPE *err);
  */
 OS_ERR_TYPE bfree(void *buffer);
 
+/**
+ * Free several blocks of memory.
+ *
+ * <b>Authorized execution levels:</b>  task, fiber, ISR.
+ *
+ * Same as calling @ref bfree on each block, with interrupts locked once for
+ * the whole list.
+ *
+ * @param buffers Pointers returned by @ref balloc.
+ * @param count   Number of pointers in buffers.
+ *
+ * @return Execution status:
+ *    - E_OS_OK All blocks were successfully freed,
+ *    - E_OS_ERR At least one pointer did not match any reserved block.
+ */
+OS_ERR_TYPE bfree_bulk(void **buffers, int count);
+
 
 /**
  * @}
@@ -44,7 +44,8 @@
  *
  * @param elt_size    the size of each element
  * @param block_first the index of the storage first block in the flash
- * @param block_count the number of blocks used
+ * @param block_count the number of blocks used, including the checkpoint
+ *                    block when CONFIG_CSTORAGE_FLASH_SPI_CHECKPOINT is set
  *
  * @return The storage handler (that must be freed later by the caller)
  *         NULL if an error occured
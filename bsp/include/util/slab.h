@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __SLAB_H__
+#define __SLAB_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @defgroup slab Slab allocator
+ * Allocator of fixed-size blocks with O(1) allocation and release.
+ *
+ * A slab hands out blocks of one size from a storage area provided by its
+ * owner. Free blocks are tracked in a two-level bitmap: one bit per block,
+ * and one summary bit per 32-block map word that holds a free block, so
+ * slab_alloc() and slab_free() need one find-first-set per level whatever
+ * the slab size. The bitmaps are updated with interrupts locked, so blocks
+ * can be allocated and released from any context.
+ *
+ * Each slab keeps usage statistics, displayed by the "dbg slab" test
+ * command for all initialized slabs.
+ *
+ * Sample blocks are reference counted slab blocks: the producer allocates
+ * one, each consumer keeping its data takes a reference, and the block goes
+ * back to its slab when the last reference is dropped. This lets several
+ * consumers share the same data without copying it.
+ *
+ * <table>
+ * <tr><th><b>Include file</b><td><tt> \#include "util/slab.h"</tt>
+ * <tr><th><b>Source path</b> <td><tt>bsp/src/util</tt>
+ * </table>
+ *
+ * @ingroup infra
+ * @{
+ */
+
+/** Largest number of blocks in a slab */
+#define SLAB_MAX_BLOCKS         1024
+
+/** Number of 32-bit words of the map of a slab of count blocks */
+#define SLAB_MAP_WORDS(count)   (((count) + 31) / 32)
+
+struct slab_stats {
+	/** Size of the blocks */
+	uint16_t block_size;
+	/** Number of blocks */
+	uint16_t count;
+	/** Blocks currently allocated */
+	uint16_t used;
+	/** Highest number of blocks allocated at the same time */
+	uint16_t max_used;
+	/** Successful allocations */
+	uint32_t allocs;
+	/** Allocations failed because the slab was full */
+	uint32_t fails;
+};
+
+struct slab {
+	/** Name displayed by the test command */
+	const char *name;
+	/** Storage of the blocks */
+	uint8_t *buf;
+	/** One bit set per free block */
+	uint32_t *map;
+	/** One bit set per map word holding a free block */
+	uint32_t summary;
+	/** Usage statistics */
+	struct slab_stats stats;
+	/** Next initialized slab */
+	struct slab *next;
+};
+
+/**
+ * Initialize a slab, with all its blocks free.
+ *
+ * @param slab       slab to initialize
+ * @param name       name of the slab, for statistics
+ * @param buf        storage of block_size * count bytes, 4-byte aligned
+ * @param block_size size of the blocks, a non-zero multiple of 4
+ * @param count      number of blocks, at most SLAB_MAX_BLOCKS
+ * @param map        SLAB_MAP_WORDS(count) words for the free block map
+ *
+ * @return 0 if no error, -1 if a parameter is not valid
+ */
+int slab_init(struct slab *slab, const char *name, void *buf,
+	      uint16_t block_size, uint16_t count, uint32_t *map);
+
+/**
+ * Allocate a block.
+ *
+ * @param slab slab to allocate from
+ *
+ * @return pointer on the block, or NULL if all blocks are allocated
+ */
+void *slab_alloc(struct slab *slab);
+
+/**
+ * Release a block.
+ *
+ * @param slab  slab the block was allocated from
+ * @param block block returned by slab_alloc()
+ *
+ * @return 0 if no error, -1 if block is not an allocated block of slab
+ */
+int slab_free(struct slab *slab, void *block);
+
+/**
+ * Check whether a pointer lies in the storage of a slab.
+ *
+ * @param slab slab to check
+ * @param ptr  pointer to check
+ *
+ * @return true if ptr points into a block of slab
+ */
+bool slab_contains(const struct slab *slab, const void *ptr);
+
+/**
+ * Get the usage statistics of a slab.
+ *
+ * @param slab  slab to query
+ * @param stats filled with the statistics
+ */
+void slab_get_stats(const struct slab *slab, struct slab_stats *stats);
+
+/** Reference counted block of samples */
+struct sample_block {
+	/** Slab the block was allocated from */
+	struct slab *slab;
+	/** Bytes of data in use, managed by the producer */
+	uint16_t len;
+	/** Number of references */
+	uint16_t refs;
+	/** Sample data */
+	uint8_t data[] __attribute__((aligned(4)));
+};
+
+/** Slab block size for sample blocks of len bytes of data */
+#define SAMPLE_BLOCK_SIZE(len)  ((sizeof(struct sample_block) + (len) + 3) & ~3)
+
+/**
+ * Allocate a sample block holding one reference.
+ *
+ * @param slab slab to allocate from
+ *
+ * @return the block, with len set to 0, or NULL if slab is full
+ */
+struct sample_block *sample_block_alloc(struct slab *slab);
+
+/**
+ * Get the number of data bytes a sample block can hold.
+ *
+ * @param block sample block
+ *
+ * @return the capacity of block
+ */
+static inline uint16_t sample_block_capacity(const struct sample_block *block)
+{
+	return block->slab->stats.block_size - sizeof(struct sample_block);
+}
+
+/**
+ * Take a reference on a sample block.
+ *
+ * @param block sample block
+ *
+ * @return block
+ */
+struct sample_block *sample_block_get(struct sample_block *block);
+
+/**
+ * Drop a reference on a sample block, releasing it with the last one.
+ *
+ * @param block sample block
+ */
+void sample_block_put(struct sample_block *block);
+
+/** @} */
+
+#endif /* __SLAB_H__ */
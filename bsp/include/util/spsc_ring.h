@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SPSC_RING_H__
+#define __SPSC_RING_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @defgroup spsc_ring SPSC ring
+ * Lock-free single-producer / single-consumer ring of framed records.
+ *
+ * The producer owns the head index and the consumer owns the tail index:
+ * both are free-running 32-bit counters published with release semantics,
+ * so one producer context and one consumer context (e.g. an interrupt and a
+ * task, or two tasks) can use the ring concurrently without locking.
+ *
+ * Every record is prefixed by a 4-byte header holding its length and is
+ * stored contiguously: when a record does not fit before the end of the
+ * buffer, the remaining bytes are skipped with a padding record. Producers
+ * can thus write in place (spsc_ring_reserve() / spsc_ring_commit()) and
+ * consumers can read in place (spsc_ring_peek() / spsc_ring_release()),
+ * and readers never need to search for message boundaries.
+ *
+ * Records are 4-byte aligned. A record of up to
+ * SPSC_RING_MAX_RECORD(size) bytes is guaranteed to fit in an empty ring.
+ *
+ * <table>
+ * <tr><th><b>Include file</b><td><tt> \#include "util/spsc_ring.h"</tt>
+ * <tr><th><b>Source path</b> <td><tt>bsp/src/util</tt>
+ * </table>
+ *
+ * @ingroup infra
+ * @{
+ */
+
+/** Size of the header prefixing each record */
+#define SPSC_RING_HDR_SIZE      4
+
+/** Largest record guaranteed to fit in an empty ring of the given size */
+#define SPSC_RING_MAX_RECORD(size) ((size) / 2 - SPSC_RING_HDR_SIZE)
+
+struct spsc_ring {
+	/** Storage, 4-byte aligned */
+	uint8_t *buf;
+	/** Storage size, a power of two */
+	uint32_t size;
+	/** Write index, only modified by the producer */
+	uint32_t head;
+	/** Read index, only modified by the consumer */
+	uint32_t tail;
+	/** Padding inserted by the pending reservation, producer private */
+	uint32_t pad;
+};
+
+/**
+ * Initialize a ring.
+ *
+ * @param ring ring to initialize
+ * @param buf  storage of the ring, 4-byte aligned
+ * @param size size of buf, a power of two and at least 16 bytes
+ *
+ * @return 0 if no error, -1 if size or buf are not valid
+ */
+int spsc_ring_init(struct spsc_ring *ring, uint8_t *buf, uint32_t size);
+
+/**
+ * Reserve room for a record. Producer side.
+ *
+ * The record is not visible to the consumer until spsc_ring_commit() is
+ * called. Only one reservation may be pending at a time.
+ *
+ * @param ring ring to write into
+ * @param len  maximum length of the record
+ *
+ * @return pointer on len contiguous bytes, or NULL if the ring is full
+ */
+void *spsc_ring_reserve(struct spsc_ring *ring, uint32_t len);
+
+/**
+ * Publish the record of the pending reservation. Producer side.
+ *
+ * @param ring ring to write into
+ * @param len  actual length of the record, at most the reserved length
+ */
+void spsc_ring_commit(struct spsc_ring *ring, uint32_t len);
+
+/**
+ * Copy a record into the ring. Producer side.
+ *
+ * @param ring ring to write into
+ * @param data record contents
+ * @param len  length of the record
+ *
+ * @return 0 if no error, -1 if the ring is full
+ */
+int spsc_ring_push(struct spsc_ring *ring, const void *data, uint32_t len);
+
+/**
+ * Get the oldest record of the ring. Consumer side.
+ *
+ * The record stays in the ring until spsc_ring_release() is called.
+ *
+ * @param ring ring to read from
+ * @param len  filled with the length of the record
+ *
+ * @return pointer on the record, or NULL if the ring is empty
+ */
+void *spsc_ring_peek(struct spsc_ring *ring, uint32_t *len);
+
+/**
+ * Remove the record returned by spsc_ring_peek(). Consumer side.
+ *
+ * @param ring ring to read from
+ */
+void spsc_ring_release(struct spsc_ring *ring);
+
+/**
+ * Copy the oldest record out of the ring and remove it. Consumer side.
+ *
+ * @param ring ring to read from
+ * @param data buffer receiving the record
+ * @param size size of data, a longer record is truncated
+ *
+ * @return the length of the record, or -1 if the ring is empty
+ */
+int spsc_ring_pop(struct spsc_ring *ring, void *data, uint32_t size);
+
+/**
+ * Check whether the ring holds no record.
+ *
+ * @param ring ring to check
+ *
+ * @return true if the ring is empty
+ */
+bool spsc_ring_is_empty(const struct spsc_ring *ring);
+
+/** @} */
+
+#endif /* __SPSC_RING_H__ */
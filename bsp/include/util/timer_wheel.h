@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @defgroup timer_wheel Timer wheel
+ * Hierarchical timer wheel used to sort active timers.
+ *
+ * The wheel has TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots each.
+ * A slot of level n covers 16^n milliseconds, so the 8 levels span the
+ * whole 32-bit millisecond range. Adding and removing a timer is O(1),
+ * timers are moved down one level at a time when their slot is reached,
+ * and the next expiration is found with one bitmap scan per level.
+ *
+ * The wheel does not lock: callers must serialize all the calls.
+ *
+ * <table>
+ * <tr><th><b>Include file</b><td><tt> \#include "util/timer_wheel.h"</tt>
+ * <tr><th><b>Source path</b> <td><tt>bsp/src/util</tt>
+ * </table>
+ *
+ * @ingroup infra
+ * @{
+ */
+
+#define TIMER_WHEEL_LEVEL_BITS 4
+#define TIMER_WHEEL_SLOTS      (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_LEVELS     (32 / TIMER_WHEEL_LEVEL_BITS)
+
+/** Timer wheel element, to be embedded in the timer descriptor */
+struct timer_wheel_node {
+	struct timer_wheel_node *next;
+	struct timer_wheel_node *prev;
+	/** Expiration date in ms, to be set before timer_wheel_add() */
+	uint32_t expiration;
+	/** Index of the slot holding the node */
+	uint8_t slot;
+};
+
+struct timer_wheel {
+	struct timer_wheel_node *slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+	/** Bitmap of non empty slots for each level */
+	uint16_t pending[TIMER_WHEEL_LEVELS];
+	/** Date up to which the wheel has been processed */
+	uint32_t base;
+};
+
+/**
+ * Initialize an empty timer wheel.
+ *
+ * @param w   Timer wheel to initialize
+ * @param now Current date in ms
+ */
+void timer_wheel_init(struct timer_wheel *w, uint32_t now);
+
+/**
+ * Insert a timer in the wheel according to its expiration date.
+ *
+ * An expiration date already in the past makes the timer expire on the
+ * next call to timer_wheel_get_expired().
+ *
+ * @param w    Timer wheel
+ * @param node Timer to insert, with node->expiration set
+ */
+void timer_wheel_add(struct timer_wheel *w, struct timer_wheel_node *node);
+
+/**
+ * Remove a timer from the wheel.
+ *
+ * @param w    Timer wheel
+ * @param node Timer to remove, must be in the wheel
+ */
+void timer_wheel_remove(struct timer_wheel *w, struct timer_wheel_node *node);
+
+/**
+ * Return an expired timer.
+ *
+ * The timer is left in the wheel, the caller is expected to remove it
+ * (and possibly add it again) before calling this function again.
+ *
+ * @param w   Timer wheel
+ * @param now Current date in ms
+ *
+ * @return a timer whose expiration date is before or at now, NULL if none
+ */
+struct timer_wheel_node *timer_wheel_get_expired(struct timer_wheel *w,
+						 uint32_t now);
+
+/**
+ * Get the expiration date of the next timer to expire.
+ *
+ * @param w          Timer wheel
+ * @param expiration (out) expiration date of the next timer
+ *
+ * @return false if the wheel is empty
+ */
+bool timer_wheel_next_expiration(struct timer_wheel *w, uint32_t *expiration);
+
+/** @} */
+
+#endif /* __TIMER_WHEEL_H__ */
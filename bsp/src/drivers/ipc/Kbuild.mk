@@ -1 +1,2 @@
 obj-$(CONFIG_IPC_UART_NS16550) += ipc_uart_ns16550.o
+obj-$(CONFIG_IPC_UART_NS16550) += ipc_uart_rx.o
@@ -29,6 +29,7 @@
  */
 
 #include "drivers/ipc_uart_ns16550.h"
+#include "drivers/ipc_uart_rx.h"
 #include <uart.h>
 #include <init.h>
 
@@ -36,6 +37,7 @@
 #include "machine.h"
 
 #include "util/assert.h"
+#include "util/compiler.h"
 #include "infra/log.h"
 #include "infra/ipc_requests.h"
 #include "panic_quark_se.h"
@@ -46,22 +48,13 @@ enum {
 	STATUS_TX_DONE,
 };
 
-enum {
-	STATUS_RX_IDLE = 0,
-	STATUS_RX_HDR,
-	STATUS_RX_DATA
-};
-
 struct ipc_uart {
 	uint8_t *tx_data;
-	uint8_t *rx_ptr;
+	struct ipc_uart_rx rx;
 	struct ipc_uart_channels channels[IPC_UART_MAX_CHANNEL];
 	struct ipc_uart_header tx_hdr;
-	struct ipc_uart_header rx_hdr;
 	uint16_t send_counter;
-	uint16_t rx_size;
 	uint8_t tx_state;
-	uint8_t rx_state;
 	uint8_t uart_enabled;
 	/* protect against multiple wakelock and wake assert calls */
 	uint8_t tx_wakelock_acquired;
@@ -71,6 +64,9 @@ struct ipc_uart {
 
 static struct ipc_uart ipc = {};
 
+/* Received frames, filled in place by the interrupt */
+static uint8_t __aligned(4) rx_ring_buf[CONFIG_IPC_UART_RX_RING_SIZE];
+
 DEFINE_LOG_MODULE(LOG_MODULE_IPC, " IPC")
 
 static bool ipc_uart_allow_sleep(void)
@@ -194,31 +190,51 @@ static int ipc_uart_ns16550_init(struct td_device *dev)
 	ipc.uart_enabled = 0;
 	ipc.tx_wakelock_acquired = 0;
 
-	/* Initialize the reception pointer */
-	ipc.rx_size = sizeof(ipc.rx_hdr);
-	ipc.rx_ptr = (uint8_t *)&ipc.rx_hdr;
-	ipc.rx_state = STATUS_RX_IDLE;
+	/* Initialize the reception state */
+	if (ipc_uart_rx_init(&ipc.rx, rx_ring_buf, sizeof(rx_ring_buf)))
+		return -1;
 
 	return 0;
 }
 
+static bool ipc_uart_channel_valid(int channel)
+{
+	return (channel < IPC_UART_MAX_CHANNEL) &&
+	       (ipc.channels[channel].cb != NULL);
+}
+
 static void ipc_uart_push_frame(uint16_t len, uint8_t *p_data)
 {
 	pr_debug(LOG_MODULE_IPC, "push_frame: received:frame len: %d, p_data: "
-		 "len %d, src %d, channel %d", ipc.rx_hdr.len, len,
-		 ipc.rx_hdr.src_cpu_id,
-		 ipc.rx_hdr.channel);
+		 "len %d, src %d, channel %d", ipc.rx.hdr.len, len,
+		 ipc.rx.hdr.src_cpu_id,
+		 ipc.rx.hdr.channel);
 
-	if ((ipc.rx_hdr.channel < IPC_UART_MAX_CHANNEL) &&
-	    (ipc.channels[ipc.rx_hdr.channel].cb != NULL)) {
-		ipc.channels[ipc.rx_hdr.channel].cb(ipc.rx_hdr.channel,
+	if (ipc_uart_channel_valid(ipc.rx.hdr.channel)) {
+		ipc.channels[ipc.rx.hdr.channel].cb(ipc.rx.hdr.channel,
 						    IPC_MSG_TYPE_MESSAGE,
 						    len,
 						    p_data);
 	} else {
-		bfree(p_data);
+		ipc_uart_rx_free(&ipc.rx, p_data);
 		pr_error(LOG_MODULE_IPC, "uart_ipc: bad channel %d",
-			 ipc.rx_hdr.channel);
+			 ipc.rx.hdr.channel);
+	}
+}
+
+/*
+ * Frames of all the channels are drained together: wake up the first open
+ * channel, frames of closed channels are dropped by ipc_uart_ns16550_rx_drain.
+ */
+static void ipc_uart_notify_frames(void)
+{
+	int i;
+
+	for (i = 0; i < IPC_UART_MAX_CHANNEL; i++) {
+		if (ipc.channels[i].cb) {
+			ipc.channels[i].cb(i, IPC_MSG_TYPE_RX_READY, 0, NULL);
+			return;
+		}
 	}
 }
 
@@ -241,58 +257,42 @@ void ipc_uart_isr()
 			assert(err == 0);
 		} else if (uart_irq_rx_ready(info->uart_dev)) {
 			int rx_cnt;
+			int rx_ev;
 
 			while ((rx_cnt =
 					uart_fifo_read(info->uart_dev,
-						       ipc.rx_ptr,
-						       ipc.rx_size)) != 0) {
-				if ((ipc.uart_enabled) &&
-				    (ipc.rx_state == STATUS_RX_IDLE)) {
+						       ipc.rx.ptr,
+						       ipc.rx.size)) != 0) {
+				/* Until UART has enabled at least one channel, data should be discarded */
+				if (!ipc.uart_enabled)
+					continue;
+
+				rx_ev = ipc_uart_rx_recv(&ipc.rx, rx_cnt);
+
+				if (rx_ev & IPC_UART_RX_START)
 					/* acquire wakelock until frame is fully received */
 					pm_wakelock_acquire(&info->rx_wl);
-					ipc.rx_state = STATUS_RX_HDR;
-				}
 
-				/* Until UART has enabled at least one channel, data should be discarded */
-				if (ipc.uart_enabled) {
-					ipc.rx_size -= rx_cnt;
-					ipc.rx_ptr += rx_cnt;
-				}
-
-				if (ipc.rx_size == 0) {
-					if (ipc.rx_state == STATUS_RX_HDR) {
-						assert(ipc.rx_hdr.len != 0);
-						ipc.rx_ptr = balloc(
-							ipc.rx_hdr.len, NULL);
-						ipc.rx_size = ipc.rx_hdr.len;
-						ipc.rx_state = STATUS_RX_DATA;
-					} else {
+				if (rx_ev & IPC_UART_RX_ALLOC) {
 #ifdef IPC_UART_DBG_RX
-						uint8_t *p_rx = ipc.rx_ptr -
-								ipc.rx_hdr.len;
-						for (int i = 0;
-						     i < ipc.ipc.rx_hdr.len;
-						     i++) {
-							pr_debug(
-								LOG_MODULE_IPC,
-								"ipc_uart_isr: %d byte is %d",
-								i, p_rx[i]);
-						}
-#endif
-
-						ipc_uart_push_frame(
-							ipc.rx_hdr.len,
-							ipc.rx_ptr -
-							ipc.rx_hdr.len);
-						ipc.rx_size = sizeof(ipc.rx_hdr);
-						ipc.rx_ptr =
-							(uint8_t *)&ipc.rx_hdr;
-						ipc.rx_state = STATUS_RX_IDLE;
-						/* Frame received, release wakelock */
-						pm_wakelock_release(
-							&info->rx_wl);
+					for (int i = 0; i < ipc.rx.hdr.len;
+					     i++) {
+						pr_debug(
+							LOG_MODULE_IPC,
+							"ipc_uart_isr: %d byte is %d",
+							i, ipc.rx.frame[i]);
 					}
+#endif
+					ipc_uart_push_frame(ipc.rx.hdr.len,
+							    ipc.rx.frame);
+				} else if (rx_ev & IPC_UART_RX_NOTIFY) {
+					/* Consumer is idle, wake it up */
+					ipc_uart_notify_frames();
 				}
+
+				if (rx_ev & IPC_UART_RX_DONE)
+					/* Frame received, release wakelock */
+					pm_wakelock_release(&info->rx_wl);
 			}
 		} else if (uart_irq_tx_ready(info->uart_dev)) {
 			int tx_len;
@@ -422,6 +422,39 @@ int ipc_uart_ns16550_send_pdu(struct td_device *dev, void *handle, int len,
 	return IPC_UART_ERROR_OK;
 }
 
+int ipc_uart_ns16550_rx_drain(struct td_device *dev,
+			       void (*cb)(int chan, int len, void *data))
+{
+	struct ipc_uart_header hdr;
+	void *p_data;
+	int count = 0;
+
+	ipc_uart_rx_rearm(&ipc.rx);
+
+	while ((p_data = ipc_uart_rx_get(&ipc.rx, &hdr)) != NULL) {
+		if (ipc_uart_channel_valid(hdr.channel)) {
+			cb(hdr.channel, hdr.len, p_data);
+			count++;
+		} else {
+			pr_error(LOG_MODULE_IPC, "uart_ipc: bad channel %d",
+				 hdr.channel);
+		}
+		ipc_uart_rx_release(&ipc.rx);
+	}
+	return count;
+}
+
+void ipc_uart_ns16550_rx_free(struct td_device *dev, void *p_data)
+{
+	ipc_uart_rx_free(&ipc.rx, p_data);
+}
+
+void ipc_uart_ns16550_get_rx_stats(struct td_device *dev,
+				   struct ipc_uart_rx_stats *stats, bool reset)
+{
+	ipc_uart_rx_get_stats(&ipc.rx, stats, reset);
+}
+
 void ipc_uart_ns16550_set_tx_cb(struct td_device *dev, void (*cb)(bool, void *),
 				void *param)
 {
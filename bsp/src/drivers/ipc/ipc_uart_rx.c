@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include "drivers/ipc_uart_rx.h"
+#include "os/os.h"
+#include "util/compiler.h"
+
+enum {
+	RX_IDLE = 0,
+	RX_HDR,
+	RX_RING,
+	RX_ALLOC
+};
+
+/*
+ * Record of the ring: the payload follows the record, or is in a buffer
+ * allocated when the frame did not fit. Packed so that the payload stays
+ * 4-byte aligned whatever the size of a pointer.
+ */
+struct rx_record {
+	struct ipc_uart_header hdr;
+	uint8_t *data;
+} __packed;
+
+/*
+ * The producer queues a frame then looks at the notified flag, the consumer
+ * clears the flag then looks at the ring. A full barrier between the store
+ * and the load of each side guarantees that either the consumer finds the
+ * new frame, or the producer finds the flag cleared and requests a wakeup.
+ */
+#define rx_fence()              __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+int ipc_uart_rx_init(struct ipc_uart_rx *rx, uint8_t *buf, uint32_t size)
+{
+	memset(rx, 0, sizeof(*rx));
+	if (spsc_ring_init(&rx->ring, buf, size))
+		return -1;
+
+	rx->ptr = (uint8_t *)&rx->hdr;
+	rx->size = sizeof(rx->hdr);
+	rx->state = RX_IDLE;
+	return 0;
+}
+
+static void rx_frame_start(struct ipc_uart_rx *rx)
+{
+	uint32_t len = rx->hdr.len;
+	struct rx_record *rec = NULL;
+
+	/* Allocated frames not returned yet must be processed first */
+	if (!__atomic_load_n(&rx->backlog, __ATOMIC_ACQUIRE) &&
+	    len <= SPSC_RING_MAX_RECORD(rx->ring.size) - sizeof(*rec))
+		rec = spsc_ring_reserve(&rx->ring, sizeof(*rec) + len);
+
+	if (rec) {
+		rx->frame = (uint8_t *)&rec[1];
+		rx->state = RX_RING;
+	} else {
+		rx->frame = balloc(len, NULL);
+		rx->stats.allocated++;
+		rx->state = RX_ALLOC;
+	}
+	rx->ptr = rx->frame;
+	rx->size = len;
+}
+
+static int rx_frame_done(struct ipc_uart_rx *rx)
+{
+	int ret = IPC_UART_RX_DONE;
+	struct rx_record *rec = NULL;
+	uint32_t len = sizeof(*rec);
+
+	if (rx->state == RX_RING) {
+		rec = (struct rx_record *)rx->frame - 1;
+		len += rx->hdr.len;
+	} else if (!__atomic_load_n(&rx->backlog, __ATOMIC_ACQUIRE)) {
+		/* The ring may have been drained while receiving the frame */
+		rec = spsc_ring_reserve(&rx->ring, len);
+	}
+
+	if (rec) {
+		rec->hdr = rx->hdr;
+		rec->data = rx->frame;
+		spsc_ring_commit(&rx->ring, len);
+		rx->stats.frames++;
+		rx_fence();
+		if (!__atomic_exchange_n(&rx->notified, 1, __ATOMIC_ACQ_REL)) {
+			rx->stats.notified++;
+			ret |= IPC_UART_RX_NOTIFY;
+		}
+	} else {
+		/* Deliver it apart, the next frames wait until it is freed */
+		__atomic_add_fetch(&rx->backlog, 1, __ATOMIC_RELEASE);
+		rx->stats.overflows++;
+		ret |= IPC_UART_RX_ALLOC;
+	}
+
+	rx->ptr = (uint8_t *)&rx->hdr;
+	rx->size = sizeof(rx->hdr);
+	rx->state = RX_IDLE;
+	return ret;
+}
+
+int ipc_uart_rx_recv(struct ipc_uart_rx *rx, int count)
+{
+	int ret = 0;
+
+	if (count <= 0)
+		return 0;
+
+	if (rx->state == RX_IDLE) {
+		rx->state = RX_HDR;
+		ret |= IPC_UART_RX_START;
+	}
+
+	rx->ptr += count;
+	rx->size -= count;
+	if (rx->size)
+		return ret;
+
+	if (rx->state == RX_HDR) {
+		rx_frame_start(rx);
+		/* An empty frame is complete with its header */
+		if (rx->size)
+			return ret;
+	}
+	return ret | rx_frame_done(rx);
+}
+
+void ipc_uart_rx_rearm(struct ipc_uart_rx *rx)
+{
+	__atomic_store_n(&rx->notified, 0, __ATOMIC_RELEASE);
+	rx_fence();
+}
+
+void *ipc_uart_rx_get(struct ipc_uart_rx *rx, struct ipc_uart_header *hdr)
+{
+	uint32_t len;
+	struct rx_record *rec = spsc_ring_peek(&rx->ring, &len);
+
+	if (rec == NULL)
+		return NULL;
+
+	*hdr = rec->hdr;
+	return rec->data;
+}
+
+void ipc_uart_rx_release(struct ipc_uart_rx *rx)
+{
+	uint32_t len;
+	struct rx_record *rec = spsc_ring_peek(&rx->ring, &len);
+
+	if (rec->data != (uint8_t *)&rec[1])
+		bfree(rec->data);
+	spsc_ring_release(&rx->ring);
+}
+
+void ipc_uart_rx_free(struct ipc_uart_rx *rx, void *frame)
+{
+	bfree(frame);
+	__atomic_sub_fetch(&rx->backlog, 1, __ATOMIC_RELEASE);
+}
+
+static uint32_t rx_stat_read(uint32_t *counter, bool reset)
+{
+	if (reset)
+		return __atomic_exchange_n(counter, 0, __ATOMIC_RELAXED);
+	return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+void ipc_uart_rx_get_stats(struct ipc_uart_rx *rx,
+			   struct ipc_uart_rx_stats *stats, bool reset)
+{
+	/* Counters are read and cleared one by one, without locking */
+	stats->frames = rx_stat_read(&rx->stats.frames, reset);
+	stats->allocated = rx_stat_read(&rx->stats.allocated, reset);
+	stats->overflows = rx_stat_read(&rx->stats.overflows, reset);
+	stats->notified = rx_stat_read(&rx->stats.notified, reset);
+}
@@ -37,6 +37,7 @@
 #include "infra/log.h"  /* For logger */
 
 #include "drivers/serial_bus_access.h"
+#include "infra/time.h"
 
 #define GET_SPI_FLASH_INFO(_dev) \
 	(&(((const struct spi_flash_driver *)_dev->driver)->info))
@@ -45,11 +46,17 @@
 #define SBA_TIMEOUT    5000
 #define DEVICE_MUTEX_DELAY OS_WAIT_FOREVER
 #define LOW_POWER_MODE
+/* Maximum number of transfers chained in one bus session */
+#define SPI_FLASH_CHAIN_LEN 4
+/* Period of the status register polling during program/erase operations */
+#define SPI_FLASH_POLL_MS 1
 /*! Flash memory management structure */
 struct driver_data {
 	uint8_t is_init;                        /*!< Init state of memory */
 
 	struct sba_request req;                 /*!< sba request object used to drive the spi flash */
+	struct sba_request seg[SPI_FLASH_CHAIN_LEN]; /*!< sba requests chained in one bus session */
+	uint8_t seg_cmd[SPI_FLASH_CHAIN_LEN][4]; /*!< Command and address of each chained request */
 	T_TIMER spi_timer;                      /*!< Timer to wait for erase/program operations to complete */
 	T_SEMAPHORE spi_timer_sem;              /*!< Semaphore to wait for spi_timer event */
 	T_SEMAPHORE spi_sync_sem;               /*!< Semaphore to wait for and spi transfer to complete */
@@ -67,13 +74,13 @@ typedef enum {
 } ER_TYPE;
 
 /* Internal device driver functions */
-static DRIVER_API_RC spi_flash_get_rdscur(struct td_device *	dev,
-					  uint8_t *		rdscur);
-static DRIVER_API_RC spi_flash_write_enable(struct td_device *dev);
 static DRIVER_API_RC spi_flash_sleep(struct td_device *dev, bool on);
 static DRIVER_API_RC spi_flash_erase(struct td_device *dev, ER_TYPE er_type,
 				     unsigned int start,
 				     unsigned int count);
+static DRIVER_API_RC spi_flash_do_erase(struct td_device *dev, ER_TYPE er_type,
+					unsigned int start,
+					unsigned int count);
 static DRIVER_API_RC spi_sync(struct td_device *dev, struct sba_request *req);
 
 /* Device driver callback functions */
@@ -91,6 +98,7 @@ int spi_flash_init(struct td_device *device)
 	 * command + 3 bytes for the address */
 	const int tx_buf_size = info->page_size + 4;
 	const int drv_data_size = sizeof(struct driver_data) + tx_buf_size;
+	int i;
 
 	/* Alloc device priv data (if allocation fails it will panic) */
 	flash_dev = (struct driver_data *)balloc(drv_data_size, NULL);
@@ -116,6 +124,14 @@ int spi_flash_init(struct td_device *device)
 	flash_dev->req.request_type = SBA_TRANSFER;
 	flash_dev->req.addr.cs = dev->addr.cs;
 	flash_dev->req.full_duplex = 0;
+	flash_dev->req.chain = NULL;
+	for (i = 0; i < SPI_FLASH_CHAIN_LEN; i++) {
+		flash_dev->seg[i].request_type = SBA_TRANSFER;
+		flash_dev->seg[i].addr.cs = dev->addr.cs;
+		flash_dev->seg[i].full_duplex = 0;
+		flash_dev->seg[i].callback = NULL;
+		flash_dev->seg[i].chain = NULL;
+	}
 
 	/* Link driver priv data to device */
 	device->priv = flash_dev;
@@ -168,13 +184,22 @@ static DRIVER_API_RC spi_sync(struct td_device *dev, struct sba_request *req)
 	DRIVER_API_RC ret;
 	OS_ERR_TYPE ret_os;
 	struct driver_data *flash_dev = (struct driver_data *)dev->priv;
+	struct sba_device *sba_dev = (struct sba_device *)dev;
 
 	req->priv_data = flash_dev->spi_sync_sem;
 	req->callback = spi_completion_callback;
 
-	if ((ret =
-		     sba_exec_dev_request((struct sba_device *)dev,
-					  req)) == DRV_RC_OK) {
+	if (req->chain) {
+		/* Chained requests are executed in one bus session */
+		req->bus_id =
+			((struct sba_master_cfg_data *)sba_dev->parent->priv)->
+			bus_id;
+		ret = sba_exec_chain(req, SBA_PRIO_NORMAL);
+	} else {
+		ret = sba_exec_dev_request(sba_dev, req);
+	}
+
+	if (ret == DRV_RC_OK) {
 		/* Wait for transfer to complete (timeout = 100ms) */
 		if ((ret_os =
 			     semaphore_take(flash_dev->spi_sync_sem,
@@ -188,6 +213,100 @@ static DRIVER_API_RC spi_sync(struct td_device *dev, struct sba_request *req)
 	return ret;
 }
 
+/* Set the chained request i, the last one set ends the chain */
+static void spi_seg(struct driver_data *flash_dev, int i, uint8_t *tx_buff,
+		    uint32_t tx_len, uint8_t *rx_buff, uint32_t rx_len)
+{
+	struct sba_request *seg = &flash_dev->seg[i];
+
+	seg->tx_buff = tx_buff;
+	seg->tx_len = tx_len;
+	seg->rx_buff = rx_buff;
+	seg->rx_len = rx_len;
+	seg->chain = NULL;
+	if (i > 0)
+		flash_dev->seg[i - 1].chain = seg;
+}
+
+static void spi_cmd_addr(uint8_t *command, uint8_t cmd, uint32_t address)
+{
+	command[0] = cmd;
+	command[1] = (uint8_t)(address >> 16);
+	command[2] = (uint8_t)(address >> 8);
+	command[3] = (uint8_t)address;
+}
+
+/* Sleep for ms milliseconds, the bus and the CPU are free meanwhile */
+static DRIVER_API_RC spi_flash_delay(struct td_device *dev, uint32_t ms)
+{
+	OS_ERR_TYPE ret_os;
+	struct driver_data *flash_dev = (struct driver_data *)dev->priv;
+
+	/* Start timer */
+	timer_start(flash_dev->spi_timer, ms, &ret_os);
+
+	/* Take timer semaphore */
+	if ((ret_os =
+		     semaphore_take(flash_dev->spi_timer_sem,
+				    ms + SBA_TIMEOUT)) != E_OS_OK)
+		return DRV_RC_FAIL;
+	return DRV_RC_OK;
+}
+
+/*
+ * Wait for the end of a program or erase operation.
+ *
+ * The status register is first read after delay ms (the typical duration of
+ * the operation), then back-to-back for spin ms, then every
+ * SPI_FLASH_POLL_MS until the WIP bit is cleared or timeout ms have been
+ * slept. Spinning suits page programs, which complete well within a
+ * millisecond. Each poll reads the status and the security registers in one
+ * bus session; fail_bit is checked in the latter once the operation is
+ * complete.
+ */
+static DRIVER_API_RC spi_flash_wait_ready(struct td_device *dev,
+					  uint32_t delay, uint32_t spin,
+					  uint32_t timeout, uint32_t fail_bit)
+{
+	DRIVER_API_RC ret;
+	uint8_t status[2];
+	uint32_t waited = 0;
+	uint32_t spin_end = get_uptime_32k() + spin * 32768 / 1000;
+	struct driver_data *flash_dev = (struct driver_data *)dev->priv;
+	const struct spi_flash_info *info = GET_SPI_FLASH_INFO(dev);
+
+	if (delay) {
+		if ((ret = spi_flash_delay(dev, delay)) != DRV_RC_OK)
+			return ret;
+		waited = delay;
+	}
+
+	for (;;) {
+		flash_dev->seg_cmd[0][0] = info->cmd_read_status;
+		flash_dev->seg_cmd[1][0] = info->cmd_read_security;
+		status[0] = status[1] = 0;
+		spi_seg(flash_dev, 0, flash_dev->seg_cmd[0], 1, &status[0], 1);
+		spi_seg(flash_dev, 1, flash_dev->seg_cmd[1], 1, &status[1], 1);
+
+		if ((ret = spi_sync(dev, &flash_dev->seg[0])) != DRV_RC_OK)
+			return ret;
+		if (!(status[0] & info->status_wip_bit))
+			return (status[1] & fail_bit) ?
+			       DRV_RC_CHECK_FAIL : DRV_RC_OK;
+		if (spin && (int32_t)(get_uptime_32k() - spin_end) < 0)
+			continue;
+		spin = 0;
+		if (waited >= timeout)
+			return DRV_RC_TIMEOUT;
+
+		if ((ret =
+			     spi_flash_delay(dev,
+					     SPI_FLASH_POLL_MS)) != DRV_RC_OK)
+			return ret;
+		waited += SPI_FLASH_POLL_MS;
+	}
+}
+
 static DRIVER_API_RC spi_flash_sleep(struct td_device *dev, bool on)
 {
 	uint8_t command;
@@ -213,16 +332,13 @@ static DRIVER_API_RC spi_flash_sleep(struct td_device *dev, bool on)
 #endif
 }
 
-DRIVER_API_RC spi_flash_get_rdid(struct td_device *dev, uint32_t *rdid)
+/* Take the device and wake the flash up */
+static DRIVER_API_RC spi_flash_lock(struct td_device *dev)
 {
-	uint8_t command;
 	DRIVER_API_RC ret;
 	OS_ERR_TYPE ret_os;
 	struct driver_data *flash_dev = (struct driver_data *)dev->priv;
-	const struct spi_flash_info *info = GET_SPI_FLASH_INFO(dev);
 
-	if (!flash_dev->is_init)
-		return DRV_RC_INVALID_OPERATION;
 	/* Take spi device mutex */
 	if ((ret_os =
 		     mutex_lock(flash_dev->device_mtx,
@@ -230,46 +346,88 @@ DRIVER_API_RC spi_flash_get_rdid(struct td_device *dev, uint32_t *rdid)
 		return DRV_RC_FAIL;
 	}
 	pm_wakelock_acquire(&flash_dev->wakelock);
-	/* wake up the flash */
-	if ((ret = spi_flash_sleep(dev, true)) != DRV_RC_OK)
-		goto exit_mutex;
 
-	flash_dev->req.tx_len = 1;
-	flash_dev->req.tx_buff = &command;
-	flash_dev->req.rx_len = 3;
-	flash_dev->req.rx_buff = (uint8_t *)rdid;
+	/* wake up the flash */
+	if ((ret = spi_flash_sleep(dev, true)) != DRV_RC_OK) {
+		/* Give device mutex */
+		pm_wakelock_release(&flash_dev->wakelock);
+		mutex_unlock(flash_dev->device_mtx);
+	}
+	return ret;
+}
 
-	command = info->cmd_read_id;
-	*rdid = 0;
-	ret = spi_sync(dev, &flash_dev->req);
+/* Put the flash to sleep and give the device */
+static void spi_flash_unlock(struct td_device *dev)
+{
+	struct driver_data *flash_dev = (struct driver_data *)dev->priv;
 
-	/* put the flash to sleep */
 	spi_flash_sleep(dev, false);
-exit_mutex:
 	/* Give device mutex */
 	pm_wakelock_release(&flash_dev->wakelock);
 	mutex_unlock(flash_dev->device_mtx);
-	return ret;
 }
 
-DRIVER_API_RC spi_flash_get_status(struct td_device *dev, uint8_t *status)
+static DRIVER_API_RC spi_flash_check_range(struct td_device *dev,
+					   uint32_t address, unsigned int len)
+{
+	struct driver_data *flash_dev = (struct driver_data *)dev->priv;
+	const struct spi_flash_info *info = GET_SPI_FLASH_INFO(dev);
+
+	if ((!flash_dev->is_init) || (len == 0))
+		return DRV_RC_INVALID_OPERATION;
+	if ((len + address) > info->flash_size)
+		return DRV_RC_OUT_OF_MEM;
+	return DRV_RC_OK;
+}
+
+DRIVER_API_RC spi_flash_session_open(struct td_device *		dev,
+				     struct spi_flash_session * session)
+{
+	struct driver_data *flash_dev = (struct driver_data *)dev->priv;
+	DRIVER_API_RC ret;
+
+	/* Not opened until the device is held */
+	session->dev = NULL;
+	if (!flash_dev->is_init)
+		return DRV_RC_INVALID_OPERATION;
+	if ((ret = spi_flash_lock(dev)) != DRV_RC_OK)
+		return ret;
+	session->dev = dev;
+	return DRV_RC_OK;
+}
+
+void spi_flash_session_close(struct spi_flash_session *session)
+{
+	spi_flash_unlock(session->dev);
+	session->dev = NULL;
+}
+
+DRIVER_API_RC spi_flash_get_rdid(struct td_device *dev, uint32_t *rdid)
 {
 	uint8_t command;
+	DRIVER_API_RC ret;
 	struct driver_data *flash_dev = (struct driver_data *)dev->priv;
 	const struct spi_flash_info *info = GET_SPI_FLASH_INFO(dev);
 
+	if (!flash_dev->is_init)
+		return DRV_RC_INVALID_OPERATION;
+	if ((ret = spi_flash_lock(dev)) != DRV_RC_OK)
+		return ret;
+
 	flash_dev->req.tx_len = 1;
 	flash_dev->req.tx_buff = &command;
-	flash_dev->req.rx_len = 1;
-	flash_dev->req.rx_buff = status;
+	flash_dev->req.rx_len = 3;
+	flash_dev->req.rx_buff = (uint8_t *)rdid;
 
-	command = info->cmd_read_status;
-	*status = 0;
-	return spi_sync(dev, &flash_dev->req);
+	command = info->cmd_read_id;
+	*rdid = 0;
+	ret = spi_sync(dev, &flash_dev->req);
+
+	spi_flash_unlock(dev);
+	return ret;
 }
 
-static DRIVER_API_RC spi_flash_get_rdscur(struct td_device *	dev,
-					  uint8_t *		rdscur)
+DRIVER_API_RC spi_flash_get_status(struct td_device *dev, uint8_t *status)
 {
 	uint8_t command;
 	struct driver_data *flash_dev = (struct driver_data *)dev->priv;
@@ -278,95 +436,79 @@ static DRIVER_API_RC spi_flash_get_rdscur(struct td_device *	dev,
 	flash_dev->req.tx_len = 1;
 	flash_dev->req.tx_buff = &command;
 	flash_dev->req.rx_len = 1;
-	flash_dev->req.rx_buff = rdscur;
+	flash_dev->req.rx_buff = status;
 
-	command = info->cmd_read_security;
-	*rdscur = 0;
+	command = info->cmd_read_status;
+	*status = 0;
 	return spi_sync(dev, &flash_dev->req);
 }
 
-static DRIVER_API_RC spi_flash_write_enable(struct td_device *dev)
+DRIVER_API_RC spi_flash_session_readv(struct spi_flash_session *	session,
+				      uint32_t				address,
+				      const struct spi_flash_iovec *	iov,
+				      unsigned int			iovcnt,
+				      unsigned int *			retlen)
 {
-	uint8_t command = 0, status = 0;
+	DRIVER_API_RC ret;
+	struct td_device *dev = session->dev;
 	struct driver_data *flash_dev = (struct driver_data *)dev->priv;
 	const struct spi_flash_info *info = GET_SPI_FLASH_INFO(dev);
-	DRIVER_API_RC ret;
+	unsigned int i, len = 0;
+	int n;
 
-	flash_dev->req.tx_len = 1;
-	flash_dev->req.tx_buff = &command;
-	flash_dev->req.rx_len = 0;
-	flash_dev->req.rx_buff = NULL;
-
-	command = info->cmd_write_en;
+	*retlen = 0;
 
-	/* Send write enable command */
-	if ((ret = spi_sync(dev, &flash_dev->req)) != DRV_RC_OK)
+	for (i = 0; i < iovcnt; i++)
+		len += iov[i].len;
+	if ((ret = spi_flash_check_range(dev, address, len)) != DRV_RC_OK)
 		return ret;
 
-	flash_dev->req.rx_len = 1;
-	flash_dev->req.rx_buff = &status;
-
-	command = info->cmd_read_status;
-
-	/* Read status register to check if write is enabled */
-	if ((ret = spi_sync(dev, &flash_dev->req)) != DRV_RC_OK)
-		return ret;
+	/* Each buffer is read by its own READ command, straight from the
+	 * flash into the caller buffer. Up to SPI_FLASH_CHAIN_LEN commands are
+	 * chained in one bus session. */
+	for (i = 0; i < iovcnt; ) {
+		for (n = 0, len = 0; i < iovcnt && n < SPI_FLASH_CHAIN_LEN;
+		     i++) {
+			if (iov[i].len == 0)
+				continue;
+			spi_cmd_addr(flash_dev->seg_cmd[n], info->cmd_read,
+				     address);
+			spi_seg(flash_dev, n, flash_dev->seg_cmd[n], 4,
+				iov[i].buf, iov[i].len);
+			address += iov[i].len;
+			len += iov[i].len;
+			n++;
+		}
+		if (n == 0)
+			break;
+		if ((ret = spi_sync(dev, &flash_dev->seg[0])) != DRV_RC_OK)
+			return ret;
+		/* TODO: sba does not provide a retlen data (could be done through request.rx_len) */
+		/*       so we count the requests that succeeded */
+		*retlen += len;
+	}
 
-	return (status & info->status_wel_bit) ? DRV_RC_OK : DRV_RC_FAIL;
+	return DRV_RC_OK;
 }
 
 DRIVER_API_RC spi_flash_read_byte(struct td_device *dev, uint32_t address,
 				  unsigned int len, unsigned int *retlen,
 				  uint8_t *data)
 {
-	DRIVER_API_RC ret = DRV_RC_OK;
-	OS_ERR_TYPE ret_os;
-	struct driver_data *flash_dev = (struct driver_data *)dev->priv;
-	const struct spi_flash_info *info = GET_SPI_FLASH_INFO(dev);
-	uint8_t command[4];
+	DRIVER_API_RC ret;
+	struct spi_flash_session session;
+	struct spi_flash_iovec iov = { .buf = data, .len = len };
 
 	*retlen = 0;
 
 	/* Check input parameters */
-	if ((!flash_dev->is_init) || (len == 0))
-		return DRV_RC_INVALID_OPERATION;
-	if ((len + address) > info->flash_size)
-		return DRV_RC_OUT_OF_MEM;
-
-	/* Take spi device mutex */
-	if ((ret_os =
-		     mutex_lock(flash_dev->device_mtx,
-				DEVICE_MUTEX_DELAY)) != E_OS_OK) {
-		return DRV_RC_FAIL;
-	}
-	pm_wakelock_acquire(&flash_dev->wakelock);
-
-	/* wake up the flash */
-	if ((ret = spi_flash_sleep(dev, true)) != DRV_RC_OK)
-		goto exit_mutex;
-
-	command[0] = info->cmd_read;
-	command[1] = (uint8_t)(address >> 16);
-	command[2] = (uint8_t)(address >> 8);
-	command[3] = (uint8_t)address;
-
-	flash_dev->req.tx_len = 4;
-	flash_dev->req.tx_buff = command;
-	flash_dev->req.rx_len = len;
-	flash_dev->req.rx_buff = data;
+	if ((ret = spi_flash_check_range(dev, address, len)) != DRV_RC_OK)
+		return ret;
 
-	/* TODO: use DMA if transfer is too long */
-	if ((ret = spi_sync(dev, &flash_dev->req)) == DRV_RC_OK) {
-		/* TODO: sba does not provide a retlen data (could be done through request.rx_len) */
-		/*       so we set retlen to len if success else 0 */
-		*retlen = len;
-	}
-	/* put the flash to sleep */
-	spi_flash_sleep(dev, false);
-exit_mutex:
-	/* Give device mutex */
-	pm_wakelock_release(&flash_dev->wakelock);
-	mutex_unlock(flash_dev->device_mtx);
+	if ((ret = spi_flash_session_open(dev, &session)) != DRV_RC_OK)
+		return ret;
+	ret = spi_flash_session_readv(&session, address, &iov, 1, retlen);
+	spi_flash_session_close(&session);
 	return ret;
 }
 
@@ -382,107 +524,92 @@ DRIVER_API_RC spi_flash_read(struct td_device *dev, uint32_t address,
 	return ret;
 }
 
-DRIVER_API_RC spi_flash_write_byte(struct td_device *dev, uint32_t address,
-				   unsigned int len, unsigned int *retlen,
-				   uint8_t *data)
+DRIVER_API_RC spi_flash_session_write(struct spi_flash_session *session,
+				      uint32_t address, unsigned int len,
+				      unsigned int *retlen,
+				      const uint8_t *data)
 {
-	DRIVER_API_RC ret = DRV_RC_OK;
-	OS_ERR_TYPE ret_os;
+	DRIVER_API_RC ret;
+	struct td_device *dev = session->dev;
 	struct driver_data *flash_dev = (struct driver_data *)dev->priv;
 	const struct spi_flash_info *info = GET_SPI_FLASH_INFO(dev);
+	unsigned int count, next;
 	uint8_t status;
 
 	*retlen = 0;
 
 	/* Check input parameters */
-	if ((!flash_dev->is_init) || (len == 0))
-		return DRV_RC_INVALID_OPERATION;
-	if ((len + address) > info->flash_size)
-		return DRV_RC_OUT_OF_MEM;
-
-	/* Take spi device mutex */
-	if ((ret_os =
-		     mutex_lock(flash_dev->device_mtx,
-				DEVICE_MUTEX_DELAY)) != E_OS_OK) {
-		return DRV_RC_FAIL;
-	}
-	pm_wakelock_acquire(&flash_dev->wakelock);
-
-	/* wake up the flash */
-	if ((ret = spi_flash_sleep(dev, true)) != DRV_RC_OK)
-		goto exit_mutex;
-
-	*retlen = len;
+	if ((ret = spi_flash_check_range(dev, address, len)) != DRV_RC_OK)
+		return ret;
 
 	/* We can only program a page with PP command so we use several write operations */
-	unsigned int count; /* Byte count to write for next program operation */
 	count = info->page_size - (address & (info->page_size - 1));
 	if (count > len)
 		count = len;
 
-	flash_dev->tx_buffer[0] = info->cmd_page_program;
-
-	/* Loop on pages to program */
-	for (;
-	     len;
-	     address += count,
-	     data += count, count =
-		     ((len -= count) >
-		      info->page_size ? info->page_size : len)) {
-		/* Enable write operation */
-		if ((ret = spi_flash_write_enable(dev)) != DRV_RC_OK) {
-			*retlen -= len;
-			goto exit_wakeup;
+	spi_cmd_addr(flash_dev->tx_buffer, info->cmd_page_program, address);
+	memcpy(flash_dev->tx_buffer + 4, data, count);
+
+	while (count) {
+		/* Enable write, check it and program the page in one bus
+		 * session: the flash ignores PP if WEL is not set. */
+		flash_dev->seg_cmd[0][0] = info->cmd_write_en;
+		flash_dev->seg_cmd[1][0] = info->cmd_read_status;
+		status = 0;
+		spi_seg(flash_dev, 0, flash_dev->seg_cmd[0], 1, NULL, 0);
+		spi_seg(flash_dev, 1, flash_dev->seg_cmd[1], 1, &status, 1);
+		spi_seg(flash_dev, 2, flash_dev->tx_buffer, count + 4, NULL, 0);
+
+		if ((ret = spi_sync(dev, &flash_dev->seg[0])) != DRV_RC_OK)
+			break;
+		if (!(status & info->status_wel_bit)) {
+			ret = DRV_RC_FAIL;
+			break;
 		}
 
-		/* Set data for write operation */
-		memcpy((uint8_t *)(flash_dev->tx_buffer) + 4, data, count);
-		flash_dev->req.tx_len = count + 4;
-		flash_dev->req.tx_buff = flash_dev->tx_buffer;
-		flash_dev->req.rx_len = 0;
-		flash_dev->req.rx_buff = NULL;
-
-		flash_dev->tx_buffer[1] = (uint8_t)(address >> 16);
-		flash_dev->tx_buffer[2] = (uint8_t)(address >> 8);
-		flash_dev->tx_buffer[3] = (uint8_t)address;
-
-		if ((ret = spi_sync(dev, &flash_dev->req)) != DRV_RC_OK) {
-			*retlen -= len;
-			goto exit_wakeup;
+		/* Prepare the next page while the flash programs this one */
+		address += count;
+		data += count;
+		len -= count;
+		next = len > info->page_size ? info->page_size : len;
+		if (next) {
+			spi_cmd_addr(flash_dev->tx_buffer,
+				     info->cmd_page_program, address);
+			memcpy(flash_dev->tx_buffer + 4, data, next);
 		}
 
-		/* loop until the write operation is complete */
-		do {
-			if ((ret =
-				     spi_flash_get_status(dev,
-							  &status)) !=
-			    DRV_RC_OK) {
-				/* Error detected */
-				*retlen -= len;
-				goto exit_wakeup;
-			}
-		} while (status & info->status_wip_bit);
-
-		/* Check for success */
-		if ((ret = spi_flash_get_rdscur(dev, &status)) != DRV_RC_OK) {
-			/* Error detected */
-			*retlen -= len;
-			goto exit_wakeup;
-		}
-		if (status & info->status_secr_pfail_bit) {
-			/* Write failed */
-			ret = DRV_RC_CHECK_FAIL;
-			*retlen -= len;
-			goto exit_wakeup;
-		}
+		if ((ret =
+			     spi_flash_wait_ready(dev, 0,
+						  info->ms_max_page_program,
+						  info->ms_max_page_program,
+						  info->status_secr_pfail_bit))
+		    != DRV_RC_OK)
+			break;
+
+		*retlen += count;
+		count = next;
 	}
 
-exit_wakeup:
-	spi_flash_sleep(dev, false);
-exit_mutex:
-	/* Give device mutex */
-	pm_wakelock_release(&flash_dev->wakelock);
-	mutex_unlock(flash_dev->device_mtx);
+	return ret;
+}
+
+DRIVER_API_RC spi_flash_write_byte(struct td_device *dev, uint32_t address,
+				   unsigned int len, unsigned int *retlen,
+				   uint8_t *data)
+{
+	DRIVER_API_RC ret;
+	struct spi_flash_session session;
+
+	*retlen = 0;
+
+	/* Check input parameters */
+	if ((ret = spi_flash_check_range(dev, address, len)) != DRV_RC_OK)
+		return ret;
+
+	if ((ret = spi_flash_session_open(dev, &session)) != DRV_RC_OK)
+		return ret;
+	ret = spi_flash_session_write(&session, address, len, retlen, data);
+	spi_flash_session_close(&session);
 	return ret;
 }
 
@@ -501,12 +628,29 @@ DRIVER_API_RC spi_flash_write(struct td_device *dev, uint32_t address,
 static DRIVER_API_RC spi_flash_erase(struct td_device *dev, ER_TYPE er_type,
 				     unsigned int start,
 				     unsigned int count)
+{
+	DRIVER_API_RC ret;
+	struct driver_data *flash_dev = (struct driver_data *)dev->priv;
+
+	/* Check input parameters */
+	if ((!flash_dev->is_init) || (count == 0))
+		return DRV_RC_INVALID_OPERATION;
+
+	if ((ret = spi_flash_lock(dev)) != DRV_RC_OK)
+		return ret;
+	ret = spi_flash_do_erase(dev, er_type, start, count);
+	spi_flash_unlock(dev);
+	return ret;
+}
+
+static DRIVER_API_RC spi_flash_do_erase(struct td_device *dev, ER_TYPE er_type,
+					unsigned int start,
+					unsigned int count)
 {
 	DRIVER_API_RC ret = DRV_RC_OK;
-	OS_ERR_TYPE ret_os;
-	uint8_t command[16];
 	uint32_t command_len = 4;
-	unsigned int er_size, timeout, er_count;
+	unsigned int er_size, timeout, max_timeout, er_count;
+	uint8_t cmd, status;
 	struct driver_data *flash_dev = (struct driver_data *)dev->priv;
 	const struct spi_flash_info *info = GET_SPI_FLASH_INFO(dev);
 
@@ -516,28 +660,30 @@ static DRIVER_API_RC spi_flash_erase(struct td_device *dev, ER_TYPE er_type,
 
 	switch (er_type) {
 	case ER_SECTOR:
-		command[0] = info->cmd_sector_erase;
+		cmd = info->cmd_sector_erase;
 		er_size = info->sector_size;
 		er_count = info->flash_size / info->sector_size;
 		timeout = info->ms_sector_erase;
 		break;
 	case ER_BLOCK:
-		command[0] = info->cmd_block_erase;
+		cmd = info->cmd_block_erase;
 		er_size = info->block_size;
 		er_count = info->flash_size / info->block_size;
 		timeout = info->ms_block_erase;
 		break;
 	case ER_LARGE_BLOCK:
-		command[0] = info->cmd_large_block_erase;
+		cmd = info->cmd_large_block_erase;
 		er_size = info->large_block_size;
 		er_count = info->flash_size / info->large_block_size;
 		timeout = info->ms_large_block_erase;
 		break;
 	case ER_CHIP:
-		command[0] = info->cmd_chip_erase;
+		cmd = info->cmd_chip_erase;
 		er_size = info->flash_size;
 		er_count = 1;
 		timeout = info->ms_chip_erase;
+		/* A chip erase lasts longer than ms_max_erase */
+		max_timeout = UINT32_MAX;
 		count = 1;
 		start = 0;
 		command_len = 1;
@@ -545,80 +691,40 @@ static DRIVER_API_RC spi_flash_erase(struct td_device *dev, ER_TYPE er_type,
 	default:
 		return DRV_RC_INVALID_OPERATION;
 	}
+	if (er_type != ER_CHIP)
+		max_timeout = info->ms_max_erase;
 
 	if ((count + start) > er_count)
 		return DRV_RC_OUT_OF_MEM;
 
-	/* Take spi device mutex */
-	if ((ret_os =
-		     mutex_lock(flash_dev->device_mtx,
-				DEVICE_MUTEX_DELAY)) != E_OS_OK) {
-		return DRV_RC_FAIL;
-	}
-	pm_wakelock_acquire(&flash_dev->wakelock);
-
-	/* wake up the flash */
-	if ((ret = spi_flash_sleep(dev, true)) != DRV_RC_OK)
-		goto exit_mutex;
 	/* TODO: Check write protection */
 	for (count += start; start < count; start++) {
-		uint32_t address = er_size * start;
-
-		/* Enable write operation */
-		if ((ret = spi_flash_write_enable(dev)) != DRV_RC_OK)
-			goto exit_wakeup;
-
-		flash_dev->req.tx_len = command_len;
-		flash_dev->req.tx_buff = command;
-		flash_dev->req.rx_len = 0;
-		flash_dev->req.rx_buff = NULL;
-
-		command[1] = (uint8_t)(address >> 16);
-		command[2] = (uint8_t)(address >> 8);
-		command[3] = (uint8_t)address;
-
-		if ((ret = spi_sync(dev, &flash_dev->req)) != DRV_RC_OK)
+		/* Enable write, check it and start the erase in one bus
+		 * session: the flash ignores the erase if WEL is not set. */
+		flash_dev->seg_cmd[0][0] = info->cmd_write_en;
+		flash_dev->seg_cmd[1][0] = info->cmd_read_status;
+		spi_cmd_addr(flash_dev->seg_cmd[2], cmd, er_size * start);
+		status = 0;
+		spi_seg(flash_dev, 0, flash_dev->seg_cmd[0], 1, NULL, 0);
+		spi_seg(flash_dev, 1, flash_dev->seg_cmd[1], 1, &status, 1);
+		spi_seg(flash_dev, 2, flash_dev->seg_cmd[2], command_len,
+			NULL, 0);
+
+		if ((ret = spi_sync(dev, &flash_dev->seg[0])) != DRV_RC_OK)
 			/* Error detected */
-			goto exit_wakeup;
-
-		/* Start timer */
-		timer_start(flash_dev->spi_timer, timeout, &ret_os);
-
-		/* Take timer semaphore (wait for info->ms_max_erase) */
-		if ((ret_os =
-			     semaphore_take(flash_dev->spi_timer_sem,
-					    info->ms_max_erase)) != E_OS_OK) {
+			break;
+		if (!(status & info->status_wel_bit)) {
 			ret = DRV_RC_FAIL;
-			goto exit_wakeup;
+			break;
 		}
 
-		/* loop until the erase is complete */
-		uint8_t status;
-		do {
-			if ((ret =
-				     spi_flash_get_status(dev,
-							  &status)) !=
-			    DRV_RC_OK)
-				/* Error detected */
-				goto exit_wakeup;
-		} while (status & info->status_wip_bit);
-
-		/* Check for success */
-		if ((ret = spi_flash_get_rdscur(dev, &status)) != DRV_RC_OK)
-			/* Error detected */
-			goto exit_wakeup;
-		if (status & info->status_secr_efail_bit) {
-			/* Erase failed */
-			ret = DRV_RC_CHECK_FAIL;
-			goto exit_wakeup;
-		}
+		/* Sleep for the nominal erase time then poll for completion */
+		if ((ret =
+			     spi_flash_wait_ready(dev, timeout, 0, max_timeout,
+						  info->status_secr_efail_bit))
+		    != DRV_RC_OK)
+			break;
 	}
-exit_wakeup:
-	spi_flash_sleep(dev, false);
-exit_mutex:
-	/* Give device mutex */
-	pm_wakelock_release(&flash_dev->wakelock);
-	mutex_unlock(flash_dev->device_mtx);
 	return ret;
 }
 
@@ -658,6 +764,14 @@ DRIVER_API_RC spi_flash_sector_erase(struct td_device * dev,
 	return spi_flash_erase(dev, ER_SECTOR, start_sector, sector_count);
 }
 
+DRIVER_API_RC spi_flash_session_sector_erase(struct spi_flash_session *session,
+					     unsigned int		start_sector,
+					     unsigned int		sector_count)
+{
+	return spi_flash_do_erase(session->dev, ER_SECTOR, start_sector,
+				  sector_count);
+}
+
 DRIVER_API_RC spi_flash_block_erase(struct td_device *	dev,
 				    unsigned int	start_block,
 				    unsigned int	block_count)
@@ -48,6 +48,7 @@ struct spi_flash_info {
 	uint32_t ms_large_block_erase;
 	uint32_t ms_chip_erase;
 	uint32_t ms_max_erase;
+	uint32_t ms_max_page_program;
 
 	uint32_t cmd_release_deep_powerdown;
 	uint32_t cmd_deep_powerdown;
@@ -48,6 +48,7 @@ const struct spi_flash_driver spi_flash_w25qxxdv_driver = {
 		.ms_large_block_erase = FLASH_LARGE_BLOCK_ERASE_MS,
 		.ms_chip_erase = FLASH_CHIP_ERASE_MS,
 		.ms_max_erase = FLASH_MAX_ERASE_MS,
+		.ms_max_page_program = FLASH_MAX_PAGE_PROGRAM_MS,
 
 		.cmd_release_deep_powerdown = FLASH_CMD_RDP,
 		.cmd_deep_powerdown = FLASH_CMD_DP,
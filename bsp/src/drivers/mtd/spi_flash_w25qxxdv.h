@@ -78,6 +78,7 @@
 #define FLASH_LARGE_BLOCK_ERASE_MS  (180) // 64KB?
 #define FLASH_CHIP_ERASE_MS         (3) //
 #define FLASH_MAX_ERASE_MS          (2000) // Maximum timeout for an erase operation
+#define FLASH_MAX_PAGE_PROGRAM_MS   (3)    // Maximum page program time (tPP)
 
 //   "*"      means command may be used in future code
 //   "***"    means command is currently used in the code.
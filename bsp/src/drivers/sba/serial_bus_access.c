@@ -29,6 +29,7 @@
  */
 
 #include <zephyr.h>
+#include <string.h>
 #include "drivers/serial_bus_access.h"
 #include "infra/log.h" // For logger API
 #include "infra/panic.h"
@@ -46,6 +47,7 @@
 
 #include "machine.h"
 #include "drivers/clk_system.h"
+#include "infra/time.h"
 
 
 static DRIVER_API_RC execute_request(sba_request_t *request);
@@ -221,13 +223,92 @@ void sba_err_callback(uint32_t bus_id);
  *  \param   status      : Status
  *
  */
-static void sba_generic_callback(uint32_t bus_id, int8_t status)
+/*
+ * Start a segment on the bus, the head of a session or the next segment of a
+ * chain. Must be called with the bus owned: from the completion interrupt or
+ * by the submitter that found the bus idle.
+ */
+static DRIVER_API_RC start_segment(struct sba_master_cfg_data *sba_dev,
+				   sba_request_t *		seg)
 {
-	DRIVER_API_RC rc = DRV_RC_OK;
+	sba_dev->current_segment = seg;
+	sba_dev->stats.segments++;
+	sba_dev->stats.bytes += seg->tx_len + seg->rx_len;
+	return execute_request(seg);
+}
+
+static void start_session(struct sba_master_cfg_data *sba_dev)
+{
+	sba_dev->session_start = get_uptime_32k();
+	if (start_segment(sba_dev, sba_dev->current_request) != DRV_RC_OK) {
+		sba_err_callback(sba_dev->bus_id);
+	}
+}
+
+/* Pop the oldest request of the highest priority queue */
+static sba_request_t *next_request(struct sba_master_cfg_data *sba_dev)
+{
+	sba_request_t *request;
+	int prio;
+
+	for (prio = SBA_PRIO_COUNT - 1; prio >= 0; prio--) {
+		request = (sba_request_t *)list_get(
+			&sba_dev->request_list[prio]);
+		if (request) {
+			sba_dev->stats.queued--;
+			return request;
+		}
+	}
+	return NULL;
+}
+
+/* Start the next pending request, or release the bus if there is none */
+static void next_session(struct sba_master_cfg_data *sba_dev)
+{
+	sba_request_t *request;
+	uint32_t saved = irq_lock();
+
+	request = next_request(sba_dev);
+	sba_dev->current_request = request;
+	if (request == NULL) {
+		sba_clock_disable(sba_dev);
+		pm_wakelock_release(&sba_dev->sba_wakelock);
+	}
+	irq_unlock(saved);
+
+	if (request != NULL) {
+		start_session(sba_dev);
+	}
+}
+
+static void session_done(struct sba_master_cfg_data *sba_dev,
+			 sba_request_t *request, int8_t status)
+{
+	uint32_t now = get_uptime_32k();
+	uint32_t wait = now - request->submit_time;
+
+	sba_dev->stats.sessions++;
+	sba_dev->stats.busy_ticks += now - sba_dev->session_start;
+	sba_dev->stats.wait_ticks += wait;
+	if (wait > sba_dev->stats.max_wait_ticks) {
+		sba_dev->stats.max_wait_ticks = wait;
+	}
+	if (status) {
+		sba_dev->stats.errors++;
+	}
+
+	request->status = status;
+	if (NULL != request->callback) {
+		request->callback(request);
+	}
+}
 
+static void sba_generic_callback(uint32_t bus_id, int8_t status)
+{
 	// Little hack to get device because we cannot give a priv data to i2c/spi driver (only bus_id)
 	struct td_device *dev;
 	struct sba_master_cfg_data *sba_dev;
+	sba_request_t *seg;
 
 	if (((unsigned int)bus_id) >= NB_BUS ||
 	    !(dev = sba_bus_device_array[bus_id])) {
@@ -238,23 +319,18 @@ static void sba_generic_callback(uint32_t bus_id, int8_t status)
 	if ((sba_dev->current_request) == NULL) {
 		panic(E_OS_ERR_UNKNOWN); // Panic because we should never reach this point.
 	} else {
-		sba_dev->current_request->status = status;
-		if (NULL != sba_dev->current_request->callback) {
-			sba_dev->current_request->callback(
-				sba_dev->current_request);
-		}
-
-		if ((sba_dev->current_request =
-			     (sba_request_t *)list_get(&sba_dev->request_list))
-		    != NULL) {
-			rc = execute_request(sba_dev->current_request);
-			if (rc != DRV_RC_OK) {
+		// Chained segments are started from here, without going
+		// through the queues nor waking up the submitter
+		seg = sba_dev->current_segment->chain;
+		if (status == 0 && seg != NULL) {
+			if (start_segment(sba_dev, seg) != DRV_RC_OK) {
 				sba_err_callback(bus_id);
 			}
-		} else {
-			sba_clock_disable(sba_dev);
-			pm_wakelock_release(&sba_dev->sba_wakelock);
+			return;
 		}
+
+		session_done(sba_dev, sba_dev->current_request, status);
+		next_session(sba_dev);
 	}
 }
 
@@ -431,12 +507,19 @@ DRIVER_API_RC sba_exec_dev_request(struct sba_device *	dev,
 	return sba_exec_request(req);
 }
 
-/*! \fn     DRIVER_API_RC sba_exec_request (sba_request_t * request)
+DRIVER_API_RC sba_exec_request(sba_request_t *request)
+{
+	request->chain = NULL;
+	return sba_exec_chain(request, SBA_PRIO_NORMAL);
+}
+
+/*! \fn     DRIVER_API_RC sba_exec_chain(sba_request_t *request, SBA_PRIORITY prio)
  *
- *  \brief   Function to add a request in the requests list.
+ *  \brief   Function to add a request, or a chain of requests, in the requests list.
  *           Configuration parameters must be valid or an error is returned - see return values below.
  *
- *  \param   request      : pointer to the request structure
+ *  \param   request      : pointer to the first request of the chain
+ *  \param   prio         : priority of the chain in the bus queues
  *
  *  \return  DRV_RC_OK on success,
  *           DRV_RC_INVALID_CONFIG        - if any configuration parameters are not valid
@@ -444,9 +527,10 @@ DRIVER_API_RC sba_exec_dev_request(struct sba_device *	dev,
  *           DRV_RC_CONTROLLER_IN_USE     - when device is busy
  *           DRV_RC_FAIL                  otherwise
  */
-DRIVER_API_RC sba_exec_request(sba_request_t *request)
+DRIVER_API_RC sba_exec_chain(sba_request_t *request, SBA_PRIORITY prio)
 {
 	DRIVER_API_RC rc = DRV_RC_OK;
+	sba_request_t *seg;
 
 	// Here we have to do a little hack to get the bus device.
 	// We keep in sba driver an array of all bus devices indexed by bus_id
@@ -464,23 +548,65 @@ DRIVER_API_RC sba_exec_request(sba_request_t *request)
 	if (sba_dev->controller_initialised != 1) {
 		return DRV_RC_FAIL;
 	}
+	if ((unsigned int)prio >= SBA_PRIO_COUNT) {
+		return DRV_RC_INVALID_CONFIG;
+	}
+	for (seg = request->chain; seg != NULL; seg = seg->chain) {
+		seg->bus_id = request->bus_id;
+	}
 
 	pm_wakelock_acquire(&sba_dev->sba_wakelock);
 
+	request->submit_time = get_uptime_32k();
+
 	uint32_t saved = irq_lock();
 
 	sba_clock_enable(sba_dev);
 	if (sba_dev->current_request == NULL) {
 		sba_dev->current_request = request;
+		sba_dev->session_start = request->submit_time;
 		irq_unlock(saved);
-		rc = execute_request(request);
+		rc = start_segment(sba_dev, request);
+		if (rc != DRV_RC_OK) {
+			// The error is returned to the caller instead of
+			// calling back, give the bus to the next request
+			next_session(sba_dev);
+		}
 	} else {
-		list_add(&sba_dev->request_list, (list_t *)request);
+		list_add(&sba_dev->request_list[prio], (list_t *)request);
+		if (++sba_dev->stats.queued > sba_dev->stats.max_queued) {
+			sba_dev->stats.max_queued = sba_dev->stats.queued;
+		}
 		irq_unlock(saved);
 	}
 	return rc;
 }
 
+DRIVER_API_RC sba_get_stats(SBA_BUSID bus_id, struct sba_bus_stats *stats,
+			    bool reset)
+{
+	struct sba_master_cfg_data *sba_dev;
+	uint32_t saved;
+	uint16_t queued;
+
+	if ((unsigned int)bus_id >= NB_BUS || !sba_bus_device_array[bus_id]) {
+		return DRV_RC_FAIL;
+	}
+	sba_dev = (struct sba_master_cfg_data *)
+		  sba_bus_device_array[bus_id]->priv;
+
+	saved = irq_lock();
+	*stats = sba_dev->stats;
+	if (reset) {
+		queued = sba_dev->stats.queued;
+		memset(&sba_dev->stats, 0, sizeof(sba_dev->stats));
+		sba_dev->stats.queued = queued;
+		sba_dev->stats.max_queued = queued;
+	}
+	irq_unlock(saved);
+	return DRV_RC_OK;
+}
+
 
 /*! \fn     DRIVER_API_RC execute_request(sba_request_t * request)
  *
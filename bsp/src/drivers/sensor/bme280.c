@@ -53,6 +53,7 @@
 **************************************************************************/
 
 #include "bme280_support.h"
+#include "bme280_compensate.h"
 
 static struct bme280_t *p_bme280 = BME280_NULL;      /**< pointer to BME280 */
 
@@ -565,163 +566,14 @@ BME280_RETURN_FUNCTION_TYPE bme280_set_softreset()
     return bme280_write_reg(BME280_RESET_REG, &v_data_uint8_tr);
 }
 
-#ifdef BME280_ENABLE_FLOAT
 /*******************************************************************************
- * Description: *//**\brief Reads actual temperature from uncompensated temperature
- *                          and returns the value in Degree centigrade
- *                          Output value of "51.23" equals 51.23 DegC.
+ * Description: *//**\brief reads temperature.
  *
  *
  *
- *  \param signed long : value of uncompensated temperature
  *
- *
- *
- *  \return
- *          double : actual temperature in floating point
- *
- ******************************************************************************/
-/* Scheduling:
- *
- *
- *
- * Usage guide:
- *
- *
- * Remarks:
- *
- ******************************************************************************/
-static double bme280_compensate_T_double(int32_t adc_t)
-{
-    double v_x1_uint32_tr = BME280_Zero_U8X;
-    double v_x2_uint32_tr = BME280_Zero_U8X;
-    double temperature = BME280_Zero_U8X;
-
-    v_x1_uint32_tr  = (((double)adc_t) / 16384.0 -
-    ((double)p_bme280->cal_param.dig_T1) / 1024.0) *
-    ((double)p_bme280->cal_param.dig_T2);
-    v_x2_uint32_tr  = ((((double)adc_t) / 131072.0 -
-    ((double)p_bme280->cal_param.dig_T1) / 8192.0) *
-    (((double)adc_t) / 131072.0 -
-    ((double)p_bme280->cal_param.dig_T1) / 8192.0)) *
-    ((double)p_bme280->cal_param.dig_T3);
-    p_bme280->cal_param.t_fine = (int32_t)(v_x1_uint32_tr + v_x2_uint32_tr);
-    temperature  = (v_x1_uint32_tr + v_x2_uint32_tr) / 5120.0;
-
-    return temperature;
-}
-
-/*******************************************************************************
- * Description: *//**\brief Reads actual pressure from uncompensated pressure
- *                          and returns pressure in Pa as double.
- *                          Output value of "96386.2"
- *                          equals 96386.2 Pa = 963.862 hPa.
- *
- *
- *  \param signed int : value of uncompensated pressure
- *
- *
- *
- *  \return
- *          double : actual pressure in floating point
- *
- ******************************************************************************/
-/* Scheduling:
- *
- *
- *
- * Usage guide:
- *
- *
- * Remarks:
- *
- ******************************************************************************/
-static double bme280_compensate_P_double(int32_t adc_p)
-{
-    double v_x1_uint32_tr = BME280_Zero_U8X;
-    double v_x2_uint32_tr = BME280_Zero_U8X;
-    double pressure = BME280_Zero_U8X;
-
-    v_x1_uint32_tr = ((double)p_bme280->cal_param.t_fine/2.0) - 64000.0;
-    v_x2_uint32_tr = v_x1_uint32_tr * v_x1_uint32_tr *
-    ((double)p_bme280->cal_param.dig_P6) / 32768.0;
-    v_x2_uint32_tr = v_x2_uint32_tr + v_x1_uint32_tr *
-    ((double)p_bme280->cal_param.dig_P5) * 2.0;
-    v_x2_uint32_tr = (v_x2_uint32_tr / 4.0) +
-    (((double)p_bme280->cal_param.dig_P4) * 65536.0);
-    v_x1_uint32_tr = (((double)p_bme280->cal_param.dig_P3) *
-    v_x1_uint32_tr * v_x1_uint32_tr / 524288.0 +
-    ((double)p_bme280->cal_param.dig_P2) * v_x1_uint32_tr) / 524288.0;
-    v_x1_uint32_tr = (1.0 + v_x1_uint32_tr / 32768.0) *
-    ((double)p_bme280->cal_param.dig_P1);
-    pressure = 1048576.0 - (double)adc_p;
-    /* Avoid exception caused by division by zero */
-    if (v_x1_uint32_tr != BME280_Zero_U8X)
-        pressure = (pressure - (v_x2_uint32_tr / 4096.0)) * 6250.0 / v_x1_uint32_tr;
-    else
-        return 0;
-    v_x1_uint32_tr = ((double)p_bme280->cal_param.dig_P9) *
-    pressure * pressure / 2147483648.0;
-    v_x2_uint32_tr = pressure * ((double)p_bme280->cal_param.dig_P8) / 32768.0;
-    pressure = pressure + (v_x1_uint32_tr + v_x2_uint32_tr +
-    ((double)p_bme280->cal_param.dig_P7)) / 16.0;
-
-    return pressure;
-}
-
-/*******************************************************************************
- * Description: *//**\brief Reads actual humidity from uncompensated humidity
- *                          and returns the value in relative humidity (%rH)
- *                          Output value of "42.12" equals 42.12 %rH
- *
- *  \param signed int : value of uncompensated humidity
- *
- *
- *
- *  \return
- *          double : actual humidity in floating point
- *
- ******************************************************************************/
-/* Scheduling:
- *
- *
- *
- * Usage guide:
- *
- *
- * Remarks:
- *
- ******************************************************************************/
-static double bme280_compensate_H_double(int32_t adc_h)
-{
-    double var_h = BME280_Zero_U8X;
-    var_h = (((double)p_bme280->cal_param.t_fine)-76800.0);
-    if (var_h != BME280_Zero_U8X)
-        var_h = (adc_h-(((double)p_bme280->cal_param.dig_H4)*64.0 +
-        ((double)p_bme280->cal_param.dig_H5) / 16384.0 * var_h))*
-        (((double)p_bme280->cal_param.dig_H2)/65536.0*(1.0 + ((double)
-        p_bme280->cal_param.dig_H6)/67108864.0*var_h*(1.0+((double)
-        p_bme280->cal_param.dig_H3)/67108864.0*var_h)));
-    else
-        return 0;
-    var_h = var_h * (1.0-((double)
-    p_bme280->cal_param.dig_H1)*var_h/524288.0);
-    if (var_h > 100.0)
-        var_h = 100.0;
-    else if (var_h < 0.0)
-        var_h = 0.0;
-    return var_h;
-
-}
-
-/*******************************************************************************
- * Description: *//**\brief reads  temperature .
- *
- *
- *
- *
- *  \param double temperature : Pointer holding
- *                      the compensated temperature.
+ *  \param int32_t temperature : Pointer holding
+ *                      the compensated temperature in 0.01 DegC.
  *
  *
  *  \return results of bus communication function
@@ -735,28 +587,30 @@ static double bme280_compensate_H_double(int32_t adc_h)
  * Usage guide:
  *
  *
- * Remarks:
+ * Remarks: t_fine is kept for the following bme280_read_p and bme280_read_h.
  *
  ******************************************************************************/
-BME280_RETURN_FUNCTION_TYPE bme280_read_t_double(double *temperature)
+BME280_RETURN_FUNCTION_TYPE bme280_read_t(int32_t *temperature)
 {
     BME280_RETURN_FUNCTION_TYPE comres = BME280_Zero_U8X;
     int32_t utemperature = BME280_Zero_U8X;
 
     comres += bme280_read_ut(&utemperature);
-    *temperature = bme280_compensate_T_double(utemperature);
+    p_bme280->cal_param.t_fine =
+    bme280_compensate_t_fine(&p_bme280->cal_param, utemperature);
+    *temperature = bme280_compensate_t(p_bme280->cal_param.t_fine);
 
     return comres;
 }
 
 /*******************************************************************************
- * Description: *//**\brief reads  pressure .
+ * Description: *//**\brief reads pressure.
  *
  *
  *
  *
- *  \param double pressure : Pointer holding
- *                          the compensated pressure.
+ *  \param uint32_t pressure : Pointer holding
+ *                          the compensated pressure in Pa, Q24.8 format.
  *
  *
  *  \return results of bus communication function
@@ -770,28 +624,29 @@ BME280_RETURN_FUNCTION_TYPE bme280_read_t_double(double *temperature)
  * Usage guide:
  *
  *
- * Remarks:
+ * Remarks: uses the t_fine of the last bme280_read_t.
  *
  ******************************************************************************/
-BME280_RETURN_FUNCTION_TYPE bme280_read_p_double(double *pressure)
+BME280_RETURN_FUNCTION_TYPE bme280_read_p(uint32_t *pressure)
 {
     BME280_RETURN_FUNCTION_TYPE comres = BME280_Zero_U8X;
-    int32_t utemperature = BME280_Zero_U8X;
+    int32_t upressure = BME280_Zero_U8X;
 
-    comres += bme280_read_up(&utemperature);
-    *pressure = bme280_compensate_P_double(utemperature);
+    comres += bme280_read_up(&upressure);
+    *pressure = bme280_compensate_p(&p_bme280->cal_param, upressure,
+    p_bme280->cal_param.t_fine);
 
     return comres;
 }
 
 /*******************************************************************************
- * Description: *//**\brief reads  humidity .
+ * Description: *//**\brief reads humidity.
  *
  *
  *
  *
- *  \param double humidity : Pointer holding
- *                          the compensated humidity.
+ *  \param uint32_t humidity : Pointer holding
+ *                          the compensated humidity in %rH, Q22.10 format.
  *
  *
  *  \return results of bus communication function
@@ -805,328 +660,34 @@ BME280_RETURN_FUNCTION_TYPE bme280_read_p_double(double *pressure)
  * Usage guide:
  *
  *
- * Remarks:
+ * Remarks: uses the t_fine of the last bme280_read_t.
  *
  ******************************************************************************/
-BME280_RETURN_FUNCTION_TYPE bme280_read_h_double(double *humidity)
+BME280_RETURN_FUNCTION_TYPE bme280_read_h(uint32_t *humidity)
 {
     BME280_RETURN_FUNCTION_TYPE comres = BME280_Zero_U8X;
     int32_t uhumidity = BME280_Zero_U8X;
 
     comres += bme280_read_uh(&uhumidity);
-    *humidity = bme280_compensate_H_double(uhumidity);
-
-    return comres;
-}
-#else
-/*******************************************************************************
- * Description: *//**\brief Reads actual temperature from uncompensated temperature
- *                    and returns the value in 0.01 degree Centigrade
- *                    Output value of "5123" equals 51.23 DegC.
- *
- *
- *
- *  \param int32_t : value of uncompensated temperature
- *
- *
- *  \return
- *          int32_t : actual temperature
- *
- ******************************************************************************/
-/* Scheduling:
- *
- *
- *
- * Usage guide:
- *
- *
- * Remarks:
- *
- ******************************************************************************/
-static int32_t bme280_compensate_T_int32(int32_t adc_t)
-{
-    int32_t v_x1_uint32_tr = BME280_Zero_U8X;
-    int32_t v_x2_uint32_tr = BME280_Zero_U8X;
-    int32_t temperature = BME280_Zero_U8X;
-
-    v_x1_uint32_tr  = ((((adc_t >> 3) - ((int32_t)
-    p_bme280->cal_param.dig_T1 << 1))) *
-    ((int32_t)p_bme280->cal_param.dig_T2)) >> 11;
-    v_x2_uint32_tr  = (((((adc_t >> 4) -
-    ((int32_t)p_bme280->cal_param.dig_T1)) * ((adc_t >> 4) -
-    ((int32_t)p_bme280->cal_param.dig_T1))) >> 12) *
-    ((int32_t)p_bme280->cal_param.dig_T3)) >> 14;
-    p_bme280->cal_param.t_fine = v_x1_uint32_tr + v_x2_uint32_tr;
-    temperature  = (p_bme280->cal_param.t_fine * 5 + 128) >> 8;
-    return temperature;
-}
-
-#ifndef CONFIG_BME280_ENABLE_INT64
-/*******************************************************************************
- * Description: *//**\brief Reads actual pressure from uncompensated pressure
- *                          and returns the value in Pascal(Pa)
- *                          Output value of "96386" equals 96386 Pa =
- *                          963.86 hPa = 963.86 millibar
- *
- *
- *
- *  \param int32_t : value of uncompensated pressure
- *
- *
- *
- *  \return
- *          uint32_t : actual pressure
- *
- ******************************************************************************/
-/* Scheduling:
- *
- *
- *
- * Usage guide:
- *
- *
- * Remarks:
- *
- ******************************************************************************/
-static uint32_t bme280_compensate_P_int32(int32_t adc_p)
-{
-    int32_t v_x1_uint32_tr = BME280_Zero_U8X;
-    int32_t v_x2_uint32_tr = BME280_Zero_U8X;
-    uint32_t pressure = BME280_Zero_U8X;
-
-    v_x1_uint32_tr = (((int32_t)p_bme280->cal_param.t_fine) >> 1) - (int32_t)64000;
-    v_x2_uint32_tr = (((v_x1_uint32_tr >> 2) * (v_x1_uint32_tr >> 2)) >> 11) *
-    ((int32_t)p_bme280->cal_param.dig_P6);
-    v_x2_uint32_tr = v_x2_uint32_tr + ((v_x1_uint32_tr *
-    ((int32_t)p_bme280->cal_param.dig_P5)) << 1);
-    v_x2_uint32_tr = (v_x2_uint32_tr >> 2) +
-    (((int32_t)p_bme280->cal_param.dig_P4) << 16);
-    v_x1_uint32_tr = (((p_bme280->cal_param.dig_P3 * (((v_x1_uint32_tr >> 2) *
-    (v_x1_uint32_tr >> 2)) >> 13)) >> 3) +
-    ((((int32_t)p_bme280->cal_param.dig_P2) *
-    v_x1_uint32_tr) >> 1)) >> 18;
-    v_x1_uint32_tr = ((((32768+v_x1_uint32_tr)) *
-    ((int32_t)p_bme280->cal_param.dig_P1))  >> 15);
-    pressure = (((uint32_t)(((int32_t)1048576) - adc_p) -
-    (v_x2_uint32_tr >> 12))) * 3125;
-    if (pressure < 0x80000000)
-        /* Avoid exception caused by division by zero */
-        if (v_x1_uint32_tr != BME280_Zero_U8X)
-            pressure = (pressure << 1) / ((uint32_t)v_x1_uint32_tr);
-        else
-            return BME280_Zero_U8X;
-    else
-        /* Avoid exception caused by division by zero */
-        if (v_x1_uint32_tr != BME280_Zero_U8X)
-            pressure = (pressure / (uint32_t)v_x1_uint32_tr) * 2;
-        else
-            return BME280_Zero_U8X;
-
-        v_x1_uint32_tr = (((int32_t)p_bme280->cal_param.dig_P9) *
-        ((int32_t)(((pressure >> 3) * (pressure >> 3)) >> 13)))
-        >> 12;
-        v_x2_uint32_tr = (((int32_t)(pressure >> 2)) *
-        ((int32_t)p_bme280->cal_param.dig_P8)) >> 13;
-        pressure = (uint32_t)((int32_t)pressure +
-        ((v_x1_uint32_tr + v_x2_uint32_tr + p_bme280->cal_param.dig_P7) >> 4));
-
-    return pressure;
-}
-#else
-/********************************************************************************
- * Description: *//**\brief Reads actual pressure from uncompensated pressure
- * \note Returns the value in Pa as unsigned 32 bit
- * integer in Q24.8 format (24 integer bits and
- * 8 fractional bits).
- * \note Output value of "24674867"
- * represents 24674867 / 256 = 96386.2 Pa = 963.862 hPa
- *
- *
- *
- *  \param  v_uncom_pressure_s32 : value of uncompensated temperature
- *
- *
- *  \return Return the actual pressure in u32
- *
- ******************************************************************************/
-static uint32_t bme280_compensate_P_int64(int32_t v_uncom_pressure_s32)
-{
-    int64_t v_x1_s64r = 0;
-    int64_t v_x2_s64r = 0;
-    int64_t pressure = 0;
-
-    v_x1_s64r = ((int64_t)p_bme280->cal_param.t_fine)
-    - 128000;
-    v_x2_s64r = v_x1_s64r * v_x1_s64r *
-    (int64_t)p_bme280->cal_param.dig_P6;
-    v_x2_s64r = v_x2_s64r + ((v_x1_s64r *
-    (int64_t)p_bme280->cal_param.dig_P5)
-    << 17);
-    v_x2_s64r = v_x2_s64r +
-    (((int64_t)p_bme280->cal_param.dig_P4)
-    << 35);
-    v_x1_s64r = ((v_x1_s64r * v_x1_s64r *
-    (int64_t)p_bme280->cal_param.dig_P3)
-    >> 8) +
-    ((v_x1_s64r * (int64_t)p_bme280->cal_param.dig_P2)
-    << 12);
-    v_x1_s64r = (((((int64_t)1)
-    << 47) + v_x1_s64r)) *
-    ((int64_t)p_bme280->cal_param.dig_P1)
-    >> 33;
-    pressure = 1048576 - v_uncom_pressure_s32;
-    /* Avoid exception caused by division by zero */
-    if (v_x1_s64r != 0)
-            pressure = (((pressure
-            << 31) - v_x2_s64r)
-            * 3125) / v_x1_s64r;
-    else
-        return 0;
-    v_x1_s64r = (((int64_t)p_bme280->cal_param.dig_P9) *
-    (pressure >> 13) *
-    (pressure >> 13))
-    >> 25;
-    v_x2_s64r = (((int64_t)p_bme280->cal_param.dig_P8) *
-    pressure) >> 19;
-    pressure = (((pressure + v_x1_s64r +
-    v_x2_s64r) >> 8) +
-    (((int64_t)p_bme280->cal_param.dig_P7)
-    << 4));
-
-    return (uint32_t)pressure;
-}
-#endif
-
-/*******************************************************************************
- * Description: *//**\brief Reads actual humidity from
- *        uncompensated humidity
- *        and returns the value in %rH as unsigned 32bit integer
- *        in Q22.10 format(22 integer 10 fractional bits).
- *        An output value of 42313
- *        represents 42313 / 1024 = 41.321 %rH
- *
- *
- *
- *  \param int32_t : value of uncompensated humidity
- *
- *  \return
- *          uint32_t : actual relative humidity
- *
- ******************************************************************************/
-/* Scheduling:
- *
- *
- *
- * Usage guide:
- *
- *
- * Remarks:
- *
- ******************************************************************************/
-static uint32_t bme280_compensate_H_int32(int32_t adc_h)
-{
-    int32_t v_x1_uint32_tr;
-    v_x1_uint32_tr = (p_bme280->cal_param.t_fine - ((int32_t)76800));
-    v_x1_uint32_tr = (((((adc_h << 14) -
-    (((int32_t)p_bme280->cal_param.dig_H4) << 20) -
-    (((int32_t)p_bme280->cal_param.dig_H5) * v_x1_uint32_tr)) +
-    ((int32_t)16384)) >> 15) *
-    (((((((v_x1_uint32_tr *
-    ((int32_t)p_bme280->cal_param.dig_H6)) >> 10) *
-    (((v_x1_uint32_tr * ((int32_t)p_bme280->cal_param.dig_H3)) >> 11) +
-    ((int32_t)32768))) >> 10) +
-    ((int32_t)2097152)) *
-    ((int32_t)p_bme280->cal_param.dig_H2) + 8192) >> 14));
-    v_x1_uint32_tr = (v_x1_uint32_tr - (((((v_x1_uint32_tr >> 15) *
-    (v_x1_uint32_tr >> 15)) >> 7) *
-    ((int32_t)p_bme280->cal_param.dig_H1)) >> 4));
-    v_x1_uint32_tr = (v_x1_uint32_tr < 0 ? 0 : v_x1_uint32_tr);
-    v_x1_uint32_tr = (v_x1_uint32_tr > 419430400 ? 419430400 : v_x1_uint32_tr);
-    return (uint32_t)(v_x1_uint32_tr>>12);
-}
-
-/*******************************************************************************
- * Description: *//**\brief reads pressure, temperature and humidity.
- *
- *
- *
- *
- *  \param int32_t temperature : Pointer holding
- *                      the compensated temperature.
- *
- *
- *  \return results of bus communication function
- *
- *
- ******************************************************************************/
-/* Scheduling:
- *
- *
- *
- * Usage guide:
- *
- *
- * Remarks:
- *
- ******************************************************************************/
-BME280_RETURN_FUNCTION_TYPE bme280_read_t(int32_t *temperature)
-{
-    BME280_RETURN_FUNCTION_TYPE comres = BME280_Zero_U8X;
-    int32_t utemperature = BME280_Zero_U8X;
-
-    comres += bme280_read_ut(&utemperature);
-    *temperature = bme280_compensate_T_int32(utemperature);
-
-    return comres;
-}
-
-/*******************************************************************************
- * Description: *//**\brief reads pressure.
- *
- *
- *
- *
- *  \param uint32_t pressure : Pointer holding
- *                          the compensated pressure.
- *
- *
- *  \return results of bus communication function
- *
- *
- ******************************************************************************/
-/* Scheduling:
- *
- *
- *
- * Usage guide:
- *
- *
- * Remarks:
- *
- ******************************************************************************/
-BME280_RETURN_FUNCTION_TYPE bme280_read_p(uint32_t *pressure)
-{
-    BME280_RETURN_FUNCTION_TYPE comres = BME280_Zero_U8X;
-    int32_t upressure = BME280_Zero_U8X;
-
-    comres += bme280_read_up(&upressure);
-#ifdef CONFIG_BME280_ENABLE_INT64
-    *pressure = bme280_compensate_P_int64(upressure);
-#else
-    *pressure = bme280_compensate_P_int32(upressure)*256;
-#endif
+    *humidity = bme280_compensate_h(&p_bme280->cal_param, uhumidity,
+    p_bme280->cal_param.t_fine);
 
     return comres;
 }
 
 /*******************************************************************************
- * Description: *//**\brief reads humidity.
- *
+ * Description: *//**\brief reads pressure, temperature and humidity
+ *  of the same measurement in one burst of the registers 0xF7 to 0xFE.
+ *  t_fine is computed once and shared by the three compensations.
  *
  *
  *
- *  \param uint32_t pressure : Pointer holding
- *                          the compensated humidity.
+ *  \param uint32_t pressure : Pointer holding the compensated pressure
+ *                          in Pa, Q24.8 format, or NULL
+ *  \param int32_t temperature : Pointer holding the compensated
+ *                          temperature in 0.01 DegC, or NULL
+ *  \param uint32_t humidity : Pointer holding the compensated humidity
+ *                          in %rH, Q22.10 format, or NULL
  *
  *
  *  \return results of bus communication function
@@ -1140,19 +701,36 @@ BME280_RETURN_FUNCTION_TYPE bme280_read_p(uint32_t *pressure)
  * Usage guide:
  *
  *
- * Remarks:
+ * Remarks: outputs given as NULL are not compensated.
  *
  ******************************************************************************/
-BME280_RETURN_FUNCTION_TYPE bme280_read_h(uint32_t *humidity)
+BME280_RETURN_FUNCTION_TYPE bme280_read_all(uint32_t *pressure,
+                                            int32_t *temperature,
+                                            uint32_t *humidity)
 {
     BME280_RETURN_FUNCTION_TYPE comres = BME280_Zero_U8X;
-    int32_t uhumidity = BME280_Zero_U8X;
-
-    comres += bme280_read_uh(&uhumidity);
-    *humidity = bme280_compensate_H_int32(uhumidity);
+    uint8_t frame[BME280_DATA_FRAME_LEN];
+    struct bme280_uncomp_data raw;
+    int32_t t_fine;
+
+    comres += bme280_bus_burst_read(BME280_PRESSURE_MSB_REG, frame,
+    BME280_DATA_FRAME_LEN);
+    if (comres)
+        return comres;
+
+    bme280_parse_data_frame(frame, &raw);
+    t_fine = bme280_compensate_t_fine(&p_bme280->cal_param, raw.adc_t);
+    p_bme280->cal_param.t_fine = t_fine;
+
+    if (temperature)
+        *temperature = bme280_compensate_t(t_fine);
+    if (pressure)
+        *pressure = bme280_compensate_p(&p_bme280->cal_param, raw.adc_p,
+        t_fine);
+    if (humidity)
+        *humidity = bme280_compensate_h(&p_bme280->cal_param, raw.adc_h,
+        t_fine);
 
     return comres;
 }
-
-#endif
 /* *INDENT-ON*  */
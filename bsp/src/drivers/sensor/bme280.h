@@ -59,11 +59,6 @@
 #include <stdint.h>
 #include <limits.h>
 
-/* If the user wants to support floating point calculations, please set
- *  the following #define. If floating point
- *  calculation is not wanted or allowed
- *  (e.g. in Linux kernel), please do not set the define. */
-/*#define BME280_ENABLE_FLOAT*/
 /* If the user wants to support 64 bit integer calculation
  *  (needed for optimal pressure accuracy) please set
  *  the following #define. If int64 calculation is not wanted
@@ -71,8 +66,6 @@
  *  large libraries), please do not set the define. */
 //#define BME280_ENABLE_INT64
 
-//#define BME280_ENABLE_FLOAT
-
 /** defines the return parameter type of the BME280_WR_FUNCTION */
 #define BME280_BUS_WR_RETURN_TYPE int8_t
 
@@ -374,7 +367,7 @@ BME280_RETURN_FUNCTION_TYPE bme280_read_p(uint32_t *pressure);
 
 BME280_RETURN_FUNCTION_TYPE bme280_read_h(uint32_t *humidity);
 
-BME280_RETURN_FUNCTION_TYPE bme280_read_pth(uint32_t *	pressure,
+BME280_RETURN_FUNCTION_TYPE bme280_read_all(uint32_t *	pressure,
 					    int32_t *	temperature,
 					    uint32_t *	humidity);
 
@@ -382,21 +375,6 @@ BME280_RETURN_FUNCTION_TYPE bme280_get_forced_pth(uint32_t *	pressure,
 						  int32_t *	temperature,
 						  uint32_t *	humidity);
 
-BME280_RETURN_FUNCTION_TYPE bme280_read_t_double(double *temperature);
-
-BME280_RETURN_FUNCTION_TYPE bme280_read_p_double(double *pressure);
-
-BME280_RETURN_FUNCTION_TYPE bme280_read_h_double(double *humidity);
-
-BME280_RETURN_FUNCTION_TYPE bme280_read_pth_double(double *	pressure,
-						   double *	temperature,
-						   double *	humidity);
-
-BME280_RETURN_FUNCTION_TYPE bme280_get_forced_pth_double(double *pressure,
-							 double *
-							 temperature, double *
-							 humidity);
-
 BME280_RETURN_FUNCTION_TYPE bme280_get_osrs_t(uint8_t *value);
 
 BME280_RETURN_FUNCTION_TYPE bme280_set_osrs_t(uint8_t value);
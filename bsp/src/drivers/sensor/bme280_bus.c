@@ -72,6 +72,19 @@ DRIVER_API_RC bme280_bus_write(uint8_t reg_addr, uint8_t *reg_data, uint8_t cnt)
 				 -1);
 }
 
+DRIVER_API_RC bme280_bus_read_regs(const uint8_t *reg_addr, uint8_t *reg_data,
+				   uint8_t n)
+{
+	return sensor_bus_read_regs(bme280_sba_info, reg_addr, reg_data, n, -1);
+}
+
+DRIVER_API_RC bme280_bus_write_regs(const uint8_t *reg_addr,
+				    const uint8_t *reg_data, uint8_t n)
+{
+	return sensor_bus_write_regs(bme280_sba_info, reg_addr, reg_data, n,
+				     -1);
+}
+
 DRIVER_API_RC bme280_config_bus(struct td_device *dev)
 {
 	struct sba_device *sba_dev = (struct sba_device *)dev;
@@ -38,6 +38,11 @@ DRIVER_API_RC bme280_bus_read(uint8_t reg_addr, uint8_t *reg_data, uint8_t cnt);
 DRIVER_API_RC bme280_bus_burst_read(uint8_t reg_addr, uint8_t *reg_data,
 				    uint32_t cnt);
 DRIVER_API_RC bme280_bus_write(uint8_t reg_addr, uint8_t *reg_data, uint8_t cnt);
+/* Read or write single registers in one bus session, up to SENSOR_BUS_MAX_SEGS */
+DRIVER_API_RC bme280_bus_read_regs(const uint8_t *reg_addr, uint8_t *reg_data,
+				   uint8_t n);
+DRIVER_API_RC bme280_bus_write_regs(const uint8_t *reg_addr,
+				    const uint8_t *reg_data, uint8_t n);
 
 static inline DRIVER_API_RC bme280_write_reg(uint8_t	v_addr_u8,
 					     uint8_t *	v_data_u8)
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bme280_compensate.h"
+
+/*
+ * The arithmetic below is the fixed-point reference of the BME280 datasheet
+ * (revision 1.1 for temperature and pressure, 1.0 for humidity), rewritten
+ * with the calibration and t_fine as arguments so that they stay in
+ * registers and t_fine is computed once per measurement. Left shifts of
+ * signed values are written as multiplications, which compile to the same
+ * shifts. Results are bit exact with the datasheet.
+ */
+
+int32_t bme280_compensate_t_fine(const struct bme280_calibration_param_t *cal,
+				 int32_t adc_t)
+{
+	int32_t t1 = cal->dig_T1;
+	int32_t var1, var2, d;
+
+	var1 = (((adc_t >> 3) - (t1 << 1)) * ((int32_t)cal->dig_T2)) >> 11;
+	d = (adc_t >> 4) - t1;
+	var2 = (((d * d) >> 12) * ((int32_t)cal->dig_T3)) >> 14;
+
+	return var1 + var2;
+}
+
+#ifdef CONFIG_BME280_ENABLE_INT64
+uint32_t bme280_compensate_p(const struct bme280_calibration_param_t *cal,
+			     int32_t adc_p, int32_t t_fine)
+{
+	int64_t var1, var2, p;
+
+	var1 = ((int64_t)t_fine) - 128000;
+	var2 = var1 * var1 * (int64_t)cal->dig_P6;
+	var2 = var2 + var1 * (int64_t)cal->dig_P5 * (1 << 17);
+	var2 = var2 + ((int64_t)cal->dig_P4) * ((int64_t)1 << 35);
+	var1 = ((var1 * var1 * (int64_t)cal->dig_P3) >> 8) +
+	       var1 * (int64_t)cal->dig_P2 * (1 << 12);
+	var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)cal->dig_P1) >> 33;
+	/* Avoid exception caused by division by zero */
+	if (var1 == 0)
+		return 0;
+
+	p = 1048576 - adc_p;
+	p = ((p * ((int64_t)1 << 31) - var2) * 3125) / var1;
+	var1 = (((int64_t)cal->dig_P9) * (p >> 13) * (p >> 13)) >> 25;
+	var2 = (((int64_t)cal->dig_P8) * p) >> 19;
+	p = ((p + var1 + var2) >> 8) + ((int64_t)cal->dig_P7) * 16;
+
+	return (uint32_t)p;
+}
+#else
+uint32_t bme280_compensate_p(const struct bme280_calibration_param_t *cal,
+			     int32_t adc_p, int32_t t_fine)
+{
+	int32_t var1, var2;
+	uint32_t p;
+
+	var1 = (t_fine >> 1) - (int32_t)64000;
+	var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t)cal->dig_P6);
+	var2 = var2 + var1 * ((int32_t)cal->dig_P5) * 2;
+	var2 = (var2 >> 2) + ((int32_t)cal->dig_P4) * 65536;
+	var1 = (((cal->dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) +
+		((((int32_t)cal->dig_P2) * var1) >> 1)) >> 18;
+	var1 = (((32768 + var1)) * ((int32_t)cal->dig_P1)) >> 15;
+	/* Avoid exception caused by division by zero */
+	if (var1 == 0)
+		return 0;
+
+	p = (((uint32_t)(((int32_t)1048576) - adc_p) - (var2 >> 12))) * 3125;
+	if (p < 0x80000000)
+		p = (p << 1) / ((uint32_t)var1);
+	else
+		p = (p / (uint32_t)var1) * 2;
+	var1 = (((int32_t)cal->dig_P9) *
+		((int32_t)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
+	var2 = (((int32_t)(p >> 2)) * ((int32_t)cal->dig_P8)) >> 13;
+	p = (uint32_t)((int32_t)p + ((var1 + var2 + cal->dig_P7) >> 4));
+
+	/* Integer Pa, returned in the Q24.8 format of the 64 bits version */
+	return p << 8;
+}
+#endif
+
+uint32_t bme280_compensate_h(const struct bme280_calibration_param_t *cal,
+			     int32_t adc_h, int32_t t_fine)
+{
+	int32_t v;
+
+	v = t_fine - ((int32_t)76800);
+	v = (((((adc_h << 14) - ((int32_t)cal->dig_H4) * (1 << 20) -
+		(((int32_t)cal->dig_H5) * v)) + ((int32_t)16384)) >> 15) *
+	     (((((((v * ((int32_t)cal->dig_H6)) >> 10) *
+		  (((v * ((int32_t)cal->dig_H3)) >> 11) +
+		   ((int32_t)32768))) >> 10) + ((int32_t)2097152)) *
+	       ((int32_t)cal->dig_H2) + 8192) >> 14));
+	v = v - (((((v >> 15) * (v >> 15)) >> 7) *
+		  ((int32_t)cal->dig_H1)) >> 4);
+	v = v < 0 ? 0 : v;
+	v = v > 419430400 ? 419430400 : v;
+
+	return (uint32_t)(v >> 12);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BME280_COMPENSATE_H__
+#define __BME280_COMPENSATE_H__
+
+#include <stdint.h>
+
+#include "bme280.h"
+
+/**
+ * Fixed-point compensation of the BME280 measurements.
+ *
+ * One measurement is read in a single burst of the data registers, from
+ * press_msb (0xF7) to hum_lsb (0xFE). t_fine is computed once from the
+ * temperature and passed to the pressure and humidity compensators, which
+ * only use integer arithmetic (64 bits for the pressure when
+ * CONFIG_BME280_ENABLE_INT64 is set). This module does not touch the
+ * hardware and can be built on the host.
+ */
+
+/* Number of bytes of the data registers burst read, 0xF7 to 0xFE */
+#define BME280_DATA_FRAME_LEN           8
+
+/* ADC value read when a measurement is skipped (oversampling set to 0) */
+#define BME280_ADC_TP_SKIPPED           0x80000
+#define BME280_ADC_H_SKIPPED            0x8000
+
+/** Uncompensated values of one measurement */
+struct bme280_uncomp_data {
+	int32_t adc_p;          /*!< 20 bits */
+	int32_t adc_t;          /*!< 20 bits */
+	int32_t adc_h;          /*!< 16 bits */
+};
+
+/**
+ * Extract the uncompensated values from a data registers burst.
+ *
+ * @param frame  BME280_DATA_FRAME_LEN bytes read from BME280_PRESSURE_MSB_REG
+ * @param raw    output uncompensated values
+ */
+static inline void bme280_parse_data_frame(const uint8_t *frame,
+					   struct bme280_uncomp_data *raw)
+{
+	raw->adc_p = ((uint32_t)frame[0] << 12) | ((uint32_t)frame[1] << 4) |
+		     (frame[2] >> 4);
+	raw->adc_t = ((uint32_t)frame[3] << 12) | ((uint32_t)frame[4] << 4) |
+		     (frame[5] >> 4);
+	raw->adc_h = ((uint32_t)frame[6] << 8) | frame[7];
+}
+
+/**
+ * Compute the fine resolution temperature shared by all compensations.
+ *
+ * @param cal    calibration parameters of the device
+ * @param adc_t  uncompensated temperature
+ *
+ * @return t_fine
+ */
+int32_t bme280_compensate_t_fine(const struct bme280_calibration_param_t *cal,
+				 int32_t adc_t);
+
+/**
+ * Temperature in 0.01 DegC from t_fine: 5123 equals 51.23 DegC.
+ */
+static inline int32_t bme280_compensate_t(int32_t t_fine)
+{
+	return (t_fine * 5 + 128) >> 8;
+}
+
+/**
+ * Compensate a pressure measurement.
+ *
+ * @param cal     calibration parameters of the device
+ * @param adc_p   uncompensated pressure
+ * @param t_fine  value returned by bme280_compensate_t_fine()
+ *
+ * @return pressure in Pa, Q24.8 format: 24674867 is 96386.2 Pa. Without
+ *         CONFIG_BME280_ENABLE_INT64 the fractional bits are always 0.
+ *         0 if the calibration parameters are invalid.
+ */
+uint32_t bme280_compensate_p(const struct bme280_calibration_param_t *cal,
+			     int32_t adc_p, int32_t t_fine);
+
+/**
+ * Compensate a humidity measurement.
+ *
+ * @param cal     calibration parameters of the device
+ * @param adc_h   uncompensated humidity
+ * @param t_fine  value returned by bme280_compensate_t_fine()
+ *
+ * @return relative humidity in %rH, Q22.10 format: 42313 is 41.321 %rH
+ */
+uint32_t bme280_compensate_h(const struct bme280_calibration_param_t *cal,
+			     int32_t adc_h, int32_t t_fine);
+
+#endif /* __BME280_COMPENSATE_H__ */
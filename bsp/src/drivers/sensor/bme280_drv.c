@@ -129,17 +129,16 @@ static int generic_read_data(struct phy_sensor_t *sensor, uint8_t *buf,
 {
 	struct bme280_sensor_drv_t *bme280_sensor =
 		(struct bme280_sensor_drv_t *)sensor;
-	BME280_RETURN_FUNCTION_TYPE com_rslt = 0;
-	int32_t temperature = 0;
-
-	com_rslt += bme280_read_t(&temperature);
+	BME280_RETURN_FUNCTION_TYPE com_rslt;
 
+	/* One burst read of the measurement, only the requested value is
+	 * compensated */
 	if (bme280_sensor->bme280_type == BME280_SENSOR_TEMP)
-		*((int32_t *)buf) = temperature;
+		com_rslt = bme280_read_all(NULL, (int32_t *)buf, NULL);
 	else if (bme280_sensor->bme280_type == BME280_SENSOR_PRESS)
-		com_rslt += bme280_read_p((uint32_t *)buf);
+		com_rslt = bme280_read_all((uint32_t *)buf, NULL, NULL);
 	else
-		com_rslt += bme280_read_h((uint32_t *)buf);
+		com_rslt = bme280_read_all(NULL, NULL, (uint32_t *)buf);
 
 	if (com_rslt)
 		return 0;
@@ -45,16 +45,28 @@ static inline void bme280_default_config(void)
 	p_bme280->t_sb = BME280_STANDBYTIME_125_MS;
 }
 
+/* Control registers, in the order they must be written: ctrl_hum only takes
+ * effect after ctrl_meas is written */
+enum {
+	CTRL_CONFIG = 0,
+	CTRL_HUM,
+	CTRL_MEAS,
+	CTRL_COUNT
+};
+
+static const uint8_t ctrl_regs[CTRL_COUNT] = {
+	[CTRL_CONFIG] = BME280_CONFIG_REG,
+	[CTRL_HUM] = BME280_CTRLHUM_REG,
+	[CTRL_MEAS] = BME280_CTRLMEAS_REG,
+};
+
 DRIVER_API_RC bme280_set_workmode(struct phy_sensor_t *sensor)
 {
 	BME280_RETURN_FUNCTION_TYPE comres = SUCCESS;
-	uint8_t cfg = BME280_Zero_U8X;
-	uint8_t ctrl_meas = BME280_Zero_U8X;
-	uint8_t ctrl_hum = BME280_Zero_U8X;
-	uint8_t cfg_check = BME280_Zero_U8X;
-	uint8_t ctrl_meas_check = BME280_Zero_U8X;
-	uint8_t ctrl_hum_check = BME280_Zero_U8X;
+	uint8_t ctrl[CTRL_COUNT];
+	uint8_t check[CTRL_COUNT];
 	uint8_t mismatch = 0;
+	int i;
 
 	struct bme280_t *p_bme280 = &bme280_s;
 
@@ -64,50 +76,43 @@ DRIVER_API_RC bme280_set_workmode(struct phy_sensor_t *sensor)
 		return E_BME280_OUT_OF_RANGE;
 	}
 
-	comres += bme280_read_reg(BME280_CTRLHUM_REG, &ctrl_hum);
-	comres += bme280_read_reg(BME280_CTRLMEAS_REG, &ctrl_meas);
-	comres += bme280_read_reg(BME280_CONFIG_REG, &cfg);
+	/* Each group of register accesses is done in one bus session */
+	comres += bme280_bus_read_regs(ctrl_regs, ctrl, CTRL_COUNT);
 
 	if (comres)
 		return comres;
 
 	//switch to sleep mode for config reg write
-	if (BME280_GET_BITSLICE(ctrl_meas,
+	if (BME280_GET_BITSLICE(ctrl[CTRL_MEAS],
 				BME280_CTRLMEAS_REG_MODE) !=
 	    BME280_SLEEP_MODE) {
 		bme280_set_softreset();
 		sensor_delay_ms(3);
 	}
-	cfg = BME280_SET_BITSLICE(cfg, BME280_CONFIG_REG_TSB, p_bme280->t_sb);
-	cfg = BME280_SET_BITSLICE(cfg, BME280_CONFIG_REG_FILTER,
-				  p_bme280->filter);
-	comres += bme280_write_reg(BME280_CONFIG_REG, &cfg);
-
-
-
-	ctrl_hum = BME280_SET_BITSLICE(ctrl_hum, BME280_CTRLHUM_REG_OSRSH,
-				       p_bme280->osrs_h);
-	comres += bme280_write_reg(BME280_CTRLHUM_REG, &ctrl_hum);
-
-	ctrl_meas = BME280_SET_BITSLICE(ctrl_meas, BME280_CTRLMEAS_REG_OSRST,
-					p_bme280->osrs_t);
-	ctrl_meas = BME280_SET_BITSLICE(ctrl_meas, BME280_CTRLMEAS_REG_OSRSP,
-					p_bme280->osrs_p);
-	ctrl_meas = BME280_SET_BITSLICE(ctrl_meas, BME280_CTRLMEAS_REG_MODE,
-					p_bme280->mode);
-	comres += bme280_write_reg(BME280_CTRLMEAS_REG, &ctrl_meas);
-
-	bme280_read_reg(BME280_CTRLHUM_REG, &ctrl_hum_check);
-	if (ctrl_hum_check != ctrl_hum)
-		mismatch |= (1 << 0);
-
-	bme280_read_reg(BME280_CTRLMEAS_REG, &ctrl_meas_check);
-	if (ctrl_meas_check != ctrl_meas)
-		mismatch |= (1 << 1);
-
-	bme280_read_reg(BME280_CONFIG_REG, &cfg_check);
-	if (cfg_check != cfg)
-		mismatch |= (1 << 2);
+	ctrl[CTRL_CONFIG] = BME280_SET_BITSLICE(ctrl[CTRL_CONFIG],
+						BME280_CONFIG_REG_TSB,
+						p_bme280->t_sb);
+	ctrl[CTRL_CONFIG] = BME280_SET_BITSLICE(ctrl[CTRL_CONFIG],
+						BME280_CONFIG_REG_FILTER,
+						p_bme280->filter);
+	ctrl[CTRL_HUM] = BME280_SET_BITSLICE(ctrl[CTRL_HUM],
+					     BME280_CTRLHUM_REG_OSRSH,
+					     p_bme280->osrs_h);
+	ctrl[CTRL_MEAS] = BME280_SET_BITSLICE(ctrl[CTRL_MEAS],
+					      BME280_CTRLMEAS_REG_OSRST,
+					      p_bme280->osrs_t);
+	ctrl[CTRL_MEAS] = BME280_SET_BITSLICE(ctrl[CTRL_MEAS],
+					      BME280_CTRLMEAS_REG_OSRSP,
+					      p_bme280->osrs_p);
+	ctrl[CTRL_MEAS] = BME280_SET_BITSLICE(ctrl[CTRL_MEAS],
+					      BME280_CTRLMEAS_REG_MODE,
+					      p_bme280->mode);
+	comres += bme280_bus_write_regs(ctrl_regs, ctrl, CTRL_COUNT);
+
+	comres += bme280_bus_read_regs(ctrl_regs, check, CTRL_COUNT);
+	for (i = 0; i < CTRL_COUNT; i++)
+		if (check[i] != ctrl[i])
+			mismatch |= (1 << i);
 
 	if (comres || mismatch) {
 		pr_debug(LOG_MODULE_BME280, "set wm mismatch=%x", mismatch);
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bmi160_fifo.h"
+#include "bmi160_regs.h"
+
+/* Regular frame header: 0b100mgaxx, control frame header: 0b01xxxxxx */
+#define FIFO_HEAD_MODE_MASK     0xC0
+#define FIFO_HEAD_MODE_REGULAR  0x80
+#define FIFO_HEAD_MODE_CONTROL  0x40
+#define FIFO_HEAD_PARM_MASK     0x3C
+#define FIFO_HEAD_SENSOR_SHIFT  2
+
+#define FIFO_ACCEL_BIT          (1 << BMI160_FIFO_ACCEL)
+#define FIFO_GYRO_BIT           (1 << BMI160_FIFO_GYRO)
+#define FIFO_MAG_BIT            (1 << BMI160_FIFO_MAG)
+
+/* Payload size of a regular frame, indexed by its sensor mask */
+static const uint8_t frame_size[8] = {
+	0, 6, 6, 12, 8, 14, 14, 20
+};
+
+static inline int16_t le16(const uint8_t *p)
+{
+	return (int16_t)(((uint16_t)p[1] << 8) | p[0]);
+}
+
+static inline void store_xyz(struct bmi160_fifo_samples *s, const uint8_t *p)
+{
+	uint16_t n = s->count++;
+
+	s->x[n] = le16(p);
+	s->y[n] = le16(p + 2);
+	s->z[n] = le16(p + 4);
+}
+
+static inline void store_mag(struct bmi160_fifo_samples *s, const uint8_t *p)
+{
+	uint16_t n = s->count++;
+
+	/* LSB are left aligned in the data registers */
+	s->x[n] = le16(p) >> 3;
+	s->y[n] = le16(p + 2) >> 3;
+	s->z[n] = le16(p + 4) >> 1;
+	if (s->r)
+		s->r[n] = le16(p + 6) >> 2;
+}
+
+static inline int is_full(const struct bmi160_fifo_samples *s)
+{
+	return s && s->count >= s->size;
+}
+
+static void stamp_samples(struct bmi160_fifo_samples *s, uint16_t first,
+			  const struct bmi160_fifo_demux *demux)
+{
+	uint32_t t;
+	int i;
+
+	if (s->count == first || !s->period)
+		return;
+
+	if (demux->sensortime_valid) {
+		t = demux->sensortime - demux->sensortime % s->period;
+		s->last_time = t;
+		if (s->time)
+			for (i = s->count - 1; i >= first; i--) {
+				s->time[i] = t & BMI160_SENSORTIME_MASK;
+				t -= s->period;
+			}
+	} else {
+		t = s->last_time;
+		for (i = first; i < s->count; i++) {
+			t = (t + s->period) & BMI160_SENSORTIME_MASK;
+			if (s->time)
+				s->time[i] = t;
+		}
+		s->last_time = t;
+	}
+}
+
+uint16_t bmi160_fifo_demux(struct bmi160_fifo_demux *demux,
+			   const uint8_t *data, uint16_t len)
+{
+	struct bmi160_fifo_samples *accel = demux->out[BMI160_FIFO_ACCEL];
+	struct bmi160_fifo_samples *gyro = demux->out[BMI160_FIFO_GYRO];
+	struct bmi160_fifo_samples *mag = demux->out[BMI160_FIFO_MAG];
+	uint16_t first[BMI160_FIFO_SENSOR_COUNT];
+	const uint8_t *p;
+	uint16_t i = 0;
+	uint8_t head, mask;
+	int s;
+
+	for (s = 0; s < BMI160_FIFO_SENSOR_COUNT; s++)
+		first[s] = demux->out[s] ? demux->out[s]->count : 0;
+	demux->sensortime_valid = 0;
+
+	while (i < len) {
+		head = data[i];
+		if ((head & FIFO_HEAD_MODE_MASK) == FIFO_HEAD_MODE_REGULAR) {
+			mask = (head & FIFO_HEAD_PARM_MASK) >>
+			       FIFO_HEAD_SENSOR_SHIFT;
+			/* Over-read: no more frames */
+			if (!mask || mask > 7)
+				break;
+			if (i + 1 + frame_size[mask] > len)
+				break;
+			if (((mask & FIFO_ACCEL_BIT) && is_full(accel)) ||
+			    ((mask & FIFO_GYRO_BIT) && is_full(gyro)) ||
+			    ((mask & FIFO_MAG_BIT) && is_full(mag)))
+				break;
+			/* Within a frame, data comes as mag, gyro, accel */
+			p = &data[i + 1];
+			if (mask & FIFO_MAG_BIT) {
+				if (mag)
+					store_mag(mag, p);
+				p += 8;
+			}
+			if (mask & FIFO_GYRO_BIT) {
+				if (gyro)
+					store_xyz(gyro, p);
+				p += 6;
+			}
+			if ((mask & FIFO_ACCEL_BIT) && accel)
+				store_xyz(accel, p);
+			i += 1 + frame_size[mask];
+			continue;
+		}
+
+		if ((head & FIFO_HEAD_MODE_MASK) != FIFO_HEAD_MODE_CONTROL)
+			break;
+
+		if (head == FIFO_HEAD_SENSOR_TIME) {
+			if (i + 4 > len)
+				break;
+			demux->sensortime = data[i + 1] |
+					    ((uint32_t)data[i + 2] << 8) |
+					    ((uint32_t)data[i + 3] << 16);
+			demux->sensortime_valid = 1;
+			/* The sensortime frame is sent once the FIFO is empty */
+			i += 4;
+			break;
+		} else if (head == FIFO_HEAD_SKIP_FRAME ||
+			   head == FIFO_HEAD_INPUT_CONFIG) {
+			if (i + 2 > len)
+				break;
+			if (head == FIFO_HEAD_SKIP_FRAME)
+				demux->skipped += data[i + 1];
+			i += 2;
+		} else {
+			break;
+		}
+	}
+
+	for (s = 0; s < BMI160_FIFO_SENSOR_COUNT; s++)
+		if (demux->out[s])
+			stamp_samples(demux->out[s], first[s], demux);
+
+	return i;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BMI160_FIFO_H__
+#define __BMI160_FIFO_H__
+
+#include <stdint.h>
+
+/**
+ * Single-pass demultiplexer for the BMI160 headered FIFO.
+ *
+ * The FIFO content is walked once: each frame header is decoded a single
+ * time and the accel, gyro and mag samples it carries are scattered into
+ * per-sensor x/y/z arrays. This module does not touch the hardware and can
+ * be built on the host.
+ */
+
+/* Sensor index in the demux output, same order as enum bmi160_sensor_type */
+#define BMI160_FIFO_ACCEL               0
+#define BMI160_FIFO_GYRO                1
+#define BMI160_FIFO_MAG                 2
+#define BMI160_FIFO_SENSOR_COUNT        3
+
+/* Sensortime is a 24 bits counter incremented every 39.0625us (25.6kHz) */
+#define BMI160_SENSORTIME_MASK          0xFFFFFF
+#define BMI160_SENSORTIME_HZ            25600
+
+/* Sensortime ticks between two samples for a given ODR (Hz x10) */
+#define BMI160_SENSORTIME_PERIOD(odr_x10) \
+	((BMI160_SENSORTIME_HZ * 10) / (odr_x10))
+
+/**
+ * Samples of one sensor, stored as structure of arrays.
+ *
+ * x/y/z hold the raw register values: 16 bits for accel and gyro, sign
+ * extended 13/13/15 bits for mag, which also fills r with the hall
+ * resistance. time, if not NULL, receives the sensortime of each sample.
+ */
+struct bmi160_fifo_samples {
+	int16_t *x;
+	int16_t *y;
+	int16_t *z;
+	uint16_t *r;
+	uint32_t *time;
+	uint16_t size;          /*!< Capacity of the arrays */
+	uint16_t count;         /*!< Number of samples stored */
+	uint16_t read;          /*!< Number of samples already consumed */
+	uint32_t period;        /*!< Sensortime ticks between two samples */
+	uint32_t last_time;     /*!< Sensortime of the last sample stored */
+};
+
+struct bmi160_fifo_demux {
+	/** Output per sensor, NULL to drop the samples of this sensor */
+	struct bmi160_fifo_samples *out[BMI160_FIFO_SENSOR_COUNT];
+	uint32_t sensortime;    /*!< Last sensortime frame read */
+	uint16_t skipped;       /*!< Frames lost by the hardware (skip frames) */
+	uint8_t sensortime_valid;
+};
+
+/**
+ * Demultiplex a FIFO dump.
+ *
+ * Samples are appended to the outputs after their current count. Parsing
+ * stops at the end of data (over-read or sensortime frame), on an unknown
+ * or truncated frame, or before a frame that does not fit in an output.
+ *
+ * Timestamps are rebuilt once the walk is done: when a sensortime frame was
+ * found, the last sample of each sensor is stamped with the sensortime
+ * aligned down on its period and the previous ones backwards from there,
+ * otherwise samples are stamped forward from last_time.
+ *
+ * @param demux  demultiplexer state and outputs
+ * @param data   FIFO content as read from the sensor
+ * @param len    number of bytes in data
+ *
+ * @return number of bytes consumed
+ */
+uint16_t bmi160_fifo_demux(struct bmi160_fifo_demux *demux,
+			   const uint8_t *data, uint16_t len);
+
+#endif /* __BMI160_FIFO_H__ */
@@ -28,6 +28,7 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "util/misc.h"
 #include "bmi160_support.h"
 #include "bmi160_bus.h"
 #include "bmi160_gpio.h"
@@ -135,6 +136,25 @@ uint8_t bmi160_mag_index = 0;
 /* FIFO data read for FIFO_FRAME of data */
 uint8_t bmi160_fifo_data[FIFO_FRAME] __attribute__((section(".dccm"))) = { 0 };
 
+/* Samples demultiplexed from bmi160_fifo_data, x, y and z arrays back to back */
+static int16_t fifo_accel_xyz[3 * FIFO_FRAME_CNT];
+static uint32_t fifo_accel_time[FIFO_FRAME_CNT];
+static int16_t fifo_gyro_xyz[3 * FIFO_FRAME_CNT];
+static uint32_t fifo_gyro_time[FIFO_FRAME_CNT];
+#if BMI160_ENABLE_MAG
+static int16_t fifo_mag_xyz[3 * MAG_FIFO_FRAME_CNT];
+static uint16_t fifo_mag_r[MAG_FIFO_FRAME_CNT];
+static uint32_t fifo_mag_time[MAG_FIFO_FRAME_CNT];
+#endif
+
+static struct bmi160_fifo_demux fifo_demux;
+
+STATIC_ASSERT(BMI160_SENSOR_ACCEL == BMI160_FIFO_ACCEL);
+STATIC_ASSERT(BMI160_SENSOR_GYRO == BMI160_FIFO_GYRO);
+#if BMI160_ENABLE_MAG
+STATIC_ASSERT(BMI160_SENSOR_MAG == BMI160_FIFO_MAG);
+#endif
+
 static uint8_t fifo_config1 = BMI160_USER_FIFO_TIME_ENABLE__MSK |
 			      BMI160_USER_FIFO_HEADER_ENABLE__MSK;
 
@@ -481,54 +501,18 @@ DRIVER_API_RC bmi160_set_if_mode(uint8_t v_if_mode_u8)
 	return com_rslt;
 }
 
-/* Parse accel data, from s16_xyz to s16_syz */
-static int8_t parse_accel_xyz_data(uint8_t *out_buf, uint8_t *out_index,
-				   uint16_t *fifo_index)
-{
-	struct bmi160_accel_t *s16_xyz_buf = (struct bmi160_accel_t *)out_buf;
-	uint16_t i = *fifo_index;
-
-	s16_xyz_buf[*out_index].x = (int16_t)
-				    ((((int32_t)((int8_t)bmi160_fifo_data[i +
-									  1]))
-				      << 8) | bmi160_fifo_data[i + 0]);
-	s16_xyz_buf[*out_index].y = (int16_t)
-				    ((((int32_t)((int8_t)bmi160_fifo_data[i +
-									  3]))
-				      << 8) | bmi160_fifo_data[i + 2]);
-	s16_xyz_buf[*out_index].z = (int16_t)
-				    ((((int32_t)((int8_t)bmi160_fifo_data[i +
-									  5]))
-				      << 8) | bmi160_fifo_data[i + 4]);
-
-	*fifo_index = i + BMI160_ACCEL_RAW_DATA_SIZE;
-	*out_index = *out_index + 1;
-	return 0;
-}
-
-/* Parse gyro data, from s16_xyz to s32_syz */
-static int8_t parse_gyro_xyz_data(uint8_t *out_buf, uint8_t *out_index,
-				  uint16_t *fifo_index)
+static void bmi160_fifo_samples_init(uint8_t type, int16_t *xyz,
+				     uint16_t *r, uint32_t *time,
+				     uint16_t size)
 {
-	struct bmi160_gyro_t *s32_xyz_buf = (struct bmi160_gyro_t *)out_buf;
-	uint16_t i = *fifo_index;
-
-	s32_xyz_buf[*out_index].x =
-		((((int32_t)((int8_t)bmi160_fifo_data[i +
-						      1])) <<
-		  8) | bmi160_fifo_data[i + 0]);
-	s32_xyz_buf[*out_index].y =
-		((((int32_t)((int8_t)bmi160_fifo_data[i +
-						      3])) <<
-		  8) | bmi160_fifo_data[i + 2]);
-	s32_xyz_buf[*out_index].z =
-		((((int32_t)((int8_t)bmi160_fifo_data[i +
-						      5])) <<
-		  8) | bmi160_fifo_data[i + 4]);
-
-	*fifo_index = i + BMI160_GYRO_RAW_DATA_SIZE;
-	*out_index = *out_index + 1;
-	return 0;
+	struct bmi160_fifo_samples *samples = &p_bmi160_rt->fifo_samples[type];
+
+	samples->x = xyz;
+	samples->y = xyz + size;
+	samples->z = xyz + 2 * size;
+	samples->r = r;
+	samples->time = time;
+	samples->size = size;
 }
 
 static DRIVER_API_RC bmi160_support_init(struct bmi160_rt_t *bmi160_rt)
@@ -537,6 +521,15 @@ static DRIVER_API_RC bmi160_support_init(struct bmi160_rt_t *bmi160_rt)
 
 	p_bmi160_rt = bmi160_rt;
 
+	bmi160_fifo_samples_init(BMI160_SENSOR_ACCEL, fifo_accel_xyz, NULL,
+				 fifo_accel_time, FIFO_FRAME_CNT);
+	bmi160_fifo_samples_init(BMI160_SENSOR_GYRO, fifo_gyro_xyz, NULL,
+				 fifo_gyro_time, FIFO_FRAME_CNT);
+#if BMI160_ENABLE_MAG
+	bmi160_fifo_samples_init(BMI160_SENSOR_MAG, fifo_mag_xyz, fifo_mag_r,
+				 fifo_mag_time, MAG_FIFO_FRAME_CNT);
+#endif
+
 #ifdef CONFIG_BMI160_CONVERT_ACCEL_DATA
 	p_bmi160_rt->convert_data_funs[BMI160_SENSOR_ACCEL] =
 		bmi160_convert_accel_data;
@@ -1196,8 +1189,8 @@ DRIVER_API_RC bmi160_fifo_disable(uint8_t	sensor_type,
 	p_bmi160_rt->fifo_ubuffer[sensor_type] = NULL;
 	p_bmi160_rt->fifo_ubuffer_len[sensor_type] = 0;
 	p_bmi160_rt->fifo_ubuffer_ptr[sensor_type] = 0;
-	p_bmi160_rt->fifo_data_start[sensor_type] = 0;
-	p_bmi160_rt->fifo_data_end[sensor_type] = 0;
+	p_bmi160_rt->fifo_samples[sensor_type].count = 0;
+	p_bmi160_rt->fifo_samples[sensor_type].read = 0;
 	return com_rslt;
 }
 
@@ -1227,148 +1220,91 @@ int bmi160_gyro_read_data(uint8_t *buf, uint16_t buff_len)
 	return sizeof(struct bmi160_gyro_t);
 }
 
-static inline int bmi160_abstract_fifo_data(uint8_t type, uint8_t size,
-					    uint8_t *out_buf,
-					    uint16_t frame_cnt_max,
-					    uint8_t *out_index,
-					    uint16_t *fifo_index)
+static inline bool fifo_samples_pending(uint8_t type)
 {
-	if (out_buf && (*out_index < frame_cnt_max)) {
-#if BMI160_ENABLE_MAG
-		if (type == BMI160_SENSOR_MAG)
-			return p_bmi160_rt->parse_mag_sensor_data(out_buf,
-								  out_index,
-								  fifo_index);
-		else
-#endif
-		if (type == BMI160_SENSOR_ACCEL)
-			return parse_accel_xyz_data(out_buf, out_index,
-						    fifo_index);
-		else
-			return parse_gyro_xyz_data(out_buf, out_index,
-						   fifo_index);
-	}
+	return p_bmi160_rt->fifo_samples[type].read !=
+	       p_bmi160_rt->fifo_samples[type].count;
+}
 
-	if (!(p_bmi160_rt->fifo_en & (1 << type))) {
-#if BMI160_ENABLE_MAG
-		if (type == BMI160_SENSOR_MAG)
-			*fifo_index += 8;
-		else
-#endif
-		*fifo_index += 6;
-		pr_debug(LOG_MODULE_BMI160,
-			 "fifo disabled type[%d], abandon data",
-			 type);
-		return 0;
+/* Decode the whole fifo read in a single pass, for all the sensors */
+static void demux_fifo_data(uint16_t len)
+{
+	struct bmi160_fifo_samples *samples;
+
+	for (int i = 0; i < BMI160_SENSOR_COUNT; i++) {
+		samples = &p_bmi160_rt->fifo_samples[i];
+		samples->count = 0;
+		samples->read = 0;
+		samples->period = 0;
+		if (p_bmi160_rt->sensor_odr[i])
+			samples->period = BMI160_SENSORTIME_PERIOD(
+				p_bmi160_rt->sensor_odr[i]);
+		/* Data of sensors with fifo disabled is abandoned */
+		fifo_demux.out[i] = (p_bmi160_rt->fifo_en & (1 << i)) ?
+				    samples : NULL;
 	}
 
-	return FIFO_BUFFER_OVERFLOW;
+	if (bmi160_fifo_demux(&fifo_demux, bmi160_fifo_data, len) != len)
+		pr_debug(LOG_MODULE_BMI160, "fifo parsing stopped early");
+
+	if (fifo_demux.sensortime_valid)
+		bmi160_fifo_time = fifo_demux.sensortime;
 }
 
-static int parse_data_from_fifo(uint8_t *buffer, uint16_t frame_cnt_max,
-				uint8_t *actual_frame, uint8_t type)
+/* Copy demultiplexed samples to the user buffer, in the frame format of the
+ * sensor type */
+static int copy_fifo_samples(uint8_t *buffer, uint16_t frame_cnt_max,
+			     uint8_t *actual_frame, uint8_t type)
 {
-	uint16_t fifo_index = 0;
-	uint8_t frame_head;
-	int8_t last_stat = 0;
-	uint8_t read_mask = 0;
-	uint16_t fifo_index_save = 0;
-
-	for (fifo_index = p_bmi160_rt->fifo_data_start[type];
-	     fifo_index < p_bmi160_rt->fifo_data_end[type];
-	     ) {
-		frame_head = bmi160_fifo_data[fifo_index];
-		fifo_index = fifo_index + 1;
-		read_mask = 0;
-		switch (frame_head) {
-		case FIFO_HEAD_A:
-			read_mask = TYPE_MASK_ACCEL;
-			break;
-		case FIFO_HEAD_G:
-			read_mask = TYPE_MASK_GYRO;
-			break;
-		case FIFO_HEAD_G_A:
-			read_mask = TYPE_MASK_ACCEL_GYRO;
-			break;
-#if BMI160_ENABLE_MAG
-		case FIFO_HEAD_M:
-			read_mask = TYPE_MASK_MAG;
-			break;
-		/* Header frame of mag and accel */
-		case FIFO_HEAD_M_A:
-			read_mask = TYPE_MASK_ACCEL_MAG;
-			break;
-		/* Header frame of mag and gyro */
-		case FIFO_HEAD_M_G:
-			read_mask = TYPE_MASK_GYRO_MAG;
-			break;
-		/* Header frame of mag, gyro and accel */
-		case FIFO_HEAD_M_G_A:
-			read_mask = TYPE_MASK_ACCEL_GYRO_MAG;
-			break;
-#endif
-		/* Header frame of skip frame */
-		case FIFO_HEAD_SKIP_FRAME:
-		case FIFO_HEAD_INPUT_CONFIG:
-			if (fifo_index + 1 >
-			    p_bmi160_rt->fifo_data_end[type]) {
-				last_stat = FIFO_SKIP_OVER_LEN;
-				break;
-			}
-			fifo_index = fifo_index + 1;
-			break;
-		/* Header frame of over read fifo v_data_u8 */
-		case FIFO_HEAD_SENSOR_TIME:
-		case FIFO_HEAD_OVER_READ_LSB:
-			last_stat = FIFO_OVER_READ_RETURN;
-			break;
-		default:
-			pr_debug(LOG_MODULE_BMI160, "unknown head:0x%x\n",
-				 frame_head);
-			last_stat = 1;
-			break;
+	struct bmi160_fifo_samples *samples = &p_bmi160_rt->fifo_samples[type];
+	uint16_t i = samples->read;
+
+	if (type == BMI160_SENSOR_ACCEL) {
+		struct bmi160_accel_t *out = (struct bmi160_accel_t *)buffer;
+		for (; buffer && i < samples->count &&
+		     *actual_frame < frame_cnt_max; i++, (*actual_frame)++) {
+			out[*actual_frame].x = samples->x[i];
+			out[*actual_frame].y = samples->y[i];
+			out[*actual_frame].z = samples->z[i];
 		}
-
-		int mix_frame_size = 0;
-		if (read_mask & TYPE_MASK_MAG)
-			mix_frame_size += BMI160_MAG_RAW_DATA_SIZE;
-		if (read_mask & TYPE_MASK_GYRO)
-			mix_frame_size += BMI160_GYRO_RAW_DATA_SIZE;
-		if (read_mask & TYPE_MASK_ACCEL)
-			mix_frame_size += BMI160_ACCEL_RAW_DATA_SIZE;
-		if (fifo_index + mix_frame_size >
-		    p_bmi160_rt->fifo_data_end[type])
-			last_stat = FIFO_M_G_A_OVER_LEN;
-
-		fifo_index_save = fifo_index;
-
-		/* Here need to keep reverse order */
-		for (int i = BMI160_SENSOR_COUNT - 1; i >= 0; i--) {
-			if (!last_stat && (read_mask & (1 << i))) {
-				if (type == i)
-					last_stat = bmi160_abstract_fifo_data(
-						i, bmi160_raw_data_size[i],
-						buffer,
-						frame_cnt_max, actual_frame,
-						&
-						fifo_index);
-				else
-					fifo_index += bmi160_raw_data_size[i];
-			}
+	} else if (type == BMI160_SENSOR_GYRO) {
+		struct bmi160_gyro_t *out = (struct bmi160_gyro_t *)buffer;
+		for (; buffer && i < samples->count &&
+		     *actual_frame < frame_cnt_max; i++, (*actual_frame)++) {
+			out[*actual_frame].x = samples->x[i];
+			out[*actual_frame].y = samples->y[i];
+			out[*actual_frame].z = samples->z[i];
 		}
-
-		if (last_stat)
-			break;
 	}
-
-	if (last_stat == FIFO_BUFFER_OVERFLOW)
-		p_bmi160_rt->fifo_data_start[type] = fifo_index_save - 1;
-	else {
-		p_bmi160_rt->fifo_data_start[type] = 0;
-		p_bmi160_rt->fifo_data_end[type] = 0;
+#if BMI160_ENABLE_MAG
+	else if (type == BMI160_SENSOR_MAG &&
+		 p_bmi160_rt->compensate_mag_data) {
+		struct bmi160_s32_xyz_t *out = (struct bmi160_s32_xyz_t *)buffer;
+		struct bmm150_mag_xyzr_t mag_xyzr;
+		for (; buffer && i < samples->count &&
+		     *actual_frame < frame_cnt_max; i++, (*actual_frame)++) {
+			mag_xyzr.x = samples->x[i];
+			mag_xyzr.y = samples->y[i];
+			mag_xyzr.z = samples->z[i];
+			mag_xyzr.r = samples->r[i];
+			p_bmi160_rt->compensate_mag_data(&mag_xyzr,
+							 &out[*actual_frame]);
+		}
 	}
+#endif
 
-	return last_stat;
+	samples->read = i;
+	if (i == samples->count)
+		return 0;
+
+	/* Keep the samples left for the next read, if still wanted */
+	if (p_bmi160_rt->fifo_en & (1 << type))
+		return FIFO_BUFFER_OVERFLOW;
+
+	pr_debug(LOG_MODULE_BMI160, "fifo disabled type[%d], abandon data",
+		 type);
+	samples->read = samples->count;
+	return 0;
 }
 
 /* When in idle, accel sampling @100Hz, AVG=1 */
@@ -1451,30 +1387,26 @@ DRIVER_API_RC bmi160_read_fifo_data(uint8_t *buffer, uint16_t buffer_len,
 
 	if (bmi160_wait_first_fifo_read_after_anymotion) {
 		for (int i = 0; i < BMI160_SENSOR_COUNT; i++) {
-			p_bmi160_rt->fifo_data_start[i] = 0;
-			p_bmi160_rt->fifo_data_end[i] = 0;
+			p_bmi160_rt->fifo_samples[i].count = 0;
+			p_bmi160_rt->fifo_samples[i].read = 0;
 		}
 	}
 
 	/* handle data left in buffer */
-	if (p_bmi160_rt->fifo_data_start[type] !=
-	    p_bmi160_rt->fifo_data_end[type]) {
-		ret_parse = parse_data_from_fifo(buffer, frame_cnt_max,
-						 actual_frame, type);
+	if (fifo_samples_pending(type)) {
+		ret_parse = copy_fifo_samples(buffer, frame_cnt_max,
+					      actual_frame, type);
 		if (ret_parse == FIFO_BUFFER_OVERFLOW) {
 			goto data_convert;
 		}
 	}
 
-	p_bmi160_rt->fifo_data_start[type] = 0;
-
 	if (!fetch_new_data)
 		goto data_convert;
 
 	/* if there is data left in fifo buffer, do not read new data */
 	for (int i = 0; i < BMI160_SENSOR_COUNT; i++) {
-		if (p_bmi160_rt->fifo_data_start[i] !=
-		    p_bmi160_rt->fifo_data_end[i])
+		if (fifo_samples_pending(i))
 			goto data_convert;
 	}
 
@@ -1548,13 +1480,10 @@ DRIVER_API_RC bmi160_read_fifo_data(uint8_t *buffer, uint16_t buffer_len,
 
 	bmi160_after_fifo_read();
 
-	for (int i = 0; i < BMI160_SENSOR_COUNT; i++) {
-		if (p_bmi160_rt->fifo_en & (1 << i))
-			p_bmi160_rt->fifo_data_end[i] = read_len;
-	}
+	demux_fifo_data(read_len);
 
-	ret_parse = parse_data_from_fifo(buffer, frame_cnt_max, actual_frame,
-					 type);
+	ret_parse = copy_fifo_samples(buffer, frame_cnt_max, actual_frame,
+				      type);
 #if DEBUG_BMI160
 	if (ret_parse == FIFO_BUFFER_OVERFLOW)
 		pr_debug(LOG_MODULE_BMI160, "reserve fifo data");
@@ -1713,6 +1642,13 @@ void bmi160_convert_gyro_data(uint8_t *buff)
 	data->z = (z * gyro_convert_numerator) / gyro_convert_denominator;
 }
 
+struct bmi160_fifo_samples *bmi160_fifo_get_samples(uint8_t sensor_type)
+{
+	if (sensor_type >= BMI160_SENSOR_COUNT)
+		return NULL;
+	return &p_bmi160_rt->fifo_samples[sensor_type];
+}
+
 inline struct bmi160_rt_t *bmi160_get_ptr(void)
 {
 	return p_bmi160_rt;
@@ -42,6 +42,7 @@
 #include "sensors/phy_sensor_api/phy_sensor_drv_api.h"
 #include "drivers/sensor/sensor_bus_common.h"
 #include "bmi160_regs.h"
+#include "bmi160_fifo.h"
 #include "bmm150_regs.h"
 
 #define FIFO_FRAME              1024
@@ -248,8 +249,7 @@ struct bmi160_rt_t {
 	uint8_t *fifo_ubuffer[BMI160_SENSOR_COUNT];     /** buffers provided by user for fifo data read */
 	uint16_t fifo_ubuffer_len[BMI160_SENSOR_COUNT];
 	uint16_t fifo_ubuffer_ptr[BMI160_SENSOR_COUNT];
-	uint16_t fifo_data_start[BMI160_SENSOR_COUNT];
-	uint16_t fifo_data_end[BMI160_SENSOR_COUNT];
+	struct bmi160_fifo_samples fifo_samples[BMI160_SENSOR_COUNT]; /** demultiplexed fifo data not yet read */
 	uint8_t sensor_enabled[BMI160_SENSOR_COUNT];
 	uint16_t sensor_odr[BMI160_SENSOR_COUNT];
 	uint32_t range_native[BMI160_SENSOR_COUNT];
@@ -259,8 +259,8 @@ struct bmi160_rt_t {
 	convert_sensor_data_fun convert_data_funs[BMI160_SENSOR_COUNT];
 	sensor_read_data_fun reg_data_read_funs[BMI160_SENSOR_COUNT];
 	/* function pointers for external sensor */
-	uint8_t (*parse_mag_sensor_data)(uint8_t *out_buf, uint8_t *out_index,
-					 uint16_t *fifo_index);
+	void (*compensate_mag_data)(struct bmm150_mag_xyzr_t *mag_xyzr,
+				    struct bmi160_s32_xyz_t *mag_comp_xyz);
 	DRIVER_API_RC (*change_mag_powermode)(uint8_t powermode);
 };
 
@@ -576,6 +576,20 @@ int bmi160_accle_read_data(uint8_t *buf, uint16_t buff_len);
  */
 int bmi160_sensor_read_fifo(uint8_t sensor_type, uint8_t *buf,
 			    uint16_t buff_len);
+/*!
+ *  @brief This API gives access to the demultiplexed fifo samples
+ *
+ *  Samples are stored as raw x/y/z arrays with their sensortime, as
+ *  decoded from the last fifo read. Batch consumers can process the
+ *  samples between read and count, then advance read.
+ *
+ *  @param sensor_type: accel, gyro or mag
+ *
+ *  @return samples of the sensor, NULL if sensor_type is invalid
+ *
+ *
+ */
+struct bmi160_fifo_samples *bmi160_fifo_get_samples(uint8_t sensor_type);
 /*!
  *  @brief This API read register sensor data for gyro
  *
@@ -36,9 +36,6 @@ static struct bmi160_rt_t *p_bmi160_rt;
 
 static struct trim_data_t mag_trim;
 
-static uint8_t bmm150_parse_mag_s32_xyz_data(uint8_t *	out_buf,
-					     uint8_t *	out_index,
-					     uint16_t * fifo_index);
 static DRIVER_API_RC bmm150_change_powermode(uint8_t power_mode);
 
 DRIVER_API_RC bmm150_bus_access_manual(uint8_t reg_addr, uint8_t *reg_data,
@@ -186,7 +183,7 @@ DRIVER_API_RC bmm150_sensor_open(void)
 
 	p_bmi160_rt = bmi160_get_ptr();
 
-	p_bmi160_rt->parse_mag_sensor_data = bmm150_parse_mag_s32_xyz_data;
+	p_bmi160_rt->compensate_mag_data = bmm150_xyzr_to_s32xyz;
 	p_bmi160_rt->change_mag_powermode = bmm150_change_powermode;
 	p_bmi160_rt->reg_data_read_funs[BMI160_SENSOR_MAG] =
 		bmm150_mag_read_data;
@@ -401,25 +398,6 @@ DRIVER_API_RC bmm150_read_mag_compensate_xyz(
 	return DRV_RC_OK;
 }
 
-static uint8_t bmm150_parse_mag_s32_xyz_data(uint8_t *	out_buf,
-					     uint8_t *	out_index,
-					     uint16_t * fifo_index)
-{
-	struct bmi160_s32_xyz_t *s32_xyz_buf =
-		(struct bmi160_s32_xyz_t *)out_buf;
-	struct bmm150_mag_xyzr_t mag_xyzr;
-	uint16_t i = *fifo_index;
-
-	bmm150_8bytes_to_xyzr(&bmi160_fifo_data[i], &mag_xyzr);
-
-	*fifo_index = i + 8;
-
-	bmm150_xyzr_to_s32xyz(&mag_xyzr, &s32_xyz_buf[*out_index]);
-
-	*out_index = *out_index + 1;
-	return 0;
-}
-
 int bmm150_mag_read_data(uint8_t *buf, uint16_t buff_len)
 {
 	if (bmm150_read_mag_compensate_xyz((struct bmi160_s32_xyz_t *)buf))
@@ -102,34 +102,24 @@ static void config_req_write(uint8_t *tx_buffer, uint32_t tx_len,
 	req->status = 1;
 }
 
-DRIVER_API_RC sensor_bus_access(struct sensor_sba_info *info,
-				uint8_t *tx_buffer, uint32_t tx_len,
-				uint8_t *rx_buffer,
-				uint32_t rx_len, bool req_read,
-				int slave_addr)
+static void config_req_seg(const struct sensor_bus_seg *seg,
+			   sba_request_t *req)
 {
-	int i;
-	sba_request_t *req;
+	if (seg->rx_len)
+		config_req_read(seg->tx_buffer, seg->tx_len, seg->rx_buffer,
+				seg->rx_len, req);
+	else
+		config_req_write(seg->tx_buffer, seg->tx_len, req);
+}
+
+/* Submit the request i of info and wait for its completion */
+static DRIVER_API_RC sensor_bus_exec(struct sensor_sba_info *info, int i)
+{
+	sba_request_t *req = &info->reqs[i].req;
 	DRIVER_API_RC ret = DRV_RC_OK;
 	OS_ERR_TYPE err;
 
-	if ((i = get_sba_req(&info->bitmap, info->req_cnt)) >= info->req_cnt) {
-		pr_debug(LOG_MODULE_DRV, "%s:DEV[%d] No req left", __func__,
-			 info->dev_id);
-		return DRV_RC_FAIL;
-	}
-
-	req = &info->reqs[i].req;
-
-	if (0 <= slave_addr)
-		req->addr.cs = slave_addr;
-
-	if (req_read)
-		config_req_read(tx_buffer, tx_len, rx_buffer, rx_len, req);
-	else
-		config_req_write(tx_buffer, tx_len, req);
-
-	if (sba_exec_request(req)) {
+	if (sba_exec_chain(req, info->prio)) {
 		pr_debug(LOG_MODULE_DRV, "%s:DEV[%d] request exec error",
 			 __func__,
 			 info->dev_id);
@@ -169,6 +159,122 @@ DRIVER_API_RC sensor_bus_access(struct sensor_sba_info *info,
 	return ret;
 }
 
+DRIVER_API_RC sensor_bus_access(struct sensor_sba_info *info,
+				uint8_t *tx_buffer, uint32_t tx_len,
+				uint8_t *rx_buffer,
+				uint32_t rx_len, bool req_read,
+				int slave_addr)
+{
+	int i;
+	sba_request_t *req;
+
+	if ((i = get_sba_req(&info->bitmap, info->req_cnt)) >= info->req_cnt) {
+		pr_debug(LOG_MODULE_DRV, "%s:DEV[%d] No req left", __func__,
+			 info->dev_id);
+		return DRV_RC_FAIL;
+	}
+
+	req = &info->reqs[i].req;
+
+	if (0 <= slave_addr)
+		req->addr.cs = slave_addr;
+
+	if (req_read)
+		config_req_read(tx_buffer, tx_len, rx_buffer, rx_len, req);
+	else
+		config_req_write(tx_buffer, tx_len, req);
+	req->chain = NULL;
+
+	return sensor_bus_exec(info, i);
+}
+
+DRIVER_API_RC sensor_bus_access_chain(struct sensor_sba_info *info,
+				      const struct sensor_bus_seg *segs,
+				      uint8_t count, int slave_addr)
+{
+	/* Segments after the first one, the first one is a request of info
+	 * which carries the completion callback */
+	sba_request_t chain[SENSOR_BUS_MAX_SEGS - 1];
+	sba_request_t *req;
+	int i, n;
+
+	if (count == 0 || count > SENSOR_BUS_MAX_SEGS)
+		return DRV_RC_INVALID_CONFIG;
+
+	if ((i = get_sba_req(&info->bitmap, info->req_cnt)) >= info->req_cnt) {
+		pr_debug(LOG_MODULE_DRV, "%s:DEV[%d] No req left", __func__,
+			 info->dev_id);
+		return DRV_RC_FAIL;
+	}
+
+	req = &info->reqs[i].req;
+
+	if (0 <= slave_addr)
+		req->addr.cs = slave_addr;
+
+	config_req_seg(&segs[0], req);
+	req->chain = count > 1 ? &chain[0] : NULL;
+	for (n = 1; n < count; n++) {
+		config_req_seg(&segs[n], &chain[n - 1]);
+		chain[n - 1].full_duplex = req->full_duplex;
+		chain[n - 1].addr = req->addr;
+		chain[n - 1].callback = NULL;
+		chain[n - 1].chain = n + 1 < count ? &chain[n] : NULL;
+	}
+
+	return sensor_bus_exec(info, i);
+}
+
+DRIVER_API_RC sensor_bus_read_regs(struct sensor_sba_info *info,
+				   const uint8_t *reg_addr, uint8_t *reg_data,
+				   uint8_t n, int slave_addr)
+{
+	struct sensor_bus_seg segs[SENSOR_BUS_MAX_SEGS];
+	uint8_t tx[SENSOR_BUS_MAX_SEGS];
+	int i;
+
+	if (n > SENSOR_BUS_MAX_SEGS)
+		return DRV_RC_INVALID_CONFIG;
+
+	for (i = 0; i < n; i++) {
+		tx[i] = reg_addr[i];
+		if (info->bus_type == SENSOR_BUS_TYPE_SPI)
+			tx[i] |= SPI_READ_CMD;
+		segs[i].tx_buffer = &tx[i];
+		segs[i].tx_len = 1;
+		segs[i].rx_buffer = &reg_data[i];
+		segs[i].rx_len = 1;
+	}
+
+	return sensor_bus_access_chain(info, segs, n, slave_addr);
+}
+
+DRIVER_API_RC sensor_bus_write_regs(struct sensor_sba_info *info,
+				    const uint8_t *reg_addr,
+				    const uint8_t *reg_data, uint8_t n,
+				    int slave_addr)
+{
+	struct sensor_bus_seg segs[SENSOR_BUS_MAX_SEGS];
+	uint8_t tx[SENSOR_BUS_MAX_SEGS][2];
+	int i;
+
+	if (n > SENSOR_BUS_MAX_SEGS)
+		return DRV_RC_INVALID_CONFIG;
+
+	for (i = 0; i < n; i++) {
+		tx[i][0] = reg_addr[i];
+		if (info->bus_type == SENSOR_BUS_TYPE_SPI)
+			tx[i][0] &= ~SPI_READ_CMD;
+		tx[i][1] = reg_data[i];
+		segs[i].tx_buffer = tx[i];
+		segs[i].tx_len = 2;
+		segs[i].rx_buffer = NULL;
+		segs[i].rx_len = 0;
+	}
+
+	return sensor_bus_access_chain(info, segs, n, slave_addr);
+}
+
 struct sensor_sba_info *sensor_config_bus(int slave_addr, uint8_t dev_id,
 					  SBA_BUSID bus_id,
 					  SENSOR_BUS_TYPE bus_type, int req_num,
@@ -194,6 +300,7 @@ struct sensor_sba_info *sensor_config_bus(int slave_addr, uint8_t dev_id,
 	info->dev_id = dev_id;
 	info->bus_type = bus_type;
 	info->block_type = block_type;
+	info->prio = SBA_PRIO_NORMAL;
 
 	for (i = 0; i < req_num; i++) {
 		reqs[i].req.bus_id = bus_id;
@@ -210,6 +317,7 @@ struct sensor_sba_info *sensor_config_bus(int slave_addr, uint8_t dev_id,
 		}
 
 		reqs[i].req.full_duplex = 0;
+		reqs[i].req.chain = NULL;
 
 		reqs[i].req.addr.slave_addr = slave_addr;
 	}
@@ -1,4 +1,5 @@
 obj-$(CONFIG_IPC) += ipc_callback.o
+obj-$(CONFIG_IPC_RING) += ipc_ring.o
 obj-y += panic.o
 obj-$(CONFIG_LOG_CBUFFER) += log_impl_cbuffer.o
 obj-$(CONFIG_LOG_PRINTK)  += log_impl_printk.o
@@ -86,6 +86,9 @@ int ipc_sync_callback(uint8_t cpu_id, int request, int param1, int param2,
 	case IPC_MSG_TYPE_FREE:
 		message_free(ptr);
 		break;
+	case IPC_MSG_TYPE_FREE_LIST:
+		message_free_list(ptr);
+		break;
 	case IPC_MSG_TYPE_MESSAGE:
 		ret = port_send_message((struct message *)ptr);
 		break;
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "infra/ipc_ring.h"
+
+/*
+ * The producer publishes its descriptor then looks at the consumer index,
+ * the consumer publishes its index then looks at the producer index. A full
+ * barrier between the store and the load of each side guarantees that at
+ * least one of them sees the other's update: either the consumer finds the
+ * new descriptor, or the producer finds the ring was drained and rings the
+ * doorbell.
+ */
+#define ring_barrier()          __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define ring_load(p)            __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define ring_store(p, v)        __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+void ipc_ring_init(struct ipc_ring *ipc_ring)
+{
+	spsc_ring_init(&ipc_ring->ring, ipc_ring->buf, sizeof(ipc_ring->buf));
+	ring_store(&ipc_ring->ready, 1);
+}
+
+int ipc_ring_post(struct ipc_ring *ipc_ring, uint32_t request, void *ptr)
+{
+	struct ipc_ring_desc desc = { .request = request, .ptr = ptr };
+	uint32_t head = ipc_ring->ring.head;
+
+	if (!ring_load(&ipc_ring->ready) ||
+	    spsc_ring_push(&ipc_ring->ring, &desc, sizeof(desc)))
+		return -1;
+
+	ring_barrier();
+	return ring_load(&ipc_ring->ring.tail) == head;
+}
+
+int ipc_ring_get(struct ipc_ring *ipc_ring, struct ipc_ring_desc *desc)
+{
+	ring_barrier();
+	if (spsc_ring_pop(&ipc_ring->ring, desc, sizeof(*desc)) < 0)
+		return -1;
+	return 0;
+}
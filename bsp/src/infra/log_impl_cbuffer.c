@@ -55,6 +55,34 @@
 /* Second message magic number; */
 #define LOG_MESSAGE_MAGIC_B     0xEE
 
+#ifdef CONFIG_LOG_CBUFFER_DEFERRED
+/* Level flag of a message holding a format pointer and raw arguments instead
+ * of formatted text */
+#define LOG_LEVEL_DEFERRED      0x80
+
+/* Maximum number of argument words recorded in a deferred message */
+#define LOG_DEFERRED_MAX_ARGS   8
+
+/* Seed of the check word of deferred messages */
+#define LOG_DEFERRED_CHECK_SEED 0x811C9DC5
+
+/* Payload of a deferred message, stored in place of the text buffer.
+ *
+ * After a saturation, the reader resyncs on the magic numbers, which raw
+ * argument words may contain: the check word, computed over the format
+ * pointer and the arguments, rejects such false starts before the format
+ * pointer is used. */
+struct __packed log_deferred_args {
+	const char *format;
+	uint32_t check;
+	uint32_t args[LOG_DEFERRED_MAX_ARGS];
+};
+
+STATIC_ASSERT(sizeof(struct log_deferred_args) <= LOG_MAX_MSG_LEN);
+
+static bool log_deferred = true;
+#endif
+
 /* The main circular buffer where messages are transiently stored */
 static uint8_t logbuf[CONFIG_LOG_CBUFFER_SIZE];
 static cbuffer_t log_buffer =
@@ -320,6 +348,188 @@ void log_impl_init(void)
 #endif
 }
 
+#ifdef CONFIG_LOG_CBUFFER_DEFERRED
+void log_set_deferred(bool enable)
+{
+	log_deferred = enable;
+}
+
+/**
+ * Parse the next conversion specification of a format string.
+ *
+ * @param p      pointer on the character following the '%'
+ * @param conv   filled with the conversion character
+ * @param wide   filled with true if the argument is 64 bits wide
+ *
+ * @return pointer on the character following the specification, or NULL if
+ * it uses a '*' width or precision
+ */
+static const char *log_parse_spec(const char *p, char *conv, bool *wide)
+{
+	int longs = 0;
+
+	while (*p && strchr("-+ #0123456789.", *p))
+		p++;
+	if (*p == '*')
+		return NULL;
+	while (*p && strchr("hlzt", *p)) {
+		if (*p == 'l')
+			longs++;
+		p++;
+	}
+	*wide = longs > 1 || (longs == 1 && sizeof(long) > sizeof(uint32_t));
+	*conv = *p;
+	return *p ? p + 1 : p;
+}
+
+/**
+ * Compute the check word of a deferred message.
+ *
+ * @param d     deferred message payload
+ * @param nargs number of argument words in d
+ *
+ * @return the check word
+ */
+static uint32_t log_deferred_check(const struct log_deferred_args *d,
+				   int nargs)
+{
+	uint32_t h = LOG_DEFERRED_CHECK_SEED ^ nargs;
+	int i;
+
+	/* FNV-1a over 32-bit words */
+	h = (h ^ (uint32_t)(uintptr_t)d->format) * 0x01000193;
+	for (i = 0; i < nargs; i++)
+		h = (h ^ d->args[i]) * 0x01000193;
+	return h;
+}
+
+/**
+ * Record the format pointer and the raw arguments of a message.
+ *
+ * @param msg    message whose buf is filled with a struct log_deferred_args
+ * @param format printf-like string format, must be a constant string
+ * @param args   arguments of the format, left untouched
+ *
+ * @return the payload length, or -1 if the message must be formatted right
+ * away (no arguments, string or floating point conversions, too many
+ * arguments)
+ */
+static int log_pack_deferred(log_message_t *msg, const char *format,
+			     va_list args)
+{
+	struct log_deferred_args *d = (struct log_deferred_args *)msg->buf;
+	const char *p = format;
+	int n = 0;
+	bool wide;
+	char conv;
+	va_list ap;
+
+	va_copy(ap, args);
+	d->format = format;
+	while ((p = strchr(p, '%')) != NULL) {
+		if (p[1] == '%') {
+			p += 2;
+			continue;
+		}
+		p = log_parse_spec(p + 1, &conv, &wide);
+		if (p == NULL || conv == '\0' || !strchr("diouxXcp", conv) ||
+		    n + wide >= LOG_DEFERRED_MAX_ARGS) {
+			n = -1;
+			break;
+		}
+		if (conv == 'p') {
+			if (sizeof(void *) > sizeof(uint32_t)) {
+				n = -1;
+				break;
+			}
+			d->args[n++] = (uintptr_t)va_arg(ap, void *);
+		} else if (wide) {
+			uint64_t v = va_arg(ap, unsigned long long);
+			d->args[n++] = (uint32_t)v;
+			d->args[n++] = (uint32_t)(v >> 32);
+		} else {
+			d->args[n++] = va_arg(ap, unsigned int);
+		}
+	}
+	va_end(ap);
+
+	/* Messages without arguments are plain copies, and their format may
+	 * well be a buffer that won't outlive the call */
+	if (n <= 0)
+		return -1;
+	d->check = log_deferred_check(d, n);
+	return offsetof(struct log_deferred_args, args) + n * sizeof(uint32_t);
+}
+
+/**
+ * Format a deferred message in place.
+ *
+ * @param msg message popped from the cbuffer, its buf holds a
+ *            struct log_deferred_args of msg->buf_size bytes
+ *
+ * @return false if the message is corrupted and must be dropped
+ */
+static bool log_format_deferred(log_message_t *msg)
+{
+	struct log_deferred_args d;
+	const char *p;
+	char spec[16];
+	bool wide;
+	char conv;
+	int len = 0;
+	int n = 0;
+	int nargs = ((int)msg->buf_size -
+		     (int)offsetof(struct log_deferred_args, args)) /
+		    (int)sizeof(uint32_t);
+
+	msg->level &= ~LOG_LEVEL_DEFERRED;
+	if (nargs <= 0 || msg->buf_size > sizeof(d))
+		return false;
+	memcpy(&d, msg->buf, msg->buf_size);
+	if (d.format == NULL || d.check != log_deferred_check(&d, nargs)) {
+		/* Corrupted message, e.g. a false start found on saturation:
+		 * the format pointer can't be trusted */
+		return false;
+	}
+
+	for (p = d.format; *p && len < (int)sizeof(msg->buf) - 1; ) {
+		if (*p != '%' || p[1] == '%') {
+			msg->buf[len++] = *p;
+			p += (*p == '%') ? 2 : 1;
+			continue;
+		}
+		const char *end = log_parse_spec(p + 1, &conv, &wide);
+		if (end - p >= (int)sizeof(spec) || n + wide >= nargs)
+			break;
+		memcpy(spec, p, end - p);
+		spec[end - p] = '\0';
+
+		int ret;
+		if (conv == 'p')
+			ret = snprintf(&msg->buf[len], sizeof(msg->buf) - len,
+				       spec, (void *)(uintptr_t)d.args[n++]);
+		else if (wide) {
+			uint64_t v = d.args[n] | ((uint64_t)d.args[n + 1] << 32);
+			n += 2;
+			ret = snprintf(&msg->buf[len], sizeof(msg->buf) - len,
+				       spec, (unsigned long long)v);
+		} else
+			ret = snprintf(&msg->buf[len], sizeof(msg->buf) - len,
+				       spec, d.args[n++]);
+		if (ret < 0)
+			break;
+		len += ret;
+		p = end;
+	}
+
+	if (len >= (int)sizeof(msg->buf))
+		len = sizeof(msg->buf) - 1;
+	msg->buf[len] = '\0';
+	msg->buf_size = len;
+	return true;
+}
+#endif
+
 /**
  * @brief Creates and pushes a user's log message into the logging queue.
  *
@@ -330,13 +540,24 @@ void log_write_msg(uint8_t level, const char *module, const char *format,
 		   va_list args)
 {
 	log_message_t msg;
+	int len = -1;
 
-	/* Contains the full text size not including the terminating \0 */
-	msg.buf_size = vsnprintf(msg.buf, sizeof(msg.buf), format, args);
-	if (msg.buf_size >= sizeof(msg.buf))
-		msg.buf_size = sizeof(msg.buf) - 1;
-	if (msg.buf_size <= 0)
+#ifdef CONFIG_LOG_CBUFFER_DEFERRED
+	if (log_deferred) {
+		len = log_pack_deferred(&msg, format, args);
+		if (len >= 0)
+			level |= LOG_LEVEL_DEFERRED;
+	}
+#endif
+	if (len < 0) {
+		/* Contains the full text size not including the terminating \0 */
+		len = vsnprintf(msg.buf, sizeof(msg.buf), format, args);
+		if (len >= (int)sizeof(msg.buf))
+			len = sizeof(msg.buf) - 1;
+	}
+	if (len <= 0)
 		return;
+	msg.buf_size = len;
 
 	/* Fill up the message contents */
 	/* Note that we abuse the has_saturated and lost_messages_count members
@@ -391,7 +612,11 @@ static int32_t log_read_msg(log_message_t *p_msg)
 	int msg_len = 0;
 	int buf_len = 0;
 	int start_r = 0;        /* Start of the next message index */
+	uint8_t saturation = 0;
 
+#ifdef CONFIG_LOG_CBUFFER_DEFERRED
+retry:
+#endif
 	it_flags = irq_lock();
 
 	if (log_buffer.r == log_buffer.w) {
@@ -442,12 +667,18 @@ static int32_t log_read_msg(log_message_t *p_msg)
 		return -1;
 	}
 
-	uint8_t saturation = log_buffer.saturation_flag;
+	/* cb_pop clears the flag, keep the one of a dropped record */
+	saturation |= log_buffer.saturation_flag;
 	ret = cb_pop(&log_buffer, start_r, (unsigned char *)p_msg, msg_len);
 
 	irq_unlock(it_flags);
 
 	p_msg->has_saturated = saturation;
 	p_msg->lost_messages_count = 0;
+#ifdef CONFIG_LOG_CBUFFER_DEFERRED
+	if ((p_msg->level & LOG_LEVEL_DEFERRED) && !log_format_deferred(p_msg))
+		/* Drop it and resync on the next message */
+		goto retry;
+#endif
 	return ret;
 }
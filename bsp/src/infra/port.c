@@ -36,7 +36,9 @@
 #include "infra/ipc.h"
 #include "infra/panic.h"
 #include <string.h>
+#include <stddef.h>
 #include "util/assert.h"
+#include "util/misc.h"
 //#define PORT_DEBUG
 
 /**
@@ -53,6 +55,25 @@ struct port {
 
 static uint8_t this_cpu_id = 0;
 
+/**
+ * Header preceding a shared message, holding its reference count.
+ * It is only updated by the CPU that allocated the message, as remote
+ * frees are routed back to it.
+ */
+struct shared_message_hdr {
+	uint32_t refs;
+};
+
+#define SHARED_HDR(msg) (((struct shared_message_hdr *)(msg)) - 1)
+
+/**
+ * Reference on a shared message, addressed to a single port.
+ */
+struct message_ref {
+	struct message m;
+	struct message *shared;
+};
+
 /* required by port_alloc() and other cfw APIs */
 uint8_t get_cpu_id(void)
 {
@@ -198,10 +219,96 @@ struct message *message_alloc(int size, OS_ERR_TYPE *err)
 	return msg;
 }
 
+struct message *message_alloc_shared(int size, OS_ERR_TYPE *err)
+{
+	struct shared_message_hdr *hdr = (struct shared_message_hdr *)
+					 balloc(sizeof(*hdr) + size, err);
+	struct message *msg = NULL;
+
+	if (hdr) {
+		hdr->refs = 1;
+		msg = (struct message *)&hdr[1];
+		memset(msg, 0, size);
+		msg->flags.f_is_shared = 1;
+	}
+
+	return msg;
+}
+
+/**
+ * Release a message allocated by this CPU.
+ */
+static void message_free_local(struct message *msg)
+{
+	struct shared_message_hdr *hdr;
+	uint32_t flags;
+
+	if (!msg->flags.f_is_shared) {
+		bfree(msg);
+		return;
+	}
+
+	hdr = SHARED_HDR(msg);
+	flags = irq_lock();
+	if (--hdr->refs == 0) {
+		irq_unlock(flags);
+		bfree(hdr);
+	} else {
+		irq_unlock(flags);
+	}
+}
+
+int port_send_shared_message(struct message *msg, uint16_t dst_port_id)
+{
+	OS_ERR_TYPE err = E_OS_OK;
+	struct message_ref *ref;
+	uint32_t flags;
+	int ret;
+
+	ref = (struct message_ref *)message_alloc(sizeof(*ref), &err);
+	if (ref == NULL)
+		return err;
+
+	/* The reference is freed by the CPU owning the shared message */
+	ref->m.id = msg->id;
+	ref->m.src_port_id = msg->src_port_id;
+	ref->m.dst_port_id = dst_port_id;
+	ref->m.len = sizeof(*ref);
+	ref->m.flags.f_prio = msg->flags.f_prio;
+	ref->m.flags.f_type = msg->flags.f_type;
+	ref->m.flags.f_queue_head = msg->flags.f_queue_head;
+	ref->m.flags.f_is_ref = 1;
+	ref->shared = msg;
+
+	flags = irq_lock();
+	SHARED_HDR(msg)->refs++;
+	irq_unlock(flags);
+
+	ret = port_send_message(&ref->m);
+	if (ret != E_OS_OK) {
+		message_free(msg);
+		message_free(&ref->m);
+	}
+	return ret;
+}
+
+struct message *port_resolve_message(struct message *msg)
+{
+	struct message *shared;
+
+	if (!msg->flags.f_is_ref)
+		return msg;
+	/* Deliver the shared message, the reference is not needed anymore */
+	shared = ((struct message_ref *)msg)->shared;
+	message_free(msg);
+	return shared;
+}
+
 void port_process_message(struct message *msg)
 {
 	struct port *p = get_port(msg->dst_port_id);
 
+	msg = port_resolve_message(msg);
 	if (p->handle_message != NULL) {
 		p->handle_message(msg, p->handle_param);
 	}
@@ -228,6 +335,17 @@ uint8_t port_get_cpu_id(uint16_t port_id)
 	return p->cpu_id;
 }
 
+/* Queue a message on a local port according to its priority */
+static void port_queue_message(struct port *port, struct message *msg,
+			       OS_ERR_TYPE *err)
+{
+	if (msg->flags.f_queue_head == true)
+		queue_send_message_head(port->queue, msg, err);
+	else
+		queue_send_message_prio(port->queue, msg, MESSAGE_PRIO(msg),
+					err);
+}
+
 #ifdef CONFIG_PORT_MULTI_CPU_SUPPORT
 #include "machine.h"
 
@@ -236,10 +354,117 @@ typedef int (*send_msg_t)(struct message *m);
 struct ipc_handler {
 	send_msg_t send_message;
 	void (*free)(struct message *message);
+	void (*free_list)(struct message *list);
+	/* Messages of this CPU freed locally, waiting to be returned */
+	struct message *free_pending;
+	struct port_remote_free_stats free_stats;
 };
 
 struct ipc_handler ipc_handler[NUM_CPU];
 
+/* Messages released together by message_free_list() */
+#define FREE_LIST_BULK 16
+
+/*
+ * A message returned to its owner is not used anymore: its header fields
+ * following the flags link it to the next message of the list. Shared
+ * messages may be freed several times, they are returned one at a time.
+ */
+static struct message *free_list_next(struct message *msg)
+{
+	struct message *next;
+
+	memcpy(&next, &msg->id, sizeof(next));
+	return next;
+}
+
+void message_free_list(struct message *list)
+{
+	void *blocks[FREE_LIST_BULK];
+	struct message *msg;
+	int count = 0;
+
+	while (list) {
+		msg = list;
+		list = free_list_next(msg);
+		blocks[count++] = msg;
+		if (count == FREE_LIST_BULK) {
+			bfree_bulk(blocks, count);
+			count = 0;
+		}
+	}
+	if (count)
+		bfree_bulk(blocks, count);
+}
+
+#if CONFIG_PORT_REMOTE_FREE_BATCH > 0
+static T_TIMER remote_free_timer;
+static bool remote_free_timer_armed;
+
+static void free_list_set_next(struct message *msg, struct message *next)
+{
+	memcpy(&msg->id, &next, sizeof(next));
+}
+
+/* Return the pending messages of a CPU, counting the list in reason */
+static void remote_free_flush(struct ipc_handler *h, uint32_t *reason)
+{
+	struct message *list;
+	uint32_t flags = irq_lock();
+
+	list = h->free_pending;
+	if (list == NULL) {
+		irq_unlock(flags);
+		return;
+	}
+	h->free_pending = NULL;
+	h->free_stats.pending = 0;
+	h->free_stats.lists++;
+	(*reason)++;
+	irq_unlock(flags);
+
+	h->free_list(list);
+}
+
+static void remote_free_timeout(void *data)
+{
+	int cpu_id;
+
+	remote_free_timer_armed = false;
+	for (cpu_id = 0; cpu_id < NUM_CPU; cpu_id++)
+		remote_free_flush(&ipc_handler[cpu_id],
+				  &ipc_handler[cpu_id].free_stats.on_timer);
+}
+
+static void remote_free_defer(struct ipc_handler *h, struct message *msg)
+{
+	OS_ERR_TYPE err = E_OS_OK;
+	bool arm = false;
+	uint32_t flags = irq_lock();
+
+	free_list_set_next(msg, h->free_pending);
+	h->free_pending = msg;
+	h->free_stats.deferred++;
+	if (++h->free_stats.pending >= CONFIG_PORT_REMOTE_FREE_BATCH) {
+		irq_unlock(flags);
+		remote_free_flush(h, &h->free_stats.on_threshold);
+		return;
+	}
+	if (!remote_free_timer_armed) {
+		remote_free_timer_armed = true;
+		arm = true;
+	}
+	irq_unlock(flags);
+
+	if (arm) {
+		timer_start(remote_free_timer, CONFIG_PORT_REMOTE_FREE_DELAY_MS,
+			    &err);
+		if (err != E_OS_OK)
+			remote_free_timeout(NULL);
+	}
+}
+#endif
+
 void set_cpu_id(uint8_t cpu_id)
 {
 	this_cpu_id = cpu_id;
@@ -260,6 +485,41 @@ void set_cpu_free_handler(uint8_t cpu_id, void (*free_handler)(struct message *)
 	ipc_handler[cpu_id].free = free_handler;
 }
 
+void set_cpu_free_list_handler(uint8_t cpu_id,
+			       void (*free_list_handler)(struct message *))
+{
+	BUILD_BUG_ON(sizeof(struct message) - offsetof(struct message, id) <
+		     sizeof(struct message *));
+
+#if CONFIG_PORT_REMOTE_FREE_BATCH > 0
+	if (remote_free_timer == NULL) {
+		OS_ERR_TYPE err = E_OS_OK;
+
+		remote_free_timer = timer_create(remote_free_timeout, NULL,
+						 CONFIG_PORT_REMOTE_FREE_DELAY_MS,
+						 false, false, &err);
+		if (remote_free_timer == NULL)
+			return;
+	}
+#endif
+	ipc_handler[cpu_id].free_list = free_list_handler;
+}
+
+void port_get_remote_free_stats(uint8_t cpu_id,
+				struct port_remote_free_stats *stats,
+				bool reset)
+{
+	struct port_remote_free_stats *s = &ipc_handler[cpu_id].free_stats;
+	uint32_t flags = irq_lock();
+
+	*stats = *s;
+	if (reset) {
+		memset(s, 0, sizeof(*s));
+		s->pending = stats->pending;
+	}
+	irq_unlock(flags);
+}
+
 int port_send_message(struct message *message)
 {
 	OS_ERR_TYPE err = 0;
@@ -279,15 +539,22 @@ int port_send_message(struct message *message)
 			 port->queue,
 			 err);
 #endif
-		queue_send_message(port->queue, message, &err);
+		port_queue_message(port, message, &err);
 		return err;
 	} else {
 #ifdef PORT_DEBUG
 		pr_debug(LOG_MODULE_MAIN, "Remote port ! using: %p handler",
 			 ipc_handler[port->cpu_id].send_message);
 #endif
-		assert(ipc_handler[port->cpu_id].send_message);
-		return ipc_handler[port->cpu_id].send_message(message);
+		struct ipc_handler *h = &ipc_handler[port->cpu_id];
+
+		assert(h->send_message);
+#if CONFIG_PORT_REMOTE_FREE_BATCH > 0
+		/* Return the pending messages along with this one */
+		if (h->free_pending)
+			remote_free_flush(h, &h->free_stats.on_send);
+#endif
+		return h->send_message(message);
 	}
 }
 
@@ -298,7 +565,12 @@ void message_free(struct message *msg)
 	pr_debug(LOG_MODULE_MAIN, "free message %p: port %p[%d] this %d id %d",
 		 msg, port, port->cpu_id, get_cpu_id(), MESSAGE_SRC(msg));
 	if (port->cpu_id == get_cpu_id()) {
-		bfree(msg);
+		message_free_local(msg);
+#if CONFIG_PORT_REMOTE_FREE_BATCH > 0
+	} else if (ipc_handler[port->cpu_id].free_list &&
+		   !msg->flags.f_is_shared) {
+		remote_free_defer(&ipc_handler[port->cpu_id], msg);
+#endif
 	} else {
 		ipc_handler[port->cpu_id].free(msg);
 	}
@@ -311,16 +583,13 @@ int port_send_message(struct message *msg)
 	struct port *port = get_port(MESSAGE_DST(msg));
 	OS_ERR_TYPE err;
 
-	if (msg->flags.f_queue_head == true)
-		queue_send_message_head(port->queue, msg, &err);
-	else
-		queue_send_message(port->queue, msg, &err);
+	port_queue_message(port, msg, &err);
 	return err;
 }
 
 void message_free(struct message *msg)
 {
-	bfree(msg);
+	message_free_local(msg);
 }
 #endif
 
@@ -78,8 +78,8 @@ static void handle_tcmd_messages(struct message *msg, void *data)
 			struct tcmd_request *request =
 				(struct tcmd_request *)msg;
 			/* Call the Test Command engine synchronous API */
-			tcmd_send(request->command, request->callback,
-				  request->data);
+			tcmd_send_batch(request->command, request->callback,
+					request->data);
 			break;
 		}
 		default:
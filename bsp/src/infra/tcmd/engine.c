@@ -66,14 +66,141 @@ struct tcmd_context {
 	const struct tcmd_handler *cmd;
 };
 
+/** A test command batch used to stream the responses of several commands **/
+struct tcmd_batch {
+	tcmd_rsp_cb_t callback;
+	void *data;
+	/* Number of commands still expecting their last response */
+	int pending;
+};
+
 /** Private functions **/
 
+/** Whether the test commands section is sorted: -1 until checked **/
+static int8_t cmds_sorted = -1;
+
+/**
+ * Compare two strings of known lengths
+ *
+ * @return <0, 0 or >0 as strcmp
+ */
+static int compare_string(const char *a, int a_len, const char *b, int b_len)
+{
+	int ret = memcmp(a, b, a_len < b_len ? a_len : b_len);
+
+	return ret ? ret : a_len - b_len;
+}
+
+/**
+ * Compare a group and command name to those of a command handler
+ *
+ * Commands are ordered by group, then by name, as the linker SORT() orders
+ * their ".test_cmds.<group>.<name>" sections.
+ *
+ * @return <0, 0 or >0 if group and name are before, equal to or after cmd
+ */
+static int compare_command(const char *group, int grp_len, const char *name,
+			   int name_len, const struct tcmd_handler *cmd)
+{
+	int ret = compare_string(group, grp_len, cmd->group, cmd->group_len);
+
+	if (ret == 0)
+		ret = compare_string(name, name_len, cmd->name, cmd->name_len);
+	return ret;
+}
+
+/**
+ * Check once that the linker sorted the test commands section
+ *
+ * A linker script without SORT() still works, through a linear lookup.
+ */
+static bool commands_sorted(void)
+{
+	const struct tcmd_handler *cmd;
+	int8_t sorted = 1;
+
+	if (cmds_sorted < 0) {
+		for (cmd = __test_cmds_start + 1; cmd < __test_cmds_end; cmd++) {
+			if (compare_command(cmd[-1].group, cmd[-1].group_len,
+					    cmd[-1].name, cmd[-1].name_len,
+					    cmd) >= 0) {
+				sorted = 0;
+				break;
+			}
+		}
+		cmds_sorted = sorted;
+	}
+	return cmds_sorted;
+}
+
+/**
+ * Find the first command handler that is not before a group and name
+ *
+ * @return a pointer to a test command handler struct or __test_cmds_end
+ */
+static const struct tcmd_handler *lower_bound(const char *group, int grp_len,
+					      const char *name, int name_len)
+{
+	const struct tcmd_handler *low = __test_cmds_start;
+	const struct tcmd_handler *high = __test_cmds_end;
+
+	while (low < high) {
+		const struct tcmd_handler *mid = low + (high - low) / 2;
+		if (compare_command(group, grp_len, name, name_len, mid) > 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/**
+ * Check if group and name are prefixes of a command handler ones
+ */
+static bool partial_match(const char *group, int grp_len, const char *name,
+			  int name_len, const struct tcmd_handler *cmd)
+{
+	return (grp_len <= cmd->group_len)
+	       && (memcmp(group, cmd->group, grp_len) == 0)
+	       && (name_len <= cmd->name_len)
+	       && (memcmp(name, cmd->name, name_len) == 0);
+}
+
+/**
+ * Find a command handler by going through the whole section
+ *
+ * @return the exact match, else the first partial match, or NULL
+ */
+static const struct tcmd_handler *find_command_linear(const char *group,
+						      int grp_len,
+						      const char *name,
+						      int name_len)
+{
+	const struct tcmd_handler *cmd;
+	const struct tcmd_handler *result = NULL;
+
+	for (cmd = __test_cmds_start; cmd < __test_cmds_end; cmd++) {
+		if (partial_match(group, grp_len, name, name_len, cmd)) {
+			if ((grp_len == cmd->group_len)
+			    && (name_len == cmd->name_len))
+				return cmd;
+			/* only keep the first partial match */
+			if (!result)
+				result = cmd;
+		}
+	}
+	return result;
+}
+
 /**
  * Find a command handler for the specified group and command name
  *
- * We go through the ordered list of registered test commands that have
- * been put by the linker in a specific section identified by start and
- * end addresses.
+ * The registered test commands have been put by the linker in a specific
+ * section identified by start and end addresses, sorted by group and name:
+ * an exact match is found by dichotomy. Otherwise, the groups starting
+ * with the given group follow each other from where it would be inserted,
+ * and the first of their commands whose name starts with the given name
+ * is returned.
  *
  * @param group the command group
  * @param name the command name
@@ -84,28 +211,25 @@ struct tcmd_context {
 static const struct tcmd_handler *find_command(const char *	group,
 					       const char *	name)
 {
-	const struct tcmd_handler *cmd = __test_cmds_start;
-	const struct tcmd_handler *result = NULL;
+	const struct tcmd_handler *cmd;
 	int grp_len = strlen(group);
 	int name_len = strlen(name);
-	bool exact_match = false;
-
-	while ((!result || !exact_match) && (cmd < __test_cmds_end)) {
-		if ((strncmp(group, cmd->group, grp_len) == 0)
-		    && (strncmp(name, cmd->name, name_len) == 0)) {
-			if ((grp_len == strlen(cmd->group))
-			    && (name_len == strlen(cmd->name))) {
-				exact_match = true;
-				result = cmd;
-			} else {
-				/* only keep the first partial match */
-				if (!result)
-					result = cmd;
-			}
-		}
-		cmd++;
+
+	if (!commands_sorted())
+		return find_command_linear(group, grp_len, name, name_len);
+
+	cmd = lower_bound(group, grp_len, name, name_len);
+	if ((cmd < __test_cmds_end)
+	    && (compare_command(group, grp_len, name, name_len, cmd) == 0))
+		return cmd;
+
+	for (cmd = lower_bound(group, grp_len, "", 0);
+	     (cmd < __test_cmds_end) && (grp_len <= cmd->group_len)
+	     && (memcmp(group, cmd->group, grp_len) == 0); cmd++) {
+		if (partial_match(group, grp_len, name, name_len, cmd))
+			return cmd;
 	}
-	return result;
+	return NULL;
 }
 
 /**
@@ -247,16 +371,16 @@ static void list_commands(int argc, char **argv, struct tcmd_handler_ctx *ctx)
 	while (first_cmd < __test_cmds_end) {
 		/* First pass: calculate response buffer size */
 		const char *cur_grp = first_cmd->group;
-		unsigned int cur_grp_len = strlen(cur_grp);
+		unsigned int cur_grp_len = first_cmd->group_len;
 		/* Format is "<group>: <commands>\0" */
-		unsigned int size = cur_grp_len + 2 + strlen(first_cmd->name) +
-				    1;
+		unsigned int size = cur_grp_len + 2 + first_cmd->name_len + 1;
 		const struct tcmd_handler *last_cmd = first_cmd;
 		const struct tcmd_handler *cmd = first_cmd + 1;
 		while ((cmd < __test_cmds_end)
-		       && (strncmp(cur_grp, cmd->group, cur_grp_len) == 0)) {
+		       && (cmd->group_len == cur_grp_len)
+		       && (memcmp(cur_grp, cmd->group, cur_grp_len) == 0)) {
 			/* Commands are separated by a space */
-			size += strlen(cmd->name) + 1;
+			size += cmd->name_len + 1;
 			last_cmd = cmd;
 			cmd++;
 		}
@@ -268,7 +392,7 @@ static void list_commands(int argc, char **argv, struct tcmd_handler_ctx *ctx)
 			char *cursor = output + cur_grp_len + 1;
 			for (cmd = first_cmd; cmd <= last_cmd; cmd++) {
 				sprintf(cursor, " %s", cmd->name);
-				cursor += strlen(cmd->name) + 1;
+				cursor += cmd->name_len + 1;
 			}
 			TCMD_RSP_PROVISIONAL(ctx, output);
 			bfree(output);
@@ -285,7 +409,9 @@ static void list_commands(int argc, char **argv, struct tcmd_handler_ctx *ctx)
 static struct tcmd_handler help_cmd = {
 	"help",
 	"",
-	list_commands
+	list_commands,
+	4,
+	0
 };
 
 /**
@@ -308,6 +434,46 @@ static void __maybe_unused tcmd_version(int argc, char **argv,
 }
 DECLARE_TEST_COMMAND_ENG(tcmd, version, tcmd_version);
 
+/**
+ * Check if a character separates the commands of a batch
+ */
+static bool is_batch_separator(char c)
+{
+	return (c == ';') || (c == '\n') || (c == '\r');
+}
+
+/**
+ * Test command batch response callback function
+ *
+ * Responses of each command are passed to the caller as they come, but the
+ * last response of a command is only kept final or error if it is the last
+ * response of the batch: others are passed as provisional responses, still
+ * carrying the OK or ERROR buffer, so that the caller sees a single
+ * invocation. The batch context is freed with the last response.
+ *
+ * @param response a response of one of the commands of the batch
+ *
+ */
+static void tcmd_batch_response_cb(const struct tcmd_response *response)
+{
+	struct tcmd_batch *batch = (struct tcmd_batch *)response->data;
+	struct tcmd_response batch_rsp = *response;
+	bool last = false;
+
+	batch_rsp.data = batch->data;
+	if (response->type != TCMD_RSP_TYPE_PROVISIONAL) {
+		/* Commands may complete from other contexts */
+		uint32_t keys = irq_lock();
+		last = (--batch->pending == 0);
+		irq_unlock(keys);
+		if (!last)
+			batch_rsp.type = TCMD_RSP_TYPE_PROVISIONAL;
+	}
+	batch->callback(&batch_rsp);
+	if (last)
+		bfree(batch);
+}
+
 /** Public API **/
 
 void tcmd_send(char *command, tcmd_rsp_cb_t callback, void *data)
@@ -407,3 +573,65 @@ void tcmd_send(char *command, tcmd_rsp_cb_t callback, void *data)
 		}
 	}
 }
+
+void tcmd_send_batch(char *commands, tcmd_rsp_cb_t callback, void *data)
+{
+	char *end = commands + strlen(commands);
+	char *first = NULL;
+	char *pc;
+	bool in_cmd = false;
+	int count = 0;
+	int sent = 0;
+	struct tcmd_batch *batch;
+	OS_ERR_TYPE err;
+
+	/* First pass: split commands in place and count them */
+	for (pc = commands; pc < end; pc++) {
+		if (is_batch_separator(*pc)) {
+			in_cmd = false;
+			*pc = '\0';
+		} else if ((*pc != ' ') && !in_cmd) {
+			in_cmd = true;
+			if (!first)
+				first = pc;
+			count++;
+		}
+	}
+	if (count < 2) {
+		/* Nothing to stream, errors are reported as usual */
+		tcmd_send(first ? first : commands, callback, data);
+		return;
+	}
+	batch = (struct tcmd_batch *)balloc(sizeof(*batch), &err);
+	if (!batch) {
+		struct tcmd_response response = {
+			commands,
+			"",
+			0,
+			TCMD_ERROR_MSG_NO_MEMORY,
+			TCMD_RSP_TYPE_ERROR,
+			data
+		};
+		callback(&response);
+		return;
+	}
+	batch->callback = callback;
+	batch->data = data;
+	batch->pending = count;
+	/*
+	 * Second pass: send commands one after the other. The caller may free
+	 * the buffer with the last response, so it is not read after the last
+	 * command has been sent.
+	 */
+	pc = commands;
+	while (sent < count) {
+		char *command = pc;
+		pc += strlen(pc) + 1;
+		while (*command == ' ')
+			command++;
+		if (*command != '\0') {
+			sent++;
+			tcmd_send(command, tcmd_batch_response_cb, batch);
+		}
+	}
+}
@@ -103,7 +103,7 @@ void handle_tcmd_remote_messages(struct message *msg, void *data)
 		 * engine. We pass the original message as an opaque data that will
 		 * be passed back in the responses.
 		 */
-		tcmd_send(command, send_response_msg, msg);
+		tcmd_send_batch(command, send_response_msg, msg);
 		/* The response cb is now responsible for freeing the message */
 		break;
 	}
@@ -58,6 +58,7 @@ T_QUEUE bsp_init(void)
 	T_QUEUE q = queue_create(64);
 	set_cpu_message_sender(CPU_ID_QUARK, ipc_async_send_message);
 	set_cpu_free_handler(CPU_ID_QUARK, ipc_async_free_message);
+	set_cpu_free_list_handler(CPU_ID_QUARK, ipc_async_free_list);
 	ipc_async_init(q);
 
 	/* Test Commands initialization */
@@ -50,6 +50,9 @@ void mbxIsr(void *param)
 		MBX_STS(IPC_QRK_SS_ASYNC) = sts;
 	}
 	ipc_handle_message();
+#ifdef CONFIG_IPC_RING
+	ipc_handle_ring();
+#endif
 }
 #else
 extern void mbxIsr(void *param);
@@ -97,6 +100,11 @@ void soc_setup()
 
 	ipc_init(IPC_SS_QRK_REQ, IPC_QRK_SS_REQ,
 		 IPC_SS_QRK_ACK, IPC_QRK_SS_ACK, CPU_ID_QUARK);
+#ifdef CONFIG_IPC_RING
+	ipc_ring_setup((struct ipc_ring *)&shared_data->ipc_ring_ss_qrk,
+		       (struct ipc_ring *)&shared_data->ipc_ring_qrk_ss,
+		       IPC_SS_QRK_RING, IPC_QRK_SS_RING);
+#endif
 
 	irq_connect_dynamic(SOC_MBOX_INTERRUPT, ISR_DEFAULT_PRIO, mbxIsr, NULL,
 			    0);
@@ -113,6 +121,10 @@ void soc_setup()
 	SOC_MBX_INT_UNMASK(IPC_QRK_SS_REQ);
 	/* Async IPC channel */
 	SOC_MBX_INT_UNMASK(IPC_QRK_SS_ASYNC);
+#ifdef CONFIG_IPC_RING
+	/* IPC ring doorbell */
+	SOC_MBX_INT_UNMASK(IPC_QRK_SS_RING);
+#endif
 
 	/* Notify QRK that ARC started. */
 	shared_data->arc_ready = 1;
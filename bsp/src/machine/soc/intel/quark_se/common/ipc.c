@@ -40,6 +40,12 @@
 
 #include "quark_se_common.h"
 
+#ifdef CONFIG_IPC_RING
+#include "infra/ipc_ring.h"
+#include "util/misc.h"
+#include "project_mapping.h"
+#endif
+
 #define MBX_IPC_SYNC_ARC_TO_QRK 5
 
 static int rx_chan = 0;
@@ -166,8 +172,75 @@ int ipc_request_sync_int(int request_id, int param1, int param2, void *ptr)
 	return ret;
 }
 
+#ifdef CONFIG_IPC_RING
+/*****************************************************************************
+ * IPC Ring:
+ * Messages and remote frees are posted to a descriptor ring in shared memory
+ * without waiting for the remote core. The doorbell mailbox is only written
+ * when the ring was found empty, the remote core then drains the ring from
+ * its mailbox interrupt.
+ *
+ ****************************************************************************/
+
+static struct ipc_ring *tx_ring;
+static struct ipc_ring *rx_ring;
+static int tx_doorbell;
+static int rx_doorbell;
+
+/* Requests queued on ipc_port while the ring was full: they must reach the
+ * ring before any new request to keep the order */
+static int ring_backlog;
+
+void ipc_ring_setup(struct ipc_ring *tx, struct ipc_ring *rx,
+		    int tx_doorbell_channel, int rx_doorbell_channel)
+{
+	BUILD_BUG_ON(sizeof(struct platform_shared_block_) >
+		     BOOTLOADER_SHARED_DATA - ARC_QRK_SHARED_DATA);
+
+	tx_ring = tx;
+	rx_ring = rx;
+	tx_doorbell = tx_doorbell_channel;
+	rx_doorbell = rx_doorbell_channel;
+	ipc_ring_init(rx_ring);
+}
+
+void ipc_handle_ring(void)
+{
+	struct ipc_ring_desc desc;
+
+	if (!MBX_STS(rx_doorbell)) return;
+	/* Acknowledge first: a doorbell rung while draining fires again */
+	MBX_STS(rx_doorbell) = 3;
+	while (!ipc_ring_get(rx_ring, &desc))
+		ipc_sync_callback(remote_cpu, desc.request, 0, 0, desc.ptr);
+}
+
+/* Must be called with interrupts locked */
+static int ipc_ring_send(int request, void *ptr)
+{
+	int ret;
+
+	if (!tx_ring || !shared_data->arc_ready)
+		return -1;
+	ret = ipc_ring_post(tx_ring, request, ptr);
+	if (ret > 0)
+		MBX_CTRL(tx_doorbell) = 0x80000000;
+	return ret < 0 ? -1 : 0;
+}
+#endif
+
 #define IPC_MESSAGE_SEND 1
 #define IPC_MESSAGE_FREE 2
+#define IPC_MESSAGE_FREE_LIST 3
+
+#ifdef CONFIG_IPC_RING
+/* IPC request passing each message of ipc_port to the remote core */
+static const uint8_t ipc_message_request[] = {
+	[IPC_MESSAGE_SEND] = IPC_MSG_TYPE_MESSAGE,
+	[IPC_MESSAGE_FREE] = IPC_MSG_TYPE_FREE,
+	[IPC_MESSAGE_FREE_LIST] = IPC_MSG_TYPE_FREE_LIST
+};
+#endif
 
 static uint16_t ipc_port;
 
@@ -176,6 +249,37 @@ struct ipc_async_msg {
 	void *data;
 };
 
+/**
+ * \brief pass a request queued by ipc_request_send() to the remote core
+ *
+ * \param request the IPC request: \ref IPC_MSG_TYPE_MESSAGE,
+ *                \ref IPC_MSG_TYPE_FREE or \ref IPC_MSG_TYPE_FREE_LIST
+ * \param data the message to send / free, or the list to free
+ */
+static void ipc_request_forward(int request, void *data)
+{
+#ifdef CONFIG_IPC_RING
+	uint32_t flags;
+
+	/* Wait for room in the ring rather than overtake the requests it
+	 * holds, the remote core drains it from its mailbox interrupt */
+	while (shared_data->arc_ready) {
+		flags = irq_lock();
+		if (!ipc_ring_send(request, data)) {
+			ring_backlog--;
+			irq_unlock(flags);
+			return;
+		}
+		irq_unlock(flags);
+		local_task_sleep_ms(1);
+	}
+	flags = irq_lock();
+	ring_backlog--;
+	irq_unlock(flags);
+#endif
+	ipc_request_sync_int(request, 0, 0, data);
+}
+
 /**
  * \brief this function is called in the context of the queue set by
  * ipc_async_init().
@@ -193,14 +297,17 @@ static void handle_ipc_request_port(struct message *m, void *data)
 	case IPC_MESSAGE_SEND:
 		pr_debug(LOG_MODULE_QUARK_SE, "Send message: %p",
 			 msg->data);
-		ipc_request_sync_int(IPC_MSG_TYPE_MESSAGE,
-				     0, 0, msg->data);
+		ipc_request_forward(IPC_MSG_TYPE_MESSAGE, msg->data);
 		break;
 	case IPC_MESSAGE_FREE:
 		pr_debug(LOG_MODULE_QUARK_SE, "Free message: %p",
 			 msg->data);
-		ipc_request_sync_int(IPC_MSG_TYPE_FREE,
-				     0, 0, msg->data);
+		ipc_request_forward(IPC_MSG_TYPE_FREE, msg->data);
+		break;
+	case IPC_MESSAGE_FREE_LIST:
+		pr_debug(LOG_MODULE_QUARK_SE, "Free message list: %p",
+			 msg->data);
+		ipc_request_forward(IPC_MSG_TYPE_FREE_LIST, msg->data);
 		break;
 	}
 	bfree(msg);
@@ -209,16 +316,28 @@ static void handle_ipc_request_port(struct message *m, void *data)
 /**
  * \brief send a message to handle_ipc_request_port()
  *
- * \param msgid the message id to generate. can be \ref IPC_MESSAGE_FREE
- *              or \ref IPC_MESSAGE_SEND
+ * \param msgid the message id to generate. can be \ref IPC_MESSAGE_FREE,
+ *              \ref IPC_MESSAGE_FREE_LIST or \ref IPC_MESSAGE_SEND
  * \param message the message data to send / free
  */
 static int ipc_request_send(uint16_t msgid, void *message)
 {
 	OS_ERR_TYPE err = E_OS_OK;
-	struct ipc_async_msg *msg =
-		(struct ipc_async_msg *)message_alloc(sizeof(*msg), &err);
+	struct ipc_async_msg *msg;
+
+#ifdef CONFIG_IPC_RING
+	uint32_t flags = irq_lock();
+
+	if (!ring_backlog &&
+	    !ipc_ring_send(ipc_message_request[msgid], message)) {
+		irq_unlock(flags);
+		return E_OS_OK;
+	}
+	ring_backlog++;
+	irq_unlock(flags);
+#endif
 
+	msg = (struct ipc_async_msg *)message_alloc(sizeof(*msg), &err);
 	if (err == E_OS_OK) {
 		MESSAGE_ID(&msg->h) = msgid;
 		MESSAGE_DST(&msg->h) = ipc_port;
@@ -226,6 +345,13 @@ static int ipc_request_send(uint16_t msgid, void *message)
 		msg->data = message;
 		port_send_message(&msg->h);
 	}
+#ifdef CONFIG_IPC_RING
+	else {
+		flags = irq_lock();
+		ring_backlog--;
+		irq_unlock(flags);
+	}
+#endif
 	return err;
 }
 
@@ -239,6 +365,11 @@ void ipc_async_free_message(struct message *message)
 	ipc_request_send(IPC_MESSAGE_FREE, message);
 }
 
+void ipc_async_free_list(struct message *list)
+{
+	ipc_request_send(IPC_MESSAGE_FREE_LIST, list);
+}
+
 void ipc_async_init(T_QUEUE queue)
 {
 	ipc_port = port_alloc(queue);
@@ -43,10 +43,16 @@ T_QUEUE ipc_setup(void)
 	/* Initialize IPC: channels have been chosen arbitrarily */
 	ipc_init(IPC_QRK_SS_REQ, IPC_SS_QRK_REQ,
 		 IPC_QRK_SS_ACK, IPC_SS_QRK_ACK, CPU_ID_ARC);
+#ifdef CONFIG_IPC_RING
+	ipc_ring_setup((struct ipc_ring *)&shared_data->ipc_ring_qrk_ss,
+		       (struct ipc_ring *)&shared_data->ipc_ring_ss_qrk,
+		       IPC_QRK_SS_RING, IPC_SS_QRK_RING);
+#endif
 	ipc_async_init(queue);
 
 	set_cpu_id(CPU_ID_QUARK);
 	set_cpu_message_sender(CPU_ID_ARC, ipc_async_send_message);
 	set_cpu_free_handler(CPU_ID_ARC, ipc_async_free_message);
+	set_cpu_free_list_handler(CPU_ID_ARC, ipc_async_free_list);
 	return queue;
 }
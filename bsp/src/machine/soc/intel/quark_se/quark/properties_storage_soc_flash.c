@@ -33,6 +33,7 @@
 #include <stdbool.h>
 
 #include "util/compiler.h"
+#include "util/misc.h"
 #include "infra/properties_storage.h"
 #include "infra/panic.h"
 #include "infra/log.h"
@@ -66,6 +67,16 @@
  * value needs to be written, it must fit in the remaining space of the block.
  *
  * The last property in a block is followed by 8 bytes set at value zero.
+ *
+ * At least one block is always kept free. Obsolete entries are reclaimed by
+ * copying the live entries of the oldest block at the write offset and erasing
+ * it. This is done incrementally by properties_storage_compact_step(), which
+ * is meant to be called in the background as soon as the free space drops
+ * below CONFIG_QUARK_SE_PROPERTIES_STORAGE_COMPACT_WATERMARK and the older
+ * blocks hold obsolete entries, so that
+ * properties_storage_set() only has to append. If the background compaction
+ * doesn't keep up, it is completed synchronously when starting to write the
+ * last free block.
  */
 
 #define NEXT_MULTIPLE_OF_4(x) (((x) + 3) & ~3)
@@ -92,13 +103,30 @@ typedef struct {
 	uint32_t previous_write_offset;
 	/* Incremented each time a new block is started */
 	uint32_t last_written_block_header;
+	/* Offset of the next entry to copy from the oldest block, 0 if no
+	 * compaction is in progress */
+	uint32_t compact_offset;
+	/* Statistics since boot */
+	uint32_t user_bytes;
+	uint32_t copied_bytes;
+	uint32_t sync_compactions;
+	uint32_t *erase_count;
 } flash_partition_t;
 
+static uint32_t reset_persistent_erase_count[FACTORY_RESET_PERSISTENT_END_BLOCK
+					     -
+					     FACTORY_RESET_PERSISTENT_START_BLOCK
+					     + 1];
+static uint32_t not_persistent_erase_count[
+	FACTORY_RESET_NON_PERSISTENT_END_BLOCK -
+	FACTORY_RESET_NON_PERSISTENT_START_BLOCK + 1];
+
 static flash_partition_t reset_persistent_partition = {
 	.start_block = FACTORY_RESET_PERSISTENT_START_BLOCK,
 	.nb_blocks = FACTORY_RESET_PERSISTENT_END_BLOCK -
 		     FACTORY_RESET_PERSISTENT_START_BLOCK + 1,
 	.block_size = EMBEDDED_FLASH_BLOCK_SIZE,
+	.erase_count = reset_persistent_erase_count,
 };
 
 static flash_partition_t not_persistent_partition = {
@@ -106,6 +134,7 @@ static flash_partition_t not_persistent_partition = {
 	.nb_blocks = FACTORY_RESET_NON_PERSISTENT_END_BLOCK -
 		     FACTORY_RESET_NON_PERSISTENT_START_BLOCK + 1,
 	.block_size = EMBEDDED_FLASH_BLOCK_SIZE,
+	.erase_count = not_persistent_erase_count,
 };
 
 #define PROPERTY_FLAG_NONE          0xFF /* 0b11111111 */
@@ -134,46 +163,156 @@ typedef struct {
 
 /* This implementation maintains an index of all properties in RAM,
  * the index is re-generated at startup by scanning the content of the
- * blocks allocated to the properties storage */
+ * blocks allocated to the properties storage.
+ *
+ * The property infos are looked up through an open-addressing hash table
+ * (linear probing) keyed on the property key, which stores the position + 1
+ * of the info in ram_cache, 0 meaning the bucket is empty. Unused infos are
+ * chained in a free list through their offset field, so that lookup, insertion
+ * and removal don't depend on the number of properties. */
 typedef struct {
 	uint32_t key;
 	uint16_t len;
 	uint8_t used;    /* false if the element is unused */
 	uint8_t reserved;
-	uint32_t offset; /* in byte, from byte 0 of block 0 (possibly outside partition) */
+	union {
+		uint32_t offset;    /* in byte, from byte 0 of block 0 (possibly outside partition) */
+		uint32_t next_free; /* position of the next unused element */
+	};
 } property_info_t;
 
+/* Number of buckets of the hash index: the smallest power of 2 keeping the
+ * load factor at most 1/2 */
+#define PROPERTY_INDEX_MIN_SIZE (2 * PROPERTIES_STORAGE_MAX_NB_PROPERTIES)
+#if PROPERTY_INDEX_MIN_SIZE <= (1 << 1)
+#define PROPERTY_INDEX_BITS 1
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 2)
+#define PROPERTY_INDEX_BITS 2
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 3)
+#define PROPERTY_INDEX_BITS 3
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 4)
+#define PROPERTY_INDEX_BITS 4
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 5)
+#define PROPERTY_INDEX_BITS 5
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 6)
+#define PROPERTY_INDEX_BITS 6
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 7)
+#define PROPERTY_INDEX_BITS 7
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 8)
+#define PROPERTY_INDEX_BITS 8
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 9)
+#define PROPERTY_INDEX_BITS 9
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 10)
+#define PROPERTY_INDEX_BITS 10
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 11)
+#define PROPERTY_INDEX_BITS 11
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 12)
+#define PROPERTY_INDEX_BITS 12
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 13)
+#define PROPERTY_INDEX_BITS 13
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 14)
+#define PROPERTY_INDEX_BITS 14
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 15)
+#define PROPERTY_INDEX_BITS 15
+#elif PROPERTY_INDEX_MIN_SIZE <= (1 << 16)
+#define PROPERTY_INDEX_BITS 16
+#else
+#error "PROPERTIES_STORAGE_MAX_NB_PROPERTIES is too large for the hash index"
+#endif
+#define PROPERTY_INDEX_SIZE (1 << PROPERTY_INDEX_BITS)
+#define PROPERTY_INDEX_MASK (PROPERTY_INDEX_SIZE - 1)
+#define PROPERTY_INDEX_NONE 0xffffffff
+
+STATIC_ASSERT(PROPERTY_INDEX_SIZE >= 2 * PROPERTIES_STORAGE_MAX_NB_PROPERTIES &&
+	      PROPERTIES_STORAGE_MAX_NB_PROPERTIES < 0xffff);
+
 static property_info_t ram_cache[PROPERTIES_STORAGE_MAX_NB_PROPERTIES];
+static uint16_t ram_index[PROPERTY_INDEX_SIZE];
+static uint32_t first_free;
+
+/* Multiplicative hashing: property keys are often small sequential numbers
+ * which need to be spread over the whole table */
+static inline uint32_t property_hash(uint32_t key)
+{
+	return (key * 2654435761u) >> (32 - PROPERTY_INDEX_BITS);
+}
+
+/* Return the bucket holding key, or the empty bucket ending its probe
+ * sequence */
+static uint32_t find_bucket(uint32_t key)
+{
+	uint32_t b = property_hash(key);
+
+	while (ram_index[b] && ram_cache[ram_index[b] - 1].key != key)
+		b = (b + 1) & PROPERTY_INDEX_MASK;
+	return b;
+}
 
 static property_info_t *get_property_info(uint32_t key)
 {
-	for (int i = 0; i < PROPERTIES_STORAGE_MAX_NB_PROPERTIES; ++i) {
-		if (ram_cache[i].key == key && ram_cache[i].used == true)
-			return &ram_cache[i];
-	}
-	return NULL;
+	uint32_t b = find_bucket(key);
+
+	if (!ram_index[b])
+		return NULL;
+	return &ram_cache[ram_index[b] - 1];
 }
-static property_info_t *alloc_property_info()
+
+/* Allocate a new info for key, which must not be in the index yet */
+static property_info_t *alloc_property_info(uint32_t key)
 {
-	for (int i = 0; i < PROPERTIES_STORAGE_MAX_NB_PROPERTIES; ++i) {
-		if (ram_cache[i].used == false) {
-			ram_cache[i].used = true;
-			return &ram_cache[i];
-		}
-	}
-	return NULL;
+	if (first_free == PROPERTY_INDEX_NONE)
+		return NULL;
+
+	property_info_t *p = &ram_cache[first_free];
+	uint32_t b = find_bucket(key);
+
+	assert(ram_index[b] == 0);
+	ram_index[b] = first_free + 1;
+	first_free = p->next_free;
+	p->used = true;
+	p->key = key;
+	return p;
 }
 
 static void free_property_info(property_info_t *p)
 {
 	assert(p->used == true);
+	uint32_t b = find_bucket(p->key);
+	uint32_t next = b;
+
+	assert(ram_index[b] == p - ram_cache + 1);
+	/* Shift back the following entries of the cluster which can't be
+	 * reached anymore once the bucket is emptied, so that no tombstone is
+	 * needed */
+	while (1) {
+		next = (next + 1) & PROPERTY_INDEX_MASK;
+		if (!ram_index[next])
+			break;
+		uint32_t home = property_hash(ram_cache[ram_index[next] - 1].key);
+		/* Leave the entry if its home bucket lies cyclically in ]b, next] */
+		if (((next - home) & PROPERTY_INDEX_MASK) <
+		    ((next - b) & PROPERTY_INDEX_MASK))
+			continue;
+		ram_index[b] = ram_index[next];
+		b = next;
+	}
+	ram_index[b] = 0;
+
 	p->used = false;
+	p->next_free = first_free;
+	first_free = p - ram_cache;
 }
 
 static void clear_all_property_info()
 {
-	for (int i = 0; i < PROPERTIES_STORAGE_MAX_NB_PROPERTIES; ++i)
+	memset(ram_index, 0, sizeof(ram_index));
+	for (int i = 0; i < PROPERTIES_STORAGE_MAX_NB_PROPERTIES; ++i) {
 		ram_cache[i].used = false;
+		ram_cache[i].next_free = i + 1;
+	}
+	ram_cache[PROPERTIES_STORAGE_MAX_NB_PROPERTIES - 1].next_free =
+		PROPERTY_INDEX_NONE;
+	first_free = 0;
 }
 
 static bool is_entry_last_in_block(uint32_t				offset,
@@ -203,13 +342,16 @@ static bool set_entry_last_in_block(uint32_t				offset,
 	return ret == DRV_RC_OK && ret_len == 2;
 }
 
-/* Find next free offset in block */
+/* Find next free offset in block, and the offset of the last entry written in
+ * it (equal to the free offset if the block is empty) */
 static uint32_t find_next_free_offset(const flash_partition_t *part,
-				      uint16_t block, bool *status)
+				      uint16_t block, uint32_t *last_offset,
+				      bool *status)
 {
 	*status = true;
 	uint32_t offset = block * part->block_size + BLOCK_HEADER_SIZE; /* starts after header */
 	property_flash_header_t prop_header = { 0 };
+	*last_offset = offset;
 	while (1) {
 		unsigned int ret_len;
 		DRIVER_API_RC __maybe_unused ret = soc_flash_read(
@@ -222,6 +364,7 @@ static uint32_t find_next_free_offset(const flash_partition_t *part,
 		}
 		if (prop_header.key == 0xffffffff)
 			break;
+		*last_offset = offset;
 		offset += NEXT_MULTIPLE_OF_4(
 			PROPERTY_HEADER_SIZE + prop_header.len);
 	}
@@ -240,6 +383,8 @@ static bool init_read_write_offset_from_flash(flash_partition_t *part)
 	uint32_t max_used_block_header = 0xffffffff;
 	uint32_t nb_unused_block = 0;
 
+	part->compact_offset = 0;
+
 	for (b = part->start_block;
 	     b < part->start_block + part->nb_blocks;
 	     ++b) {
@@ -308,9 +453,11 @@ static bool init_read_write_offset_from_flash(flash_partition_t *part)
 				    BLOCK_HEADER_SIZE;
 	part->last_written_block_header = max_used_block_header;
 	bool status;
+	/* The last entry is needed to flag it as last in block when switching
+	 * to the next one */
 	part->current_write_offset = find_next_free_offset(part, max_used_block,
+							   &part->previous_write_offset,
 							   &status);
-	part->previous_write_offset = part->current_write_offset;
 	return status;
 }
 
@@ -358,12 +505,16 @@ static bool fill_index_from_flash(const flash_partition_t *part)
 		if (!IS_ENTRY_OBSOLETE(prop_header)) {
 			/* The entry is the most up-to-date one for this property, store it
 			 * in our RAM index */
-			property_info_t *p = alloc_property_info();
+			property_info_t *p = get_property_info(prop_header.key);
+			/* A reset between writing a new value and flagging the
+			 * previous one obsolete leaves 2 valid entries: the last
+			 * one written wins */
+			if (p == NULL)
+				p = alloc_property_info(prop_header.key);
 			/* As we reload a previous valid storage, we can't overflow by
 			 * design */
 			assert(p);
 
-			p->key = prop_header.key;
 			p->len = prop_header.len;
 			p->offset = offset;
 		}
@@ -388,6 +539,8 @@ static void format_partition(flash_partition_t *part)
 	pr_warning(LOG_MODULE_MAIN, "Formatting flash blocks %u through %u...",
 		   part->start_block, part->start_block + part->nb_blocks);
 	assert(ret == DRV_RC_OK);
+	for (int i = 0; i < part->nb_blocks; i++)
+		part->erase_count[i]++;
 }
 
 /* Intialize the property storage from the flash content. In case of errors, we
@@ -432,6 +585,18 @@ void properties_storage_format_all(void)
 	properties_storage_init();
 }
 
+/* An entry is live if it is the one referenced by the RAM index. Entries
+ * which are not flagged obsolete can still be stale duplicates, either left by
+ * a reset in the middle of a set, or by a compaction interrupted by a reset */
+static bool is_entry_live(uint32_t				offset,
+			  const property_flash_header_t *	pfh)
+{
+	if (IS_ENTRY_OBSOLETE(*pfh))
+		return false;
+	property_info_t *prop_info = get_property_info(pfh->key);
+	return prop_info && prop_info->offset == offset;
+}
+
 /* Copy the entry at src_offset to the current write offset */
 static void copy_entry_if_not_obsolete(flash_partition_t *	part,
 				       uint32_t *		src_offset,
@@ -453,7 +618,7 @@ static void copy_entry_if_not_obsolete(flash_partition_t *	part,
 					4;
 
 	/* Scraps obsolete content */
-	if (!IS_ENTRY_OBSOLETE(*prop_header)) {
+	if (is_entry_live(*src_offset, prop_header)) {
 		ret =
 			soc_flash_read(*src_offset + PROPERTY_HEADER_SIZE,
 				       value_size,
@@ -471,12 +636,12 @@ static void copy_entry_if_not_obsolete(flash_partition_t *	part,
 
 		property_info_t *prop_info = get_property_info(prop_header->key);
 		/* Update RAM index for this entry */
-		assert(prop_info);
 		prop_info->offset = part->current_write_offset;
 
 		part->previous_write_offset = part->current_write_offset;
 		part->current_write_offset += PROPERTY_HEADER_SIZE +
 					      value_size * 4;
+		part->copied_bytes += PROPERTY_HEADER_SIZE + value_size * 4;
 	}
 
 	*src_offset += PROPERTY_HEADER_SIZE + value_size * 4;
@@ -501,6 +666,23 @@ static properties_storage_status_t make_entry_obsolete_in_flash(uint32_t offset)
 	return ret;
 }
 
+/* Release the oldest block once all its live entries have been copied */
+static void erase_oldest_block(flash_partition_t *part)
+{
+	uint16_t oldest_block = OLDEST_BLOCK(part);
+
+	part->current_read_offset =
+		NEXT_BLOCK(part,
+			   oldest_block) * part->block_size +
+		BLOCK_HEADER_SIZE;
+	part->compact_offset = 0;
+
+	DRIVER_API_RC ret = soc_flash_block_erase(oldest_block, 1);
+	if (ret != DRV_RC_OK)
+		panic(67);
+	part->erase_count[oldest_block - part->start_block]++;
+}
+
 /* Initialize the next block to prepare writting in it. This may involve
  * shifting the oldest blocks content into the new one to get rid of obsolete
  * properties to make space */
@@ -534,9 +716,11 @@ static void prepare_next_block(flash_partition_t *part)
 		/* We are starting to write on the last free block, but we always
 		 * need at least one completely free block so we need to free the
 		 * oldest used block. For this, we copy the oldest block's
-		 * content in the new one, and scrap all obsolete entries */
-		uint16_t oldest_block = OLDEST_BLOCK(part);
-		uint32_t src_offset = oldest_block * part->block_size +
+		 * content in the new one, and scrap all obsolete entries.
+		 * The background compaction didn't keep up: resume it from
+		 * where it stopped */
+		uint32_t src_offset = part->compact_offset ? part->compact_offset :
+				      OLDEST_BLOCK(part) * part->block_size +
 				      BLOCK_HEADER_SIZE;
 
 		bool last_in_block = false;
@@ -547,32 +731,17 @@ static void prepare_next_block(flash_partition_t *part)
 			copy_entry_if_not_obsolete(part, &src_offset,
 						   &last_in_block);
 
-		part->current_read_offset =
-			NEXT_BLOCK(part,
-				   oldest_block) * part->block_size +
-			BLOCK_HEADER_SIZE;
-
 		/* We are done copying one block into the other, we can now clear
 		 * the oldest block */
-		DRIVER_API_RC ret = soc_flash_block_erase(oldest_block, 1);
-		if (ret != DRV_RC_OK)
-			panic(67);
+		erase_oldest_block(part);
+		part->sync_compactions++;
 	}
 }
 
-properties_storage_status_t properties_storage_set(
-	uint32_t key,
-	const uint8_t *buf,
-	uint16_t len, bool factory_reset_persistent)
+/* Ensure we have enough contiguous space in the currently written block to
+ * append an entry of len bytes. Return false if the store is full */
+static bool reserve_space(flash_partition_t *part, uint16_t len)
 {
-	if (len > PROPERTIES_STORAGE_MAX_VALUE_LEN)
-		return PROPERTIES_STORAGE_INVALID_ARG;
-
-	unsigned int ret_len;
-	flash_partition_t *part = factory_reset_persistent ?
-				  &reset_persistent_partition : &
-				  not_persistent_partition;
-
 	uint16_t old_write_block = BLOCK_FOR_OFFSET(part,
 						    part->current_write_offset);
 
@@ -580,7 +749,6 @@ properties_storage_status_t properties_storage_set(
 					    (part->current_write_offset %
 					     part->block_size);
 
-	/* Ensure we have enough contiguous space in the currently written block */
 	/* The "+8" here is important: it ensures that after writing the new
 	 * property, we will still have at least 8 bytes free at the end of the
 	 * block so that:
@@ -598,12 +766,182 @@ properties_storage_status_t properties_storage_set(
 		 * means that the store is completely filled with valid entries */
 		if (old_write_block ==
 		    BLOCK_FOR_OFFSET(part, part->current_write_offset))
-			return PROPERTIES_STORAGE_BOUNDS_ERROR;
+			return false;
 
 		remaining_space_in_block = part->block_size -
 					   (part->current_write_offset %
 					    part->block_size);
 	}
+	return true;
+}
+
+/* Space which can be written before having to compact synchronously */
+static uint32_t get_free_space(const flash_partition_t *part)
+{
+	uint16_t write_block = BLOCK_FOR_OFFSET(part,
+						part->current_write_offset);
+	uint16_t used_blocks = (write_block + part->nb_blocks - OLDEST_BLOCK(
+					part)) % part->nb_blocks + 1;
+
+	/* Don't count the block which must always remain free */
+	return part->block_size - part->current_write_offset %
+	       part->block_size +
+	       (part->nb_blocks - used_blocks - 1) *
+	       (part->block_size - BLOCK_HEADER_SIZE);
+}
+
+static void get_block_stats(const flash_partition_t *		part,
+			    uint16_t				block,
+			    struct properties_storage_block_stats *	stats)
+{
+	uint32_t offset = block * part->block_size + BLOCK_HEADER_SIZE;
+	uint32_t end = offset - BLOCK_HEADER_SIZE + part->block_size;
+	property_flash_header_t pfh = { 0 };
+	unsigned int ret_len;
+	DRIVER_API_RC __maybe_unused ret = soc_flash_read(
+		block * part->block_size, 1, &ret_len, &stats->seq);
+
+	assert(ret == DRV_RC_OK && ret_len == 1);
+	stats->live_bytes = 0;
+	stats->obsolete_bytes = 0;
+	stats->erase_count = part->erase_count[block - part->start_block];
+	if (stats->seq == UNUSED_BLOCK_HEADER) {
+		stats->free_bytes = part->block_size - BLOCK_HEADER_SIZE;
+		return;
+	}
+
+	while (offset + PROPERTY_HEADER_SIZE <= end) {
+		ret = soc_flash_read(offset, 2, &ret_len, (uint32_t *)&pfh);
+		assert(ret == DRV_RC_OK && ret_len == 2);
+		if (pfh.key == 0xffffffff)
+			break;
+		uint32_t size = NEXT_MULTIPLE_OF_4(PROPERTY_HEADER_SIZE + pfh.len);
+		if (is_entry_live(offset, &pfh))
+			stats->live_bytes += size;
+		else
+			stats->obsolete_bytes += size;
+		if (is_entry_last_in_block(offset, &pfh)) {
+			/* The rest of the block is lost */
+			offset = end;
+			break;
+		}
+		offset += size;
+	}
+	stats->free_bytes = end - offset;
+}
+
+/* Obsolete bytes which compacting the blocks older than the one being written
+ * would reclaim */
+static uint32_t get_reclaimable_space(const flash_partition_t *part)
+{
+	struct properties_storage_block_stats stats;
+	uint16_t write_block = BLOCK_FOR_OFFSET(part,
+						part->current_write_offset);
+	uint32_t reclaimable = 0;
+
+	for (uint16_t block = OLDEST_BLOCK(part); block != write_block;
+	     block = NEXT_BLOCK(part, block)) {
+		get_block_stats(part, block, &stats);
+		reclaimable += stats.obsolete_bytes;
+	}
+	return reclaimable;
+}
+
+/* Copy at most one entry of the oldest block. Return true if some compaction
+ * work remains to be done */
+static bool compact_step(flash_partition_t *part)
+{
+	if (part->compact_offset == 0) {
+		/* Nothing can be reclaimed from the block being written, and
+		 * copying live entries only would cycle the blocks for nothing */
+		if (get_free_space(part) >=
+		    CONFIG_QUARK_SE_PROPERTIES_STORAGE_COMPACT_WATERMARK ||
+		    OLDEST_BLOCK(part) ==
+		    BLOCK_FOR_OFFSET(part, part->current_write_offset) ||
+		    get_reclaimable_space(part) == 0)
+			return false;
+		part->compact_offset = part->current_read_offset;
+	}
+
+	property_flash_header_t pfh = { 0 };
+	unsigned int ret_len;
+	DRIVER_API_RC __maybe_unused ret = soc_flash_read(
+		part->compact_offset, 2, &ret_len, (uint32_t *)&pfh);
+
+	assert(ret == DRV_RC_OK && ret_len == 2);
+	bool live = is_entry_live(part->compact_offset, &pfh);
+	if (live) {
+		if (!reserve_space(part, pfh.len)) {
+			/* Only live entries: nothing to reclaim */
+			part->compact_offset = 0;
+			return false;
+		}
+		/* Switching to the last free block completed the compaction */
+		if (part->compact_offset == 0)
+			return true;
+	}
+
+	uint32_t src_offset = part->compact_offset;
+	bool last_in_block;
+	copy_entry_if_not_obsolete(part, &part->compact_offset,
+				   &last_in_block);
+	/* Requests are served before the block is erased: once the copy is
+	 * written, flag the source so that it can't come back on the next
+	 * boot if the copy is deleted */
+	if (live)
+		make_entry_obsolete_in_flash(src_offset);
+	if (last_in_block)
+		erase_oldest_block(part);
+	return true;
+}
+
+bool properties_storage_compact_step(void)
+{
+	/* Compact one partition at a time, the most valuable one first */
+	if (compact_step(&reset_persistent_partition))
+		return true;
+	return compact_step(&not_persistent_partition);
+}
+
+properties_storage_status_t properties_storage_get_stats(
+	bool						factory_reset_persistent,
+	struct properties_storage_stats *		stats,
+	struct properties_storage_block_stats *		blocks,
+	uint16_t					nb_blocks)
+{
+	const flash_partition_t *part = factory_reset_persistent ?
+					&reset_persistent_partition : &
+					not_persistent_partition;
+
+	stats->nb_blocks = part->nb_blocks;
+	stats->free_bytes = get_free_space(part);
+	stats->user_bytes = part->user_bytes;
+	stats->copied_bytes = part->copied_bytes;
+	stats->sync_compactions = part->sync_compactions;
+
+	if (nb_blocks > part->nb_blocks)
+		nb_blocks = part->nb_blocks;
+	for (int i = 0; i < nb_blocks; i++)
+		get_block_stats(part, part->start_block + i, &blocks[i]);
+
+	return PROPERTIES_STORAGE_SUCCESS;
+}
+
+properties_storage_status_t properties_storage_set(
+	uint32_t key,
+	const uint8_t *buf,
+	uint16_t len, bool factory_reset_persistent)
+{
+	if (len > PROPERTIES_STORAGE_MAX_VALUE_LEN)
+		return PROPERTIES_STORAGE_INVALID_ARG;
+
+	unsigned int ret_len;
+	flash_partition_t *part = factory_reset_persistent ?
+				  &reset_persistent_partition : &
+				  not_persistent_partition;
+
+	if (!reserve_space(part, len))
+		return PROPERTIES_STORAGE_BOUNDS_ERROR;
 
 	/* From this point we know we have enough space available at
 	 * current_write_offset to write the new entry. */
@@ -621,6 +959,7 @@ properties_storage_status_t properties_storage_set(
 		panic(67);
 	part->previous_write_offset = part->current_write_offset;
 	part->current_write_offset += wlen;
+	part->user_bytes += wlen;
 	assert(BLOCK_FOR_OFFSET(part, part->current_write_offset) ==
 	       BLOCK_FOR_OFFSET(part, part->previous_write_offset));
 
@@ -633,10 +972,9 @@ properties_storage_status_t properties_storage_set(
 			return PROPERTIES_STORAGE_IO_ERROR;
 	} else {
 		/* Allocate a new property info in our cache */
-		p = alloc_property_info();
+		p = alloc_property_info(key);
 		if (p == NULL)
 			return PROPERTIES_STORAGE_BOUNDS_ERROR;
-		p->key = key;
 	}
 	p->offset = part->previous_write_offset;
 	p->len = len;
@@ -688,7 +1026,7 @@ properties_storage_status_t properties_storage_get(uint32_t key, uint8_t *buf,
 	unsigned int ret_len;
 	DRIVER_API_RC ret;
 
-	if (pinfo->len > 4) {
+	if (pinfo->len >= 4) {
 		ret =
 			soc_flash_read(pinfo->offset + PROPERTY_HEADER_SIZE,
 				       (pinfo->len & ~3) / 4, &ret_len,
@@ -512,7 +512,9 @@ void init_all_devices(void)
 #endif
 }
 
-/* Array of qrk flash memory partitioning */
+/* Array of qrk flash memory partitioning. The panic, properties, log, system
+ * event and circular storage partitions are also written without the
+ * ll_storage service, their reads are never cached. */
 flash_partition_t storage_configuration[] =
 {
 	{
@@ -520,7 +522,8 @@ flash_partition_t storage_configuration[] =
 		.flash_id = APPLICATION_DATA_FLASH_ID,
 		.start_block = APPLICATION_DATA_START_BLOCK,
 		.end_block = APPLICATION_DATA_END_BLOCK,
-		.factory_reset_state = FACTORY_RESET_NON_PERSISTENT
+		.factory_reset_state = FACTORY_RESET_NON_PERSISTENT,
+		.cacheable = 1
 	},
 	{
 		.partition_id = DEBUGPANIC_PARTITION_ID,
@@ -548,7 +551,8 @@ flash_partition_t storage_configuration[] =
 		.flash_id = FACTORY_SETTINGS_FLASH_ID,
 		.start_block = FACTORY_SETTINGS_START_BLOCK,
 		.end_block = FACTORY_SETTINGS_END_BLOCK,
-		.factory_reset_state = FACTORY_RESET_PERSISTENT
+		.factory_reset_state = FACTORY_RESET_PERSISTENT,
+		.cacheable = 1
 	},
 	{
 		.partition_id = SPI_FOTA_PARTITION_ID,
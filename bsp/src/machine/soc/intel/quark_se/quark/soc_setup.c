@@ -115,19 +115,22 @@ void mbx_out_channel()
 enum {
 	IPC_RX_REQ = 0,
 	IPC_RX_ACK,
-	IPC_RX_ASYNC
+	IPC_RX_ASYNC,
+	IPC_RX_RING
 };
 
 static void (*ipc_callbacks[])() = {
 	[IPC_RX_ASYNC] = mbx_out_channel,
 	[IPC_RX_REQ] = NULL,
-	[IPC_RX_ACK] = NULL
+	[IPC_RX_ACK] = NULL,
+	[IPC_RX_RING] = NULL
 };
 
 static const uint8_t ipc_channels[] = {
 	[IPC_RX_ASYNC] = IPC_SS_QRK_ASYNC,
 	[IPC_RX_REQ] = IPC_SS_QRK_REQ,
-	[IPC_RX_ACK] = IPC_SS_QRK_ACK
+	[IPC_RX_ACK] = IPC_SS_QRK_ACK,
+	[IPC_RX_RING] = IPC_SS_QRK_RING
 };
 
 void notrace mbxIsr(int param)
@@ -147,7 +150,7 @@ void notrace mbxIsr(int param)
 			if (ipc_channels[i] == IPC_SS_QRK_ASYNC)
 				MBX_STS(ipc_channels[i]) = sts;
 		}
-	} while (MBX_CHALL_STS & 0x0500);
+	} while (MBX_CHALL_STS & 0x0540);
 }
 
 static void display_boot_target(void)
@@ -168,6 +171,9 @@ void soc_setup(void)
 
 	/* Temporary: we need to reference the IPC message handler from mbxIsr */
 	ipc_callbacks[IPC_RX_REQ] = ipc_handle_message;
+#ifdef CONFIG_IPC_RING
+	ipc_callbacks[IPC_RX_RING] = ipc_handle_ring;
+#endif
 
 	/* TODO: Get the ARC Flash start address from predefined HW block */
 
@@ -218,6 +224,9 @@ void soc_setup(void)
 	/* Enable interrupt for ipc channels */
 	SOC_MBX_INT_UNMASK(IPC_SS_QRK_ASYNC);
 	SOC_MBX_INT_UNMASK(IPC_SS_QRK_REQ);
+#ifdef CONFIG_IPC_RING
+	SOC_MBX_INT_UNMASK(IPC_SS_QRK_RING);
+#endif
 
 	/* Enable Always on timer */
 	SCSS_REG_VAL(SCSS_AONC_CFG) = AONC_CNT_EN;
@@ -84,6 +84,15 @@ OS_ERR_TYPE bfree(void *ptr)
 	return E_OS_OK;
 }
 
+OS_ERR_TYPE bfree_bulk(void **buffers, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		bfree(buffers[i]);
+	return E_OS_OK;
+}
+
 
 /*************************    QUEUES   *************************/
 
@@ -143,6 +152,13 @@ void queue_send_message_head(T_QUEUE queue, T_QUEUE_MESSAGE message,
 	queue_put_head(queue, message);
 }
 
+/* Priorities are not supported, messages are dequeued in FIFO order */
+void queue_send_message_prio(T_QUEUE queue, T_QUEUE_MESSAGE message,
+			     uint8_t prio, OS_ERR_TYPE *err)
+{
+	queue_put(queue, message);
+}
+
 T_QUEUE queue_create(uint32_t max_size)
 {
 	int i, found = 0;
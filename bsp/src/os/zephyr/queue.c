@@ -37,9 +37,13 @@
  */
 
 #include <zephyr.h>
+#include <string.h>
 
 #include "util/list.h"
 #include "infra/panic.h"
+#ifdef CONFIG_QUEUE_STATS
+#include "infra/time.h"
+#endif
 #include "common.h"
 
 /* Warning 'next' must be the first element of the struct */
@@ -47,15 +51,27 @@ typedef struct                     // element for linked-list
 {
 	list_t *next;            //the next element in the list
 	void *data;                 //generic pointer to any data type
+#ifdef CONFIG_QUEUE_STATS
+	uint32_t timestamp;         //enqueue date, in 32kHz ticks
+#endif
 }list_element;
 
+/*
+ * Messages are stored in one list per priority band. A bit is set in
+ * prio_map for each non empty band so that the highest priority message is
+ * found in constant time.
+ */
 typedef struct                    // a linked-list of list_element
 {
-	list_head_t _list;
+	list_head_t _list[QUEUE_PRIO_COUNT];
+	uint32_t prio_map;
 	uint32_t current_size;
 	uint32_t max_size;
 	T_SEMAPHORE sema;   /* semaphore used by the listener to wait on new incoming data
 	                     * and used by the producer to signal new incoming data in the queue */
+#ifdef CONFIG_QUEUE_STATS
+	struct queue_stats stats;
+#endif
 }queue_impl_t;
 
 
@@ -68,7 +84,8 @@ DECLARE_BLK_ALLOC(element, list_element, QUEUE_ELEMENT_POOL_SIZE)  /* see common
 
 static void lock_pool(void);
 static void unlock_pool(void);
-static OS_ERR_TYPE add_data(queue_impl_t *queue, void *data, bool head);           // Append data to the head or tail of the queue
+static OS_ERR_TYPE add_data(queue_impl_t *queue, void *data, uint8_t prio,
+			    bool head);           // Append data to the head or tail of a band of the queue
 static OS_ERR_TYPE remove_data(queue_impl_t *queue, void **data);                 // Remove data to the queue
 
 
@@ -151,8 +168,14 @@ T_QUEUE queue_create(uint32_t max_size)
 		unlock_pool();
 
 		if (q != NULL) {
-			list_init(&q->_list); // replace the following commented code
+			int i;
+			for (i = 0; i < QUEUE_PRIO_COUNT; i++)
+				list_init(&q->_list[i]);
+			q->prio_map = 0;
 			q->current_size = 0;
+#ifdef CONFIG_QUEUE_STATS
+			memset(&q->stats, 0, sizeof(q->stats));
+#endif
 			q->max_size = max_size;
 			q->sema = semaphore_create(0);
 		} else {
@@ -244,6 +267,29 @@ void queue_get_message(T_QUEUE queue, T_QUEUE_MESSAGE *message, int timeout,
 }
 
 
+static void send_message(T_QUEUE queue, T_QUEUE_MESSAGE message, uint8_t prio,
+			 bool head, OS_ERR_TYPE *err)
+{
+	OS_ERR_TYPE _err;
+	queue_impl_t *q = (queue_impl_t *)queue;
+
+	/* check input parameters */
+	if (queue_used(q) && q->sema != NULL) {
+		uint32_t it_mask = irq_lock();
+		_err = add_data(q, message, prio, head);
+		irq_unlock(it_mask);
+
+		if (_err == E_OS_OK) {
+			semaphore_give(q->sema, &_err); // signal new message in the queue to the listener.
+			error_management(err, E_OS_OK);
+		} else {
+			error_management(err, _err);
+		}
+	} else { /* param invalid */
+		error_management(err, E_OS_ERR);
+	}
+}
+
 /**
  * Send a message on a queue.
  *
@@ -266,25 +312,35 @@ void queue_get_message(T_QUEUE queue, T_QUEUE_MESSAGE *message, int timeout,
 void queue_send_message(T_QUEUE queue, T_QUEUE_MESSAGE message,
 			OS_ERR_TYPE *err)
 {
-	OS_ERR_TYPE _err;
-	queue_impl_t *q = (queue_impl_t *)queue;
-
-	/* check input parameters */
-	if (queue_used(q) && q->sema != NULL) {
-		uint32_t it_mask = irq_lock();
-		_err = add_data(q, message, false);
-		irq_unlock(it_mask);
+	send_message(queue, message, QUEUE_PRIO_DEFAULT, false, err);
+}
 
-		if (_err == E_OS_OK) {
-			semaphore_give(q->sema, &_err); // signal new message in the queue to the listener.
-			error_management(err, E_OS_OK);
-		} else {
-			error_management(err, _err);
-		}
-	} else { /* param invalid */
-		error_management(err, E_OS_ERR);
-	}
-	return;
+/**
+ * Send a message on a queue with a priority.
+ *
+ *     Send / queue a message after the messages of the same or higher
+ *     priority.
+ *     This service may panic if err parameter is NULL and:
+ *      -# queue parameter is invalid, or
+ *      -# the queue is already full, or
+ *
+ *     Authorized execution levels:  task, fiber, ISR.
+ *
+ * @param queue: handler on the queue (value returned by queue_create).
+ *
+ * @param message (in): pointer to the message to send.
+ *
+ * @param prio: priority of the message, saturated to QUEUE_PRIO_COUNT - 1.
+ *
+ * @param err (out): execution status:
+ *          -# E_OS_OK : a message was read
+ *          -# E_OS_ERR_OVERFLOW: the queue is full (message was not posted)
+ *          -# E_OS_ERR: invalid parameter
+ */
+void queue_send_message_prio(T_QUEUE queue, T_QUEUE_MESSAGE message,
+			     uint8_t prio, OS_ERR_TYPE *err)
+{
+	send_message(queue, message, prio, false, err);
 }
 
 /**
@@ -309,27 +365,35 @@ void queue_send_message(T_QUEUE queue, T_QUEUE_MESSAGE message,
 void queue_send_message_head(T_QUEUE queue, T_QUEUE_MESSAGE message,
 			     OS_ERR_TYPE *err)
 {
-	OS_ERR_TYPE _err;
-	queue_impl_t *q = (queue_impl_t *)queue;
+	send_message(queue, message, QUEUE_PRIO_COUNT - 1, true, err);
+}
 
-	/* check input parameters */
-	if (queue_used(q) && q->sema != NULL) {
-		uint32_t it_mask = irq_lock();
-		_err = add_data(q, message, true);
-		irq_unlock(it_mask);
+#ifdef CONFIG_QUEUE_STATS
+/**
+ * Get the statistics of a queue.
+ *
+ *     Authorized execution levels:  task, fiber, ISR.
+ *
+ * @param queue: handler on the queue (value returned by queue_create).
+ *
+ * @param stats (out): statistics since the queue creation or the last reset.
+ *
+ * @param reset: reset the high watermark and the latency counters.
+ */
+void queue_get_stats(T_QUEUE queue, struct queue_stats *stats, bool reset)
+{
+	queue_impl_t *q = (queue_impl_t *)queue;
+	uint32_t it_mask = irq_lock();
 
-		if (_err == E_OS_OK) {
-			semaphore_give(q->sema, &_err); // signal new message in the queue to the listener.
-			error_management(err, E_OS_OK);
-		} else {
-			error_management(err, _err);
-		}
-	} else { /* param invalid */
-		error_management(err, E_OS_ERR);
+	*stats = q->stats;
+	stats->depth = q->current_size;
+	if (reset) {
+		memset(&q->stats, 0, sizeof(q->stats));
+		q->stats.high_watermark = q->current_size;
 	}
-	return;
+	irq_unlock(it_mask);
 }
-
+#endif
 
 static void lock_pool(void)
 {
@@ -352,20 +416,33 @@ static void unlock_pool(void)
 }
 
 
-static OS_ERR_TYPE add_data(queue_impl_t *list, void *data, bool head)
+static OS_ERR_TYPE add_data(queue_impl_t *list, void *data, uint8_t prio,
+			    bool head)
 {
 	OS_ERR_TYPE err = E_OS_ERR_OVERFLOW;
 
+	if (prio >= QUEUE_PRIO_COUNT)
+		prio = QUEUE_PRIO_COUNT - 1;
+
 	/* if linked-list not full */
 	if (list->current_size < list->max_size) {
 		list_element *element = element_alloc();
 		if (element) {
 			element->data = data;
+#ifdef CONFIG_QUEUE_STATS
+			element->timestamp = get_uptime_32k();
+#endif
 			if (head)
-				list_add_head(&(list->_list), (list_t *)element);
+				list_add_head(&(list->_list[prio]),
+					      (list_t *)element);
 			else
-				list_add(&(list->_list), (list_t *)element);
+				list_add(&(list->_list[prio]), (list_t *)element);
+			list->prio_map |= 1 << prio;
 			list->current_size++;
+#ifdef CONFIG_QUEUE_STATS
+			if (list->current_size > list->stats.high_watermark)
+				list->stats.high_watermark = list->current_size;
+#endif
 			err = E_OS_OK;
 		} else {
 			panic(E_OS_ERR_NO_MEMORY); /* Panic if no memory available */
@@ -378,14 +455,24 @@ static OS_ERR_TYPE add_data(queue_impl_t *list, void *data, bool head)
 
 static OS_ERR_TYPE remove_data(queue_impl_t *list, void **data)
 {
-	list_element *element = (list_element *)list_get(&(list->_list));
-
-	if (element == NULL) {
+	if (list->prio_map == 0)
 		return E_OS_ERR_EMPTY;
-	} else {
-		*data = element->data;
-		element_free(element);
-		list->current_size--;
-	}
+
+	/* Highest non empty band */
+	int prio = 31 - __builtin_clz(list->prio_map);
+	list_element *element = (list_element *)list_get(&(list->_list[prio]));
+
+	if (list_empty(&(list->_list[prio])))
+		list->prio_map &= ~(1 << prio);
+	*data = element->data;
+#ifdef CONFIG_QUEUE_STATS
+	uint32_t latency = get_uptime_32k() - element->timestamp;
+	list->stats.count[prio]++;
+	list->stats.total_latency[prio] += latency;
+	if (latency > list->stats.max_latency[prio])
+		list->stats.max_latency[prio] = latency;
+#endif
+	element_free(element);
+	list->current_size--;
 	return E_OS_OK;
 }
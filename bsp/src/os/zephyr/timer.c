@@ -37,6 +37,7 @@
 #include "infra/panic.h"
 #include "common.h"
 #include "infra/time.h"
+#include "util/timer_wheel.h"
 
 /*type for timer status */
 typedef enum {
@@ -48,17 +49,15 @@ typedef enum {
 typedef struct {
 	T_ENTRY_POINT callback; /* function to call on timer expiration -- a NULL value means the timer is not running */
 	void *data;           /* data to provide to the callback */
-	uint32_t expiration;    /* tick when timer is due to expire */
 	uint32_t delay;         /* timer "timeout" in us -- used for repeating timers */
 	uint8_t repeat;      /* specifies if timer shall be automatically restarted upon expiration */
 	uint8_t status;      /* describe the timer state */
 } T_TIMER_DESC;
 
-/** Chained list of timers */
+/** Timer element of the timer wheel */
 typedef struct _timer_list {
+	struct timer_wheel_node node; /* must be first: holds the expiration date */
 	T_TIMER_DESC desc;
-	struct _timer_list *prev;
-	struct _timer_list *next;
 }T_TIMER_LIST_ELT;
 
 
@@ -118,14 +117,18 @@ void timer_task_port(void)
 /** Pool of timers */
 DECLARE_BLK_ALLOC(g_TimerPool, T_TIMER_LIST_ELT, TIMER_POOL_SIZE) /* see common.h */
 
-/** Head of the chained list that sorts active timers according to their expiration date */
-T_TIMER_LIST_ELT * g_CurrentTimerHead;
+/** Timer wheel that sorts active timers according to their expiration date */
+static struct timer_wheel g_TimerWheel;
+
+/** Expiration date timer_task is waiting for, valid if g_TimerTaskArmed */
+static uint32_t g_NextExpiration;
+static bool g_TimerTaskArmed;
 
 /**********************************************************
 ************** Forward declarations **********************
 **********************************************************/
 static void signal_timer_task(void);
-static bool is_after_expiration(uint32_t tick, T_TIMER_DESC *tmrDesc);
+static bool is_next_to_expire(T_TIMER_LIST_ELT *timer);
 static void add_timer(T_TIMER_LIST_ELT *newTimer);
 static void remove_timer(T_TIMER_LIST_ELT *timerToRemove);
 static void execute_callback(T_TIMER_LIST_ELT *expiredTimer);
@@ -168,183 +171,91 @@ static void signal_timer_task(void)
 }
 
 
-#ifdef __DEBUG_OS_ABSTRACTION_TIMER
-/**
- *  Print the list of active timers, from tail (first to expire) to head (last to expire).
- */
-static void display_list(void)
-{
-	T_TIMER_LIST_ELT *tbv;
-
-	tbv = g_CurrentTimerHead;
-	if (NULL == tbv) {
-		_log(" list is empty");
-	} else {
-		_log(" Head = 0x%x", (uint32_t)tbv);
-		while (NULL != tbv) {
-			_log(" -> 0x%x", (uint32_t)tbv->next);
-			tbv = tbv->next;
-		}
-	}
-}
-#endif
-
 /**
- * Returns whether the provided tick
- *     is before or after the expiration
- *     of a timer.
+ * Returns whether a timer expires before the date
+ *     timer_task is currently waiting for.
  *
- * @param tick date to compare
- * @param tmrDesc timer descriptor
+ * @param timer timer to compare, must be in the timer wheel
  *
- * @return true if tick parameter represents
- *     a date after the expiration of the
- *     timer
- *     or false if the timer descriptor is null
- *     or if tick represents a date before the
- *     expiration of the timer
+ * @return true if timer_task shall be unblocked to
+ *     assess the change
  *
+ * WARNING: must be called with IRQs locked
  */
-static bool is_after_expiration(uint32_t tick, T_TIMER_DESC *tmrDesc)
+static bool is_next_to_expire(T_TIMER_LIST_ELT *timer)
 {
-	if (NULL != tmrDesc) {
-		/* timer will expire before the tick rolls over */
-		return tick >= tmrDesc->expiration;
-	}
-	return false;
+	return !g_TimerTaskArmed ||
+	       ((int32_t)(timer->node.expiration - g_NextExpiration) < 0);
 }
 
 
 /**
- * Insert a timer in the list of active timer,
+ * Insert a timer in the timer wheel,
  *    according to its expiration date.
  *
  * @param newTimer pointer on the timer to insert
  *
  * WARNING: newTimer MUST NOT be null (rem: static function )
+ * WARNING: must be called with IRQs locked
  *
  */
 static void add_timer(T_TIMER_LIST_ELT *newTimer)
 {
-	T_TIMER_LIST_ELT *insertionPoint;
-	T_TIMER_LIST_ELT *listTail;
-	bool found;
-
 #ifdef __DEBUG_OS_ABSTRACTION_TIMER
 	_log(
-		"\nINFO : add_timer - start: adding 0x%x to expire at %d (now = %d - delay = %d - ticktime = %d)",
-		(uint32_t)newTimer, newTimer->desc.expiration,
+		"\nINFO : add_timer: adding 0x%x to expire at %d (now = %d - delay = %d - ticktime = %d)",
+		(uint32_t)newTimer, newTimer->node.expiration,
 		get_uptime_ms(), newTimer->desc.delay, sys_clock_us_per_tick);
-	display_list();
 #endif
-
-
-	if (NULL == g_CurrentTimerHead) {
-		/* there is no active timer, make newTimer the head timer */
-		g_CurrentTimerHead = newTimer;
-		newTimer->prev = NULL;
-		newTimer->next = NULL;
-	} else {
-		/* find the next timer to expire after newTimer->desc.expiration */
-		insertionPoint = g_CurrentTimerHead;
-		listTail = g_CurrentTimerHead;
-		found = false;
-		while ((NULL != insertionPoint) && (false == found)) {
-			if (!is_after_expiration(newTimer->desc.expiration,
-						 &(insertionPoint->desc))) { /* newTimer is due to expire before insertionPoint */
-				if (g_CurrentTimerHead == insertionPoint) { /*  insert newTimer before the head timer  */
-					g_CurrentTimerHead->prev = newTimer;
-					newTimer->prev = NULL;
-					newTimer->next = g_CurrentTimerHead;
-					g_CurrentTimerHead = newTimer;
-				} else { /* insert newTimer between insertionPoint and insertionPoint->prev */
-					newTimer->prev = insertionPoint->prev;
-					newTimer->next = insertionPoint;
-					insertionPoint->prev = newTimer;
-					newTimer->prev->next = newTimer;
-				}
-				/* done */
-				found = true;
-			} else { /* newTimer is due to expire after insertionPoint, continue searching */
-				listTail = insertionPoint; /* update list head marker = last non null insertionPoint */
-				/* move downward */
-				insertionPoint = insertionPoint->next;
-			}
-		}
-
-		if ((false == found) && (NULL != listTail)) {
-			/* newTimer is due to expire after all others have expired */
-			listTail->next = newTimer;
-			newTimer->prev = listTail;
-		}
-	}
-
+	timer_wheel_add(&g_TimerWheel, &newTimer->node);
 	newTimer->desc.status = E_TIMER_RUNNING;
-
-#ifdef __DEBUG_OS_ABSTRACTION_TIMER
-	_log("\nINFO : add_timer - end "); display_list();
-	display_list();
-#endif
 }
 
 /**
- * Remove a timer from the list of active timers.
+ * Remove a timer from the timer wheel.
  *
  * @param timerToRemove pointer on the timer to remove
  *
  * WARNING: timerToRemove MUST NOT be null (rem: static function )
+ * WARNING: must be called with IRQs locked
  *
  */
 static void remove_timer(T_TIMER_LIST_ELT *timerToRemove)
 {
-	T_TIMER_LIST_ELT *removePoint;
-
 #ifdef __DEBUG_OS_ABSTRACTION_TIMER
 	_log(
-		"\nINFO : remove_timer - start: removing 0x%x to expire at %d (now = %d)",
-		(uint32_t)timerToRemove, timerToRemove->desc.expiration,
+		"\nINFO : remove_timer: removing 0x%x to expire at %d (now = %d)",
+		(uint32_t)timerToRemove, timerToRemove->node.expiration,
 		get_uptime_ms());
-	display_list();
 #endif
-
-	if (NULL != g_CurrentTimerHead) {
-		removePoint = g_CurrentTimerHead;
-		while (NULL != removePoint) {
-			if (timerToRemove == removePoint) {
-				if (NULL != timerToRemove->next) {
-					timerToRemove->next->prev =
-						timerToRemove->prev;
-				}
-				if (NULL != timerToRemove->prev) {
-					timerToRemove->prev->next =
-						timerToRemove->next;
-				}
-			}
-			removePoint = removePoint->next;
-		}
-
-		if (timerToRemove == g_CurrentTimerHead) {
-			g_CurrentTimerHead = g_CurrentTimerHead->next;
-			if (NULL != g_CurrentTimerHead) {
-				g_CurrentTimerHead->prev = NULL;
-			}
-		}
-	} else {
-#ifdef __DEBUG_OS_ABSTRACTION_TIMER
-		_log("\nERROR : remove_timer : list of active timer is empty ");
-#endif
-		panic(E_OS_ERR);
-	}
-
-	/* clean-up links */
-	timerToRemove->prev = NULL;
-	timerToRemove->next = NULL;
+	timer_wheel_remove(&g_TimerWheel, &timerToRemove->node);
 	timerToRemove->desc.status = E_TIMER_READY;
+}
+
+/**
+ * Compute the next expiration date of a repeating timer.
+ *
+ * With CONFIG_OS_TIMER_DRIFT_FREE the timer is re-armed relatively to its
+ * previous expiration date, skipping the periods that were entirely missed,
+ * so that the callback latency does not accumulate.
+ *
+ * @param timer repeating timer that just expired
+ *
+ * @return next expiration date
+ */
+static uint32_t next_expiration(T_TIMER_LIST_ELT *timer)
+{
+	uint32_t now = get_uptime_ms();
 
+#ifdef CONFIG_OS_TIMER_DRIFT_FREE
+	uint32_t next = timer->node.expiration + timer->desc.delay;
 
-#ifdef __DEBUG_OS_ABSTRACTION_TIMER
-	_log("\nINFO : remove_timer - end ");
-	display_list();
+	if ((int32_t)(next - now) <= 0)
+		next += ((now - next) / timer->desc.delay + 1) *
+			timer->desc.delay;
+	return next;
+#else
+	return now + timer->desc.delay;
 #endif
 }
 
@@ -362,7 +273,7 @@ static void execute_callback(T_TIMER_LIST_ELT *expiredTimer)
 	_log(
 		"\nINFO : execute_callback : executing callback of timer 0x%x  (now = %u - expiration = %u)",
 		(uint32_t)expiredTimer,
-		get_uptime_ms(), expiredTimer->desc.expiration);
+		get_uptime_ms(), expiredTimer->node.expiration);
 #endif
 	int flags = irq_lock();
 
@@ -371,9 +282,8 @@ static void execute_callback(T_TIMER_LIST_ELT *expiredTimer)
 		remove_timer(expiredTimer);
 		/* add it again if repeat flag was on */
 		if (expiredTimer->desc.repeat) {
-			expiredTimer->desc.expiration = get_uptime_ms() +
-							expiredTimer->desc.
-							delay;
+			expiredTimer->node.expiration =
+				next_expiration(expiredTimer);
 			add_timer(expiredTimer);
 		}
 	}
@@ -414,18 +324,19 @@ void os_init_timer(void)
 	g_TimerSem = OS_TIMER_SEM;
 #endif
 
-	/* start with empty list of active timers: */
-	g_CurrentTimerHead = NULL;
+	/* start with an empty timer wheel: */
+	timer_wheel_init(&g_TimerWheel, get_uptime_ms());
+	g_TimerTaskArmed = false;
 
 	/* memset ( g_TimerPool_elements, 0 ):  */
 	for (idx = 0; idx < TIMER_POOL_SIZE; idx++) {
 		g_TimerPool_elements[idx].desc.callback = NULL;
 		g_TimerPool_elements[idx].desc.data = NULL;
 		g_TimerPool_elements[idx].desc.delay = 0;
-		g_TimerPool_elements[idx].desc.expiration = 0;
 		g_TimerPool_elements[idx].desc.repeat = false;
-		g_TimerPool_elements[idx].prev = NULL;
-		g_TimerPool_elements[idx].next = NULL;
+		g_TimerPool_elements[idx].node.expiration = 0;
+		g_TimerPool_elements[idx].node.prev = NULL;
+		g_TimerPool_elements[idx].node.next = NULL;
 		/* hopefully, the init function is performed before
 		 *  timer_create and timer_stop can be called,
 		 *  hence there is no need for a critical section
@@ -521,13 +432,15 @@ T_TIMER timer_create(T_ENTRY_POINT callback, void *privData, uint32_t delay,
 				/* insert timer in the list of active timers */
 				if (startup) {
 					int flags;
-					timer->desc.expiration =
+					bool doSignal;
+					timer->node.expiration =
 						get_uptime_ms() +
 						timer->desc.delay;
 					flags = irq_lock();
 					add_timer(timer);
+					doSignal = is_next_to_expire(timer);
 					irq_unlock(flags);
-					if (g_CurrentTimerHead == timer) {
+					if (doSignal) {
 						/* new timer is the next to expire, unblock timer_task to assess the change */
 						signal_timer_task();
 					}
@@ -536,7 +449,7 @@ T_TIMER timer_create(T_ENTRY_POINT callback, void *privData, uint32_t delay,
 #ifdef __DEBUG_OS_ABSTRACTION_TIMER
 				_log(
 					"\nINFO : timer_create : new timer will expire at %u (now = %u ) - addr = 0x%x",
-					timer->desc.expiration,
+					timer->node.expiration,
 					get_uptime_ms(), (uint32)timer);
 #endif
 				error_management(err, E_OS_OK);
@@ -577,19 +490,22 @@ void timer_start(T_TIMER tmr, uint32_t delay, OS_ERR_TYPE *err)
 #ifdef __DEBUG_OS_ABSTRACTION_TIMER
 				_log("\nINFO : timer_start : starting  timer ");
 #endif
+				bool doSignal;
 				/* Update expiration time */
 				timer->desc.delay = delay;
-				timer->desc.expiration = get_uptime_ms() +
+				timer->node.expiration = get_uptime_ms() +
 							 timer->desc.delay;
 				/* add the timer */
 				add_timer(timer);
+				doSignal = is_next_to_expire(timer);
 
 				irq_unlock(flags);
 				/* new timer is the next to expire, unblock timer_task to assess the change */
-				if (g_CurrentTimerHead == timer) {
+				if (doSignal) {
 					signal_timer_task();
 				}
 			} else {
+				irq_unlock(flags);
 				/* timer is not valid */
 				localErr = E_OS_ERR;
 			}
@@ -633,7 +549,8 @@ void timer_stop(T_TIMER tmr)
 #endif
 			/* remove the timer */
 
-			if (g_CurrentTimerHead == timer) {
+			if (g_TimerTaskArmed &&
+			    (timer->node.expiration == g_NextExpiration)) {
 				doSignal = true;
 			}
 
@@ -713,6 +630,9 @@ void timer_task(int dummy1, int dummy2)
 {
 	int32_t timeout = UINT32_MAX;
 	uint32_t now;
+	uint32_t next;
+	struct timer_wheel_node *expired;
+	int flags;
 
 	UNUSED(dummy1);
 	UNUSED(dummy2);
@@ -726,31 +646,41 @@ void timer_task(int dummy1, int dummy2)
 #else
 		nano_sem_take(&g_TimerSem, CONVERT_MS_TO_TICKS(timeout));
 #endif
-		now = get_uptime_ms();
 		/* task is unblocked: check for expired timers */
-		while (g_CurrentTimerHead &&
-		       is_after_expiration(now, &(g_CurrentTimerHead->desc))) {
-			execute_callback(g_CurrentTimerHead);
+		while (1) {
 			now = get_uptime_ms();
+			flags = irq_lock();
+			expired = timer_wheel_get_expired(&g_TimerWheel, now);
+			irq_unlock(flags);
+			if (NULL == expired)
+				break;
+			execute_callback((T_TIMER_LIST_ELT *)expired);
 		}
+
 		/* Compute timeout until the expiration of the next timer */
-		if (g_CurrentTimerHead != NULL) {
+		flags = irq_lock();
+		g_TimerTaskArmed = timer_wheel_next_expiration(&g_TimerWheel,
+							       &next);
+		if (g_TimerTaskArmed) {
 			/* In micro kernel context, timeout = 0 or timeout < 0 works.
 			 * In nano kernel context timeout must be a positive value.
+			 * A timer started since the wheel was checked may already
+			 * be due: do not wait in that case.
 			 */
-			timeout = g_CurrentTimerHead->desc.expiration - now;
-			if (timeout < 0) panic(E_OS_ERR_OVERFLOW);
+			g_NextExpiration = next;
+			timeout = next - now;
+			if (timeout < 0)
+				timeout = 0;
 		} else {
 			timeout = UINT32_MAX;
 		}
+		irq_unlock(flags);
 
 #ifdef __DEBUG_OS_ABSTRACTION_TIMER
-		if (NULL != g_CurrentTimerHead)
+		if (g_TimerTaskArmed)
 			_log(
 				"\nINFO : timer_task : now = %u, next timer expires at %u, timeout = %u",
-				get_uptime_ms(),
-				g_CurrentTimerHead->desc.expiration,
-				timeout);
+				get_uptime_ms(), next, timeout);
 		else
 			_log(
 				"\nINFO : timer_task : now = %u, no next timer, timeout = OS_WAIT_FOREVER",
@@ -1,5 +1,8 @@
 obj-y += list.o
 obj-$(CONFIG_WORKQUEUE) += workqueue.o
+obj-$(CONFIG_TIMER_WHEEL) += timer_wheel.o
+obj-$(CONFIG_SPSC_RING) += spsc_ring.o
+obj-$(CONFIG_SLAB) += slab.o
 obj-$(CONFIG_CUNIT_TESTS) += cunit_test.o
 obj-$(CONFIG_LOG_CBUFFER) += cbuffer.o
 obj-$(CONFIG_CSTORAGE_FLASH_SPI) += cir_storage_flash_spi.o
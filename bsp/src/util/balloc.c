@@ -54,6 +54,12 @@
 
 #define BITS_PER_U32 (sizeof(uint32_t) * 8)
 
+/** Number of tracker words needed for a pool of count blocks */
+#define TRACK_WORDS(count) (((count) + BITS_PER_U32 - 1) / BITS_PER_U32)
+
+/** Tracker bit of a block: block 0 is the most significant bit of word 0 */
+#define BLOCK_BIT(block) (1U << (BITS_PER_U32 - 1 - ((block) % BITS_PER_U32)))
+
 /** If defined, allow to use a block larger than required when all smaller blocks are already reserved */
 #define MALLOC_ALLOW_OUTCLASS
 
@@ -64,6 +70,8 @@ typedef struct {
 	uint32_t end;           /** end address of the pool */
 	uint16_t count;         /** total number of blocks within the pool */
 	uint16_t size;          /** size of each memory block within the pool */
+	uint16_t words;         /** number of 32-bit words in the tracker */
+	uint16_t hint;          /** lowest tracker word that may hold a free block */
 #ifdef CONFIG_MEMORY_POOLS_BALLOC_STATISTICS
 #ifdef CONFIG_MEMORY_POOLS_BALLOC_TRACK_OWNER
 	uint32_t **owners;
@@ -85,13 +93,12 @@ typedef struct {
 #ifdef CONFIG_MEMORY_POOLS_BALLOC_TRACK_OWNER
 #define DECLARE_MEMORY_POOL(index, size, count)	\
 	uint8_t mblock_ ## index[count][size] __aligned(4);	\
-	uint32_t mblock_alloc_track_ ## index[count / BITS_PER_U32 + 1] = { 0 }; \
+	uint32_t mblock_alloc_track_ ## index[TRACK_WORDS(count)] = { 0 }; \
 	uint32_t *mblock_owners_ ## index[count] = { 0 };
 #else
 #define DECLARE_MEMORY_POOL(index, size, count)	\
 	uint8_t mblock_ ## index[count][size] __aligned(4);	\
-	uint32_t mblock_alloc_track_ ## index[count / BITS_PER_U32 + \
-					      1] = { 0 };
+	uint32_t mblock_alloc_track_ ## index[TRACK_WORDS(count)] = { 0 };
 #endif
 
 #include "memory_pool_list.def"
@@ -108,6 +115,8 @@ T_POOL_DESC mpool[] =
 /* T_POOL_DESC.end */ (uint32_t)mblock_ ## index + count * size, \
 /* T_POOL_DESC.count */ count, \
 /* T_POOL_DESC.size */ size, \
+/* T_POOL_DESC.words */ TRACK_WORDS(count), \
+/* T_POOL_DESC.hint */ 0, \
 /* T_POOL_DESC.owners */ mblock_owners_ ## index, \
 /* T_POOL_DESC.max */ 0, \
 /* T_POOL_DESC.cur */ 0, \
@@ -122,6 +131,8 @@ T_POOL_DESC mpool[] =
 /* T_POOL_DESC.end */ (uint32_t)mblock_ ## index + count * size, \
 /* T_POOL_DESC.count */ count, \
 /* T_POOL_DESC.size */ size, \
+/* T_POOL_DESC.words */ TRACK_WORDS(count), \
+/* T_POOL_DESC.hint */ 0, \
 /* T_POOL_DESC.max */ 0, \
 /* T_POOL_DESC.cur */ 0, \
 /* T_POOL_DESC.sum */ 0, \
@@ -138,7 +149,7 @@ T_POOL_DESC mpool[] =
 /** Allocate the memory blocks and tracking variables for each pool */
 #define DECLARE_MEMORY_POOL(index, size, count)	\
 	uint8_t mblock_ ## index[count][size]; \
-	uint32_t mblock_alloc_track_ ## index[count / BITS_PER_U32 + 1] = { 0 };
+	uint32_t mblock_alloc_track_ ## index[TRACK_WORDS(count)] = { 0 };
 
 #include "memory_pool_list.def"
 
@@ -153,7 +164,9 @@ T_POOL_DESC mpool [] =
 /* T_POOL_DESC.start */ (uint32_t)mblock_ ## index,	\
 /* T_POOL_DESC.end */ (uint32_t)mblock_ ## index + count * size, \
 /* T_POOL_DESC.count */ count, \
-/* T_POOL_DESC.size */ size \
+/* T_POOL_DESC.size */ size, \
+/* T_POOL_DESC.words */ TRACK_WORDS(count), \
+/* T_POOL_DESC.hint */ 0 \
 	},
 
 #include "memory_pool_list.def"
@@ -175,6 +188,12 @@ T_POOL_DESC mpool [] =
  * Return the next free block of a pool and
  *   mark it as reserved/allocated.
  *
+ * The tracker is scanned a word at a time starting from the pool hint,
+ * which always points at or before the first word holding a free block.
+ * Within a word the first free block is found with a count leading zeros
+ * on the inverted word, so the time spent with IRQs locked no longer
+ * depends on the pool occupancy.
+ *
  * @param pool index of the pool in mpool
  *
  * @return allocated buffer or NULL if none is
@@ -182,32 +201,41 @@ T_POOL_DESC mpool [] =
  */
 static void *memblock_alloc(uint32_t pool)
 {
+	T_POOL_DESC *desc = &mpool[pool];
+	uint32_t free_bits;
+	uint16_t word;
 	uint16_t block;
 	uint32_t flags = irq_lock();
 
-	for (block = 0; block < mpool[pool].count; block++) {
-		if (((mpool[pool].track)[block / BITS_PER_U32] & 1 <<
-		     (BITS_PER_U32 - 1 - (block % BITS_PER_U32))) == 0) {
-			(mpool[pool].track)[block / BITS_PER_U32] =
-				(mpool[pool].track)[block / BITS_PER_U32] |
-				(1 << (BITS_PER_U32 - 1 - (block % BITS_PER_U32)));
+	for (word = desc->hint; word < desc->words; word++) {
+		free_bits = ~(desc->track[word]);
+		if (free_bits == 0)
+			continue;
+
+		block = word * BITS_PER_U32 + __builtin_clz(free_bits);
+		if (block >= desc->count)
+			/* Only the unused tail of the last word is clear */
+			break;
+
+		desc->track[word] |= BLOCK_BIT(block);
+		desc->hint = word;
 #ifdef CONFIG_MEMORY_POOLS_BALLOC_STATISTICS
-			mpool[pool].cur = mpool[pool].cur + 1;
+		desc->cur = desc->cur + 1;
 #ifdef CONFIG_MEMORY_POOLS_BALLOC_TRACK_OWNER
-			/* get return address */
-			uint32_t ret_a = (uint32_t)__builtin_return_address(0);
-			mpool[pool].owners[block] =
-				(uint32_t *)(((ret_a & 0xFFFF0U) >> 4) |
-					     ((get_uptime_ms() & 0xFFFF0) << 12));
+		/* get return address */
+		uint32_t ret_a = (uint32_t)__builtin_return_address(0);
+		desc->owners[block] =
+			(uint32_t *)(((ret_a & 0xFFFF0U) >> 4) |
+				     ((get_uptime_ms() & 0xFFFF0) << 12));
 #endif
-			if (mpool[pool].cur > mpool[pool].max)
-				mpool[pool].max = mpool[pool].cur;
+		if (desc->cur > desc->max)
+			desc->max = desc->cur;
 #endif
-			irq_unlock(flags);
-			return (void *)(mpool[pool].start +
-					mpool[pool].size * block);
-		}
+		irq_unlock(flags);
+		return (void *)(desc->start + desc->size * block);
 	}
+	/* Pool is full: the next free will move the hint back */
+	desc->hint = desc->words;
 	irq_unlock(flags);
 	return NULL;
 }
@@ -225,23 +253,27 @@ static void *memblock_alloc(uint32_t pool)
  */
 static void memblock_free(uint32_t pool, void *ptr)
 {
+	T_POOL_DESC *desc = &mpool[pool];
 	uint16_t block;
+	uint16_t word;
 	uint32_t flags;
 
-	block = ((uint32_t)ptr - mpool[pool].start) / mpool[pool].size;
-	if (block < mpool[pool].count) {
+	block = ((uint32_t)ptr - desc->start) / desc->size;
+	if (block < desc->count) {
+		word = block / BITS_PER_U32;
 		flags = irq_lock();
-		(mpool[pool].track)[block / BITS_PER_U32] &=
-			~(1 << (BITS_PER_U32 - 1 - (block % BITS_PER_U32)));
-		irq_unlock(flags);
+		desc->track[word] &= ~BLOCK_BIT(block);
+		if (word < desc->hint)
+			desc->hint = word;
 #ifdef CONFIG_MEMORY_POOLS_BALLOC_STATISTICS
-		mpool[pool].cur = mpool[pool].cur - 1;
+		desc->cur = desc->cur - 1;
 #endif
+		irq_unlock(flags);
 	} else {
 		pr_debug(
 			LOG_MODULE_UTIL,
 			"ERR: memblock_free: ptr 0x%X is not within pool %d [0x%X , 0x%X]",
-			ptr, pool, mpool[pool].start, mpool[pool].end);
+			ptr, pool, desc->start, desc->end);
 	}
 }
 
@@ -266,7 +298,7 @@ static bool memblock_used(uint32_t pool, void *ptr)
 	block = ((uint32_t)ptr - mpool[pool].start) / mpool[pool].size;
 	if (block < mpool[pool].count) {
 		if (((mpool[pool].track)[block / BITS_PER_U32] &
-		     (1 << (BITS_PER_U32 - 1 - (block % BITS_PER_U32)))) != 0)
+		     BLOCK_BIT(block)) != 0)
 			return true;
 	}
 	return false;
@@ -319,9 +351,8 @@ static void print_pool(int method, void *ctx)
 		str_count = 0;
 
 		for (block = 0; block < mpool[pool].count; block++) {
-			if (((mpool[pool].track)[block / BITS_PER_U32] & 1 <<
-			     (BITS_PER_U32 - 1 -
-			      (block % BITS_PER_U32)))) {
+			if ((mpool[pool].track)[block / BITS_PER_U32] &
+			    BLOCK_BIT(block)) {
 				if (str_count == 0) {
 					cur = tmp;
 					PRINT_POOL(method, " owners:", ctx);
@@ -526,6 +557,59 @@ OS_ERR_TYPE bfree(void *buffer)
 	return err;
 }
 
+/**
+ * Frees several blocks of memory.
+ *
+ * Authorized execution levels:  task, fiber, ISR
+ *
+ * Blocks returned together usually come from the same pool: the pool of
+ * the previous block is tried first.
+ *
+ * @param buffers pointers returned by malloc
+ *
+ * @param count number of pointers in buffers
+ *
+ * @return execution status:
+ *    E_OS_OK : all blocks were successfully freed
+ *    E_OS_ERR : at least one pointer did not match
+ *        any reserved block
+ */
+OS_ERR_TYPE bfree_bulk(void **buffers, int count)
+{
+	OS_ERR_TYPE err = E_OS_OK;
+	uint8_t poolIdx = 0;
+	unsigned int imask;
+	uint32_t buffer;
+	int i;
+
+	imask = irq_lock();
+	for (i = 0; i < count; i++) {
+		buffer = (uint32_t)buffers[i];
+		if (buffer < mpool[poolIdx].start ||
+		    buffer >= mpool[poolIdx].end) {
+			for (poolIdx = 0; poolIdx < NB_MEMORY_POOLS; poolIdx++)
+				if (buffer >= mpool[poolIdx].start &&
+				    buffer < mpool[poolIdx].end)
+					break;
+			if (poolIdx == NB_MEMORY_POOLS) {
+				poolIdx = 0;
+				err = E_OS_ERR;
+				continue;
+			}
+		}
+		if (memblock_used(poolIdx, buffers[i])) {
+			memblock_free(poolIdx, buffers[i]);
+		} else {
+			pr_debug(LOG_MODULE_UTIL,
+				 "ERR: memory_free: buffer %p is already free\n",
+				 buffers[i]);
+			err = E_OS_ERR;
+		}
+	}
+	irq_unlock(imask);
+	return err;
+}
+
 
 #ifdef CONFIG_DBG_POOL_TCMD
 
@@ -39,6 +39,12 @@
 #include "cir_storage_backend.h"
 #include "util/cir_storage_flash_spi.h"
 #include "drivers/serial_bus_access.h"
+#ifdef CONFIG_CSTORAGE_FLASH_SPI_WRITE_BACK
+#include "util/workqueue.h"
+
+/* Write-back buffer size, the SPI flash page program size */
+#define SPI_FLASH_WB_SIZE 256
+#endif
 
 static int32_t spi_flash_0_read(cir_storage_flash_t *storage, uint32_t address,
 				uint32_t data_size,
@@ -51,6 +57,10 @@ static int32_t spi_flash_0_erase(cir_storage_flash_t *	storage,
 				 uint32_t		nb_blocks_to_erase);
 static void spi_flash_0_lock(cir_storage_flash_t *storage);
 static void spi_flash_0_unlock(cir_storage_flash_t *storage);
+#ifdef CONFIG_CSTORAGE_FLASH_SPI_WRITE_BACK
+static void spi_flash_0_dirty(cir_storage_flash_t *storage);
+static void spi_flash_0_sync_timeout(void *data);
+#endif
 
 /**
  * SPI Circular storage information
@@ -58,6 +68,10 @@ static void spi_flash_0_unlock(cir_storage_flash_t *storage);
 typedef struct _cir_storage_flash_spi_t {
 	cir_storage_flash_t storage;
 	T_MUTEX mutex /*!< Mutex to be used to lock/unlock */;
+#ifdef CONFIG_CSTORAGE_FLASH_SPI_WRITE_BACK
+	T_TIMER sync_timer; /*!< Timer flushing the write-back buffer */
+	uint8_t wb_buf[SPI_FLASH_WB_SIZE]; /*!< Write-back buffer */
+#endif
 } cir_storage_flash_spi_t;
 
 cir_storage_t *cir_storage_flash_spi_init(uint32_t	elt_size,
@@ -73,6 +87,15 @@ cir_storage_t *cir_storage_flash_spi_init(uint32_t	elt_size,
 	spi_storage->storage.parent.elt_size = elt_size;
 	spi_storage->storage.block_first = block_first;
 	spi_storage->storage.block_last = block_first + block_count - 1;
+#ifdef CONFIG_CSTORAGE_FLASH_SPI_CHECKPOINT
+	/* The last block holds the checkpoints */
+	spi_storage->storage.block_last--;
+	spi_storage->storage.cp_block = block_first + block_count - 1;
+	spi_storage->storage.cp_interval =
+		CONFIG_CSTORAGE_FLASH_SPI_CHECKPOINT_INTERVAL;
+#else
+	spi_storage->storage.cp_block = CIR_STORAGE_NO_CHECKPOINT;
+#endif
 	spi_storage->storage.block_size = SERIAL_FLASH_BLOCK_SIZE;
 	spi_storage->storage.read = spi_flash_0_read;
 	spi_storage->storage.write = spi_flash_0_write;
@@ -80,6 +103,18 @@ cir_storage_t *cir_storage_flash_spi_init(uint32_t	elt_size,
 	spi_storage->storage.lock = spi_flash_0_lock;
 	spi_storage->storage.unlock = spi_flash_0_unlock;
 	spi_storage->mutex = mutex_create();
+#ifdef CONFIG_CSTORAGE_FLASH_SPI_WRITE_BACK
+	spi_storage->storage.wb_buf = spi_storage->wb_buf;
+	spi_storage->storage.wb_size = SPI_FLASH_WB_SIZE;
+	spi_storage->storage.wb_dirty = spi_flash_0_dirty;
+	spi_storage->sync_timer = timer_create(spi_flash_0_sync_timeout,
+					       spi_storage,
+					       CONFIG_CSTORAGE_FLASH_SPI_SYNC_DELAY,
+					       false, false, NULL);
+#else
+	spi_storage->storage.wb_buf = NULL;
+	spi_storage->storage.wb_dirty = NULL;
+#endif
 	if ((err =
 		     cir_storage_flash_init((cir_storage_flash_t *)spi_storage))
 	    == 0) {
@@ -89,6 +124,9 @@ cir_storage_t *cir_storage_flash_spi_init(uint32_t	elt_size,
 			 "Error initializing flash storage: %d",
 			 err);
 		mutex_delete(spi_storage->mutex);
+#ifdef CONFIG_CSTORAGE_FLASH_SPI_WRITE_BACK
+		timer_delete(spi_storage->sync_timer);
+#endif
 		bfree(spi_storage);
 		return NULL;
 	}
@@ -156,3 +194,30 @@ static void spi_flash_0_unlock(cir_storage_flash_t *storage)
 
 	mutex_unlock(spi_storage->mutex);
 }
+
+#ifdef CONFIG_CSTORAGE_FLASH_SPI_WRITE_BACK
+static void spi_flash_0_sync(void *data)
+{
+	cir_storage_flash_spi_t *spi_storage = data;
+
+	cir_storage_sync(&spi_storage->storage.parent);
+}
+
+/* Timer callbacks can't wait for the storage mutex, defer the sync */
+static void spi_flash_0_sync_timeout(void *data)
+{
+	workqueue_queue_work(spi_flash_0_sync, data);
+}
+
+/* Called with the storage locked when the write-back buffer gets data */
+static void spi_flash_0_dirty(cir_storage_flash_t *storage)
+{
+	cir_storage_flash_spi_t *spi_storage =
+		(cir_storage_flash_spi_t *)storage;
+	OS_ERR_TYPE err;
+
+	/* Fails harmlessly if a sync is already scheduled */
+	timer_start(spi_storage->sync_timer,
+		    CONFIG_CSTORAGE_FLASH_SPI_SYNC_DELAY, &err);
+}
+#endif
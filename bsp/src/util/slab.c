@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <zephyr.h>
+#include "util/slab.h"
+
+#ifdef CONFIG_TCMD
+#include <stdio.h>
+#include "infra/tcmd/handler.h"
+#endif
+
+/* Initialized slabs, for the test command */
+static struct slab *slab_list;
+
+int slab_init(struct slab *slab, const char *name, void *buf,
+	      uint16_t block_size, uint16_t count, uint32_t *map)
+{
+	uint32_t key;
+	uint16_t words = SLAB_MAP_WORDS(count);
+	struct slab *s;
+
+	if (!buf || !map || ((uintptr_t)buf & 3) || !block_size ||
+	    (block_size & 3) || !count || count > SLAB_MAX_BLOCKS)
+		return -1;
+
+	key = irq_lock();
+	slab->name = name;
+	slab->buf = buf;
+	slab->map = map;
+	memset(&slab->stats, 0, sizeof(slab->stats));
+	slab->stats.block_size = block_size;
+	slab->stats.count = count;
+
+	memset(map, 0xff, words * sizeof(uint32_t));
+	if (count % 32)
+		map[words - 1] = (1U << (count % 32)) - 1;
+	slab->summary = words == 32 ? ~0U : (1U << words) - 1;
+
+	for (s = slab_list; s && s != slab; s = s->next)
+		;
+	if (!s) {
+		slab->next = slab_list;
+		slab_list = slab;
+	}
+	irq_unlock(key);
+	return 0;
+}
+
+void *slab_alloc(struct slab *slab)
+{
+	uint32_t key = irq_lock();
+	uint32_t word, bit;
+	void *block = NULL;
+
+	if (slab->summary) {
+		word = __builtin_ctz(slab->summary);
+		bit = __builtin_ctz(slab->map[word]);
+		slab->map[word] &= ~(1U << bit);
+		if (!slab->map[word])
+			slab->summary &= ~(1U << word);
+		block = slab->buf + (word * 32 + bit) * slab->stats.block_size;
+
+		slab->stats.allocs++;
+		if (++slab->stats.used > slab->stats.max_used)
+			slab->stats.max_used = slab->stats.used;
+	} else {
+		slab->stats.fails++;
+	}
+	irq_unlock(key);
+	return block;
+}
+
+bool slab_contains(const struct slab *slab, const void *ptr)
+{
+	return (const uint8_t *)ptr >= slab->buf &&
+	       (const uint8_t *)ptr < slab->buf +
+	       slab->stats.block_size * slab->stats.count;
+}
+
+int slab_free(struct slab *slab, void *block)
+{
+	uint32_t offset = (uint8_t *)block - slab->buf;
+	uint32_t index, word, bit;
+	uint32_t key;
+	int ret = -1;
+
+	if (!slab_contains(slab, block) || offset % slab->stats.block_size)
+		return -1;
+	index = offset / slab->stats.block_size;
+	word = index / 32;
+	bit = 1U << (index % 32);
+
+	key = irq_lock();
+	if (!(slab->map[word] & bit)) {
+		slab->map[word] |= bit;
+		slab->summary |= 1U << word;
+		slab->stats.used--;
+		ret = 0;
+	}
+	irq_unlock(key);
+	return ret;
+}
+
+void slab_get_stats(const struct slab *slab, struct slab_stats *stats)
+{
+	uint32_t key = irq_lock();
+
+	*stats = slab->stats;
+	irq_unlock(key);
+}
+
+struct sample_block *sample_block_alloc(struct slab *slab)
+{
+	struct sample_block *block = slab_alloc(slab);
+
+	if (block) {
+		block->slab = slab;
+		block->len = 0;
+		block->refs = 1;
+	}
+	return block;
+}
+
+struct sample_block *sample_block_get(struct sample_block *block)
+{
+	uint32_t key = irq_lock();
+
+	block->refs++;
+	irq_unlock(key);
+	return block;
+}
+
+void sample_block_put(struct sample_block *block)
+{
+	uint32_t key = irq_lock();
+	uint16_t refs = --block->refs;
+
+	irq_unlock(key);
+	if (!refs)
+		slab_free(block->slab, block);
+}
+
+#ifdef CONFIG_TCMD
+void slab_tcmd(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	struct slab_stats stats;
+	char tmp[80];
+	struct slab *s;
+
+	for (s = slab_list; s; s = s->next) {
+		slab_get_stats(s, &stats);
+		snprintf(tmp, sizeof(tmp),
+			 "%s: %ux%u used:%u max:%u allocs:%u fails:%u",
+			 s->name, stats.count, stats.block_size, stats.used,
+			 stats.max_used, (unsigned int)stats.allocs,
+			 (unsigned int)stats.fails);
+		TCMD_RSP_PROVISIONAL(ctx, tmp);
+	}
+	TCMD_RSP_FINAL(ctx, NULL);
+}
+DECLARE_TEST_COMMAND_ENG(dbg, slab, slab_tcmd);
+#endif
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include "util/spsc_ring.h"
+#include "util/misc.h"
+
+/* Header flag of the record skipping the end of the buffer */
+#define SPSC_RING_PAD           0x80000000
+
+/* Space used by a record of the given length, header included */
+#define RECORD_SPACE(len)       (((len) + SPSC_RING_HDR_SIZE + 3) & ~3)
+
+#define ring_load(p)            __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define ring_store(p, v)        __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+int spsc_ring_init(struct spsc_ring *ring, uint8_t *buf, uint32_t size)
+{
+	if (!IS_POWER_OF_TWO(size) || size < 16 || ((uintptr_t)buf & 3))
+		return -1;
+
+	ring->buf = buf;
+	ring->size = size;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->pad = 0;
+	return 0;
+}
+
+void *spsc_ring_reserve(struct spsc_ring *ring, uint32_t len)
+{
+	uint32_t head = ring->head;
+	uint32_t used = head - ring_load(&ring->tail);
+	uint32_t pos = head & (ring->size - 1);
+	uint32_t need = RECORD_SPACE(len);
+	uint32_t pad = 0;
+
+	/* Records never wrap, skip the end of the buffer if needed */
+	if (need > ring->size - pos)
+		pad = ring->size - pos;
+	if (len > ring->size || pad + need > ring->size - used)
+		return NULL;
+
+	ring->pad = pad;
+	return &ring->buf[(pos + pad) & (ring->size - 1)] + SPSC_RING_HDR_SIZE;
+}
+
+void spsc_ring_commit(struct spsc_ring *ring, uint32_t len)
+{
+	uint32_t head = ring->head;
+	uint32_t pos = head & (ring->size - 1);
+
+	if (ring->pad) {
+		*(uint32_t *)&ring->buf[pos] = SPSC_RING_PAD;
+		head += ring->pad;
+		pos = 0;
+		ring->pad = 0;
+	}
+	*(uint32_t *)&ring->buf[pos] = len;
+
+	/* Publish the record once its contents and header are written */
+	ring_store(&ring->head, head + RECORD_SPACE(len));
+}
+
+int spsc_ring_push(struct spsc_ring *ring, const void *data, uint32_t len)
+{
+	void *p = spsc_ring_reserve(ring, len);
+
+	if (p == NULL)
+		return -1;
+	memcpy(p, data, len);
+	spsc_ring_commit(ring, len);
+	return 0;
+}
+
+void *spsc_ring_peek(struct spsc_ring *ring, uint32_t *len)
+{
+	uint32_t tail = ring->tail;
+	uint32_t head = ring_load(&ring->head);
+	uint32_t pos = tail & (ring->size - 1);
+	uint32_t hdr;
+
+	if (tail == head)
+		return NULL;
+
+	hdr = *(uint32_t *)&ring->buf[pos];
+	if (hdr & SPSC_RING_PAD) {
+		/* A padding record is always followed by a real one */
+		tail += ring->size - pos;
+		ring_store(&ring->tail, tail);
+		pos = 0;
+		hdr = *(uint32_t *)&ring->buf[0];
+	}
+
+	*len = hdr;
+	return &ring->buf[pos] + SPSC_RING_HDR_SIZE;
+}
+
+void spsc_ring_release(struct spsc_ring *ring)
+{
+	uint32_t tail = ring->tail;
+	uint32_t hdr = *(uint32_t *)&ring->buf[tail & (ring->size - 1)];
+
+	/* Free the record once its contents have been consumed */
+	ring_store(&ring->tail, tail + RECORD_SPACE(hdr));
+}
+
+int spsc_ring_pop(struct spsc_ring *ring, void *data, uint32_t size)
+{
+	uint32_t len;
+	void *p = spsc_ring_peek(ring, &len);
+
+	if (p == NULL)
+		return -1;
+	memcpy(data, p, len < size ? len : size);
+	spsc_ring_release(ring);
+	return len;
+}
+
+bool spsc_ring_is_empty(const struct spsc_ring *ring)
+{
+	return ring_load(&ring->head) == ring_load(&ring->tail);
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include "util/timer_wheel.h"
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define LEVEL_SHIFT(level) ((level) * TIMER_WHEEL_LEVEL_BITS)
+
+/**
+ * Find the first non empty slot after the wheel base.
+ *
+ * Timers of a level always expire after all the timers of the lower levels,
+ * so the first non empty slot of the lowest non empty level holds the next
+ * timer to expire.
+ *
+ * @param w     Timer wheel
+ * @param start (out) date at which the slot begins
+ *
+ * @return level of the slot, -1 if the wheel is empty
+ */
+static int find_next_slot(struct timer_wheel *w, uint32_t *start)
+{
+	int level;
+	uint32_t idx;
+	uint32_t rot;
+
+	for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		if (w->pending[level] == 0)
+			continue;
+		/* Rotate the bitmap so that bit 0 is the slot of the base */
+		idx = (w->base >> LEVEL_SHIFT(level)) & SLOT_MASK;
+		rot = w->pending[level];
+		rot = ((rot >> idx) | (rot << (TIMER_WHEEL_SLOTS - idx))) &
+		      ((1 << TIMER_WHEEL_SLOTS) - 1);
+		*start = ((w->base >> LEVEL_SHIFT(level)) + __builtin_ctz(rot))
+			 << LEVEL_SHIFT(level);
+		return level;
+	}
+	return -1;
+}
+
+void timer_wheel_init(struct timer_wheel *w, uint32_t now)
+{
+	int i;
+
+	for (i = 0; i < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS; i++)
+		w->slots[i] = NULL;
+	for (i = 0; i < TIMER_WHEEL_LEVELS; i++)
+		w->pending[i] = 0;
+	w->base = now;
+}
+
+void timer_wheel_add(struct timer_wheel *w, struct timer_wheel_node *node)
+{
+	uint32_t pos = node->expiration;
+	uint32_t diff;
+	int level = 0;
+
+	/* Late timers are put in the current slot */
+	if ((int32_t)(pos - w->base) < 0)
+		pos = w->base;
+
+	/* The level is given by the highest digit differing from the base */
+	diff = pos ^ w->base;
+	if (diff)
+		level = (31 - __builtin_clz(diff)) / TIMER_WHEEL_LEVEL_BITS;
+
+	node->slot = level * TIMER_WHEEL_SLOTS +
+		     ((pos >> LEVEL_SHIFT(level)) & SLOT_MASK);
+	node->prev = NULL;
+	node->next = w->slots[node->slot];
+	if (node->next)
+		node->next->prev = node;
+	w->slots[node->slot] = node;
+	w->pending[level] |= 1 << (node->slot & SLOT_MASK);
+}
+
+void timer_wheel_remove(struct timer_wheel *w, struct timer_wheel_node *node)
+{
+	if (node->prev)
+		node->prev->next = node->next;
+	else
+		w->slots[node->slot] = node->next;
+	if (node->next)
+		node->next->prev = node->prev;
+
+	if (w->slots[node->slot] == NULL)
+		w->pending[node->slot / TIMER_WHEEL_SLOTS] &=
+			~(1 << (node->slot & SLOT_MASK));
+
+	node->prev = NULL;
+	node->next = NULL;
+}
+
+struct timer_wheel_node *timer_wheel_get_expired(struct timer_wheel *w,
+						 uint32_t now)
+{
+	struct timer_wheel_node *node;
+	struct timer_wheel_node *next;
+	uint32_t start;
+	int level;
+	int slot;
+
+	while (1) {
+		level = find_next_slot(w, &start);
+		if ((level < 0) || ((int32_t)(start - now) > 0)) {
+			/* Nothing is due, no timer is in a slot before now */
+			if ((int32_t)(now - w->base) > 0)
+				w->base = now;
+			return NULL;
+		}
+
+		w->base = start;
+		slot = level * TIMER_WHEEL_SLOTS +
+		       ((start >> LEVEL_SHIFT(level)) & SLOT_MASK);
+		if (level == 0)
+			return w->slots[slot];
+
+		/* Cascade the slot timers to the lower levels */
+		node = w->slots[slot];
+		w->slots[slot] = NULL;
+		w->pending[level] &= ~(1 << (slot & SLOT_MASK));
+		while (node) {
+			next = node->next;
+			timer_wheel_add(w, node);
+			node = next;
+		}
+	}
+}
+
+bool timer_wheel_next_expiration(struct timer_wheel *w, uint32_t *expiration)
+{
+	struct timer_wheel_node *node;
+	uint32_t start;
+	int level;
+
+	level = find_next_slot(w, &start);
+	if (level < 0)
+		return false;
+
+	if (level == 0) {
+		*expiration = start;
+		return true;
+	}
+
+	/* Only the timers of this slot can expire first */
+	node = w->slots[level * TIMER_WHEEL_SLOTS +
+			((start >> LEVEL_SHIFT(level)) & SLOT_MASK)];
+	*expiration = node->expiration;
+	for (node = node->next; node; node = node->next)
+		if ((int32_t)(node->expiration - *expiration) < 0)
+			*expiration = node->expiration;
+	if ((int32_t)(*expiration - start) < 0)
+		*expiration = start;
+	return true;
+}
@@ -121,6 +121,28 @@ void properties_storage_test(void)
 	CU_ASSERT("Read Length OK", readlen == 13);
 	CU_ASSERT("Read content correct", strncmp(data, rdata, 13) == 0);
 
+	/* With the background compaction running in between, writes never need
+	 * to compact synchronously */
+	struct properties_storage_stats stats;
+	struct properties_storage_block_stats blocks[3];
+	uint32_t sync_compactions;
+	properties_storage_get_stats(false, &stats, blocks, 0);
+	sync_compactions = stats.sync_compactions;
+	for (int i = 0; i < 3 * 2048 / 13 + 15; ++i) {
+		ret = properties_storage_set(42, data, 13, false);
+		CU_ASSERT("Write OK", ret == PROPERTIES_STORAGE_SUCCESS);
+		while (properties_storage_compact_step()) ;
+	}
+	properties_storage_get_stats(false, &stats, blocks, 3);
+	CU_ASSERT("No synchronous compaction",
+		  stats.sync_compactions == sync_compactions);
+	CU_ASSERT("Live data accounted",
+		  blocks[0].live_bytes + blocks[1].live_bytes +
+		  blocks[2].live_bytes == 2 * (8 + 16));
+	ret = properties_storage_get(66, rdata, sizeof(rdata), &readlen);
+	CU_ASSERT("Read OK", ret == PROPERTIES_STORAGE_SUCCESS);
+	CU_ASSERT("Read content correct", strncmp(data, rdata, 13) == 0);
+
 	properties_storage_format_all();
 
 	uint8_t large_buf[PROPERTIES_STORAGE_MAX_VALUE_LEN + 50];
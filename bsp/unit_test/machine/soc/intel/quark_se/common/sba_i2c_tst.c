@@ -50,6 +50,7 @@
 static void test_sba_single_add(void);
 static void test_sba_multiple_add(void);
 static void test_sba_multiple_add_fiber(void);
+static void test_sba_chain(void);
 
 /*
 ** Callback counters
@@ -383,16 +384,81 @@ static void test_sba_multiple_add_fiber(void)
 }
 
 
+static void test_sba_chain(void)
+{
+	union sba_config config;
+	struct sba_bus_stats stats;
+	DRIVER_API_RC rc;
+
+	init_multiple_sba_requests(&config);
+	sba_get_stats(SBA_I2C_MASTER_1, &stats, true);
+
+	cu_print("\n");
+	cu_print("###################################\n");
+	cu_print("CHAIN AND PRIORITY TEST\n");
+
+	/* Write B, read, write C, read in one session: only the callback of
+	 * the head is called */
+	tx_request[0]->tx_buff = tx_buff[IND_LIB_B];
+	tx_request[0]->chain = trx_request[0];
+	trx_request[0]->tx_buff = &trx_buff;
+	trx_request[0]->rx_buff = rx_buff[0];
+	trx_request[0]->chain = tx_request[1];
+	tx_request[1]->tx_buff = tx_buff[IND_LIB_C];
+	tx_request[1]->chain = trx_request[1];
+	trx_request[1]->tx_buff = &trx_buff;
+	trx_request[1]->rx_buff = rx_buff[1];
+	trx_request[1]->chain = NULL;
+	rc = sba_exec_chain(tx_request[0], SBA_PRIO_NORMAL);
+	CU_ASSERT("sba_exec_chain() return not ok\n", rc == DRV_RC_OK);
+
+	/* Queued while the chain is running: the high priority write of B
+	 * is served before the normal read queued first */
+	trx_request[2]->tx_buff = &trx_buff;
+	trx_request[2]->rx_buff = rx_buff[2];
+	trx_request[2]->chain = NULL;
+	rc = sba_exec_chain(trx_request[2], SBA_PRIO_NORMAL);
+	CU_ASSERT("sba_exec_chain() return not ok\n", rc == DRV_RC_OK);
+	tx_request[2]->tx_buff = tx_buff[IND_LIB_B];
+	tx_request[2]->chain = NULL;
+	rc = sba_exec_chain(tx_request[2], SBA_PRIO_HIGH);
+	CU_ASSERT("sba_exec_chain() return not ok\n", rc == DRV_RC_OK);
+
+	rc = wait_rx_complete(1);
+	CU_ASSERT("Time-out wait rx expire \n", rc == true);
+	CU_ASSERT("Tx callbacks differ\n", i2c_tx_complete == 2);
+	i2c_tx_complete = 0;
+
+	CU_ASSERT("chain first read differs\n", rx_buff[0][0] == LIBRARY_B);
+	CU_ASSERT("chain second read differs\n", rx_buff[1][0] == LIBRARY_C);
+	CU_ASSERT("high priority request not served first\n",
+		  rx_buff[2][0] == LIBRARY_B);
+
+	sba_get_stats(SBA_I2C_MASTER_1, &stats, false);
+	cu_print("sessions %d segments %d bytes %d busy %d max wait %d\n",
+		 stats.sessions, stats.segments, stats.bytes, stats.busy_ticks,
+		 stats.max_wait_ticks);
+	CU_ASSERT("sessions count differs\n", stats.sessions == 3);
+	CU_ASSERT("segments count differs\n", stats.segments == 6);
+	CU_ASSERT("errors on the bus\n", stats.errors == 0);
+	CU_ASSERT("max queued differs\n", stats.max_queued == 2);
+
+	end_multiple_test();
+	cu_print("######################################\n");
+}
+
 void sba_i2c_test(void)
 {
 	cu_print("########################################################\n");
 	cu_print("# Purpose of Serial Bus Access I2C tests :             #\n");
 	cu_print("#            Addition of one request (Rx, Tx, Rx / Tx) #\n");
 	cu_print("#            Addition of several requests              #\n");
+	cu_print("#            Chained requests and priorities           #\n");
 	cu_print("#            Test error cases                          #\n");
 	cu_print("########################################################\n");
 
 	test_sba_single_add();
 	test_sba_multiple_add();
 	test_sba_multiple_add_fiber();
+	test_sba_chain();
 }
@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "infra/log.h"
+#include "infra/time.h"
 #include "machine/soc/intel/quark_se/quark/log_backend_uart.h"
 #include "util/cunit_test.h"
 
@@ -216,3 +217,99 @@ void logger_test(void)
 	log_flush();
 	log_set_backend(log_backend_uart);
 }
+
+#ifdef CONFIG_LOG_CBUFFER_DEFERRED
+
+DEFINE_LOG_MODULE_DEBUG(LOG_MODULE_LOGBENCH, "LOGB")
+
+#define BENCH_BURST     16
+#define BENCH_ROUNDS    64
+
+/* Average cost of one log call, in 32kHz ticks scaled by BENCH_ROUNDS */
+static uint32_t bench_log_calls(bool debug)
+{
+	uint32_t start, total = 0;
+	int i, r;
+
+	for (r = 0; r < BENCH_ROUNDS; r++) {
+		start = get_uptime_32k();
+		for (i = 0; i < BENCH_BURST; i++) {
+			if (debug)
+				pr_debug(LOG_MODULE_LOGBENCH,
+					 "sample %d x=%d y=%d z=%d", i, r, -r,
+					 i * r);
+			else
+				pr_info(LOG_MODULE_LOGBENCH,
+					"sample %d x=%d y=%d z=%d", i, r, -r,
+					i * r);
+		}
+		total += get_uptime_32k() - start;
+		/* Formatting cost of deferred messages is paid here */
+		log_flush();
+	}
+	return total;
+}
+
+static void bench_print(const char *name, uint32_t text, uint32_t deferred)
+{
+	/* 32kHz ticks to ns per call, then ns to CPU cycles */
+	uint32_t text_ns = (uint64_t)text * 30518 / (BENCH_ROUNDS * BENCH_BURST);
+	uint32_t def_ns = (uint64_t)deferred * 30518 /
+			  (BENCH_ROUNDS * BENCH_BURST);
+
+	cu_print("%s: formatted %d ns (%d cycles), deferred %d ns (%d cycles)\n",
+		 name, text_ns, text_ns * CONFIG_CLOCK_SPEED / 1000, def_ns,
+		 def_ns * CONFIG_CLOCK_SPEED / 1000);
+}
+
+void logger_benchmark(void)
+{
+	uint32_t text[2], deferred[2];
+
+	cu_print(
+		"##############################################################\n");
+	cu_print(
+		"# Purpose of the logger benchmark :                          #\n");
+	cu_print(
+		"#     Check that deferred messages are formatted correctly   #\n");
+	cu_print(
+		"#     Compare the per-call cost of formatted and deferred    #\n");
+	cu_print(
+		"#     logging                                                #\n");
+	cu_print(
+		"##############################################################\n");
+
+	log_flush();
+	CU_ASSERT("Log level change failed",
+		  log_set_global_level(LOG_LEVEL_DEBUG) == 0);
+
+	/* A deferred message must read the same as a formatted one */
+	log_set_deferred(true);
+	log_set_backend(testbackend);
+	testbackend_reset();
+	pr_info(LOG_MODULE_LOGTEST, "val %d %u 0x%04x %lld %c%%", -42, 42u,
+		0x2a, -1234567890123LL, 'z');
+	log_flush();
+	CU_ASSERT("Unexpected log header",
+		  testbackend_compare_header(test_header));
+	CU_ASSERT("Unexpected deferred log content",
+		  testbackend_compare_body(
+			  "val -42 42 0x002a -1234567890123 z%"));
+	testbackend_reset();
+
+	/* Only measure the caller side, output goes to a dummy backend */
+	log_set_backend(usedbackend);
+	log_set_deferred(false);
+	text[0] = bench_log_calls(false);
+	text[1] = bench_log_calls(true);
+	log_set_deferred(true);
+	deferred[0] = bench_log_calls(false);
+	deferred[1] = bench_log_calls(true);
+
+	bench_print("pr_info", text[0], deferred[0]);
+	bench_print("pr_debug", text[1], deferred[1]);
+
+	log_flush();
+	log_set_backend(log_backend_uart);
+}
+#endif
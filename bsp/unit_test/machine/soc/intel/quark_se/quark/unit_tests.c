@@ -45,6 +45,9 @@ void run_unit_tests(void)
 #endif
 
 	CU_RUN_TEST(logger_test);
+#ifdef CONFIG_LOG_CBUFFER_DEFERRED
+	CU_RUN_TEST(logger_benchmark);
+#endif
 	CU_RUN_TEST(properties_storage_test);
 
 #if defined(CONFIG_CONSOLE_MANAGER)
@@ -9,6 +9,8 @@ obj-y += test_queue.o
 obj-y += test_sema.o
 obj-y += test_task.o
 obj-y += test_timer.o
+obj-$(CONFIG_TIMER_WHEEL) += test_timer_wheel.o
+obj-$(CONFIG_SPSC_RING) += test_spsc_ring.o
 obj-y += test_counter.o
 obj-y += utility.o
 obj-y += test_interrupt.o
@@ -33,6 +33,7 @@
  */
 
 #include "os/os.h"
+#include "infra/time.h"
 #include "utility.h"
 #include "util/cunit_test.h"
 
@@ -282,3 +283,66 @@ void test_malloc_and_free_outclass(void)
 		CU_ASSERT("free not successful.", err == E_OS_OK);
 	}
 }
+
+#define BENCH_ROUNDS 200
+#define BENCH_BURST  8
+
+/* Measure the balloc/bfree latency of the most populated pool when it is
+ * already 10%, 50% and 90% occupied. All the block search is done with IRQs
+ * locked, so the reported allocation latency also bounds the IRQ masked time.
+ */
+void test_malloc_benchmark(void)
+{
+	static uint8_t *fill[256];
+	uint8_t *burst[BENCH_BURST];
+	static const uint8_t occupancy[] = { 10, 50, 90 };
+	OS_ERR_TYPE err = E_OS_OK;
+	uint32_t pool = 0;
+	uint32_t nb_fill, nb_burst;
+	uint32_t t_alloc, t_free, start, mid;
+	uint32_t i, j, k, r;
+
+	for (i = 1; i < NB_OF_MEMORY_POOL; i++)
+		if (all_pools[i].nb_elem > all_pools[pool].nb_elem)
+			pool = i;
+
+	CU_ASSERT("test not valid if:", all_pools[pool].nb_elem <= DIM(fill));
+
+	for (k = 0; k < DIM(occupancy); k++) {
+		nb_fill = all_pools[pool].nb_elem * occupancy[k] / 100;
+		nb_burst = all_pools[pool].nb_elem - nb_fill;
+		if (nb_burst > BENCH_BURST)
+			nb_burst = BENCH_BURST;
+
+		for (i = 0; i < nb_fill; i++) {
+			fill[i] = balloc(all_pools[pool].size, &err);
+			CU_ASSERT("balloc not successful.", err == E_OS_OK);
+		}
+
+		t_alloc = 0;
+		t_free = 0;
+		for (r = 0; r < BENCH_ROUNDS; r++) {
+			start = get_uptime_32k();
+			for (j = 0; j < nb_burst; j++)
+				burst[j] = balloc(all_pools[pool].size, &err);
+			mid = get_uptime_32k();
+			for (j = 0; j < nb_burst; j++)
+				bfree(burst[j]);
+			t_alloc += mid - start;
+			t_free += get_uptime_32k() - mid;
+		}
+
+		/* 32kHz ticks to ns per operation */
+		cu_print("pool %d bytes %d%% used: balloc %d ns bfree %d ns\n",
+			 all_pools[pool].size, occupancy[k],
+			 (uint32_t)((uint64_t)t_alloc * 30518 /
+				    (BENCH_ROUNDS * nb_burst)),
+			 (uint32_t)((uint64_t)t_free * 30518 /
+				    (BENCH_ROUNDS * nb_burst)));
+
+		for (i = 0; i < nb_fill; i++) {
+			err = bfree(fill[i]);
+			CU_ASSERT("free not successful.", err == E_OS_OK);
+		}
+	}
+}
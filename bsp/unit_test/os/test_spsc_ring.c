@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * SPSC ring tests: check record framing and wrapping in a single context, then
+ * stress the ring with a producer running from a timer callback while the
+ * test task consumes.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "os/os.h"
+#include "infra/time.h"
+#include "util/compiler.h"
+#include "util/spsc_ring.h"
+#include "util/cunit_test.h"
+#include "utility.h"
+
+#define RING_SIZE               256
+#define STRESS_RECORDS          20000
+#define STRESS_BURST            8
+#define STRESS_TIMEOUT_MS       10000
+
+static uint8_t ring_buf[RING_SIZE] __aligned(4);
+static struct spsc_ring ring;
+
+/* Length of the record with the given sequence number */
+static uint32_t record_len(uint32_t seq)
+{
+	return sizeof(seq) + seq * 7 % (SPSC_RING_MAX_RECORD(RING_SIZE) - 3);
+}
+
+static void fill_record(uint8_t *p, uint32_t seq, uint32_t len)
+{
+	uint32_t i;
+
+	memcpy(p, &seq, sizeof(seq));
+	for (i = sizeof(seq); i < len; i++)
+		p[i] = seq + i;
+}
+
+static bool check_record(const uint8_t *p, uint32_t seq, uint32_t len)
+{
+	uint32_t i;
+
+	if (len != record_len(seq) || memcmp(p, &seq, sizeof(seq)))
+		return false;
+	for (i = sizeof(seq); i < len; i++)
+		if (p[i] != (uint8_t)(seq + i))
+			return false;
+	return true;
+}
+
+void test_spsc_ring_framing(void)
+{
+	uint8_t rec[SPSC_RING_MAX_RECORD(RING_SIZE)];
+	uint32_t seq, len, i;
+	uint8_t *p;
+
+	CU_ASSERT("bad size accepted",
+		  spsc_ring_init(&ring, ring_buf, RING_SIZE - 4) == -1);
+	CU_ASSERT("unaligned buffer accepted",
+		  spsc_ring_init(&ring, ring_buf + 1, RING_SIZE / 2) == -1);
+	CU_ASSERT("init failed",
+		  spsc_ring_init(&ring, ring_buf, RING_SIZE) == 0);
+	CU_ASSERT("new ring not empty", spsc_ring_is_empty(&ring));
+	CU_ASSERT("pop on empty ring", spsc_ring_pop(&ring, rec, 4) == -1);
+
+	/* Fill the ring with small records, it must refuse the last one */
+	i = 0;
+	while (spsc_ring_push(&ring, &i, sizeof(i)) == 0)
+		i++;
+	CU_ASSERT("unexpected capacity", i == RING_SIZE / 8);
+	for (seq = 0; seq < i; seq++) {
+		CU_ASSERT("bad record length",
+			  spsc_ring_pop(&ring, &len, sizeof(len)) == 4);
+		CU_ASSERT("bad record", len == seq);
+	}
+	CU_ASSERT("ring not empty", spsc_ring_is_empty(&ring));
+
+	/* Reserve more than needed, commit less, across many wraps */
+	for (seq = 0; seq < 1000; seq++) {
+		p = spsc_ring_reserve(&ring, SPSC_RING_MAX_RECORD(RING_SIZE));
+		CU_ASSERT("reserve failed on empty ring", p != NULL);
+		if (p == NULL)
+			return;
+		CU_ASSERT("misaligned record", ((uintptr_t)p & 3) == 0);
+		fill_record(p, seq, record_len(seq));
+		spsc_ring_commit(&ring, record_len(seq));
+
+		p = spsc_ring_peek(&ring, &len);
+		CU_ASSERT("bad record", p && check_record(p, seq, len));
+		spsc_ring_release(&ring);
+	}
+	CU_ASSERT("ring not empty", spsc_ring_is_empty(&ring));
+
+	/* Records longer than the destination buffer are truncated */
+	fill_record(rec, 0, sizeof(rec));
+	spsc_ring_push(&ring, rec, sizeof(rec));
+	CU_ASSERT("bad truncated length",
+		  spsc_ring_pop(&ring, &len, sizeof(len)) == sizeof(rec));
+	CU_ASSERT("bad truncated record", len == 0);
+	CU_ASSERT("record larger than the ring accepted",
+		  spsc_ring_reserve(&ring, RING_SIZE) == NULL);
+}
+
+static volatile uint32_t produced;
+static volatile uint32_t producer_full;
+
+static void producer_cb(void *priv)
+{
+	int i;
+	uint8_t *p;
+
+	for (i = 0; i < STRESS_BURST && produced < STRESS_RECORDS; i++) {
+		p = spsc_ring_reserve(&ring, record_len(produced));
+		if (p == NULL) {
+			producer_full++;
+			return;
+		}
+		fill_record(p, produced, record_len(produced));
+		spsc_ring_commit(&ring, record_len(produced));
+		produced++;
+	}
+}
+
+void test_spsc_ring_stress(void)
+{
+	uint32_t consumed = 0, errors = 0, len;
+	uint32_t start = get_uptime_ms();
+	OS_ERR_TYPE err;
+	T_TIMER timer;
+	uint8_t *p;
+
+	spsc_ring_init(&ring, ring_buf, RING_SIZE);
+	produced = 0;
+	producer_full = 0;
+
+	timer = timer_create(producer_cb, NULL, 1, true, true, &err);
+	CU_ASSERT("timer creation failed", err == E_OS_OK);
+	if (err != E_OS_OK)
+		return;
+
+	while (consumed < STRESS_RECORDS &&
+	       get_uptime_ms() - start < STRESS_TIMEOUT_MS) {
+		p = spsc_ring_peek(&ring, &len);
+		if (p == NULL)
+			continue;
+		if (!check_record(p, consumed, len))
+			errors++;
+		spsc_ring_release(&ring);
+		consumed++;
+	}
+	timer_delete(timer);
+
+	cu_print("spsc ring: %d records consumed, %d errors, producer full %d "
+		 "times\n", consumed, errors, producer_full);
+	CU_ASSERT("records lost", consumed == STRESS_RECORDS);
+	CU_ASSERT("corrupted records", errors == 0);
+	CU_ASSERT("ring not empty", spsc_ring_is_empty(&ring));
+}
@@ -104,6 +104,10 @@ static void test_queue(void)
 	CU_RUN_TEST(test_queue_functional_testing_different_tasks);
 #ifndef CONFIG_ARC
 	CU_RUN_TEST(test_queue_interrupt);
+#endif
+#ifdef CONFIG_SPSC_RING
+	CU_RUN_TEST(test_spsc_ring_framing);
+	CU_RUN_TEST(test_spsc_ring_stress);
 #endif
 	cu_print("======================\n");
 }
@@ -117,6 +121,10 @@ static void test_timer(void)
 	CU_RUN_TEST(test_timer_callback_with_timer_stop);
 	CU_RUN_TEST(test_timer_restart);
 	CU_RUN_TEST(test_timer_stat);
+#ifdef CONFIG_TIMER_WHEEL
+	CU_RUN_TEST(test_timer_wheel_expiration);
+	CU_RUN_TEST(test_timer_wheel_benchmark);
+#endif
 	CU_RUN_TEST(test_counter_millisecond_incrementation);
 	CU_RUN_TEST(test_counter_microsecond_incrementation);
 	cu_print("======================\n");
@@ -139,6 +147,7 @@ static void test_malloc(void)
 	CU_RUN_TEST(test_malloc_and_free_1);
 	CU_TEST_DISABLED(test_malloc_and_free_2);
 	CU_RUN_TEST(test_malloc_and_free_outclass);
+	CU_RUN_TEST(test_malloc_benchmark);
 #ifndef CONFIG_ARC
 	CU_RUN_TEST(test_malloc_in_interruption_ctx);
 #endif
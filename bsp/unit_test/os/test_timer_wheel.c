@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Timer wheel tests: schedule a few hundred timers against a simulated clock
+ * and check that each one expires exactly once, never early and in order.
+ * tools/tests/timer_wheel_test.c runs the same test on the host with
+ * thousands of timers.
+ */
+
+#include <stdint.h>
+
+#include "os/os.h"
+#include "infra/time.h"
+#include "util/timer_wheel.h"
+#include "util/cunit_test.h"
+#include "utility.h"
+
+#define NB_WHEEL_TIMERS 256
+
+static struct timer_wheel wheel;
+static struct timer_wheel_node nodes[NB_WHEEL_TIMERS];
+static bool active[NB_WHEEL_TIMERS];
+
+/* Small linear congruential generator, to stay deterministic */
+static uint32_t rand_state;
+static uint32_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return rand_state >> 8;
+}
+
+static void check_expired(uint32_t now, uint32_t *fired)
+{
+	struct timer_wheel_node *node;
+	uint32_t last = 0;
+	bool first = true;
+
+	while ((node = timer_wheel_get_expired(&wheel, now)) != NULL) {
+		CU_ASSERT("timer expired early",
+			  (int32_t)(node->expiration - now) <= 0);
+		CU_ASSERT("timers expired out of order",
+			  first || (int32_t)(node->expiration - last) >= 0);
+		last = node->expiration;
+		first = false;
+		timer_wheel_remove(&wheel, node);
+		active[node - nodes] = false;
+		(*fired)++;
+	}
+}
+
+void test_timer_wheel_expiration(void)
+{
+	/* Start close to the 32-bit roll over to check it is handled */
+	uint32_t now = 0xFFFF0000;
+	uint32_t fired = 0;
+	uint32_t next;
+	uint32_t i, step;
+
+	rand_state = 1;
+	timer_wheel_init(&wheel, now);
+	CU_ASSERT("empty wheel has a timer",
+		  !timer_wheel_next_expiration(&wheel, &next));
+
+	for (step = 0; step < 20 * NB_WHEEL_TIMERS; step++) {
+		i = next_rand() % NB_WHEEL_TIMERS;
+		if (!active[i]) {
+			/* mix of short (sensor polling) and long timers */
+			nodes[i].expiration = now + 1 +
+					      next_rand() %
+					      ((i & 1) ? 50 : 200000);
+			timer_wheel_add(&wheel, &nodes[i]);
+			active[i] = true;
+		} else if ((next_rand() & 3) == 0) {
+			timer_wheel_remove(&wheel, &nodes[i]);
+			active[i] = false;
+		}
+
+		now += next_rand() % 3;
+		check_expired(now, &fired);
+	}
+
+	/* Drain the wheel by jumping to each next expiration */
+	while (timer_wheel_next_expiration(&wheel, &next)) {
+		CU_ASSERT("next expiration in the past",
+			  (int32_t)(next - now) > 0);
+		now = next;
+		check_expired(now, &fired);
+	}
+
+	for (i = 0; i < NB_WHEEL_TIMERS; i++)
+		CU_ASSERT("timer never expired", !active[i]);
+	cu_print("%d timers expired\n", fired);
+}
+
+void test_timer_wheel_benchmark(void)
+{
+	uint32_t start, t_add, t_remove;
+	uint32_t i;
+
+	rand_state = 2;
+	timer_wheel_init(&wheel, 0);
+
+	start = get_uptime_32k();
+	for (i = 0; i < NB_WHEEL_TIMERS; i++) {
+		nodes[i].expiration = 1 + next_rand() % 600000;
+		timer_wheel_add(&wheel, &nodes[i]);
+	}
+	t_add = get_uptime_32k() - start;
+
+	start = get_uptime_32k();
+	for (i = 0; i < NB_WHEEL_TIMERS; i++)
+		timer_wheel_remove(&wheel, &nodes[i]);
+	t_remove = get_uptime_32k() - start;
+
+	/* 32kHz ticks to ns per operation */
+	cu_print("%d timers: add %d ns remove %d ns\n", NB_WHEEL_TIMERS,
+		 (uint32_t)((uint64_t)t_add * 30518 / NB_WHEEL_TIMERS),
+		 (uint32_t)((uint64_t)t_remove * 30518 / NB_WHEEL_TIMERS));
+}
@@ -103,14 +103,38 @@ typedef struct {
 	uint16_t put_idx;
 	uint16_t get_idx;
 	int16_t raw_data_offset;
+	/* resampling plan, filled by the sensor core on subscription changes */
+	void *phy_sensor;	/* active physical sensor, or NULL */
+	uint16_t period;	/* ms between two demanded frames */
+	uint16_t match_window;	/* frames per common window of the matched demands */
+	uint16_t sync_window;	/* frames per common window of all demands */
+	uint16_t gap;		/* physical frames per demanded frame */
+	int8_t scale;		/* vernier steps per demanded frame */
 }sensor_data_demand_t;
 
+/**
+ * frames of one demanded sensor passed to exec_batch: count frames of
+ * frame_size bytes stored back to back, calibration offsets already added
+ **/
+typedef struct {
+	void *frames;
+	uint16_t count;
+	uint16_t frame_size;
+}sensor_data_batch_t;
+
 /**
  * feed control api structure, which are called by open sensor core
+ *
+ * exec_batch is optional: when set, it is called instead of exec with the
+ * frames of several samples per demand, indexed as feed->demand. Frame k of
+ * a demand was sampled at k / freq from the first one. Since a batch may
+ * produce several results, algorithms report them with
+ * ReportSensDataDirectly rather than ready_flag.
  **/
 struct feed_general_t;
 typedef struct {
 	int (*exec)(void **, struct feed_general_t *);
+	int (*exec_batch)(sensor_data_batch_t *, struct feed_general_t *);
 	int (*init)(struct feed_general_t *);
 	int (*deinit)(struct feed_general_t *);
 	int (*reset)(struct feed_general_t *);
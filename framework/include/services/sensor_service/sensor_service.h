@@ -31,6 +31,8 @@
 #ifndef __SENSOR_SVC_API_H__
 #define __SENSOR_SVC_API_H__
 
+#include <stddef.h>
+
 #include "cfw/cfw.h"
 
 #include "services/services_ids.h"
@@ -56,6 +58,11 @@
  *   Client will receive _MSG_ID_SS_SENSOR_SUBSCRIBE_DATA_EVT_ messages
  *   with attached \ref sensor_service_subscribe_data_event_t.\n
  *   Data depends on the sensor type (see sensor_data_format.h for details).
+ * - \ref sensor_service_subscribe_data_batch to subscribe to a sensor with
+ *   batching.\n
+ *   Client will receive _MSG_ID_SENSOR_SERVICE_SUBSCRIBE_BATCH_EVT_ messages
+ *   with attached \ref sensor_service_subscribe_batch_event_t, each carrying
+ *   several timestamped samples.
  *
  * @ingroup services
  * @{
@@ -111,13 +118,15 @@
 		MSG_ID_SENSOR_SERVICE_EVT | 0x06)
 #define MSG_ID_SENSOR_SERVICE_GET_PROPERTY_EVT           ( \
 		MSG_ID_SENSOR_SERVICE_EVT | 0x07)
+#define MSG_ID_SENSOR_SERVICE_SUBSCRIBE_BATCH_EVT        ( \
+		MSG_ID_SENSOR_SERVICE_EVT | 0x08)
 
 
-#define GET_SENSOR_TYPE(sensor_handle)  ((((uint32_t)(sensor_handle)) >> \
+#define GET_SENSOR_TYPE(sensor_handle)  ((((uint32_t)(uintptr_t)(sensor_handle)) >> \
 					  24) & 0xFF)
-#define GET_SENSOR_ID(sensor_handle)    (((uint32_t)(sensor_handle)) & 0xFFFFFF)
+#define GET_SENSOR_ID(sensor_handle)    (((uint32_t)(uintptr_t)(sensor_handle)) & 0xFFFFFF)
 #define GET_SENSOR_HANDLE(type,	\
-			  id)     (void *)((((type) & \
+			  id)     (void *)(uintptr_t)((((type) & \
 					     0xFF) << 24) | ((id) & 0xFFFFFF))
 
 /**
@@ -174,6 +183,42 @@ typedef struct {
 	sensor_service_sensor_data_header_t sensor_data_header;
 } sensor_service_subscribe_data_event_t;
 
+/**
+ * One sample of a batched subscription event
+ */
+typedef struct {
+	uint32_t timestamp;    /*!< Time when this data is generated */
+	uint8_t data_length;   /*!< Data size */
+	uint8_t data[0];       /*!< Start of data; Content depends on the sensor. */
+} sensor_service_batch_sample_t;
+
+/** Size taken by a sample of `len` bytes in a batch, samples are 4 bytes aligned */
+#define SS_BATCH_SAMPLE_SIZE(len) \
+	((offsetof(sensor_service_batch_sample_t, data) + (len) + 3) & ~3)
+
+/** Next sample of a batch */
+#define SS_BATCH_NEXT_SAMPLE(s) ((sensor_service_batch_sample_t *) \
+				 ((uint8_t *)(s) + \
+				  SS_BATCH_SAMPLE_SIZE((s)->data_length)))
+
+/**
+ * Sensor service report batched subscribe data
+ *
+ * The event is shared by all the clients subscribed with the same batching
+ * parameters and the same private data: it is read only, `head.priv` is the
+ * private data of the client, and `head.conn` is only set when the event is
+ * sent to a single client.
+ */
+typedef struct {
+	struct cfw_message head;
+	sensor_service_t handle;
+	uint8_t sensor_type;          /*!< Sensor type as in \ref ss_sensor_type_t */
+	uint8_t subscription_type;    /*!< Defined for a specific sensor_type */
+	uint8_t sample_nr;            /*!< Number of samples */
+	uint16_t data_length;         /*!< Size of all the samples */
+	sensor_service_batch_sample_t samples[0]; /*!< First sample, see \ref SS_BATCH_NEXT_SAMPLE */
+} sensor_service_subscribe_batch_event_t;
+
 /**
  * Start the sensor scanning.
  *
@@ -222,6 +267,35 @@ void sensor_service_subscribe_data(cfw_service_conn_t *p_service_conn,
 				   uint16_t sampling_interval,
 				   uint16_t reporting_interval);
 
+/**
+ * Subscribe to sensor data, delivered in batches
+ *
+ * Samples are accumulated by the service and sent in one event when
+ * `batch_count` samples are pending, or when the oldest pending sample has
+ * waited for `batch_latency` ms. Batches may hold fewer samples than
+ * requested to fit in a message.
+ *
+ * @param  p_service_conn      Service connection
+ * @param  p_priv              Pointer to private data that will be passed back in response
+ * @param  sensor              Sensor handle as received on \ref MSG_ID_SENSOR_SERVICE_START_SCANNING_EVT
+ * @param  data_type           Specific to sensor type.
+ * @param  data_type_nr        Size of data type
+ * @param  sampling_interval   Fequency of sensor data sampling,unit[HZ].
+ * @param  reporting_interval  Frequency of sensor data reporting,unit[ms].
+ * @param  batch_count         Maximum number of samples in a batch.
+ * @param  batch_latency       Maximum time a sample is kept in a batch,unit[ms].
+ *
+ * @b Response: _MSG_ID_SENSOR_SERVICE_SUBSCRIBE_DATA_RSP_ with attached \ref sensor_service_message_general_rsp_t
+ */
+void sensor_service_subscribe_data_batch(cfw_service_conn_t *p_service_conn,
+					 void *p_priv, sensor_service_t sensor,
+					 uint8_t *data_type,
+					 uint8_t data_type_nr,
+					 uint16_t sampling_interval,
+					 uint16_t reporting_interval,
+					 uint8_t batch_count,
+					 uint16_t batch_latency);
+
 /**
  * Unsubscribe from sensor data
  *
@@ -31,9 +31,21 @@
 #ifndef __STORAGE_TASK__
 #define __STORAGE_TASK__
 
+#include "infra/xloop.h"
+
 /**
  * Initialisation for storage task
  */
 void init_storage(void);
 
+/**
+ * Get the execution loop of the storage task.
+ *
+ * Storage services can post jobs on it to run background work, like
+ * compaction, in between the processing of their requests.
+ *
+ * @return the storage task xloop
+ */
+xloop_t *storage_task_get_xloop(void);
+
 #endif /* __STORAGE_TASK__ */
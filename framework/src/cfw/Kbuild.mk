@@ -4,5 +4,8 @@ obj-$(CONFIG_CFW_CLIENT) += client_api.o
 obj-$(CONFIG_CFW_SERVICE) += service_api.o
 obj-$(CONFIG_CFW_MASTER) += service_manager.o
 obj-$(CONFIG_CFW_PROXY) += service_manager_proxy.o
+# Master and Proxy are exclusive
+obj-$(CONFIG_CFW_MASTER) += cfw_events.o
+obj-$(CONFIG_CFW_PROXY) += cfw_events.o
 cflags-$(CONFIG_PROFILING) += -finstrument-functions -finstrument-functions-exclude-file-list=service_manager_proxy.c,service_api.c,client_api.c,cproxy.c,cfw_debug.c
 obj-$(CONFIG_CFW_QUARK_SE_HELPERS) += cfw_quark_se_helpers.o
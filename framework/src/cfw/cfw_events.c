@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2015, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/list.h"
+#include "cfw_internal.h"
+
+/** Number of buckets of the registered events hash table, power of 2 */
+#define REGISTERED_EVT_BUCKETS 16
+
+/** Registered events, hashed by indication message id */
+static list_head_t registered_evt_table[REGISTERED_EVT_BUCKETS];
+
+list_head_t *cfw_get_event_bucket(int msg_id)
+{
+	/* Message ids are built from a service base and a small index */
+	return &registered_evt_table[(msg_id ^ (msg_id >> 4) ^ (msg_id >> 8)) &
+				     (REGISTERED_EVT_BUCKETS - 1)];
+}
+
+registered_evt_list_t *get_event_registered_list(int msg_id)
+{
+	registered_evt_list_t *l =
+		(registered_evt_list_t *)cfw_get_event_bucket(msg_id)->head;
+
+	while (l) {
+		if (l->ind == msg_id) {
+			return l;
+		}
+		l = (registered_evt_list_t *)l->list.next;
+	}
+	return NULL;
+}
+
+list_head_t *get_event_list(int msg_id)
+{
+	registered_evt_list_t *l = get_event_registered_list(msg_id);
+
+	if (l)
+		return &l->lh;
+	return NULL;
+}
+
+void cfw_foreach_registered_event(void (*cb)(registered_evt_list_t *l,
+					     void *param), void *param)
+{
+	registered_evt_list_t *l;
+	int i;
+
+	for (i = 0; i < REGISTERED_EVT_BUCKETS; i++) {
+		l = (registered_evt_list_t *)registered_evt_table[i].head;
+		while (l) {
+			cb(l, param);
+			l = (registered_evt_list_t *)l->list.next;
+		}
+	}
+}
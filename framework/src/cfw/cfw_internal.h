@@ -127,6 +127,26 @@ typedef struct {
 	int service_id;
 } cfw_register_svc_avail_req_msg_t;
 
+/**
+ * Indication list
+ * Holds a list of receivers.
+ */
+typedef struct {
+	list_t list;
+	conn_handle_t *conn_handle;
+} indication_list_t;
+
+/**
+ * \struct registered_int_list_t holds a list of registered clients to an indication
+ *
+ * Holds a list of registered receiver for each indication.
+ */
+typedef struct registered_evt_list_ {
+	list_t list; /*! Linking stucture */
+	list_head_t lh; /*! List of client */
+	int ind; /*! Indication message id */
+} registered_evt_list_t;
+
 /* Services list reference */
 extern service_t *services[];
 
@@ -179,6 +199,45 @@ void _cfw_register_event(conn_handle_t *handle, int msgId);
  */
 void _cfw_unregister_event(conn_handle_t *h);
 
+/**
+ * Get the bucket of the registered events table for an indication.
+ *
+ * The registered events are hashed by indication message id, the
+ * registered_evt_list_t of an indication is added to its bucket.
+ *
+ * @param msg_id the indication message id
+ *
+ * @return the list of registered events the indication belongs to
+ */
+list_head_t *cfw_get_event_bucket(int msg_id);
+
+/**
+ * Get the registered events entry of an indication.
+ *
+ * @param msg_id the indication message id
+ *
+ * @return the entry or NULL if no client ever registered to the indication
+ */
+registered_evt_list_t *get_event_registered_list(int msg_id);
+
+/**
+ * Get the list of clients registered to an indication.
+ *
+ * @param msg_id the indication message id
+ *
+ * @return a list of indication_list_t or NULL
+ */
+list_head_t *get_event_list(int msg_id);
+
+/**
+ * Call a function on each registered events entry.
+ *
+ * @param cb the function to call
+ * @param param the parameter passed to cb
+ */
+void cfw_foreach_registered_event(void (*cb)(registered_evt_list_t *l,
+					     void *param), void *param);
+
 /**
  * Gets the service matching the specified ID.
  *
@@ -69,8 +69,12 @@ struct cfw_message *cfw_clone_message(struct cfw_message *msg)
 	if (ret == NULL) {
 		pr_debug(LOG_MODULE_CFW, "%s: Error allocating message",
 			 __func__);
-	} else
+	} else {
 		memcpy(ret, msg, CFW_MESSAGE_LEN(msg));
+		/* The copy is a plain message, whatever the original was */
+		ret->m.flags.f_is_shared = 0;
+		ret->m.flags.f_is_ref = 0;
+	}
 	return ret;
 }
 
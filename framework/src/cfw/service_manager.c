@@ -180,6 +180,7 @@ void send_slave_service_shutdown(service_t *svc, struct cfw_message *rply_msg)
 #endif
 	CFW_MESSAGE_CONN(msg) = (void *)svc->service_id;
 	CFW_MESSAGE_ID(msg) = MSG_ID_CFW_SERVICE_SHUTDOWN_REQ;
+	MESSAGE_PRIO(&msg->m) = MESSAGE_PRIO_HIGH;
 	cfw_send_message(msg);
 }
 
@@ -490,64 +491,16 @@ static void cfw_services_shutdown(void (*shutdown_hook_complete)(
 	MESSAGE_DST(&ssm->msg) = service_mgr_port_id;
 	ssm->shutdown_hook_complete = shutdown_hook_complete;
 	ssm->data = data;
+	MESSAGE_PRIO(&ssm->msg) = MESSAGE_PRIO_HIGH;
 	cfw_send_message(ssm);
 }
 
-/**
- * Indication list
- * Holds a list of receivers.
- */
-typedef struct {
-	list_t list;
-	conn_handle_t *conn_handle;
-} indication_list_t;
-
-/**
- * \struct registered_int_list_t holds a list of registered clients to an indication
- *
- * Holds a list of registered receiver for each indication.
- */
-typedef struct registered_evt_list_ {
-	list_t list; /*! Linking stucture */
-	list_head_t lh; /*! List of client */
-	int ind; /*! Indication message id */
-} registered_evt_list_t;
-
-list_head_t registered_evt_list;
-
-registered_evt_list_t *get_event_registered_list(int msg_id)
-{
-	registered_evt_list_t *l =
-		(registered_evt_list_t *)registered_evt_list.head;
-
-	while (l) {
-		if (l->ind == msg_id) {
-			return l;
-		}
-		l = (registered_evt_list_t *)l->list.next;
-	}
-	return NULL;
-}
-
-list_head_t *get_event_list(int msg_id)
-{
-	registered_evt_list_t *l = get_event_registered_list(msg_id);
-
-	if (l)
-		return &l->lh;
-	return NULL;
-}
-
 static void send_event_callback(void *item, void *param)
 {
-	struct cfw_message *msg = (struct cfw_message *)param;
+	struct message *shared = (struct message *)param;
 	indication_list_t *ind = (indication_list_t *)item;
-	struct cfw_message *m = cfw_clone_message(msg);
 
-	if (m != NULL) {
-		CFW_MESSAGE_DST(m) = ind->conn_handle->client_port;
-		cfw_send_message(m);
-	}
+	port_send_shared_message(shared, ind->conn_handle->client_port);
 }
 
 void cfw_send_event(struct cfw_message *msg)
@@ -555,10 +508,39 @@ void cfw_send_event(struct cfw_message *msg)
 #ifdef SVC_MANAGER_DEBUG
 	pr_debug(LOG_MODULE_CFW, "%s : msg:%d", __func__, CFW_MESSAGE_ID(msg));
 #endif
+	OS_ERR_TYPE err;
+	struct cfw_message *m;
 	list_head_t *list = get_event_list(CFW_MESSAGE_ID(msg));
-	if (list != NULL) {
-		list_foreach(list, send_event_callback, msg);
+
+	if (list == NULL || list_empty(list))
+		return;
+
+	if (list->head == list->tail) {
+		/* Single client: a plain copy is cheaper than a shared one */
+		m = cfw_clone_message(msg);
+		if (m != NULL) {
+			CFW_MESSAGE_DST(m) =
+				((indication_list_t *)list->head)->conn_handle
+				->client_port;
+			cfw_send_message(m);
+		}
+		return;
 	}
+
+	/* Copy the event once and hand a reference to each client */
+	m = (struct cfw_message *)message_alloc_shared(CFW_MESSAGE_LEN(msg),
+						       &err);
+	if (m == NULL) {
+		pr_debug(LOG_MODULE_CFW, "%s: Error allocating message",
+			 __func__);
+		return;
+	}
+	memcpy(m, msg, CFW_MESSAGE_LEN(msg));
+	m->m.flags.f_is_shared = 1;
+	m->m.flags.f_is_ref = 0;
+	list_foreach(list, send_event_callback, CFW_MESSAGE_HEADER(m));
+	/* Release the reference held while sending */
+	cfw_msg_free(m);
 }
 
 static int unregister_events_cb(void *element, void *param)
@@ -572,15 +554,14 @@ static int unregister_events_cb(void *element, void *param)
 	return 0;
 }
 
-void _cfw_unregister_event(conn_handle_t *h)
+static void unregister_event_cb(registered_evt_list_t *l, void *param)
 {
-	registered_evt_list_t *l =
-		(registered_evt_list_t *)registered_evt_list.head;
+	list_foreach_del(&l->lh, unregister_events_cb, param);
+}
 
-	while (l) {
-		list_foreach_del(&l->lh, unregister_events_cb, h);
-		l = (registered_evt_list_t *)l->list.next;
-	}
+void _cfw_unregister_event(conn_handle_t *h)
+{
+	cfw_foreach_registered_event(unregister_event_cb, h);
 }
 
 static bool check_duplicate_handle_cb(list_t *element, void *param)
@@ -605,7 +586,7 @@ void _cfw_register_event(conn_handle_t *h, int msg_id)
 		ind = (registered_evt_list_t *)balloc(sizeof(*ind), NULL);
 		ind->ind = msg_id;
 		list_init(&ind->lh);
-		list_add(&registered_evt_list, &ind->list);
+		list_add(cfw_get_event_bucket(msg_id), &ind->list);
 	}
 
 	if (!list_find_first(&ind->lh, check_duplicate_handle_cb, h)) {
@@ -130,6 +130,75 @@ static int demo_algorithm_exec(void **sensor_data, feed_general_t *feed)
 	return ret;
 }
 
+/*********************
+ * the callback function below is template of algorithm's batch execute
+ * function: it receives all the frames of a fifo drain at once. Frames of
+ * each sensor are contiguous, here accel and gyro are paired by time.
+ * the results are reported directly as a batch may produce several of them.
+ **********************/
+static int demo_algorithm_exec_batch(sensor_data_batch_t *batch,
+				     feed_general_t *feed)
+{
+	int index_a = GetDemandIdx(feed, SENSOR_ACCELEROMETER);
+	int index_g = GetDemandIdx(feed, SENSOR_GYROSCOPE);
+	struct accel_phy_data *accel;
+	struct gyro_phy_data *gyro;
+	int count_a, count_g, steps;
+
+	if (index_a < 0 || index_g < 0)
+		return 0;
+
+	accel = batch[index_a].frames;
+	gyro = batch[index_g].frames;
+	count_a = batch[index_a].count;
+	count_g = batch[index_g].count;
+	steps = count_a > count_g ? count_a : count_g;
+
+	for (int k = 0; k < steps; k++) {
+		int16_t accel_data[3] = { 0 };
+		int gyro_data[3] = { 0 };
+
+		if (count_a > 0) {
+			struct accel_phy_data *a = &accel[k * count_a / steps];
+			accel_data[0] = a->ax;
+			accel_data[1] = a->ay;
+			accel_data[2] = a->az;
+		}
+		if (count_g > 0) {
+			struct gyro_phy_data *g = &gyro[k * count_g / steps];
+			gyro_data[0] = g->gx;
+			gyro_data[1] = g->gy;
+			gyro_data[2] = g->gz;
+		}
+
+		if (demo_algorithm_process(accel_data, gyro_data) == 1) {
+			exposed_sensor_t *sensor = GetExposedStruct(
+				SENSOR_ALGO_DEMO, DEFAULT_ID);
+			if (sensor != NULL) {
+				struct demo_algo_result *value =
+					(struct demo_algo_result *)
+					sensor->rpt_data_buf;
+				value->type = 1;
+				value->ax = accel_data[0];
+				value->ay = accel_data[1];
+				value->az = accel_data[2];
+				value->gx = gyro_data[0];
+				value->gy = gyro_data[1];
+				value->gz = gyro_data[2];
+				ReportSensDataDirectly(sensor);
+			}
+		}
+	}
+
+	if (demo_algorithm_hold_idle() == 1) {
+		STOP_IDLE(feed);
+	} else {
+		START_IDLE(feed);
+	}
+
+	return 0;
+}
+
 /***********************
  * the callback function below is called when basic algorithms is started at first.
  **********************/
@@ -206,7 +275,8 @@ sensor_data_demand_t basic_algo_demo_demand[] = {
  * 2. demand: describe what physical sensor data to demand in the basic_algo.
  * 3. demand_length: count of demand array.
  * 4. ctl_api: consist of the api what are used to control the basic_algo,
- *      such as init, exex, goto_idle and out_idle
+ *      such as init, exex, goto_idle and out_idle. exec_batch is
+ *      optional, exec is used when it is not set.
  * 5. <define_feedinit> is used to make out the feed list in opencore.
  *******************************/
 static feed_general_t demo_algo = {
@@ -218,6 +288,7 @@ static feed_general_t demo_algo = {
 		.init = demo_algorithm_init,
 		.deinit = demo_algorithm_deinit,
 		.exec = demo_algorithm_exec,
+		.exec_batch = demo_algorithm_exec_batch,
 		.goto_idle = demo_algorithm_goto_idle,
 		.out_idle = demo_algorithm_out_idle,
 	},
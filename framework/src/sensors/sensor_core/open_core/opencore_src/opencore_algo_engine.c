@@ -40,6 +40,13 @@ static char commit_buf[sizeof(struct ia_cmd)
 static uint16_t algo_engine_port;
 extern uint8_t read_out_fifo_flag;
 
+/* vernier steps between two frames of a demand: scale is the int8_t
+ * cm_multi_freq / freq, which wraps for widely apart rates */
+#define RESAMPLE_STRIDE(scale) ((scale) > 0 ? (scale) : -(scale))
+
+/* frames handed to exec_batch, shared between the demands of a feed */
+static uint8_t batch_buf[EXEC_BATCH_BUFFER_SIZE] __attribute__((aligned(4)));
+
 void OpencoreCommitSensData(uint8_t type, uint8_t id, void* data_ptr, int data_length)
 {
 	exposed_sensor_t* report_sensor = GetExposedStruct(type, id);
@@ -63,21 +70,32 @@ void OpencoreCommitSensData(uint8_t type, uint8_t id, void* data_ptr, int data_l
 	}
 }
 
-static void HandleAlgo(feed_general_t* feed, void** data_ptr)
+static void CommitReadySensData(void)
 {
-	int ret = feed->ctl_api.exec(data_ptr, feed);
-	if(ret != 0){
-		for(list_t* next = exposed_sensor_list.head; next != NULL; next = next->next){
-			exposed_sensor_t* exposed_sensor = (exposed_sensor_t*)next;
-			if(exposed_sensor->ready_flag != 0){
-				OpencoreCommitSensData(exposed_sensor->type, exposed_sensor->id,
-					exposed_sensor->rpt_data_buf, exposed_sensor->rpt_data_buf_len);
-				exposed_sensor->ready_flag = 0;
-			}
+	for(list_t* next = exposed_sensor_list.head; next != NULL; next = next->next){
+		exposed_sensor_t* exposed_sensor = (exposed_sensor_t*)next;
+		if(exposed_sensor->ready_flag != 0){
+			OpencoreCommitSensData(exposed_sensor->type, exposed_sensor->id,
+				exposed_sensor->rpt_data_buf, exposed_sensor->rpt_data_buf_len);
+			exposed_sensor->ready_flag = 0;
 		}
 	}
 }
 
+static void HandleAlgo(feed_general_t* feed, void** data_ptr)
+{
+	int ret = feed->ctl_api.exec(data_ptr, feed);
+	if(ret != 0)
+		CommitReadySensData();
+}
+
+static void HandleAlgoBatch(feed_general_t* feed, sensor_data_batch_t* batch)
+{
+	int ret = feed->ctl_api.exec_batch(batch, feed);
+	if(ret != 0)
+		CommitReadySensData();
+}
+
 static void AddCaliData(uint8_t phy_type, sensor_handle_t* phy_sensor, void* ptr_from)
 {
 	switch(phy_type){
@@ -101,31 +119,154 @@ static void AddCaliData(uint8_t phy_type, sensor_handle_t* phy_sensor, void* ptr
 	}
 }
 
-static void HandleMatchBufferData(feed_general_t* feed)
+static void AddCaliDataBulk(uint8_t phy_type, sensor_handle_t* phy_sensor,
+				void* frames, int count, int frame_size)
+{
+	switch(phy_type){
+		case SENSOR_ACCELEROMETER:
+			{
+				short* cali_ptr = (short*)phy_sensor->clb_data_buffer;
+				short cx = cali_ptr[0], cy = cali_ptr[1], cz = cali_ptr[2];
+				for(int n = 0; n < count; n++){
+					short* ptr = (short*)(frames + n * frame_size);
+					ptr[0] += cx;
+					ptr[1] += cy;
+					ptr[2] += cz;
+				}
+			}
+			break;
+		case SENSOR_GYROSCOPE:
+		case SENSOR_MAGNETOMETER:
+			{
+				int* cali_ptr = (int*)phy_sensor->clb_data_buffer;
+				int cx = cali_ptr[0], cy = cali_ptr[1], cz = cali_ptr[2];
+				for(int n = 0; n < count; n++){
+					int* ptr = (int*)(frames + n * frame_size);
+					ptr[0] += cx;
+					ptr[1] += cy;
+					ptr[2] += cz;
+				}
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+/* Number of SYNC windows gathered in the match buffers before handling them */
+static int GetMatchWindows(feed_general_t* feed)
+{
+	sensor_data_demand_t* demand = feed->demand;
+	int windows = 0;
+
+	if(feed->ctl_api.exec_batch == NULL)
+		return 1;
+
+	for(int i = 0; i < feed->demand_length; i++){
+		if(demand[i].freq == 0 || demand[i].match_buffer_repo == 0)
+			continue;
+		if(demand[i].sync_window == 0)
+			continue;
+		//the delay buffer keeps match_buffer_repo - 1 frames at most
+		int fit = (demand[i].match_buffer_repo - 1) / demand[i].sync_window;
+		if(windows == 0 || fit < windows)
+			windows = fit;
+	}
+	return windows > 0 ? windows : 1;
+}
+
+/* Hand the frames of vernier steps [0, vernier_length) to exec_batch,
+ * in as few calls as batch_buf allows. Returns 0, without taking any frame,
+ * when batch_buf cannot hold a frame of each demand */
+static int HandleMatchBufferBatch(feed_general_t* feed, int vernier_length)
 {
 	sensor_data_demand_t* demand = feed->demand;
 	uint8_t demand_length = feed->demand_length;
-	uint8_t data_match_not_ready_flag = 0;
-	uint16_t cm_time_consume = 1;
-	uint8_t match_times = 0;
+	sensor_handle_t* phy_sensor[demand_length];
+	sensor_data_batch_t batch[demand_length];
+	int stride[demand_length];
+	int share = 0, min_stride = 0, window;
 
 	for(int i = 0; i < demand_length; i++){
-		if(demand[i].freq == 0)
+		phy_sensor[i] = NULL;
+		if(demand[i].freq == 0 || demand[i].scale == 0 || demand[i].match_buffer == NULL)
 			continue;
-		if((demand[i].flag & IGNORE) != 0)
+		phy_sensor[i] = demand[i].phy_sensor;
+		if(phy_sensor[i] == NULL)
 			continue;
-		cm_time_consume = GetCommonMultiple(cm_time_consume, ValueRound((float)1000 / demand[i].freq));
+		stride[i] = RESAMPLE_STRIDE(demand[i].scale);
+		share += phy_sensor[i]->sensor_data_frame_size;
+		if(min_stride == 0 || stride[i] < min_stride)
+			min_stride = stride[i];
+	}
+	if(share == 0)
+		return 1;
+	if(share > (int)sizeof(batch_buf))
+		return 0;
+
+	//each demand gets the same number of frames in batch_buf
+	window = sizeof(batch_buf) / share * min_stride;
+
+	for(int v0 = 0; v0 < vernier_length; v0 += window){
+		int v1 = v0 + window < vernier_length ? v0 + window : vernier_length;
+		uint8_t* put = batch_buf;
+		int act = 0;
+
+		memset(batch, 0, sizeof(batch));
+		for(int i = 0; i < demand_length; i++){
+			if(phy_sensor[i] == NULL)
+				continue;
+			int frame_size = phy_sensor[i]->sensor_data_frame_size;
+			int repo = demand[i].match_buffer_repo;
+			int avail = (demand[i].put_idx + repo - demand[i].get_idx) % repo;
+			//frames of the steps v0 <= v < v1 where v % stride == 0
+			int count = (v1 + stride[i] - 1) / stride[i] - (v0 + stride[i] - 1) / stride[i];
+			if(count > avail)
+				count = avail;
+
+			batch[i].frames = put;
+			batch[i].frame_size = frame_size;
+			batch[i].count = count;
+			for(int n = 0; n < count; ){
+				int run = repo - demand[i].get_idx;
+				if(run > count - n)
+					run = count - n;
+				memcpy(put + n * frame_size, demand[i].match_buffer
+					+ frame_size * demand[i].get_idx, run * frame_size);
+				demand[i].get_idx += run;
+				if(demand[i].get_idx >= repo)
+					demand[i].get_idx = 0;
+				n += run;
+			}
+			demand[i].match_data_count -= count;
+			//add the calibration offset value
+			AddCaliDataBulk(demand[i].type, phy_sensor[i], put, count, frame_size);
+			put += sizeof(batch_buf) / share * frame_size;
+			act += count;
+		}
+
+		if(act != 0)
+			HandleAlgoBatch(feed, batch);
 	}
+	return 1;
+}
+
+static void HandleMatchBufferData(feed_general_t* feed)
+{
+	sensor_data_demand_t* demand = feed->demand;
+	uint8_t demand_length = feed->demand_length;
+	uint8_t data_match_not_ready_flag = 0;
+	uint8_t match_times = 0;
 
 	for(int i = 0; i < demand_length; i++){
 		if(demand[i].freq == 0)
 			continue;
 		if((demand[i].flag & IGNORE) != 0)
 			continue;
-		if(demand[i].match_data_count < cm_time_consume / ValueRound((float)1000 / demand[i].freq)){
+		if(demand[i].match_data_count < demand[i].match_window){
 			data_match_not_ready_flag++;
 		}else{
-			int temp = demand[i].match_data_count / (cm_time_consume / ValueRound((float)1000 / demand[i].freq));
+			int temp = demand[i].match_data_count / demand[i].match_window;
 			if(match_times == 0 || temp < match_times)
 				match_times = temp;
 		}
@@ -133,35 +274,38 @@ static void HandleMatchBufferData(feed_general_t* feed)
 
 	if(data_match_not_ready_flag == 0){
 		int vernier_length = 0;
-		uint16_t cm_multi_freq = 1;
-		int8_t scale[demand_length];
-		memset(scale, 0, sizeof(scale));
+		int next[demand_length];
+
 		for(int i = 0; i < demand_length; i++){
+			int count;
 			if(demand[i].freq == 0)
 				continue;
-			cm_multi_freq = GetCommonMultiple(cm_multi_freq, demand[i].freq);
+			count = match_times * demand[i].match_window;
+			if(vernier_length == 0 || vernier_length < count * demand[i].scale)
+				vernier_length = count * demand[i].scale;
 		}
 
+		if(feed->ctl_api.exec_batch != NULL
+				&& HandleMatchBufferBatch(feed, vernier_length))
+			return;
+
+		//next vernier step taking a frame of each demand
 		for(int i = 0; i < demand_length; i++){
-			int count;
-			if(demand[i].freq == 0)
-				continue;
-			scale[i] = cm_multi_freq / demand[i].freq;
-			count  = match_times * (cm_time_consume / ValueRound((float)1000 / demand[i].freq));
-			if(vernier_length == 0 || vernier_length < count * scale[i])
-				vernier_length = count * scale[i];
+			next[i] = vernier_length;
+			if(demand[i].freq != 0 && demand[i].phy_sensor != NULL
+					&& demand[i].scale != 0 && demand[i].match_buffer != NULL)
+				next[i] = 0;
 		}
 
-		for(int v = 0; v < vernier_length; v++){
+		for(int v = 0; v < vernier_length; ){
 			void* ptr[demand_length];
 			memset(ptr, 0, sizeof(ptr));
-			int act = 0;
+			int act = 0, v_next = vernier_length;
 			for(int i = 0; i < demand_length; i++){
-				if(demand[i].freq == 0)
-					continue;
-				sensor_handle_t* phy_sensor = GetActivePollSensStruct(demand[i].type, demand[i].id);
-				if(phy_sensor != NULL && scale[i] != 0 && demand[i].match_buffer != NULL){
-					if(v % scale[i] == 0 && demand[i].get_idx != demand[i].put_idx){
+				if(next[i] == v){
+					sensor_handle_t* phy_sensor = demand[i].phy_sensor;
+					next[i] += RESAMPLE_STRIDE(demand[i].scale);
+					if(demand[i].get_idx != demand[i].put_idx){
 						void* ptr_from = demand[i].match_buffer
 							+ phy_sensor->sensor_data_frame_size * demand[i].get_idx;
 						//add the calibration offset value
@@ -174,14 +318,56 @@ static void HandleMatchBufferData(feed_general_t* feed)
 						act++;
 					}
 				}
+				if(next[i] < v_next)
+					v_next = next[i];
 			}
 
 			if(act != 0 && feed->ctl_api.exec != NULL)
 				HandleAlgo(feed, ptr);
+			v = v_next;
 		}
 	}
 }
 
+/* Hand the frames of one raw data node to exec_batch, returns the number of
+ * frames used as the per frame loop of FeedSensDataDirectly does. The frame
+ * must fit in batch_buf */
+static int FeedRawDataBatch(feed_general_t* feed, int i, sensor_handle_t* phy_sensor,
+				void* buffer, uint16_t raw_sensor_data_count, int gap)
+{
+	sensor_data_demand_t* demand = &feed->demand[i];
+	int frame_size = phy_sensor->sensor_data_frame_size;
+	int capacity = sizeof(batch_buf) / frame_size;
+	sensor_data_batch_t batch[feed->demand_length];
+	int count = 0;
+
+	memset(batch, 0, sizeof(batch));
+	batch[i].frames = batch_buf;
+	batch[i].frame_size = frame_size;
+
+	while(gap * count + demand->raw_data_offset < raw_sensor_data_count){
+		int n = 0;
+		if(gap == 1){
+			n = raw_sensor_data_count - count - demand->raw_data_offset;
+			if(n > capacity)
+				n = capacity;
+			memcpy(batch_buf, buffer + (count + demand->raw_data_offset) * frame_size,
+				n * frame_size);
+			count += n;
+		}else{
+			for(; n < capacity && gap * count + demand->raw_data_offset
+					< raw_sensor_data_count; n++, count++)
+				memcpy(batch_buf + n * frame_size, buffer
+					+ (gap * count + demand->raw_data_offset) * frame_size, frame_size);
+		}
+		//add cali offset
+		AddCaliDataBulk(demand->type, phy_sensor, batch_buf, n, frame_size);
+		batch[i].count = n;
+		HandleAlgoBatch(feed, batch);
+	}
+	return count;
+}
+
 static void FeedSensDataDirectly(feed_general_t* feed)
 {
 	sensor_data_demand_t* demand = feed->demand;
@@ -189,8 +375,9 @@ static void FeedSensDataDirectly(feed_general_t* feed)
 	for(int i = 0; i < demand_length; i++){
 		if(demand[i].freq == 0)
 			continue;
-		sensor_handle_t* phy_sensor = GetActivePollSensStruct(demand[i].type, demand[i].id);
+		sensor_handle_t* phy_sensor = demand[i].phy_sensor;
 		if(phy_sensor != NULL){
+			int gap = demand[i].gap;
 			list_t* node = phy_sensor->raw_data_head[phy_sensor->head_for_algo].head;
 			while(node != NULL){
 				//get raw data node
@@ -198,21 +385,26 @@ static void FeedSensDataDirectly(feed_general_t* feed)
 					- offsetof(raw_data_node_t, raw_data_node));
 				uint16_t raw_sensor_data_count = raw_data->raw_data_count;
 				void* buffer = raw_data->buffer;
-				int gap = ValueRound((float)phy_sensor->freq / (demand[i].freq * 10));
 				int frame_size = phy_sensor->sensor_data_frame_size;
 				int count;
 				void* ptr[demand_length];
 				memset(ptr, 0, sizeof(ptr));
 
-				for(count = 0; gap * count + demand[i].raw_data_offset < raw_sensor_data_count; count++){
-					int idx = gap * count + demand[i].raw_data_offset;
-					void* ptr_from = phy_sensor->feed_data_buffer;
-					memcpy(ptr_from, buffer + idx * frame_size, frame_size);
-					//add cali offset
-					AddCaliData(demand[i].type, phy_sensor, ptr_from);
-					ptr[i] = ptr_from;
-					if(feed->ctl_api.exec != NULL)
-						HandleAlgo(feed, ptr);
+				if(feed->ctl_api.exec_batch != NULL
+						&& frame_size <= (int)sizeof(batch_buf)){
+					count = FeedRawDataBatch(feed, i, phy_sensor, buffer,
+							raw_sensor_data_count, gap);
+				}else{
+					for(count = 0; gap * count + demand[i].raw_data_offset < raw_sensor_data_count; count++){
+						int idx = gap * count + demand[i].raw_data_offset;
+						void* ptr_from = phy_sensor->feed_data_buffer;
+						memcpy(ptr_from, buffer + idx * frame_size, frame_size);
+						//add cali offset
+						AddCaliData(demand[i].type, phy_sensor, ptr_from);
+						ptr[i] = ptr_from;
+						if(feed->ctl_api.exec != NULL)
+							HandleAlgo(feed, ptr);
+					}
 				}
 				demand[i].raw_data_offset = gap - (raw_sensor_data_count
 					- (gap * (count - 1) + demand[i].raw_data_offset));
@@ -237,7 +429,7 @@ static void CopySensorData2DelayBuf(sensor_data_demand_t* demand, void* buffer,
 			demand->get_idx++;
 			if(demand->get_idx == demand->match_buffer_repo)
 				demand->get_idx = 0;
-				demand->match_data_count--;
+			demand->match_data_count--;
 		}
 	}
 }
@@ -249,21 +441,14 @@ static void FeedSensDataAfterMatch(feed_general_t* feed, match_t type)
 	list_t* node[demand_length];
 	memset(node, 0, sizeof(node));
 	int d_valid_cnt = 0;
-	uint32_t cm_time_consume = 1;
 	int count[demand_length];
 	memset(count, 0, sizeof(count));
+	int match_windows = GetMatchWindows(feed);
 
 	for(int i = 0; i < demand_length; i++){
 		if(demand[i].freq == 0)
 			continue;
-		cm_time_consume = GetCommonMultiple(cm_time_consume,
-			ValueRound((float)1000 / demand[i].freq));
-	}
-
-	for(int i = 0; i < demand_length; i++){
-		if(demand[i].freq == 0)
-			continue;
-		sensor_handle_t* phy_sensor = GetActivePollSensStruct(demand[i].type, demand[i].id);
+		sensor_handle_t* phy_sensor = demand[i].phy_sensor;
 		if(phy_sensor != NULL)
 			//get raw data node
 			node[i] = phy_sensor->raw_data_head[phy_sensor->head_for_algo].head;
@@ -275,15 +460,15 @@ static void FeedSensDataAfterMatch(feed_general_t* feed, match_t type)
 		for(int i = 0; i < demand_length; i++){
 			if(demand[i].freq == 0)
 				continue;
-			sensor_handle_t* phy_sensor = GetActivePollSensStruct(demand[i].type, demand[i].id);
+			sensor_handle_t* phy_sensor = demand[i].phy_sensor;
 			if ((phy_sensor != NULL) && (node[i] != NULL)) {
 				raw_data_node_t* raw_data = (raw_data_node_t*)((void*)node[i] - offsetof(raw_data_node_t, raw_data_node));
 				uint16_t raw_sensor_data_count = raw_data->raw_data_count;
 				void* buffer = raw_data->buffer;
-				int gap = ValueRound((float)phy_sensor->freq / (demand[i].freq * 10));
+				int gap = demand[i].gap;
 
 				if(type == SYNC){
-					int	target_count = cm_time_consume / ValueRound((float)1000 / demand[i].freq);
+					int	target_count = match_windows * demand[i].sync_window;
 					for(; gap * count[i] + demand[i].raw_data_offset < raw_sensor_data_count
 							&& demand[i].match_data_count < target_count; count[i]++){
 						CopySensorData2DelayBuf(&demand[i], buffer, gap, count[i], phy_sensor->sensor_data_frame_size);
@@ -366,9 +551,7 @@ static void FeedSensData2Algo(void)
 			list_t* temp = node->next;
 			raw_data_node_t* raw_data = (raw_data_node_t*)((void*)node
 				- offsetof(raw_data_node_t, raw_data_node));
-			if(phy_sensor->fifo_length == 0 || phy_sensor->fifo_use_flag == 0)
-				FreeInDss(raw_data->buffer);
-			FreeInDss((void*)node);
+			FreeRawDataNode(raw_data);
 			node = temp;
 		}
 		memset(&phy_sensor->raw_data_head[phy_sensor->head_for_algo], 0, sizeof(list_head_t));
@@ -400,6 +583,7 @@ static int ReadFifo(sensor_handle_t* phy_sensor, int* fifo_clear)
 				if(node == NULL)
 					pr_error(LOG_MODULE_OPEN_CORE, "fail to alloc raw data node fifo type=%d", phy_sensor_node->type);
 				if(node != NULL){
+					node->block = NULL;
 					node->buffer = phy_sensor_node->buffer;
 					node->raw_data_count = ret / phy_sensor_node->sensor_data_frame_size;
 					uint8_t head_for_raw = phy_sensor_node->head_for_algo == 0 ? 1 : 0;
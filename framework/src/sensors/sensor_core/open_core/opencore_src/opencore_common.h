@@ -42,6 +42,7 @@
 #include "ipc_comm.h"
 #include "opencore_algo_common.h"
 #include "sensors/phy_sensor_api/phy_sensor_api.h"
+#include "util/slab.h"
 
 #ifdef SUSPEND_TEST
 #include "drivers/bmi160_bus.h"
@@ -50,6 +51,7 @@
 #define MATCH_BUFFER_LIMIT_SIZE     128
 #define RAW_DATA_BUFFER_LIMIT_SIZE  1024
 #define RAW_DATA_DUMP_BUFFER_SIZE   256
+#define EXEC_BATCH_BUFFER_SIZE      512
 #define POLLING_TOLERANCE           10
 #define ON                    (1 << 0)
 #define IDLE                  (1 << 1)
@@ -102,6 +104,8 @@ typedef struct {
 	list_t raw_data_node;
 	void *buffer;
 	uint16_t raw_data_count;
+	/* sample block holding buffer, NULL for the phy sensor fifo buffer */
+	struct sample_block *block;
 }raw_data_node_t;
 
 struct poll_links {
@@ -151,8 +155,11 @@ typedef struct {
 	uint8_t fifo_share_read_sync_done : 1;
 }sensor_handle_t;
 
+void DssInit(void);
 void *AllocFromDss(uint32_t size);
 int FreeInDss(void *buf);
+struct sample_block *AllocSampleBlock(uint32_t size);
+void FreeRawDataNode(raw_data_node_t *raw_data);
 
 DEFINE_LOG_MODULE(LOG_MODULE_OPEN_CORE, "OCOR")
 
@@ -37,7 +37,7 @@ static int poll_timeout = OS_WAIT_FOREVER;
 static char stack[STACKSIZE] __aligned(4);
 static uint8_t no_motion_flag;
 static uint8_t calibration_flag;
-int read_out_fifo_flag = 0;
+uint8_t read_out_fifo_flag = 0;
 static int loop;
 static int reg_mark;
 static int fifo_mark;
@@ -49,7 +49,6 @@ static int SensorCoreProcess(int* poll_timeout)
 {
 	loop = reg_mark = fifo_mark = read_ohrm_consume = 0;
 	static double last_ct = 0;
-	static int last_poll_timeout = 0;
 	int act_npp, act_algo = 0;
 	while(1){
 		double min_npp = 0;
@@ -76,13 +75,11 @@ static int SensorCoreProcess(int* poll_timeout)
 		}
 
 		if(act_npp == 0){
-			last_poll_timeout = FOREVER_VALUE;
 			*poll_timeout = FOREVER_VALUE;
 			return act_algo;
 		}
 
 		if(ct < min_npp && min_npp - ct > 1){
-			last_poll_timeout = min_npp - ct;
 			*poll_timeout = min_npp - ct;
 			return act_algo;
 		}
@@ -102,31 +99,36 @@ static int SensorCoreProcess(int* poll_timeout)
 					act_algo++;
 					fifo_mark++;
 				}else if(phy_sensor->fifo_use_flag == 0){
-					void* temp_ptr = phy_sensor->buffer - offsetof(struct sensor_data, data);
-					int ct_local = get_uptime_ms();
-					ret = phy_sensor_data_read(phy_sensor->ptr, (struct sensor_data*)temp_ptr);
-					read_ohrm_consume = get_uptime_ms() - ct_local;
-					if(ret != 0){
-						raw_data_node_t* node = (raw_data_node_t*)AllocFromDss(sizeof(raw_data_node_t));
-						if(node == NULL)
-							pr_error(LOG_MODULE_OPEN_CORE, "fail to alloc raw data node reg");
-						void* buffer = AllocFromDss(phy_sensor->buffer_length);
-						if(buffer == NULL)
-							pr_error(LOG_MODULE_OPEN_CORE, "fail to alloc raw data buffer reg");
-						if(node != NULL && buffer != NULL){
-							memcpy(buffer, phy_sensor->buffer, ret);
-							node->buffer = buffer;
+					//read straight into the sample block handed to the feeds
+					struct sample_block* block = AllocSampleBlock(sizeof(struct sensor_data)
+						+ phy_sensor->buffer_length);
+					if(block == NULL)
+						pr_error(LOG_MODULE_OPEN_CORE, "fail to alloc raw data buffer reg");
+					raw_data_node_t* node = (raw_data_node_t*)AllocFromDss(sizeof(raw_data_node_t));
+					if(node == NULL)
+						pr_error(LOG_MODULE_OPEN_CORE, "fail to alloc raw data node reg");
+					if(node != NULL && block != NULL){
+						struct sensor_data* sensor_data = (struct sensor_data*)block->data;
+						sensor_data->data_length = phy_sensor->buffer_length;
+						int ct_local = get_uptime_ms();
+						ret = phy_sensor_data_read(phy_sensor->ptr, sensor_data);
+						read_ohrm_consume = get_uptime_ms() - ct_local;
+						if(ret != 0){
+							block->len = sizeof(struct sensor_data) + ret;
+							node->block = block;
+							node->buffer = sensor_data->data;
 							node->raw_data_count = ret / phy_sensor->sensor_data_frame_size;
 							uint8_t head_for_raw = phy_sensor->head_for_algo == 0 ? 1 : 0;
 							list_add(&phy_sensor->raw_data_head[head_for_raw], &node->raw_data_node);
 							act_algo++;
-						}else{
-							if(node != NULL)
-								FreeInDss((void*)node);
-							if(buffer != NULL)
-								FreeInDss(buffer);
+							block = NULL;
+							node = NULL;
 						}
 					}
+					if(node != NULL)
+						FreeInDss((void*)node);
+					if(block != NULL)
+						sample_block_put(block);
 					phy_sensor->npp = ct + phy_sensor->pi;
 					reg_mark++;
 				}
@@ -935,20 +937,22 @@ static struct ia_cmd* ParseCmd(struct ia_cmd* inbound)
 					if(node == NULL)
 						pr_error(LOG_MODULE_OPEN_CORE, "fail to alloc raw data node");
 
-					void* buffer = AllocFromDss(sensor_data->data_length);
-					if(buffer == NULL)
+					struct sample_block* block = AllocSampleBlock(sensor_data->data_length);
+					if(block == NULL)
 						pr_error(LOG_MODULE_OPEN_CORE, "fail to alloc raw data buffer reg");
 
-					if(node != NULL && buffer != NULL){
-						node->buffer = buffer;
+					if(node != NULL && block != NULL){
+						block->len = sensor_data->data_length;
+						node->block = block;
+						node->buffer = block->data;
 						node->raw_data_count = sensor_data->data_length / phy_sensor->sensor_data_frame_size;
-						memcpy(buffer, sensor_data->data, sensor_data->data_length);
+						memcpy(block->data, sensor_data->data, sensor_data->data_length);
 						list_add(&phy_sensor->raw_data_head, &node->raw_data_node);
 					}else{
 						if(node != NULL)
 							FreeInDss((void*)node);
-						if(buffer != NULL)
-							FreeInDss(buffer);
+						if(block != NULL)
+							sample_block_put(block);
 					}
 				}
 			}
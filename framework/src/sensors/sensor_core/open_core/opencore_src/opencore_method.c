@@ -206,6 +206,52 @@ int ValueRound(float value)
 	return rslt;
 }
 
+/* Work out once, when the subscriptions change, what the engine needs to
+ * resample the physical sensor data to the demanded rates of a feed */
+void BuildResamplePlan(feed_general_t *feed)
+{
+	sensor_data_demand_t *demand = feed->demand;
+	uint16_t cm_time_all = 1;
+	uint16_t cm_time_match = 1;
+	uint16_t cm_multi_freq = 1;
+	int i;
+
+	for (i = 0; i < feed->demand_length; i++) {
+		if (demand[i].freq == 0)
+			continue;
+		demand[i].period = ValueRound((float)1000 / demand[i].freq);
+		cm_time_all = GetCommonMultiple(cm_time_all, demand[i].period);
+		if ((demand[i].flag & IGNORE) == 0)
+			cm_time_match = GetCommonMultiple(cm_time_match,
+							  demand[i].period);
+		cm_multi_freq = GetCommonMultiple(cm_multi_freq,
+						  demand[i].freq);
+	}
+
+	for (i = 0; i < feed->demand_length; i++) {
+		sensor_handle_t *phy_sensor;
+
+		if (demand[i].freq == 0) {
+			demand[i].phy_sensor = NULL;
+			demand[i].period = 0;
+			demand[i].match_window = 0;
+			demand[i].sync_window = 0;
+			demand[i].gap = 0;
+			demand[i].scale = 0;
+			continue;
+		}
+		phy_sensor = GetActivePollSensStruct(demand[i].type,
+						     demand[i].id);
+		demand[i].phy_sensor = phy_sensor;
+		demand[i].match_window = cm_time_match / demand[i].period;
+		demand[i].sync_window = cm_time_all / demand[i].period;
+		demand[i].scale = cm_multi_freq / demand[i].freq;
+		demand[i].gap = phy_sensor == NULL ? 0 :
+				ValueRound((float)phy_sensor->freq /
+					   (demand[i].freq * 10));
+	}
+}
+
 int SendCmd2OpenCore(int cmd_id)
 {
 	int length = sizeof(struct ia_cmd);
@@ -56,4 +56,6 @@ uint16_t GetCommonMultiple(uint16_t next_freq, uint16_t prev_multiple);
 
 int ValueRound(float value);
 
+void BuildResamplePlan(feed_general_t *feed);
+
 #endif
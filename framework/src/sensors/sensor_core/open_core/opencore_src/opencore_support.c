@@ -58,97 +58,72 @@ static void raw_data_fifo_int_cb(phy_sensor_event_t* event, void* priv_data);
 static uint8_t buffer_for_raw_sensor_data[64*BUF_CNT_64
 	+ 128*BUF_CNT_128
 	+ 512*BUF_CNT_512
-	+ 1024*BUF_CNT_1024] __attribute__((section(".dccm")));
-static volatile uint32_t buf_mask_64;
-static volatile uint8_t buf_mask_128;
-static volatile uint8_t buf_mask_256;
-static volatile uint8_t buf_mask_512;
-static volatile uint8_t buf_mask_1024;
+	+ 1024*BUF_CNT_1024] __attribute__((section(".dccm"), aligned(4)));
+
+//one slab per buffer size, smallest first
+static const struct {
+	const char* name;
+	uint16_t size;
+	uint16_t count;
+} dss_config[] = {
+	{ "oc64", 64, BUF_CNT_64 },
+	{ "oc128", 128, BUF_CNT_128 },
+	{ "oc512", 512, BUF_CNT_512 },
+	{ "oc1024", 1024, BUF_CNT_1024 },
+};
+#define DSS_SLAB_CNT (sizeof(dss_config) / sizeof(dss_config[0]))
+
+static struct slab dss_slab[DSS_SLAB_CNT];
+static uint32_t dss_map[DSS_SLAB_CNT][SLAB_MAP_WORDS(BUF_CNT_64)];
+
+void DssInit(void)
+{
+	uint8_t* start = buffer_for_raw_sensor_data;
+	for(int i = 0; i < DSS_SLAB_CNT; i++){
+		slab_init(&dss_slab[i], dss_config[i].name, start, dss_config[i].size,
+			dss_config[i].count, dss_map[i]);
+		start += dss_config[i].size * dss_config[i].count;
+	}
+}
 
+//use a larger buffer when all buffers of the fitting size are taken
 void* AllocFromDss(uint32_t size)
 {
-	void* ptr = NULL;
-	void* start = (void*)&buffer_for_raw_sensor_data[0];
-	uint32_t key = irq_lock();
-	if(size <= 64 && buf_mask_64 != (1 << BUF_CNT_64) - 1){
-		for(int i = 0; i < BUF_CNT_64; i++){
-			if((buf_mask_64 & (1 << i)) == 0){
-				ptr = start + 64*i;
-				buf_mask_64 |= 1 << i;
-				break;
-			}
-		}
-	}else if(size <= 128 && buf_mask_128 != (1 << BUF_CNT_128) - 1){
-		for(int i = 0; i < BUF_CNT_128; i++){
-			if((buf_mask_128 & (1 << i)) == 0){
-				ptr = start + 64*BUF_CNT_64 + 128*i;
-				buf_mask_128 |= 1 << i;
-				break;
-			}
-		}
-	}else if(size <= 512 && buf_mask_512 != (1 << BUF_CNT_512) - 1){
-		for(int i = 0; i < BUF_CNT_512; i++){
-			if((buf_mask_512 & (1 << i)) == 0){
-				ptr = start + 64*BUF_CNT_64 + 128*BUF_CNT_128 + 512*i;
-				buf_mask_512 |= 1 << i;
-				break;
-			}
-		}
-	}else if(size <= 1024 && buf_mask_1024 != (1 << BUF_CNT_1024) - 1){
-		for(int i = 0; i < BUF_CNT_1024; i++){
-			if((buf_mask_1024 & (1 << i)) == 0){
-				ptr = start + 64*BUF_CNT_64 + 128*BUF_CNT_128 + 512*BUF_CNT_512 + 1024*i;
-				buf_mask_1024 |= 1 << i;
-				break;
-			}
+	for(int i = 0; i < DSS_SLAB_CNT; i++){
+		if(size <= dss_config[i].size){
+			void* ptr = slab_alloc(&dss_slab[i]);
+			if(ptr != NULL)
+				return ptr;
 		}
 	}
-
-	irq_unlock(key);
-	return ptr;
+	return NULL;
 }
 
 int FreeInDss(void* buf)
 {
-	int ret = -1;
-	void* start = (void*)&buffer_for_raw_sensor_data[0];
-	uint32_t key = irq_lock();
-	if(buf < start + 64*BUF_CNT_64){
-		for(int i = 0; i < BUF_CNT_64; i++){
-			if(buf == start + 64*i){
-				buf_mask_64 &= ~(1<<i);
-				ret = 0;
-				break;
-			}
-		}
-	}else if(buf < start + 64*BUF_CNT_64 + 128*BUF_CNT_128){
-		for(int i = 0; i < BUF_CNT_128; i++){
-			if(buf == start + 64*BUF_CNT_64 + 128*i){
-				buf_mask_128 &= ~(1<<i);
-				ret = 0;
-				break;
-			}
-		}
-	}else if(buf < start + 64*BUF_CNT_64 + 128*BUF_CNT_128 + 512*BUF_CNT_512){
-		for(int i = 0; i < BUF_CNT_512; i++){
-			if(buf == start + 64*BUF_CNT_64 + 128*BUF_CNT_128 + 512*i){
-				buf_mask_512 &= ~(1<<i);
-				ret = 0;
-				break;
-			}
-		}
-	}else if(buf < start + 64*BUF_CNT_64 + 128*BUF_CNT_128 + 512*BUF_CNT_512 + 1024*BUF_CNT_1024){
-		for(int i = 0; i < BUF_CNT_1024; i++){
-			if(buf == start + 64*BUF_CNT_64 + 128*BUF_CNT_128 + 512*BUF_CNT_512 + 1024*i){
-				buf_mask_1024 &= ~(1<<i);
-				ret = 0;
-				break;
-			}
+	for(int i = 0; i < DSS_SLAB_CNT; i++)
+		if(slab_contains(&dss_slab[i], buf))
+			return slab_free(&dss_slab[i], buf);
+	return -1;
+}
+
+struct sample_block* AllocSampleBlock(uint32_t size)
+{
+	for(int i = 0; i < DSS_SLAB_CNT; i++){
+		if(SAMPLE_BLOCK_SIZE(size) <= dss_config[i].size){
+			struct sample_block* block = sample_block_alloc(&dss_slab[i]);
+			if(block != NULL)
+				return block;
 		}
 	}
+	return NULL;
+}
 
-	irq_unlock(key);
-	return ret;
+void FreeRawDataNode(raw_data_node_t* raw_data)
+{
+	if(raw_data->block != NULL)
+		sample_block_put(raw_data->block);
+	FreeInDss((void*)raw_data);
 }
 
 static uint16_t MatchFreq(sensor_handle_t* phy_sensor, uint16_t freq)
@@ -213,8 +188,7 @@ static void ClosePhySensor(sensor_handle_t* phy_sensor)
 			list_t* temp = node->next;
 			raw_data_node_t* raw_data = (raw_data_node_t*)((void*)node
 				- offsetof(raw_data_node_t, raw_data_node));
-			FreeInDss(raw_data->buffer);
-			FreeInDss((void*)node);
+			FreeRawDataNode(raw_data);
 			node = temp;
 		}
 		memset(&phy_sensor->raw_data_head[i], 0, sizeof(list_head_t));
@@ -334,7 +308,7 @@ static int CheckFeedIfDirect(feed_general_t* feed)
 }
 
 
-void RefleshSensorCore(void)
+static void RefleshSensorList(void)
 {
 	uint8_t active_flag = 0;
 	uint8_t suspend_flag = 0;
@@ -759,6 +733,15 @@ void RefleshSensorCore(void)
 	}
 }
 
+void RefleshSensorCore(void)
+{
+	RefleshSensorList();
+
+	//phy sensors, freqs and IGNORE flags are settled, plan the resampling
+	for(list_t* node = feed_list.head; node != NULL; node = node->next)
+		BuildResamplePlan((feed_general_t*)node);
+}
+
 #ifdef SUPPORT_INTERRUPT_MODE
 static void raw_data_fifo_int_cb(phy_sensor_event_t* event, void* priv_data)
 {
@@ -911,6 +894,7 @@ out:
 	if(demand_ptr == NULL)
 		return;
 
+	memset(demand_ptr, 0, sizeof(sensor_data_demand_t) * count);
 	atlsp_algoC.demand = demand_ptr;
 	atlsp_algoC.demand_length = count;
 
@@ -924,6 +908,7 @@ out:
 		if(exposed_sensor == NULL)
 			continue;
 
+		memset(exposed_sensor, 0, sizeof(exposed_sensor_t));
 		exposed_sensor->depend_flag = 1 << BASIC_ALGO_RAWDATA;
 		exposed_sensor->type = phy_sensor->type;
 		exposed_sensor->id = phy_sensor->id;
@@ -1040,6 +1025,7 @@ static void ExposedSensorInit(void)
 
 void SensorCoreInit(void)
 {
+	DssInit();
 	PhySensorsInit();
 	FeedInit();
 	ExposedSensorInit();
@@ -1,6 +1,7 @@
 obj-$(CONFIG_SERVICES_BLE_IMPL) += ble_service.o
 obj-$(CONFIG_SERVICES_BLE) += ble_service_api.o
 obj-$(CONFIG_SERVICES_BLE) += nble_driver.o
+obj-$(CONFIG_SERVICES_BLE) += nble_rpc_pack.o
 obj-$(CONFIG_SERVICES_BLE_IMPL) += ble_service_utils.o
 obj-$(CONFIG_BLE_CORE_TEST) += test/
 
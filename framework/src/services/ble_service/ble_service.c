@@ -111,9 +111,15 @@ void on_nble_gap_dbg_rsp(const struct nble_debug_resp *params)
 static void handle_msg_id_ble_rpc_callin(struct message *msg, void *priv)
 {
 	struct ble_rpc_callin *rpc = container_of(msg, struct ble_rpc_callin, msg);
+
+	if (rpc->p_data == NULL) {
+		/* static wakeup message, handle all the pending messages */
+		nble_driver_rx_drain();
+		return;
+	}
 	/* handle incoming message */
-	rpc_deserialize(rpc->p_data, rpc->len);
-	bfree(rpc->p_data);
+	nble_driver_rx_deserialize(rpc->channel, rpc->p_data, rpc->len);
+	nble_driver_rx_free(rpc->p_data);
 	message_free(msg);
 }
 
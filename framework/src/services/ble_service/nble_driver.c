@@ -28,6 +28,7 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <string.h>
 #include "util/assert.h"
 
 #include "nble_driver.h"
@@ -43,11 +44,17 @@
 #include "ticks.h"
 
 #include "rpc.h"
+#include "nble_rpc_pack.h"
 
 #include "util/misc.h"
 
 #include "infra/log.h"
 
+#ifdef CONFIG_TCMD
+#include <stdio.h>
+#include "infra/tcmd/handler.h"
+#endif
+
 /*
  * Macro definition for reset pin
  * Curie and other board - Everything should be working out of the box
@@ -61,6 +68,15 @@ static uint16_t rpc_port_id;
 static struct td_device *uart_nble_dev;
 static struct td_device *gpio_dev;
 static list_head_t m_rpc_tx_q;
+static struct nble_rpc_stats m_rpc_stats;
+#if CONFIG_RPC_TX_COALESCE_MTU > 0
+/* RPC buffers queued while the UART was busy, sent as one frame */
+static uint8_t m_rpc_tx_pack[CONFIG_RPC_TX_COALESCE_MTU];
+#endif
+#ifdef CONFIG_RPC_IN
+/* Posted when frames are pending in the UART RX ring, never freed */
+static struct ble_rpc_callin m_rpc_rx_ready;
+#endif
 
 void on_nble_curie_init(void)
 {
@@ -148,12 +164,14 @@ void uart_ipc_disable(void)
 }
 
 static void *m_rpc_channel;
+static void *m_rpc_packed_channel;
 
-struct rpc_tx_elt {
-	list_t l;
-	uint16_t length;
-	uint8_t data[0];
-};
+static void uart_rpc_count_tx(int messages, int len)
+{
+	m_rpc_stats.tx_frames++;
+	m_rpc_stats.tx_messages += messages;
+	m_rpc_stats.tx_bytes += sizeof(struct ipc_uart_header) + len;
+}
 
 /**
  * Try to send a element of the RPC waiting list
@@ -164,13 +182,17 @@ struct rpc_tx_elt {
 static int uart_rpc_try_tx(list_t *l)
 {
 	struct rpc_tx_elt *p_elt;
+	int ret;
 
 	/* Retrieve the RPC TX element from the list pointer */
 	p_elt = container_of(l, struct rpc_tx_elt, l);
 
 	/* Try to send the element payload */
-	return ipc_uart_ns16550_send_pdu(nble_interface_get(),
+	ret = ipc_uart_ns16550_send_pdu(nble_interface_get(),
 			m_rpc_channel, p_elt->length, p_elt->data);
+	if (ret == IPC_UART_ERROR_OK)
+		uart_rpc_count_tx(1, p_elt->length);
+	return ret;
 }
 
 /**
@@ -178,12 +200,29 @@ static int uart_rpc_try_tx(list_t *l)
  * of the previous message.  This is invoked under interrupt context
  * and therefore does not require protection.  It is also expected
  * that the tx operation can not fail.
+ *
+ * The elements queued while the previous message was being sent are packed
+ * in one frame if CONFIG_RPC_TX_COALESCE_MTU allows it.
  */
 static void uart_rpc_try_tx_on_free(void)
 {
 	list_t *l;
 	int ret;
 
+#if CONFIG_RPC_TX_COALESCE_MTU > 0
+	int count;
+	uint16_t len = nble_rpc_pack(&m_rpc_tx_q, m_rpc_tx_pack,
+				     sizeof(m_rpc_tx_pack), &count);
+
+	if (len) {
+		ret = ipc_uart_ns16550_send_pdu(nble_interface_get(),
+						m_rpc_packed_channel, len,
+						m_rpc_tx_pack);
+		assert(ret == IPC_UART_ERROR_OK);
+		uart_rpc_count_tx(count, len);
+		return;
+	}
+#endif
 	/* Get next element in tx q */
 	l = list_get(&m_rpc_tx_q);
 	if (l) {
@@ -227,6 +266,7 @@ static void uart_rpc_try_tx_on_add(void)
  *
  * @param channel Channel on which the event applies
  * @param request IPC_MSG_TYPE_MESSAGE when a new message was received,
+ * IPC_MSG_TYPE_RX_READY when messages are pending in the RX ring,
  * IPC_MSG_TYPE_FREE when the previous message was sent and can be freed.
  * @param len Length of the data
  * @param p_data Pointer to the data
@@ -248,14 +288,23 @@ static int uart_ipc_rpc_cback(int channel, int request, int len, void *p_data)
 		MESSAGE_TYPE(&rpc->msg) = TYPE_INT;
 		rpc->p_data = p_data;
 		rpc->len = len;
+		rpc->channel = channel;
 		if (port_send_message(&rpc->msg) != E_OS_OK)
 			panic(-1);
 #endif
 	}
 		break;
+	case IPC_MSG_TYPE_RX_READY:
+#ifdef CONFIG_RPC_IN
+		/* Only one wakeup is pending at a time, see nble_driver_rx_drain */
+		if (port_send_message(&m_rpc_rx_ready.msg) != E_OS_OK)
+			panic(-1);
+#endif
+		break;
 	case IPC_MSG_TYPE_FREE:
-		/* Free the message */
-		bfree(p_data);
+		/* Free the message, packed frames are not allocated */
+		if (channel == RPC_CHANNEL)
+			bfree(p_data);
 
 		/* Try to send another message immediately */
 		uart_rpc_try_tx_on_free();
@@ -269,6 +318,46 @@ static int uart_ipc_rpc_cback(int channel, int request, int len, void *p_data)
 	return 0;
 }
 
+static void uart_rpc_rx_message(uint8_t *p_data, uint16_t len)
+{
+	m_rpc_stats.rx_messages++;
+	rpc_deserialize(p_data, len);
+}
+
+void nble_driver_rx_deserialize(int channel, uint8_t *p_data, int len)
+{
+	m_rpc_stats.rx_frames++;
+	if (channel != RPC_PACKED_CHANNEL)
+		uart_rpc_rx_message(p_data, len);
+	else if (nble_rpc_unpack(p_data, len, uart_rpc_rx_message) < 0)
+		pr_error(LOG_MODULE_BLE, "Bad packed RPC frame, len %d", len);
+}
+
+static void uart_rpc_rx_frame(int channel, int len, void *p_data)
+{
+	nble_driver_rx_deserialize(channel, p_data, len);
+}
+
+void nble_driver_rx_drain(void)
+{
+	ipc_uart_ns16550_rx_drain(nble_interface_get(), uart_rpc_rx_frame);
+}
+
+void nble_driver_rx_free(uint8_t *p_data)
+{
+	ipc_uart_ns16550_rx_free(nble_interface_get(), p_data);
+}
+
+void nble_driver_get_stats(struct nble_rpc_stats *stats, bool reset)
+{
+	uint32_t flags = irq_lock();
+
+	*stats = m_rpc_stats;
+	if (reset)
+		memset(&m_rpc_stats, 0, sizeof(m_rpc_stats));
+	irq_unlock(flags);
+}
+
 uint8_t *rpc_alloc_cb(uint16_t length)
 {
 	struct rpc_tx_elt *p_elt;
@@ -313,6 +402,9 @@ void nble_driver_init(void)
 
 	/* Open the UART channel for RPC while Nordic is in reset */
 	m_rpc_channel = ipc_uart_channel_open(RPC_CHANNEL, uart_ipc_rpc_cback);
+	/* Packed frames are always accepted, and only sent if configured */
+	m_rpc_packed_channel = ipc_uart_channel_open(RPC_PACKED_CHANNEL,
+						     uart_ipc_rpc_cback);
 
 	gpio_write(gpio_dev, RESET_PIN, 1);
 
@@ -327,4 +419,31 @@ void nble_driver_configure(T_QUEUE queue, void (*handler)(struct message*, void*
 	rpc_port_id = port_alloc(queue);
 	assert(rpc_port_id != 0);
 	port_set_handler(rpc_port_id, handler, NULL);
+
+#ifdef CONFIG_RPC_IN
+	MESSAGE_ID(&m_rpc_rx_ready.msg) = 0;
+	MESSAGE_LEN(&m_rpc_rx_ready.msg) = sizeof(m_rpc_rx_ready);
+	MESSAGE_SRC(&m_rpc_rx_ready.msg) = rpc_port_id;
+	MESSAGE_DST(&m_rpc_rx_ready.msg) = rpc_port_id;
+	MESSAGE_TYPE(&m_rpc_rx_ready.msg) = TYPE_INT;
+#endif
+}
+
+#ifdef CONFIG_TCMD
+void nble_rpc_stats_tcmd(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	struct nble_rpc_stats stats;
+	char tmp[80];
+
+	nble_driver_get_stats(&stats, argc > 2 && !strcmp(argv[2], "reset"));
+	snprintf(tmp, sizeof(tmp),
+		 "tx frames:%u msgs:%u bytes:%u rx frames:%u msgs:%u",
+		 (unsigned int)stats.tx_frames,
+		 (unsigned int)stats.tx_messages,
+		 (unsigned int)stats.tx_bytes,
+		 (unsigned int)stats.rx_frames,
+		 (unsigned int)stats.rx_messages);
+	TCMD_RSP_FINAL(ctx, tmp);
 }
+DECLARE_TEST_COMMAND_ENG(ble, rpc_stats, nble_rpc_stats_tcmd);
+#endif
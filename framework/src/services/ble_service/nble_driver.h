@@ -36,8 +36,21 @@
 
 struct ble_rpc_callin {
 	struct message msg; /**< Message header, MUST be first element of structure */
-	uint8_t *p_data; /**< RPC buffer, must be freed after deserializing */
+	uint8_t *p_data; /**< RPC buffer, must be freed with @ref nble_driver_rx_free
+			  * after deserializing. NULL when RPC buffers are pending in
+			  * the UART RX ring: call @ref nble_driver_rx_drain and do not
+			  * free the message. */
 	uint16_t len; /**< length of above buffer */
+	uint8_t channel; /**< IPC UART channel the buffer was received on */
+};
+
+/** RPC traffic counters */
+struct nble_rpc_stats {
+	uint32_t tx_frames; /**< IPC UART frames sent */
+	uint32_t tx_messages; /**< RPC buffers sent */
+	uint32_t tx_bytes; /**< Bytes sent, IPC UART headers included */
+	uint32_t rx_frames; /**< IPC UART frames received */
+	uint32_t rx_messages; /**< RPC buffers received */
 };
 
 /**
@@ -52,4 +65,33 @@ void nble_driver_configure(T_QUEUE queue, void (*handler)(struct message*, void*
 
 void uart_ipc_disable(void);
 
+/**
+ * Deserialize all the RPC buffers pending in the UART RX ring.
+ */
+void nble_driver_rx_drain(void);
+
+/**
+ * Deserialize the RPC buffer(s) of a received IPC UART frame.
+ *
+ * @param channel IPC UART channel the frame was received on
+ * @param p_data  Frame content
+ * @param len     Frame length
+ */
+void nble_driver_rx_deserialize(int channel, uint8_t *p_data, int len);
+
+/**
+ * Free the RPC buffer of a @ref ble_rpc_callin message.
+ *
+ * @param p_data RPC buffer
+ */
+void nble_driver_rx_free(uint8_t *p_data);
+
+/**
+ * Get the RPC traffic counters.
+ *
+ * @param stats Filled with the counters
+ * @param reset true to clear the counters
+ */
+void nble_driver_get_stats(struct nble_rpc_stats *stats, bool reset);
+
 #endif /* NBLE_DRIVER_H_ */
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2015, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include "nble_rpc_pack.h"
+#include "os/os.h"
+#include "util/misc.h"
+
+uint16_t nble_rpc_pack(list_head_t *q, uint8_t *frame, uint16_t mtu,
+		       int *count)
+{
+	struct rpc_tx_elt *p_elt;
+	list_t *l;
+	uint32_t len = 0;
+	int n = 0;
+	int i;
+
+	/* Count the buffers fitting in the frame before dequeuing anything */
+	for (l = q->head; l; l = l->next) {
+		p_elt = container_of(l, struct rpc_tx_elt, l);
+		if (len + NBLE_RPC_PACK_HDR_SIZE + p_elt->length > mtu)
+			break;
+		len += NBLE_RPC_PACK_HDR_SIZE + p_elt->length;
+		n++;
+	}
+	*count = 0;
+	if (n < 2)
+		return 0;
+
+	len = 0;
+	for (i = 0; i < n; i++) {
+		p_elt = container_of(list_get(q), struct rpc_tx_elt, l);
+		frame[len++] = p_elt->length & 0xff;
+		frame[len++] = p_elt->length >> 8;
+		memcpy(&frame[len], p_elt->data, p_elt->length);
+		len += p_elt->length;
+		bfree(p_elt);
+	}
+	*count = n;
+	return len;
+}
+
+int nble_rpc_unpack(uint8_t *frame, uint16_t len,
+		    void (*cb)(uint8_t *data, uint16_t len))
+{
+	uint32_t pos;
+	uint16_t sub_len;
+	int n = 0;
+
+	for (pos = 0; pos < len; pos += NBLE_RPC_PACK_HDR_SIZE + sub_len) {
+		if (len - pos < NBLE_RPC_PACK_HDR_SIZE)
+			return -1;
+		sub_len = frame[pos] | (frame[pos + 1] << 8);
+		if (len - pos - NBLE_RPC_PACK_HDR_SIZE < sub_len)
+			return -1;
+		n++;
+	}
+
+	for (pos = 0; pos < len; pos += NBLE_RPC_PACK_HDR_SIZE + sub_len) {
+		sub_len = frame[pos] | (frame[pos + 1] << 8);
+		cb(&frame[pos + NBLE_RPC_PACK_HDR_SIZE], sub_len);
+	}
+	return n;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2015, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef NBLE_RPC_PACK_H_
+#define NBLE_RPC_PACK_H_
+
+#include <stdint.h>
+#include "util/list.h"
+
+/*
+ * Packing of several RPC buffers in one IPC UART frame.
+ *
+ * A packed frame is sent on RPC_PACKED_CHANNEL and holds a sequence of RPC
+ * buffers, each of them prefixed by its length on 2 bytes, little endian,
+ * without any padding. Frames on RPC_CHANNEL hold a single RPC buffer, as
+ * before.
+ *
+ * This module does not touch the hardware and can be built on the host.
+ */
+
+/** Size of the length prefixing each RPC buffer in a packed frame */
+#define NBLE_RPC_PACK_HDR_SIZE  2
+
+/** RPC buffer waiting in the TX queue */
+struct rpc_tx_elt {
+	list_t l;
+	uint16_t length;
+	uint8_t data[0];
+};
+
+/**
+ * Pack the first buffers of an RPC TX queue in a frame.
+ *
+ * Buffers are only removed from the queue, and freed, if at least two of
+ * them fit in the frame: a single buffer is better sent as is.
+ *
+ * @param q     queue of struct rpc_tx_elt, protected by the caller
+ * @param frame frame to fill
+ * @param mtu   size of frame
+ * @param count filled with the number of buffers packed
+ *
+ * @return the length of the frame, 0 if nothing was packed
+ */
+uint16_t nble_rpc_pack(list_head_t *q, uint8_t *frame, uint16_t mtu,
+		       int *count);
+
+/**
+ * Call a function on each RPC buffer of a packed frame.
+ *
+ * The frame is checked first, nothing is delivered if it is malformed.
+ *
+ * @param frame packed frame
+ * @param len   length of frame
+ * @param cb    function called with each RPC buffer and its length
+ *
+ * @return the number of buffers delivered, -1 if the frame is malformed
+ */
+int nble_rpc_unpack(uint8_t *frame, uint16_t len,
+		    void (*cb)(uint8_t *data, uint16_t len));
+
+#endif /* NBLE_RPC_PACK_H_ */
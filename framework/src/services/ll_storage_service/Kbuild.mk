@@ -28,5 +28,6 @@
 
 ifeq ($(CONFIG_QUARK_SE_QUARK),y)
 obj-$(CONFIG_SERVICES_QUARK_SE_LL_STORAGE_IMPL)  += ll_storage_service.o
+obj-$(CONFIG_SERVICES_QUARK_SE_LL_STORAGE_IMPL)  += ll_storage_cache.o
 obj-$(CONFIG_SERVICES_QUARK_SE_LL_STORAGE)       += ll_storage_service_api.o
 endif
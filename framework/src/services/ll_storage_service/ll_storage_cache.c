@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "ll_storage_cache.h"
+
+/* Unlink line i from the LRU list */
+static void lru_remove(struct ll_storage_cache *cache, uint8_t i)
+{
+	struct ll_storage_cache_line *line = &cache->lines[i];
+
+	cache->lines[line->prev].next = line->next;
+	cache->lines[line->next].prev = line->prev;
+	if (cache->mru == i)
+		cache->mru = line->next;
+}
+
+/* Insert line i before the head of the LRU list */
+static void lru_insert(struct ll_storage_cache *cache, uint8_t i)
+{
+	struct ll_storage_cache_line *line = &cache->lines[i];
+	struct ll_storage_cache_line *head = &cache->lines[cache->mru];
+
+	line->next = cache->mru;
+	line->prev = head->prev;
+	cache->lines[head->prev].next = i;
+	head->prev = i;
+}
+
+/* Make line i the most recently used one */
+static void lru_touch(struct ll_storage_cache *cache, uint8_t i)
+{
+	if (cache->mru == i)
+		return;
+	lru_remove(cache, i);
+	lru_insert(cache, i);
+	cache->mru = i;
+}
+
+/* Make line i the least recently used one */
+static void lru_drop(struct ll_storage_cache *cache, uint8_t i)
+{
+	if (cache->lines[cache->mru].prev == i)
+		return;
+	lru_remove(cache, i);
+	lru_insert(cache, i);
+}
+
+void ll_storage_cache_init(struct ll_storage_cache *cache,
+			   struct ll_storage_cache_line *lines, uint8_t *data,
+			   uint8_t nb_lines, uint16_t line_size,
+			   ll_storage_cache_read_t read, void *priv)
+{
+	int i;
+
+	memset(cache, 0, sizeof(*cache));
+	cache->lines = lines;
+	cache->data = data;
+	cache->nb_lines = nb_lines;
+	cache->line_size = line_size;
+	cache->read = read;
+	cache->priv = priv;
+
+	/* Circular list: the LRU line is the one before the MRU line */
+	for (i = 0; i < nb_lines; i++) {
+		lines[i].valid = 0;
+		lines[i].prev = i ? i - 1 : nb_lines - 1;
+		lines[i].next = i + 1 < nb_lines ? i + 1 : 0;
+	}
+}
+
+/* Return the line holding address, or -1. The list is walked from the MRU
+ * line so that hot lines are found first. */
+static int lookup(struct ll_storage_cache *cache, uint16_t flash_id,
+		  uint32_t address)
+{
+	uint8_t i = cache->mru;
+	int n;
+
+	for (n = 0; n < cache->nb_lines; n++) {
+		struct ll_storage_cache_line *line = &cache->lines[i];
+
+		if (!line->valid)
+			/* Invalid lines are at the LRU end of the list */
+			return -1;
+		if (line->address == address && line->flash_id == flash_id)
+			return i;
+		i = line->next;
+	}
+	return -1;
+}
+
+/* Take the least recently used line for address, its data is to be set */
+static uint8_t alloc_line(struct ll_storage_cache *cache, uint16_t flash_id,
+			  uint32_t address)
+{
+	uint8_t i = cache->lines[cache->mru].prev;
+
+	if (cache->lines[i].valid)
+		cache->stats.evictions++;
+	cache->lines[i].address = address;
+	cache->lines[i].flash_id = flash_id;
+	cache->lines[i].valid = 1;
+	lru_touch(cache, i);
+	return i;
+}
+
+int ll_storage_cache_read(struct ll_storage_cache *cache, uint16_t flash_id,
+			  uint32_t address, uint32_t len, uint8_t *buf)
+{
+	uint32_t mask = cache->line_size - 1;
+	uint32_t first = address & ~mask;
+	uint32_t line_addr, offset, count, missing = 0;
+	int i, ret;
+
+	if (len == 0)
+		return 0;
+
+	if (len > (uint32_t)cache->nb_lines * cache->line_size / 2) {
+		cache->stats.bypasses++;
+		return cache->read(cache->priv, flash_id, address,
+				   (len + 3) & ~3, buf);
+	}
+
+	if (first == ((address + len - 1) & ~mask)) {
+		/* Within one line: fill it on a miss */
+		offset = address & mask;
+		if ((i = lookup(cache, flash_id, first)) >= 0) {
+			cache->stats.hits++;
+			lru_touch(cache, i);
+		} else {
+			/* The line is read in place, it is lost on error */
+			i = alloc_line(cache, flash_id, first);
+			ret = cache->read(cache->priv, flash_id, first,
+					  cache->line_size,
+					  cache->data + i * cache->line_size);
+			if (ret) {
+				cache->lines[i].valid = 0;
+				lru_drop(cache, i);
+				return ret;
+			}
+			cache->stats.misses++;
+		}
+		memcpy(buf, cache->data + i * cache->line_size + offset, len);
+		return 0;
+	}
+
+	/* Several lines: served from the cache if they are all there,
+	 * otherwise read from the flash in one go */
+	for (line_addr = first; line_addr < address + len;
+	     line_addr += cache->line_size)
+		if (lookup(cache, flash_id, line_addr) < 0)
+			missing++;
+
+	if (missing) {
+		ret = cache->read(cache->priv, flash_id, address,
+				  (len + 3) & ~3, buf);
+		if (ret)
+			return ret;
+		cache->stats.misses += missing;
+	}
+
+	for (line_addr = first; line_addr < address + len;
+	     line_addr += cache->line_size) {
+		offset = line_addr < address ? address - line_addr : 0;
+		count = cache->line_size - offset;
+		if (count > address + len - line_addr - offset)
+			count = address + len - line_addr - offset;
+
+		i = lookup(cache, flash_id, line_addr);
+		if (i >= 0) {
+			lru_touch(cache, i);
+			if (missing)
+				continue;
+			cache->stats.hits++;
+			memcpy(buf + line_addr + offset - address,
+			       cache->data + i * cache->line_size + offset,
+			       count);
+		} else if (count == cache->line_size) {
+			/* Keep the lines fully read */
+			i = alloc_line(cache, flash_id, line_addr);
+			memcpy(cache->data + i * cache->line_size,
+			       buf + line_addr - address, count);
+		}
+	}
+	return 0;
+}
+
+void ll_storage_cache_invalidate(struct ll_storage_cache *cache,
+				 uint16_t flash_id, uint32_t address,
+				 uint32_t len)
+{
+	uint32_t first = address & ~(cache->line_size - 1);
+	int i;
+
+	if (len == 0)
+		return;
+
+	for (i = 0; i < cache->nb_lines; i++) {
+		struct ll_storage_cache_line *line = &cache->lines[i];
+
+		if (line->valid && line->flash_id == flash_id &&
+		    line->address >= first && line->address < address + len) {
+			line->valid = 0;
+			cache->stats.invalidations++;
+			lru_drop(cache, i);
+		}
+	}
+}
+
+void ll_storage_cache_get_stats(struct ll_storage_cache *	cache,
+				struct ll_storage_cache_stats * stats,
+				bool				reset)
+{
+	*stats = cache->stats;
+	if (reset)
+		memset(&cache->stats, 0, sizeof(cache->stats));
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LL_STORAGE_CACHE_H__
+#define __LL_STORAGE_CACHE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Read-through LRU cache of flash lines.
+ *
+ * The cache holds nb_lines lines of line_size bytes, tagged by flash id and
+ * line aligned address. A read within one line fills the line on a miss. A
+ * read over several lines is served from the cache when all of them are
+ * there, otherwise it is done with one flash read and the lines it fully
+ * covers are kept: a read never costs more flash accesses than without the
+ * cache. Reads of more than half the cache bypass it so that a sequential
+ * scan does not evict the hot lines; with nb_lines set to 0 all reads bypass
+ * the cache. Writes and erases go straight to the flash and invalidate the
+ * lines they overlap, so the flash is always up to date.
+ * This module does not touch the hardware and can be built on the host.
+ */
+
+/**
+ * Read callback: read len bytes of flash flash_id at address into buf.
+ * address and len are multiple of 4.
+ *
+ * @return 0 on success, an error code otherwise
+ */
+typedef int (*ll_storage_cache_read_t)(void *priv, uint16_t flash_id,
+				       uint32_t address, uint32_t len,
+				       uint8_t *buf);
+
+/** Cache counters */
+struct ll_storage_cache_stats {
+	uint32_t hits;          /*!< Lines read from the cache */
+	uint32_t misses;        /*!< Lines read from the flash */
+	uint32_t evictions;     /*!< Valid lines replaced by new ones */
+	uint32_t invalidations; /*!< Lines invalidated by a write or an erase */
+	uint32_t bypasses;      /*!< Reads too large to go through the cache */
+};
+
+struct ll_storage_cache_line {
+	uint32_t address;       /*!< Line aligned flash address */
+	uint16_t flash_id;      /*!< Flash of the line */
+	uint8_t valid;
+	uint8_t prev;           /*!< Previous line in the LRU list */
+	uint8_t next;           /*!< Next line in the LRU list */
+};
+
+struct ll_storage_cache {
+	struct ll_storage_cache_line *lines;
+	uint8_t *data;          /*!< nb_lines * line_size bytes */
+	uint16_t line_size;
+	uint8_t nb_lines;
+	uint8_t mru;            /*!< Head of the LRU list */
+	ll_storage_cache_read_t read;
+	void *priv;
+	struct ll_storage_cache_stats stats;
+};
+
+/**
+ * Initialize a cache.
+ *
+ * @param cache     cache to initialize
+ * @param lines     nb_lines line descriptors
+ * @param data      nb_lines * line_size bytes, 4 bytes aligned
+ * @param nb_lines  number of lines, up to 255
+ * @param line_size size of a line, power of 2 and multiple of 4
+ * @param read      flash read callback
+ * @param priv      private data passed to read
+ */
+void ll_storage_cache_init(struct ll_storage_cache *cache,
+			   struct ll_storage_cache_line *lines, uint8_t *data,
+			   uint8_t nb_lines, uint16_t line_size,
+			   ll_storage_cache_read_t read, void *priv);
+
+/**
+ * Read bytes of flash through the cache.
+ *
+ * @param cache     cache to use
+ * @param flash_id  flash to read
+ * @param address   address of the first byte to read, multiple of 4
+ * @param len       number of bytes to read
+ * @param buf       where to store the data, len bytes rounded up to a
+ *                  multiple of 4
+ *
+ * @return 0 on success, the error of the read callback otherwise
+ */
+int ll_storage_cache_read(struct ll_storage_cache *cache, uint16_t flash_id,
+			  uint32_t address, uint32_t len, uint8_t *buf);
+
+/**
+ * Invalidate the lines overlapping a range of flash.
+ *
+ * To be called after any write or erase of the range.
+ *
+ * @param cache     cache to use
+ * @param flash_id  flash written
+ * @param address   address of the first byte written
+ * @param len       number of bytes written
+ */
+void ll_storage_cache_invalidate(struct ll_storage_cache *cache,
+				 uint16_t flash_id, uint32_t address,
+				 uint32_t len);
+
+/**
+ * Get the cache counters.
+ *
+ * @param cache     cache to use
+ * @param stats     where to copy the counters
+ * @param reset     clear the counters after the copy
+ */
+void ll_storage_cache_get_stats(struct ll_storage_cache *	cache,
+				struct ll_storage_cache_stats * stats,
+				bool				reset);
+
+#endif /* __LL_STORAGE_CACHE_H__ */
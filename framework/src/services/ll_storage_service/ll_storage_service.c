@@ -28,7 +28,10 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <string.h>
+
 #include "infra/log.h"
+#include "util/misc.h"
 
 #include "cfw/cfw.h"
 #include "cfw/cfw_service.h"
@@ -41,6 +44,12 @@
 #include "services/services_ids.h"
 #include "services/ll_storage_service/ll_storage_service.h"
 #include "ll_storage_service_private.h"
+#include "ll_storage_cache.h"
+
+#ifdef CONFIG_TCMD
+#include <stdio.h>
+#include "infra/tcmd/handler.h"
+#endif
 
 /****************************************************************************************
 ************************** SERVICE INITIALIZATION **************************************
@@ -58,18 +67,37 @@ static service_t ll_storage_service = {
 
 extern const flash_device_t flash_devices[];
 
-
+/* No partition for this ID in the lookup table */
+#define PARTITION_NONE 0xff
 
 static struct {
 	flash_partition_t *partitions;
 	uint8_t no_part;
+	/* Index in partitions of each partition ID */
+	uint8_t part_lut[NUMBER_OF_PARTITIONS];
+	struct ll_storage_cache cache;
 } ll_storage_config;
 
 DEFINE_LOG_MODULE(LOG_MODULE_LL_STORAGE_SERVICE, "LLST")
 
+static int flash_read(void *priv, uint16_t flash_id, uint32_t address,
+		      uint32_t len, uint8_t *buf);
+
 /* Init and Configure partitions seen by the Storage Service. */
 static void ll_storage_service_init(int service_id, void *queue)
 {
+	const int nb_lines = CONFIG_SERVICES_QUARK_SE_LL_STORAGE_CACHE_LINES;
+	const int line_size =
+		CONFIG_SERVICES_QUARK_SE_LL_STORAGE_CACHE_LINE_SIZE;
+	struct ll_storage_cache_line *lines = NULL;
+	uint8_t *data = NULL;
+	int i;
+
+	/* Lines are found by masking the address */
+	BUILD_BUG_ON(CONFIG_SERVICES_QUARK_SE_LL_STORAGE_CACHE_LINE_SIZE < 4 ||
+		     (CONFIG_SERVICES_QUARK_SE_LL_STORAGE_CACHE_LINE_SIZE &
+		      (CONFIG_SERVICES_QUARK_SE_LL_STORAGE_CACHE_LINE_SIZE - 1)));
+
 	cfw_register_service(queue, &ll_storage_service, handle_message, NULL);
 
 	/* Flash memory partitioning array */
@@ -77,6 +105,24 @@ static void ll_storage_service_init(int service_id, void *queue)
 
 	ll_storage_config.partitions = storage_configuration;
 	ll_storage_config.no_part = NUMBER_OF_PARTITIONS;
+
+	/* The first partition declared with an ID wins, as with a linear
+	 * search of the partitions */
+	memset(ll_storage_config.part_lut, PARTITION_NONE,
+	       sizeof(ll_storage_config.part_lut));
+	for (i = ll_storage_config.no_part - 1; i >= 0; i--)
+		if (storage_configuration[i].partition_id <
+		    NUMBER_OF_PARTITIONS)
+			ll_storage_config.part_lut[storage_configuration[i].
+						   partition_id] = i;
+
+	if (nb_lines) {
+		/* If allocation fails it will panic */
+		lines = balloc(nb_lines * sizeof(*lines), NULL);
+		data = balloc(nb_lines * line_size, NULL);
+	}
+	ll_storage_cache_init(&ll_storage_config.cache, lines, data, nb_lines,
+			      line_size, flash_read, NULL);
 }
 
 CFW_DECLARE_SERVICE(ll_storage, LL_STOR_SERVICE_ID, ll_storage_service_init);
@@ -95,6 +141,83 @@ static void ll_storage_client_disconnected(conn_handle_t *instance)
 	pr_debug(LOG_MODULE_LL_STORAGE_SERVICE, "%s: ", __func__);
 }
 
+/* Return the partition of an ID, NULL if there is none */
+static const flash_partition_t *get_partition(uint16_t partition_id)
+{
+	uint8_t i;
+
+	if (partition_id >= NUMBER_OF_PARTITIONS)
+		return NULL;
+	i = ll_storage_config.part_lut[partition_id];
+	return i == PARTITION_NONE ? NULL : &ll_storage_config.partitions[i];
+}
+
+/* Cache read callback, len is a multiple of 4 */
+static int flash_read(void *priv, uint16_t flash_id, uint32_t address,
+		      uint32_t len, uint8_t *buf)
+{
+	unsigned int retlen = 0;
+	DRIVER_API_RC ret = DRV_RC_FAIL;
+
+	if (flash_devices[flash_id].flash_location == EMBEDDED_FLASH) {
+		ret = soc_flash_read(address, len / sizeof(uint32_t), &retlen,
+				     (uint32_t *)buf);
+#ifdef CONFIG_SPI_FLASH
+	} else { // SERIAL_FLASH
+		ret = spi_flash_read(
+			(struct td_device *)&pf_sba_device_flash_spi0,
+			address, len / sizeof(uint32_t), &retlen,
+			(uint32_t *)buf);
+#endif
+	}
+	if (ret == DRV_RC_OK && retlen != len / sizeof(uint32_t))
+		ret = DRV_RC_FAIL;
+	return ret;
+}
+
+/* Write size dwords, the cache is invalidated even on failure */
+static DRIVER_API_RC flash_write(uint16_t flash_id, uint32_t address,
+				 uint32_t size, unsigned int *retlen,
+				 uint32_t *buffer)
+{
+	DRIVER_API_RC ret = DRV_RC_FAIL;
+
+	if (flash_devices[flash_id].flash_location == EMBEDDED_FLASH) {
+		ret = soc_flash_write(address, size, retlen, buffer);
+#ifdef CONFIG_SPI_FLASH
+	} else { // SERIAL_FLASH
+		ret = spi_flash_write(
+			(struct td_device *)&pf_sba_device_flash_spi0,
+			address, size, retlen, buffer);
+#endif
+	}
+	ll_storage_cache_invalidate(&ll_storage_config.cache, flash_id,
+				    address, size * sizeof(uint32_t));
+	return ret;
+}
+
+/* Erase count blocks, the cache is invalidated even on failure */
+static DRIVER_API_RC flash_erase(uint16_t flash_id, uint32_t start_block,
+				 uint32_t count)
+{
+	const flash_device_t *flash = &flash_devices[flash_id];
+	DRIVER_API_RC ret = DRV_RC_FAIL;
+
+	if (flash->flash_location == EMBEDDED_FLASH) {
+		ret = soc_flash_block_erase(start_block, count);
+#ifdef CONFIG_SPI_FLASH
+	} else { // SERIAL_FLASH
+		ret = spi_flash_sector_erase(
+			(struct td_device *)&pf_sba_device_flash_spi0,
+			start_block, count);
+#endif
+	}
+	ll_storage_cache_invalidate(&ll_storage_config.cache, flash_id,
+				    start_block * flash->block_size,
+				    count * flash->block_size);
+	return ret;
+}
+
 void handle_erase_block(struct cfw_message *msg)
 {
 	ll_storage_erase_block_req_msg_t *req =
@@ -105,10 +228,7 @@ void handle_erase_block(struct cfw_message *msg)
 			MSG_ID_LL_STORAGE_SERVICE_ERASE_BLOCK_RSP,
 			sizeof(*resp));
 
-	flash_device_t flash;
-	uint16_t flash_id = 0;
-	int16_t partition_index = -1;
-	uint32_t i = 0;
+	const flash_partition_t *part;
 	DRIVER_API_RC ret = DRV_RC_FAIL;
 
 	if (req->no_blks == 0) {
@@ -118,15 +238,7 @@ void handle_erase_block(struct cfw_message *msg)
 		goto send;
 	}
 
-	for (i = 0; i < ll_storage_config.no_part; i++)
-		if (ll_storage_config.partitions[i].partition_id ==
-		    req->partition_id) {
-			flash_id = ll_storage_config.partitions[i].flash_id;
-			partition_index = i;
-			break;
-		}
-
-	if (partition_index == -1) {
+	if ((part = get_partition(req->partition_id)) == NULL) {
 		pr_debug(
 			LOG_MODULE_LL_STORAGE_SERVICE,
 			"LL Storage Service - Write Block: Invalid partition ID");
@@ -134,37 +246,18 @@ void handle_erase_block(struct cfw_message *msg)
 		goto send;
 	}
 
-	uint16_t last_block =
-		ll_storage_config.partitions[partition_index].start_block +
-		req->st_blk + req->no_blks - 1;
+	uint16_t last_block = part->start_block + req->st_blk +
+			      req->no_blks - 1;
 
-	if (last_block >
-	    ll_storage_config.partitions[partition_index].end_block) {
+	if (last_block > part->end_block) {
 		pr_debug(LOG_MODULE_LL_STORAGE_SERVICE,
 			 "LL Storage Service - Write Block: Partition overflow");
 		ret = DRV_RC_OUT_OF_MEM;
 		goto send;
 	}
 
-	flash = flash_devices[flash_id];
-
-	if (flash.flash_location == EMBEDDED_FLASH) {
-		ret =
-			soc_flash_block_erase(
-				ll_storage_config.partitions[partition_index].
-				start_block +
-				req->st_blk, req->no_blks);
-	}
-#ifdef CONFIG_SPI_FLASH
-	else {
-		// SERIAL_FLASH
-		ret = spi_flash_sector_erase(
-			(struct td_device *)&pf_sba_device_flash_spi0,
-			ll_storage_config.partitions[
-				partition_index].start_block + req->st_blk,
-			req->no_blks);
-	}
-#endif
+	ret = flash_erase(part->flash_id, part->start_block + req->st_blk,
+			  req->no_blks);
 
 send:
 	resp->status = ret;
@@ -181,10 +274,8 @@ void handle_write_partition(struct cfw_message *msg)
 			MSG_ID_LL_STORAGE_SERVICE_WRITE_RSP,
 			sizeof(*resp));
 
-	flash_device_t flash;
-	uint16_t flash_id = 0;
-	int16_t partition_index = -1;
-	uint32_t i = 0;
+	const flash_device_t *flash;
+	const flash_partition_t *part;
 	uint32_t size = 0;
 	unsigned int retlen = 0;
 	DRIVER_API_RC ret = DRV_RC_FAIL;
@@ -204,15 +295,7 @@ void handle_write_partition(struct cfw_message *msg)
 		goto send;
 	}
 
-	for (i = 0; i < ll_storage_config.no_part; i++)
-		if (ll_storage_config.partitions[i].partition_id ==
-		    req->partition_id) {
-			flash_id = ll_storage_config.partitions[i].flash_id;
-			partition_index = i;
-			break;
-		}
-
-	if (partition_index == -1) {
+	if ((part = get_partition(req->partition_id)) == NULL) {
 		pr_debug(
 			LOG_MODULE_LL_STORAGE_SERVICE,
 			"LL Storage Service - Write Data: Invalid partition ID");
@@ -220,13 +303,12 @@ void handle_write_partition(struct cfw_message *msg)
 		goto send;
 	}
 
-	flash = flash_devices[flash_id];
+	flash = &flash_devices[part->flash_id];
 
 	if ((req->write_type == WRITE_REQ) &&
-	    (((ll_storage_config.partitions[partition_index].start_block *
-	       flash.block_size) + (req->st_offset + req->size))
-	     > ((ll_storage_config.partitions[partition_index].end_block +
-		 1) * flash.block_size))) {
+	    (((part->start_block * flash->block_size) +
+	      (req->st_offset + req->size))
+	     > ((part->end_block + 1) * flash->block_size))) {
 		pr_debug(LOG_MODULE_LL_STORAGE_SERVICE,
 			 "LL Storage Service - Write Data: Partition overflow");
 		ret = DRV_RC_OUT_OF_MEM;
@@ -236,47 +318,15 @@ void handle_write_partition(struct cfw_message *msg)
 	size = req->size / sizeof(uint32_t) + !!(req->size % sizeof(uint32_t));
 
 	if (req->write_type == ERASE_REQ) {
-		if (flash.flash_location == EMBEDDED_FLASH) {
-			ret = soc_flash_block_erase(
-				ll_storage_config.partitions[partition_index].
-				start_block,
-				(ll_storage_config.
-				 partitions[partition_index
-				 ].end_block -
-				 ll_storage_config.
-				 partitions[partition_index].
-				 start_block) + 1);
-#ifdef CONFIG_SPI_FLASH
-		} else { // SERIAL_FLASH
-			ret = spi_flash_sector_erase(
-				(struct td_device *)&pf_sba_device_flash_spi0,
-				ll_storage_config.
-				partitions[partition_index].start_block,
-				(ll_storage_config.
-				 partitions[
-					 partition_index].end_block -
-				 ll_storage_config.
-				 partitions[partition_index].
-				 start_block) + 1);
-#endif
-		}
+		ret = flash_erase(part->flash_id, part->start_block,
+				  (part->end_block - part->start_block) + 1);
 	} else {
 		uint32_t address =
-			((ll_storage_config.partitions[partition_index].
-			  start_block *
-			  flash.block_size) + req->st_offset);
+			((part->start_block * flash->block_size) +
+			 req->st_offset);
 
-		if (flash.flash_location == EMBEDDED_FLASH) {
-			ret = soc_flash_write(address, size, &retlen,
-					      req->buffer);
-#ifdef CONFIG_SPI_FLASH
-		} else { // SERIAL_FLASH
-			ret = spi_flash_write(
-				(struct td_device *)&pf_sba_device_flash_spi0,
-				address, size, &retlen,
-				req->buffer);
-#endif
-		}
+		ret = flash_write(part->flash_id, address, size, &retlen,
+				  req->buffer);
 
 		resp->actual_size =
 			(retlen *
@@ -303,12 +353,9 @@ void handle_read_partition(struct cfw_message *msg)
 			MSG_ID_LL_STORAGE_SERVICE_READ_RSP,
 			sizeof(*resp));
 
-	flash_device_t flash;
-	uint16_t flash_id = 0;
-	int16_t partition_index = -1;
-	uint32_t i = 0;
+	const flash_device_t *flash;
+	const flash_partition_t *part;
 	uint32_t size = 0;
-	unsigned int retlen = 0;
 	DRIVER_API_RC ret = DRV_RC_FAIL;
 
 	if (req->size == 0) {
@@ -318,27 +365,18 @@ void handle_read_partition(struct cfw_message *msg)
 		goto send;
 	}
 
-	for (i = 0; i < ll_storage_config.no_part; i++)
-		if (ll_storage_config.partitions[i].partition_id ==
-		    req->partition_id) {
-			flash_id = ll_storage_config.partitions[i].flash_id;
-			partition_index = i;
-			break;
-		}
-
-	if (partition_index == -1) {
+	if ((part = get_partition(req->partition_id)) == NULL) {
 		pr_debug(LOG_MODULE_LL_STORAGE_SERVICE,
 			 "LL Storage Service - Read Data: Invalid partition ID");
 		ret = DRV_RC_FAIL;
 		goto send;
 	}
 
-	flash = flash_devices[flash_id];
+	flash = &flash_devices[part->flash_id];
 
-	if (((ll_storage_config.partitions[partition_index].start_block *
-	      flash.block_size) + (req->st_offset + req->size))
-	    > ((ll_storage_config.partitions[partition_index].end_block +
-		1) * flash.block_size)) {
+	if (((part->start_block * flash->block_size) +
+	     (req->st_offset + req->size))
+	    > ((part->end_block + 1) * flash->block_size)) {
 		pr_debug(LOG_MODULE_LL_STORAGE_SERVICE,
 			 "LL Storage Service - Read Data: Partition overflow");
 		ret = DRV_RC_OUT_OF_MEM;
@@ -348,25 +386,19 @@ void handle_read_partition(struct cfw_message *msg)
 	size = (req->size / sizeof(uint32_t)) + !!(req->size % sizeof(uint32_t));
 
 	uint32_t address =
-		((ll_storage_config.partitions[partition_index].start_block *
-		  flash.block_size) + req->st_offset);
+		((part->start_block * flash->block_size) + req->st_offset);
 	resp->buffer = balloc(size * sizeof(uint32_t), NULL);
 
-	if (flash.flash_location == EMBEDDED_FLASH) {
-		ret = soc_flash_read(address, size, &retlen, resp->buffer);
-#ifdef CONFIG_SPI_FLASH
-	} else { // SERIAL_FLASH
-		ret = spi_flash_read(
-			(struct td_device *)&pf_sba_device_flash_spi0,
-			address, size, &retlen, resp->buffer);
-#endif
-	}
+	/* Partitions also written outside of the service are not cached */
+	if (part->cacheable)
+		ret = ll_storage_cache_read(&ll_storage_config.cache,
+					    part->flash_id, address, req->size,
+					    resp->buffer);
+	else
+		ret = flash_read(NULL, part->flash_id, address,
+				 size * sizeof(uint32_t), resp->buffer);
 
-	resp->actual_read_size =
-		(retlen * sizeof(uint32_t)) - (((req->size % sizeof(uint32_t)))
-					       ? (4 -
-						  (req->size %
-						   sizeof(uint32_t))) : 0);
+	resp->actual_read_size = ret == DRV_RC_OK ? req->size : 0;
 
 send:
 	resp->status = ret;
@@ -393,3 +425,22 @@ static void handle_message(struct cfw_message *msg, void *param)
 
 	cfw_msg_free(msg);
 }
+
+#ifdef CONFIG_TCMD
+void ll_storage_cache_tcmd(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
+{
+	struct ll_storage_cache_stats stats;
+	char tmp[80];
+
+	ll_storage_cache_get_stats(&ll_storage_config.cache, &stats,
+				   argc > 2 && !strcmp(argv[2], "reset"));
+	snprintf(tmp, sizeof(tmp),
+		 "hits:%u misses:%u evictions:%u inval:%u bypasses:%u",
+		 (unsigned int)stats.hits, (unsigned int)stats.misses,
+		 (unsigned int)stats.evictions,
+		 (unsigned int)stats.invalidations,
+		 (unsigned int)stats.bypasses);
+	TCMD_RSP_FINAL(ctx, tmp);
+}
+DECLARE_TEST_COMMAND_ENG(dbg, llcache, ll_storage_cache_tcmd);
+#endif
@@ -34,6 +34,7 @@
 #include "infra/properties_storage.h"
 
 #include "cfw/cfw_service.h"
+#include "services/storage_task.h"
 
 #include "properties_service_internal.h"
 #include "services/properties_service/properties_service.h"
@@ -185,6 +186,25 @@ static void handle_remove_property(struct cfw_message *msg)
 	cfw_send_message(rsp);
 }
 
+static bool compaction_posted;
+
+/* Run the compaction one step at a time so that pending requests are
+ * processed in between */
+static void compaction_job(void *param)
+{
+	if (properties_storage_compact_step())
+		xloop_post_func(storage_task_get_xloop(), compaction_job, NULL);
+	else
+		compaction_posted = false;
+}
+
+static void schedule_compaction(void)
+{
+	if (compaction_posted)
+		return;
+	compaction_posted = true;
+	xloop_post_func(storage_task_get_xloop(), compaction_job, NULL);
+}
 
 static void handle_request(struct cfw_message *msg, void *param)
 {
@@ -194,12 +214,15 @@ static void handle_request(struct cfw_message *msg, void *param)
 		break;
 	case MSG_ID_PROP_SERVICE_REMOVE_PROP_REQ:
 		handle_remove_property(msg);
+		schedule_compaction();
 		break;
 	case MSG_ID_PROP_SERVICE_WRITE_PROP_REQ:
 		handle_write_property(msg);
+		schedule_compaction();
 		break;
 	case MSG_ID_PROP_SERVICE_ADD_PROP_REQ:
 		handle_add_property(msg);
+		schedule_compaction();
 		break;
 	default:
 		cfw_print_default_handle_error_msg(LOG_MODULE_MAIN,
@@ -227,6 +250,7 @@ static void property_service_init(int id, void *queue)
 {
 	properties_storage_init();
 	cfw_register_service(queue, &properties_service, handle_request, NULL);
+	schedule_compaction();
 }
 
 CFW_DECLARE_SERVICE(properties, PROPERTIES_SERVICE_ID, property_service_init);
@@ -294,4 +318,64 @@ error_msg:
 }
 DECLARE_TEST_COMMAND_ENG(property, read, tcmd_property_read);
 
+#define PROPERTY_STATS_MAX_BLOCKS 8
+
+static void tcmd_property_stats_partition(bool				persistent,
+					  struct tcmd_handler_ctx *	ctx)
+{
+	struct properties_storage_stats stats;
+	struct properties_storage_block_stats blocks[PROPERTY_STATS_MAX_BLOCKS];
+	char tmp[80];
+	int i;
+
+	properties_storage_get_stats(persistent, &stats, blocks,
+				     PROPERTY_STATS_MAX_BLOCKS);
+
+	/* Write amplification in hundredths */
+	snprintf(tmp, sizeof(tmp),
+		 "%s: free %u written %u copied %u wa %u sync %u",
+		 persistent ? "persistent" : "non persistent",
+		 stats.free_bytes, stats.user_bytes, stats.copied_bytes,
+		 stats.user_bytes ? (unsigned int)((stats.user_bytes +
+						    stats.copied_bytes) * 100ULL /
+						   stats.user_bytes) : 0,
+		 stats.sync_compactions);
+	TCMD_RSP_PROVISIONAL(ctx, tmp);
+
+	for (i = 0; i < stats.nb_blocks && i < PROPERTY_STATS_MAX_BLOCKS;
+	     i++) {
+		snprintf(tmp, sizeof(tmp),
+			 " %d: seq %u live %u obsolete %u free %u erases %u", i,
+			 blocks[i].seq, blocks[i].live_bytes,
+			 blocks[i].obsolete_bytes, blocks[i].free_bytes,
+			 blocks[i].erase_count);
+		TCMD_RSP_PROVISIONAL(ctx, tmp);
+	}
+}
+
+/*
+ * Test command to get usage and wear statistics of the properties storage:
+ * property stats
+ *
+ * Write amplification (wa) is given in hundredths.
+ *
+ * @param[in]   argc        Number of arguments in the Test Command (including group and name)
+ * @param[in]   argv        Table of null-terminated buffers containing the arguments
+ * @param[in]   ctx         The context to pass back to responses
+ */
+static void tcmd_property_stats(int			argc,
+				char *			argv[],
+				struct tcmd_handler_ctx *ctx)
+{
+	if (argc != 2) {
+		TCMD_RSP_ERROR(ctx, TCMD_ERROR_MSG_INV_ARG);
+		return;
+	}
+
+	tcmd_property_stats_partition(true, ctx);
+	tcmd_property_stats_partition(false, ctx);
+	TCMD_RSP_FINAL(ctx, NULL);
+}
+DECLARE_TEST_COMMAND_ENG(property, stats, tcmd_property_stats);
+
 #endif
@@ -1,6 +1,7 @@
 ifdef CONFIG_SERVICES_SENSOR_IMPL
 obj-y += sensor_svc.o
 obj-y += sensor_svc_list.o
+obj-y += sensor_svc_batch.o
 obj-y += sensor_svc_utils.o
 obj-y += sensor_svc_calibration.o
 obj-$(CONFIG_QUARK_SE_ARC) += svc_platform_arc.o
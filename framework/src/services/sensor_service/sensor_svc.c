@@ -31,6 +31,7 @@
 #include "os/os.h"
 #include "cfw/cfw_service.h"
 #include "infra/message.h"
+#include "infra/time.h"
 
 #include "sensors/sensor_core/open_core/sc_exposed.h"
 #include "sensor_svc.h"
@@ -39,6 +40,7 @@
 #include "sensor_svc_platform.h"
 #include "sensor_svc_utils.h"
 #include "sensor_svc_calibration.h"
+#include "sensor_svc_batch.h"
 
 uint16_t ss_svc_port_id = 0;
 #define SENSOR_FSM_SWITCH(cur_status, flag)			\
@@ -73,10 +75,6 @@ uint16_t ss_svc_port_id = 0;
 
 #define TO_CLIENT_ARBIT_LIST(p_client_handle) container_of( \
 		p_client_handle, client_arbit_info_list_t, p_handle)
-#define GET_DST_PORT(client_handle) (((conn_handle_t *)(((cfw_service_conn_t *)( \
-								 client_handle)) \
-							->server_handle))-> \
-				     client_port)
 #define IS_CONNECTED_STATUS(status) ((status) == PAIRED ? 1 :	\
 				     ((status) == SUBSCRIBING ? 1 :    \
 				      ((status) == SUBSCRIBED ? 1 :	\
@@ -532,11 +530,26 @@ void ss_send_subscribing_evt_msg_to_clients(sensor_service_t sensor_handle,
 		(client_arbit_info_list_t *)p_list->arbit_info_list_header.head;
 
 	int err = -1;
+	bool batched = false;
+	uint32_t now = get_uptime_ms();
 
 	while (l) {
 		if (l->arbit_info.conn_status == SUBSCRIBED ||
 		    l->arbit_info.conn_status == SUBSCRIBE_EVENT) {
 			l->arbit_info.conn_status = SUBSCRIBE_EVENT; /* Update client's connection status */
+			err = 0;
+			if (l->arbit_info.subscribe_data_param.batch_count) {
+				/* Falls back to single events without batch */
+				if (l->batch == NULL) {
+					ss_batch_attach(p_list, l);
+				}
+				if (l->batch) {
+					batched = true;
+					l = (client_arbit_info_list_t *)
+					    l->list.next;
+					continue;
+				}
+			}
 			sensor_service_subscribe_data_event_t *p_msg =
 				(sensor_service_subscribe_data_event_t *)
 				cfw_alloc_message(
@@ -556,14 +569,20 @@ void ss_send_subscribing_evt_msg_to_clients(sensor_service_t sensor_handle,
 			p_msg->sensor_data_header.subscription_type = data_type;
 			p_msg->sensor_data_header.timestamp = timestamp;
 			data_cpy(p_msg->sensor_data_header.data, p_data, len);
-			send_evt_msg_to_client(
-				(struct cfw_message *)p_msg, l->p_handle,
-				MSG_ID_SENSOR_SERVICE_SUBSCRIBE_DATA_EVT,
-				l->priv_from_client);
-			err = 0;
+			if (send_evt_msg_to_client(
+				    (struct cfw_message *)p_msg, l->p_handle,
+				    MSG_ID_SENSOR_SERVICE_SUBSCRIBE_DATA_EVT,
+				    l->priv_from_client) == SS_STATUS_SUCCESS) {
+				ss_subscription_account(l, 1, 0, now);
+			}
 		}
 		l = (client_arbit_info_list_t *)l->list.next;
 	}
+	if (batched) {
+		/* Copied once for all the clients sharing each batch */
+		ss_batch_add_sample(sensor_handle, data_type, timestamp, p_data,
+				    len);
+	}
 	if (err == -1) {
 		/* there chances that after sending unsubscribe to sensor core,
 		 * sensor service still received sensor data. This is because
@@ -1086,6 +1105,11 @@ static void ss_svc_subscribe_handler(ss_sensor_subscribe_data_req_t *	p_req,
 #endif
 		goto EXIT;
 	}
+	/* The batch matching the new parameters is joined on the first data */
+	ss_batch_detach(l);
+	l->arbit_info.subscribe_data_param.batch_count = p_req->batch_count;
+	l->arbit_info.subscribe_data_param.batch_latency = p_req->batch_latency;
+	memset(&l->stats, 0, sizeof(l->stats));
 	uint8_t arbitrating_is_ok = ss_sensor_new_status_arbit(p_list,
 							       SUBSCRIBING);
 	switch (arbitrating_is_ok) {
@@ -1219,6 +1243,7 @@ static void ss_svc_unsubscribe_handler(
 #endif
 		goto EXIT;
 	}
+	ss_batch_detach(l);
 	uint8_t arbitrating_is_ok = ss_sensor_new_status_arbit(p_list,
 							       UNSUBSCRIBING);
 	client_arbit_info_list_t *p_client_arbit_list =
@@ -1964,6 +1989,9 @@ static void ss_svc_msg_handler(struct cfw_message *p_msg, void *p_param)
 		ss_svc_get_property_handle(
 			(ss_sensor_get_property_req_t *)p_msg, p_param);
 		break;
+	case MSG_ID_SS_BATCH_FLUSH_REQ:
+		ss_batch_flush_expired();
+		break;
 #if defined(BLE_SERVICE) && (BLE_SERVICE == 1)
 	case MSG_ID_SS_BLE_RSP_MSG:
 		ss_ble_resp_msg_handler((ble_status_msg_t *)p_msg);
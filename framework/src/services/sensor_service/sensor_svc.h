@@ -44,6 +44,9 @@ typedef sensor_service_message_general_rsp_t ss_sensor_unsubscribe_data_rsp_t;
 
 DEFINE_LOG_MODULE(LOG_MODULE_SS_SVC, "SS_S")
 
+/* Port of the sensor service */
+extern uint16_t ss_svc_port_id;
+
 /*
  * sensor service send get_calibration event to app
  */
@@ -97,6 +100,8 @@ typedef struct {
 #define MSG_ID_SS_SENSOR_SET_PROPERTY_REQ            (MSG_ID_SS_BASE | 0x08)
 #define MSG_ID_SS_SENSOR_GET_PROPERTY_REQ            (MSG_ID_SS_BASE | 0x09)
 
+#define MSG_ID_SS_BATCH_FLUSH_REQ                   (MSG_ID_SS_BASE | 0x0A)
+
 
 #define SENSOR_DEVICE_ID_REQ_MASK           (1 << SENSOR_DEVICE_ID)
 #define SENSOR_PRODUCT_ID_REQ_MASK          (1 << SENSOR_PRODUCT_ID)
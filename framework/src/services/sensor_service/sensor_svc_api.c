@@ -77,6 +77,21 @@ void sensor_service_subscribe_data(cfw_service_conn_t *p_service_conn,
 				   uint8_t *data_type, uint8_t data_type_nr,
 				   uint16_t sampling_interval,
 				   uint16_t reporting_interval)
+{
+	sensor_service_subscribe_data_batch(p_service_conn, p_priv, sensor,
+					    data_type, data_type_nr,
+					    sampling_interval,
+					    reporting_interval, 0, 0);
+}
+
+void sensor_service_subscribe_data_batch(cfw_service_conn_t *p_service_conn,
+					 void *p_priv, sensor_service_t sensor,
+					 uint8_t *data_type,
+					 uint8_t data_type_nr,
+					 uint16_t sampling_interval,
+					 uint16_t reporting_interval,
+					 uint8_t batch_count,
+					 uint16_t batch_latency)
 {
 	ss_sensor_subscribe_data_req_t *p_msg;
 
@@ -96,6 +111,8 @@ void sensor_service_subscribe_data(cfw_service_conn_t *p_service_conn,
 	p_msg->data_type_nr = data_type_nr;
 	p_msg->sampling_interval = sampling_interval;
 	p_msg->reporting_interval = reporting_interval;
+	p_msg->batch_count = batch_count;
+	p_msg->batch_latency = batch_latency;
 
 	/* Fill Request Parammeter */
 	memcpy(p_msg->data_type, data_type, sizeof(uint8_t) * data_type_nr);
@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "os/os.h"
+#include "cfw/cfw_service.h"
+#include "infra/message.h"
+#include "infra/port.h"
+#include "infra/time.h"
+
+#include "sensor_svc.h"
+#include "sensor_svc_list.h"
+#include "sensor_svc_utils.h"
+#include "sensor_svc_batch.h"
+
+/*
+ * Samples accumulated for all the subscriptions of a sensor sharing the same
+ * batching parameters.
+ */
+struct ss_batch {
+	list_t list;
+	sensor_service_t sensor_handle;
+	uint16_t max_latency;   /* 0 if the batch is only sent when full */
+	uint8_t max_count;
+	uint8_t refs;           /* Subscriptions attached to the batch */
+	uint16_t capacity;      /* Payload size of the pending event */
+	uint32_t first_ms;      /* Arrival time of the oldest pending sample */
+	sensor_service_subscribe_batch_event_t *p_evt; /* Pending event */
+};
+
+static list_head_t ss_batch_list;
+
+/* Single timer for the latency of all the batches */
+static T_TIMER ss_batch_timer;
+static bool ss_batch_timer_armed;
+static uint32_t ss_batch_deadline;
+
+#define IS_RECEIVING_STATUS(status) ((status) == SUBSCRIBED ||	\
+				     (status) == SUBSCRIBE_EVENT)
+
+static void ss_batch_timer_handler(void *priv)
+{
+	/* Batches are only touched by the service, hand it over */
+	struct cfw_message *p_msg = cfw_alloc_message(sizeof(*p_msg));
+
+	if (p_msg == NULL) {
+		return;
+	}
+	CFW_MESSAGE_TYPE(p_msg) = TYPE_REQ;
+	CFW_MESSAGE_ID(p_msg) = MSG_ID_SS_BATCH_FLUSH_REQ;
+	CFW_MESSAGE_LEN(p_msg) = sizeof(*p_msg);
+	CFW_MESSAGE_DST(p_msg) = ss_svc_port_id;
+	CFW_MESSAGE_SRC(p_msg) = ss_svc_port_id;
+	p_msg->priv = NULL;
+	p_msg->conn = NULL;
+	cfw_send_message(p_msg);
+}
+
+static void ss_batch_arm(uint32_t deadline, uint32_t now)
+{
+	OS_ERR_TYPE err;
+	int32_t delay = (int32_t)(deadline - now);
+
+	/* A past deadline is re-armed, in case its request was lost */
+	if (ss_batch_timer_armed &&
+	    (int32_t)(deadline - ss_batch_deadline) >= 0 &&
+	    (int32_t)(ss_batch_deadline - now) > 0) {
+		return;
+	}
+	if (ss_batch_timer == NULL) {
+		ss_batch_timer = timer_create(ss_batch_timer_handler, NULL,
+					      1, false, false, &err);
+		if (ss_batch_timer == NULL) {
+			SS_PRINT_ERR("No batch timer, batches sent when full");
+			return;
+		}
+	}
+	ss_batch_deadline = deadline;
+	ss_batch_timer_armed = true;
+	timer_start(ss_batch_timer, delay > 0 ? delay : 1, &err);
+}
+
+void ss_subscription_account(client_arbit_info_list_t *l, uint16_t samples,
+			     uint16_t latency, uint32_t now)
+{
+	ss_subscription_stats_t *p_stats = &l->stats;
+
+	if (p_stats->events == 0) {
+		p_stats->start_ms = now;
+	}
+	p_stats->events++;
+	p_stats->samples += samples;
+	p_stats->latency_sum += latency;
+	if (latency > p_stats->latency_max) {
+		p_stats->latency_max = latency;
+	}
+}
+
+static void ss_batch_send(struct ss_batch *b, uint32_t now)
+{
+	sensor_service_subscribe_batch_event_t *p_evt = b->p_evt;
+	ss_sensor_dev_list_t *p_list = ss_get_sensor_dev_list(b->sensor_handle);
+	client_arbit_info_list_t *l, *p_first = NULL;
+	struct cfw_message *p_copy;
+	uint16_t latency = now - b->first_ms;
+	int sharing = 0;
+
+	b->p_evt = NULL;
+	CFW_MESSAGE_TYPE(&p_evt->head) = TYPE_RSP;
+	CFW_MESSAGE_ID(&p_evt->head) = MSG_ID_SENSOR_SERVICE_SUBSCRIBE_BATCH_EVT;
+	CFW_MESSAGE_LEN(&p_evt->head) = sizeof(*p_evt) + p_evt->data_length;
+	CFW_MESSAGE_SRC(&p_evt->head) = ss_svc_port_id;
+
+	l = p_list ? (client_arbit_info_list_t *)
+	    p_list->arbit_info_list_header.head : NULL;
+	for (; l != NULL; l = (client_arbit_info_list_t *)l->list.next) {
+		if (l->batch == b &&
+		    IS_RECEIVING_STATUS(l->arbit_info.conn_status)) {
+			if (p_first == NULL) {
+				p_first = l;
+			}
+			if (l->priv_from_client == p_first->priv_from_client) {
+				sharing++;
+			}
+		}
+	}
+	if (p_first == NULL) {
+		cfw_msg_free(&p_evt->head);
+		return;
+	}
+
+	/* The event is shared by the clients expecting the same private data */
+	p_evt->head.priv = p_first->priv_from_client;
+	p_evt->head.conn = sharing == 1 ? p_first->p_handle : NULL;
+	for (l = p_first; l != NULL;
+	     l = (client_arbit_info_list_t *)l->list.next) {
+		if (l->batch != b ||
+		    !IS_RECEIVING_STATUS(l->arbit_info.conn_status) ||
+		    (sharing == 1 && l == p_first)) {
+			continue;
+		}
+		if (l->priv_from_client != p_evt->head.priv) {
+			/* Other private data need their own copy */
+			p_copy = cfw_clone_message(&p_evt->head);
+			if (p_copy == NULL) {
+				continue;
+			}
+			CFW_MESSAGE_DST(p_copy) = GET_DST_PORT(l->p_handle);
+			p_copy->priv = l->priv_from_client;
+			p_copy->conn = l->p_handle;
+			cfw_send_message(p_copy);
+		} else if (port_send_shared_message(
+				   CFW_MESSAGE_HEADER(&p_evt->head),
+				   GET_DST_PORT(l->p_handle)) != E_OS_OK) {
+			continue;
+		}
+		ss_subscription_account(l, p_evt->sample_nr, latency, now);
+	}
+
+	if (sharing == 1) {
+		/* The event is owned by its only receiver */
+		CFW_MESSAGE_DST(&p_evt->head) = GET_DST_PORT(p_first->p_handle);
+		ss_subscription_account(p_first, p_evt->sample_nr, latency,
+					now);
+		cfw_send_message(p_evt);
+		return;
+	}
+	cfw_msg_free(&p_evt->head);
+}
+
+static void ss_batch_drop(struct ss_batch *b)
+{
+	if (b->p_evt) {
+		cfw_msg_free(&b->p_evt->head);
+		b->p_evt = NULL;
+	}
+}
+
+int ss_batch_attach(ss_sensor_dev_list_t *p_list, client_arbit_info_list_t *l)
+{
+	subscribe_data_param_t *p_param = &l->arbit_info.subscribe_data_param;
+	struct ss_batch *b = (struct ss_batch *)ss_batch_list.head;
+
+	ss_batch_detach(l);
+	while (b) {
+		if (b->sensor_handle == p_list->sensor_handle &&
+		    b->max_count == p_param->batch_count &&
+		    b->max_latency == p_param->batch_latency) {
+			break;
+		}
+		b = (struct ss_batch *)b->list.next;
+	}
+	if (b == NULL) {
+		b = (struct ss_batch *)balloc(sizeof(*b), NULL);
+		if (b == NULL) {
+			return SS_STATUS_ERROR;
+		}
+		memset(b, 0, sizeof(*b));
+		b->sensor_handle = p_list->sensor_handle;
+		b->max_count = p_param->batch_count;
+		b->max_latency = p_param->batch_latency;
+		list_add(&ss_batch_list, &b->list);
+	}
+	b->refs++;
+	l->batch = b;
+	return SS_STATUS_SUCCESS;
+}
+
+void ss_batch_detach(client_arbit_info_list_t *l)
+{
+	struct ss_batch *b = l->batch;
+
+	if (b == NULL) {
+		return;
+	}
+	l->batch = NULL;
+#if defined(SENSOR_SERVICE_DEBUG) && (SENSOR_SERVICE_DEBUG == 1)
+	SS_PRINT_LOG("sensor 0x%x: %d events, %d samples, latency max %d ms",
+		     (uint32_t)b->sensor_handle, l->stats.events,
+		     l->stats.samples, l->stats.latency_max);
+#endif
+	if (--b->refs) {
+		return;
+	}
+	/* Nobody is left to receive the pending samples */
+	ss_batch_drop(b);
+	list_remove(&ss_batch_list, &b->list);
+	bfree(b);
+}
+
+void ss_batch_add_sample(sensor_service_t sensor_handle, uint8_t data_type,
+			 uint32_t timestamp, const void *p_data, uint8_t len)
+{
+	uint16_t size = SS_BATCH_SAMPLE_SIZE(len);
+	struct ss_batch *b = (struct ss_batch *)ss_batch_list.head;
+	sensor_service_batch_sample_t *p_sample;
+	uint32_t now = get_uptime_ms();
+	OS_ERR_TYPE err;
+
+	for (; b != NULL; b = (struct ss_batch *)b->list.next) {
+		if (b->sensor_handle != sensor_handle) {
+			continue;
+		}
+		if (b->p_evt && (b->p_evt->subscription_type != data_type ||
+				 b->p_evt->data_length + size > b->capacity)) {
+			ss_batch_send(b, now);
+		}
+		if (b->p_evt == NULL) {
+			b->capacity = b->max_count * size;
+			if (b->capacity > SS_BATCH_MAX_SIZE) {
+				b->capacity = SS_BATCH_MAX_SIZE < size ?
+					      size : SS_BATCH_MAX_SIZE;
+			}
+			b->p_evt = (sensor_service_subscribe_batch_event_t *)
+				   message_alloc_shared(sizeof(*b->p_evt) +
+							b->capacity, &err);
+			if (b->p_evt == NULL) {
+				SS_PRINT_ERR("Allocing mem failed");
+				continue;
+			}
+			b->p_evt->handle = sensor_handle;
+			b->p_evt->sensor_type = GET_SENSOR_TYPE(sensor_handle);
+			b->p_evt->subscription_type = data_type;
+			b->first_ms = now;
+			if (b->max_latency) {
+				ss_batch_arm(now + b->max_latency, now);
+			}
+		}
+		p_sample = (sensor_service_batch_sample_t *)
+			   ((uint8_t *)b->p_evt->samples +
+			    b->p_evt->data_length);
+		p_sample->timestamp = timestamp;
+		p_sample->data_length = len;
+		memcpy(p_sample->data, p_data, len);
+		b->p_evt->data_length += size;
+		b->p_evt->sample_nr++;
+		if (b->p_evt->sample_nr >= b->max_count ||
+		    b->p_evt->data_length + size > b->capacity) {
+			ss_batch_send(b, now);
+		}
+	}
+}
+
+void ss_batch_flush_expired(void)
+{
+	struct ss_batch *b = (struct ss_batch *)ss_batch_list.head;
+	uint32_t now = get_uptime_ms();
+
+	ss_batch_timer_armed = false;
+	for (; b != NULL; b = (struct ss_batch *)b->list.next) {
+		if (b->p_evt == NULL || b->max_latency == 0) {
+			continue;
+		}
+		if ((int32_t)(now - b->first_ms) >= b->max_latency) {
+			ss_batch_send(b, now);
+		} else {
+			ss_batch_arm(b->first_ms + b->max_latency, now);
+		}
+	}
+}
+
+int ss_get_subscription_stats(sensor_service_t sensor_handle,
+			      void *p_client_handle,
+			      ss_subscription_stats_t *p_stats)
+{
+	ss_sensor_dev_list_t *p_list = ss_get_sensor_dev_list(sensor_handle);
+	client_arbit_info_list_t *l;
+
+	if (p_list == NULL) {
+		return SS_STATUS_ERROR;
+	}
+	l = ss_get_client_con_info(p_list, p_client_handle);
+	if (l == NULL) {
+		return SS_STATUS_ERROR;
+	}
+	*p_stats = l->stats;
+	return SS_STATUS_SUCCESS;
+}
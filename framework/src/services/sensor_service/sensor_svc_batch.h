@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SENSOR_SVC_BATCH_H__
+#define __SENSOR_SVC_BATCH_H__
+
+#include "services/sensor_service/sensor_service.h"
+#include "sensor_svc_list.h"
+
+/* Largest batch payload, kept within the biggest balloc blocks */
+#define SS_BATCH_MAX_SIZE           512
+
+/**
+ * @brief  Join the batch of the sensor matching the subscription parameters.
+ *         Subscriptions with identical parameters share the same batch, and
+ *         each event is delivered to all of them from a single buffer.
+ * @param  p_list: Sensor list pointer
+ *         l: Client arbitration info, with batching parameters set
+ * @retval SS_STATUS_SUCCESS if no error, otherwise SS_STATUS_ERROR
+ */
+int ss_batch_attach(ss_sensor_dev_list_t *p_list, client_arbit_info_list_t *l);
+
+/**
+ * @brief  Leave the batch of a subscription, if any.
+ *         The batch and its pending samples are freed with its last client.
+ * @param  l: Client arbitration info
+ */
+void ss_batch_detach(client_arbit_info_list_t *l);
+
+/**
+ * @brief  Append a sample to all the batches of a sensor.
+ *         A batch is sent as soon as it is full.
+ * @param  sensor_handle: Sensor identification
+ *         data_type: Subscription type of the sample
+ *         timestamp: Time when this data is generated
+ *         p_data: Sample data
+ *         len: Sample data length
+ */
+void ss_batch_add_sample(sensor_service_t sensor_handle, uint8_t data_type,
+			 uint32_t timestamp, const void *p_data, uint8_t len);
+
+/**
+ * @brief  Send the batches whose oldest sample reached the batch latency.
+ *         Called on MSG_ID_SS_BATCH_FLUSH_REQ, sent by the batching timer.
+ */
+void ss_batch_flush_expired(void);
+
+/**
+ * @brief  Account events sent to a subscription in its statistics
+ * @param  l: Client arbitration info
+ *         samples: Number of samples carried by the event
+ *         latency: Batching delay of the oldest sample, in ms
+ *         now: Current time, in ms
+ */
+void ss_subscription_account(client_arbit_info_list_t *l, uint16_t samples,
+			     uint16_t latency, uint32_t now);
+
+/**
+ * @brief  Get the statistics of a data subscription
+ * @param  sensor_handle: Sensor identification
+ *         p_client_handle: Client identification
+ *         p_stats: Returned statistics
+ * @retval SS_STATUS_SUCCESS if no error, otherwise SS_STATUS_ERROR
+ */
+int ss_get_subscription_stats(sensor_service_t sensor_handle,
+			      void *p_client_handle,
+			      ss_subscription_stats_t *p_stats);
+
+#endif
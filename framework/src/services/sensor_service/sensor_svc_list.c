@@ -28,11 +28,14 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <string.h>
+
 #include "cfw/cfw.h"
 #include "os/os.h"
 
 #include "sensor_svc_list.h"
 #include "sensor_svc_utils.h"
+#include "sensor_svc_batch.h"
 
 static list_head_t ss_client_list_head;
 static list_head_t ss_sensor_list_head;
@@ -259,6 +262,7 @@ int  ss_arbit_info_list_delete(list_head_t *	p_arbit_info_list,
 	if (p_arbit_info_list == NULL) {
 		return SS_LIST_ERROR;
 	}
+	ss_batch_detach((client_arbit_info_list_t *)p_element);
 	return _delete_list(p_arbit_info_list, p_element);
 }
 
@@ -322,6 +326,11 @@ int ss_sensor_list_delete(void *p_handle)
 		//SS_PRINT_ERR("Sensor device handle is NULL");
 		return SS_LIST_ERROR;
 	}
+	client_arbit_info_list_t *l =
+		(client_arbit_info_list_t *)p_list->arbit_info_list_header.head;
+	for (; l != NULL; l = (client_arbit_info_list_t *)l->list.next) {
+		ss_batch_detach(l);
+	}
 	if (ss_list_delete_ext(&p_list->arbit_info_list_header) ==
 	    SS_LIST_ERROR) {
 		//SS_PRINT_ERR("Arbitration list deletion failed");
@@ -372,6 +381,8 @@ client_arbit_info_list_t *ss_arbit_info_list_add(
 	if (priv_data_from_client != NULL)
 		p_arbit_info_list->priv_from_client = priv_data_from_client;
 	p_arbit_info_list->arbit_info.flag = 0;
+	p_arbit_info_list->batch = NULL;
+	memset(&p_arbit_info_list->stats, 0, sizeof(p_arbit_info_list->stats));
 	list_add(&p_list->arbit_info_list_header,
 		 (list_t *)p_arbit_info_list);
 	return p_arbit_info_list;
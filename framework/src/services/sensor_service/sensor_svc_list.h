@@ -79,8 +79,23 @@ typedef struct {
 typedef struct {
 	uint16_t sampling_interval;
 	uint16_t reporting_interval;
+	uint16_t batch_latency;
+	uint8_t batch_count; /* 0 if the subscription is not batched */
 } subscribe_data_param_t;
 
+/*
+ * Statistics of a data subscription, reset on each subscribe request
+ */
+typedef struct {
+	uint32_t start_ms;      /* Time of the first event */
+	uint32_t events;        /* Events sent to the client */
+	uint32_t samples;       /* Samples carried by these events */
+	uint32_t latency_sum;   /* Sum of the batching delays, in ms */
+	uint16_t latency_max;   /* Largest batching delay, in ms */
+} ss_subscription_stats_t;
+
+struct ss_batch;
+
 typedef struct {
 	uint8_t conn_status;
 	uint32_t flag; /* Flag the client if waiting for some describe or alarm info */
@@ -94,6 +109,8 @@ typedef struct {
 	void *p_handle;
 	void *priv_from_client;
 	client_arbit_info_t arbit_info;
+	struct ss_batch *batch; /* Batch shared with the identical subscriptions */
+	ss_subscription_stats_t stats;
 } client_arbit_info_list_t;
 
 typedef struct {
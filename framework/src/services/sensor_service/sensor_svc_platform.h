@@ -73,6 +73,8 @@ typedef struct {
 	struct cfw_message header;
 	uint16_t sampling_interval; /*!< Sensor data sample frequence, unit: HZ*/
 	uint16_t reporting_interval; /*!< sensor data reporting interval, unit: ms*/
+	uint16_t batch_latency; /*!< Maximum batching delay, unit: ms*/
+	uint8_t batch_count; /*!< Maximum samples per event, 0 to disable batching*/
 	sensor_service_t sensor;
 	uint8_t data_type_nr;
 	uint8_t data_type[1];
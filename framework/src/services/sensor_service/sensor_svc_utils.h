@@ -43,6 +43,7 @@
 
 /* *INDENT-OFF* */
 #define GET_CLIENT_HANDLE(p_msg) (((conn_handle_t *)(((struct cfw_message *)p_msg)->conn))->client_handle)
+#define GET_DST_PORT(client_handle) (((conn_handle_t *)(((cfw_service_conn_t *)(client_handle))->server_handle))->client_port)
 
 #define svc_foreach_list(p_list) for(; (p_list) != NULL; p_list = (__typeof__(*p_list) *)(((list_t *)(p_list))->next))
 /* *INDENT-ON* */
@@ -42,13 +42,14 @@
 DEFINE_TASK(TASK_STORAGE, 7, storage_task, 2048, 0);
 
 static T_QUEUE storage_queue;
-xloop_t loop;
+static xloop_t loop;
 
 /* Storage initialisation */
 void init_storage(void)
 {
 	storage_queue = queue_create(10);
 	assert(storage_queue);
+	xloop_init_from_queue(&loop, storage_queue);
 
 #ifdef CONFIG_SERVICES_QUARK_SE_LL_STORAGE_IMPL
 	cfw_set_queue_for_service(LL_STOR_SERVICE_ID, storage_queue);
@@ -65,9 +66,13 @@ void init_storage(void)
 	task_start(TASK_STORAGE);
 }
 
+xloop_t *storage_task_get_xloop(void)
+{
+	return &loop;
+}
+
 void storage_task(void)
 {
-	cfw_loop(storage_queue);
 #ifdef CONFIG_SYSTEM_EVENTS
 	system_event_set_xloop(&loop);
 #endif
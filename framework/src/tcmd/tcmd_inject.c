@@ -31,6 +31,7 @@
 #include <string.h>
 #include "os/os.h"
 #include "cfw/cfw.h"
+#include "infra/port.h"
 #include "infra/tcmd/handler.h"
 #include "infra/log.h"
 
@@ -152,7 +153,9 @@ void cfw_poll_message(int argc, char *argv[], struct tcmd_handler_ctx *ctx)
 
 	queue_get_message(queue, &m, OS_NO_WAIT, &err);
 	if (err == E_OS_OK) {
-		msg = (struct cfw_message *)m;
+		/* Events sent to several clients are queued as references */
+		msg = (struct cfw_message *)port_resolve_message(
+			(struct message *)m);
 		int i;
 		for (i = 0; (CFW_MESSAGE_LEN(msg) / MSG_SPLIT_SIZE &&
 			     i < CFW_MESSAGE_LEN(msg) / MSG_SPLIT_SIZE); i++) {
@@ -30,6 +30,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "cir_storage.h"
 #include "cir_storage_backend.h"
@@ -81,6 +82,23 @@ typedef struct _elt_status {
 #define ELT_WRITTEN   0xBBBBBBBB
 #define ELT_READ      0x00000000
 
+/**
+ * Checkpoints are appended to the checkpoint block, the last one written gives
+ * the read and write pointers, which only need to be validated at mount.
+ */
+typedef struct _checkpoint {
+	block_header_t header;   /** Same as the storage block header */
+	block_pointer_t rp;      /** Read pointer */
+	block_pointer_t wp;      /** Write pointer */
+	uint32_t check;          /** Inverted XOR of the previous words */
+} checkpoint_t;
+
+#define CIR_STORAGE_CHECKPOINT_MAGIC 0xC4EC
+
+#define CHECKPOINT_SLOTS(storage) (storage->block_size/sizeof(checkpoint_t))
+#define CHECKPOINT_ADDR(storage,slot) \
+	(storage->cp_block*storage->block_size + (slot)*sizeof(checkpoint_t))
+
 static int32_t write_header(cir_storage_flash_t *storage, uint32_t index) {
 
 	block_header_t header = {
@@ -104,6 +122,194 @@ static int32_t write_status(cir_storage_flash_t *storage,
 	                      (uint8_t *)&status);
 };
 
+static uint32_t checkpoint_check(checkpoint_t *cp)
+{
+	uint32_t *word = (uint32_t *)cp;
+	uint32_t check = 0;
+	size_t i;
+
+	for (i = 0; i < offsetof(checkpoint_t, check)/sizeof(uint32_t); i++) {
+		check ^= word[i];
+	}
+	return ~check;
+}
+
+/* On failure the buffered elements are kept, they have been acknowledged:
+ * the next flush programs them again.
+ * Must be called with the storage mutex locked */
+static int32_t wb_flush(cir_storage_flash_t *storage)
+{
+	if (storage->wb_len == 0) {
+		return 0;
+	}
+	if (storage->write(storage, storage->wb_addr, storage->wb_len,
+			   storage->wb_buf) != 0) {
+		/* Have the backend schedule another sync */
+		if (storage->wb_dirty) {
+			storage->wb_dirty(storage);
+		}
+		return -1;
+	}
+	storage->wb_len = 0;
+	return 0;
+}
+
+/* Must be called with the storage mutex locked */
+static void write_checkpoint(cir_storage_flash_t *storage)
+{
+	checkpoint_t cp = {
+		.header = { .magic = CIR_STORAGE_CHECKPOINT_MAGIC },
+	};
+
+	if (storage->cp_block == CIR_STORAGE_NO_CHECKPOINT) {
+		return;
+	}
+	storage->cp_count = 0;
+
+	/* A checkpoint may not point after elements still held in RAM */
+	if (wb_flush(storage) != 0) {
+		return;
+	}
+
+	if (storage->cp_slot >= CHECKPOINT_SLOTS(storage)) {
+		if (storage->erase(storage, storage->cp_block, 1) != 0) {
+			return;
+		}
+		storage->cp_slot = 0;
+	}
+
+	cp.header.size = storage->parent.elt_size;
+	cp.rp = storage->rp;
+	cp.wp = storage->wp;
+	cp.check = checkpoint_check(&cp);
+	/* On failure, the next mount falls back to the full scan */
+	storage->write(storage, CHECKPOINT_ADDR(storage, storage->cp_slot),
+		       sizeof(cp), (uint8_t *)&cp);
+	storage->cp_slot++;
+}
+
+/* Count a pointer move, and checkpoint every cp_interval of them.
+ * Must be called with the storage mutex locked */
+static void count_checkpoint(cir_storage_flash_t *storage)
+{
+	if (storage->cp_interval && ++storage->cp_count >= storage->cp_interval) {
+		write_checkpoint(storage);
+	}
+}
+
+/* Find the last valid checkpoint and the first free checkpoint slot */
+static int32_t read_checkpoint(cir_storage_flash_t *storage, checkpoint_t *cp)
+{
+	uint32_t lo = 0, hi = CHECKPOINT_SLOTS(storage);
+
+	/* Checkpoints are written in order, look for the first erased slot */
+	while (lo < hi) {
+		uint32_t mid = (lo + hi)/2;
+		uint32_t word;
+		if (storage->read(storage, CHECKPOINT_ADDR(storage, mid),
+				  sizeof(word), (uint8_t *)&word) != 0) {
+			return -1;
+		}
+		if (word == BLOCK_UNUSED) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+	storage->cp_slot = lo;
+
+	/* The last checkpoint may have been interrupted, try the one before */
+	while (lo > 0 && lo + 2 > storage->cp_slot) {
+		lo--;
+		if (storage->read(storage, CHECKPOINT_ADDR(storage, lo),
+				  sizeof(*cp), (uint8_t *)cp) != 0) {
+			return -1;
+		}
+		if (cp->header.magic == CIR_STORAGE_CHECKPOINT_MAGIC
+			&& cp->header.size == storage->parent.elt_size
+			&& cp->check == checkpoint_check(cp)) {
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/* Check that a checkpointed pointer designates an element of a valid block
+ * owning this pointer */
+static int32_t check_pointer(cir_storage_flash_t *storage, block_pointer_t *ptr,
+			     uint32_t status_offset)
+{
+	uint32_t elt_space = storage->parent.elt_size + sizeof(elt_status_t);
+	uint32_t offset = ptr->offset - ptr->index*storage->block_size;
+	block_info_t info;
+
+	if (ptr->index < storage->block_first || ptr->index > storage->block_last
+		|| ptr->offset < ptr->index*storage->block_size
+		|| offset < sizeof(block_info_t) || offset > storage->last_offset
+		|| (offset - sizeof(block_info_t))%elt_space) {
+		return -1;
+	}
+	if (storage->read(storage, ptr->index*storage->block_size,
+			  sizeof(info), (uint8_t *)&info) != 0) {
+		return -1;
+	}
+	if (((uint32_t) info.header.magic != CIR_STORAGE_FLASH_MAGIC)
+		|| (info.header.size != storage->parent.elt_size)
+		|| (*(uint32_t *)((uint8_t *)&info.status + status_offset)
+			!= BLOCK_CURRENT)) {
+		return -1;
+	}
+	return 0;
+}
+
+/* Move a checkpointed pointer forward, up to the first empty element for the
+ * write pointer or the first non-read element for the read pointer, without
+ * leaving its block */
+static int32_t scan_forward(cir_storage_flash_t *storage, block_pointer_t *ptr,
+			    bool write, uint32_t stop)
+{
+	uint32_t elt_space = storage->parent.elt_size + sizeof(elt_status_t);
+
+	while (ptr->offset != stop) {
+		uint32_t elt_status;
+		if (storage->read(storage, ptr->offset, sizeof(elt_status),
+				  (uint8_t *)&elt_status) != 0) {
+			return -1;
+		}
+		if (write ? (elt_status == ELT_EMPTY) : (elt_status != ELT_READ)) {
+			return 0;
+		}
+		/* The pointer would have switched block */
+		if (ptr->offset%storage->block_size == storage->last_offset) {
+			return -1;
+		}
+		ptr->offset += elt_space;
+	}
+	return 0;
+}
+
+/* Mount the storage from its last checkpoint */
+static int32_t mount_checkpoint(cir_storage_flash_t *storage)
+{
+	checkpoint_t cp;
+
+	if (read_checkpoint(storage, &cp) != 0
+		|| check_pointer(storage, &cp.wp, WRITE_STATUS_OFFSET) != 0
+		|| check_pointer(storage, &cp.rp, READ_STATUS_OFFSET) != 0) {
+		return -1;
+	}
+
+	/* Skip elements pushed, then popped, since the checkpoint */
+	if (scan_forward(storage, &cp.wp, true, 0) != 0
+		|| scan_forward(storage, &cp.rp, false, cp.wp.offset) != 0) {
+		return -1;
+	}
+
+	storage->wp = cp.wp;
+	storage->rp = cp.rp;
+	return 0;
+}
+
 int32_t cir_storage_flash_init(cir_storage_flash_t *storage)
 {
 	block_info_t info;
@@ -121,6 +327,17 @@ int32_t cir_storage_flash_init(cir_storage_flash_t *storage)
 
 	WRITE_PTR(storage) = 0;
 	READ_PTR(storage) = 0;
+	storage->wb_len = 0;
+	storage->cp_count = 0;
+	storage->cp_slot = CHECKPOINT_SLOTS(storage);
+
+	if (storage->cp_block != CIR_STORAGE_NO_CHECKPOINT) {
+		if (mount_checkpoint(storage) == 0) {
+			return 0;
+		}
+		WRITE_PTR(storage) = 0;
+		READ_PTR(storage) = 0;
+	}
 
 	/* Retrieve write and read pointers */
 	uint32_t block_index = storage->block_first;
@@ -174,7 +391,8 @@ int32_t cir_storage_flash_init(cir_storage_flash_t *storage)
 		block_index++;
 	}
 	if ((READ_PTR(storage) != 0) && (WRITE_PTR(storage) != 0)) {
-		/* Existing storage detected */
+		/* Existing storage detected, make the next mount a fast one */
+		write_checkpoint(storage);
 		return 0;
 	}
 	/* Storage first init */
@@ -207,31 +425,98 @@ int32_t cir_storage_flash_init(cir_storage_flash_t *storage)
 	WRITE_PTR(storage) = READ_PTR(storage);
 	WRITE_BLOCK(storage) = storage->block_first;
 	READ_BLOCK(storage) = storage->block_first;
+
+	/* Drop the checkpoints of any previous storage */
+	if (storage->cp_block != CIR_STORAGE_NO_CHECKPOINT) {
+		if (storage->erase(storage, storage->cp_block, 1) != 0) {
+			return -1;
+		}
+		storage->cp_slot = 0;
+		write_checkpoint(storage);
+	}
 	return 0;
 }
 
-cir_storage_err_t cir_storage_push(cir_storage_t *self, uint8_t *buf)
+/* Flush the write-back buffer if it holds the element at the given address.
+ * Must be called with the storage mutex locked */
+static int32_t wb_flush_element(cir_storage_flash_t *storage, uint32_t addr)
 {
-	cir_storage_flash_t *storage = (cir_storage_flash_t *)self;
-	cir_storage_err_t ret = CBUFFER_STORAGE_SUCCESS;
+	if (storage->wb_len && addr >= storage->wb_addr
+		&& addr < storage->wb_addr + storage->wb_len) {
+		return wb_flush(storage);
+	}
+	return 0;
+}
 
-	storage->lock(storage);
+/* Write status and data of the element at the write pointer.
+ * Must be called with the storage mutex locked */
+static int32_t write_element(cir_storage_flash_t *storage, uint8_t *buf)
+{
 	elt_status_t elt_status = { ELT_WRITTEN };
+	uint32_t elt_space = sizeof(elt_status) + storage->parent.elt_size;
 
-	/* Update the status of the next element */
-	if (storage->write(storage, WRITE_PTR(storage), sizeof(elt_status), (uint8_t *)&elt_status) != 0) {
-		ret = CBUFFER_STORAGE_ERROR;
-		goto exit;
+	if (storage->wb_buf == NULL || elt_space > storage->wb_size) {
+		/* Update the status of the next element */
+		if (storage->write(storage, WRITE_PTR(storage), sizeof(elt_status), (uint8_t *)&elt_status) != 0) {
+			return -1;
+		}
+		/* Write the element */
+		return storage->write(storage, WRITE_PTR(storage) + sizeof(elt_status), storage->parent.elt_size, buf);
 	}
 
-	/* Write the element */
-	if (storage->write(storage, WRITE_PTR(storage) + sizeof(elt_status), self->elt_size, buf) != 0) {
+	/* Only contiguous elements are coalesced */
+	if (storage->wb_len && storage->wb_addr + storage->wb_len != WRITE_PTR(storage)) {
+		if (wb_flush(storage) != 0) {
+			return -1;
+		}
+	}
+	/* The buffer may still be full after a failed flush */
+	if (storage->wb_len + elt_space > storage->wb_size) {
+		if (wb_flush(storage) != 0) {
+			return -1;
+		}
+	}
+	if (storage->wb_len == 0) {
+		storage->wb_addr = WRITE_PTR(storage);
+		if (storage->wb_dirty) {
+			storage->wb_dirty(storage);
+		}
+	}
+	memcpy(storage->wb_buf + storage->wb_len, &elt_status, sizeof(elt_status));
+	memcpy(storage->wb_buf + storage->wb_len + sizeof(elt_status), buf, storage->parent.elt_size);
+	storage->wb_len += elt_space;
+
+	/* Program the buffer as soon as the next element does not fit. The
+	 * element is accepted even if this fails, the next push or sync
+	 * retries */
+	if (storage->wb_len + elt_space > storage->wb_size) {
+		wb_flush(storage);
+	}
+	return 0;
+}
+
+/* Must be called with the storage mutex locked */
+static cir_storage_err_t push_one_element(cir_storage_flash_t *storage, uint8_t *buf)
+{
+	cir_storage_err_t ret = CBUFFER_STORAGE_SUCCESS;
+
+	if (write_element(storage, buf) != 0) {
 		ret = CBUFFER_STORAGE_ERROR;
 		goto exit;
 	}
 
 	/* Increase and adjust write pointer */
 	if (WRITE_PTR(storage)%storage->block_size == storage->last_offset) {
+		/* The block elements must be in flash before the block status */
+		if (wb_flush(storage) != 0) {
+			/* The element is refused, the previous ones stay in
+			 * the buffer */
+			storage->wb_len -= sizeof(elt_status_t) +
+					   storage->parent.elt_size;
+			ret = CBUFFER_STORAGE_ERROR;
+			goto exit;
+		}
+
 		/* Mark current block as non-current for write pointer */
 		if (write_status(storage, WRITE_BLOCK(storage), BLOCK_USED, WRITE_STATUS_OFFSET) != 0) {
 			ret = CBUFFER_STORAGE_ERROR;
@@ -274,15 +559,55 @@ cir_storage_err_t cir_storage_push(cir_storage_t *self, uint8_t *buf)
 				goto exit;
 			}
 		}
+		write_checkpoint(storage);
 	} else {
-		WRITE_PTR(storage) += sizeof(elt_status) + storage->parent.elt_size;
+		WRITE_PTR(storage) += sizeof(elt_status_t) + storage->parent.elt_size;
+		count_checkpoint(storage);
 	}
 
 exit:
+	return ret;
+}
+
+cir_storage_err_t cir_storage_push(cir_storage_t *self, uint8_t *buf)
+{
+	cir_storage_flash_t *storage = (cir_storage_flash_t *)self;
+	cir_storage_err_t ret;
+
+	storage->lock(storage);
+	ret = push_one_element(storage, buf);
 	storage->unlock(storage);
 	return ret;
 }
 
+cir_storage_err_t cir_storage_push_n(cir_storage_t *self, uint8_t *buf, uint32_t count)
+{
+	cir_storage_flash_t *storage = (cir_storage_flash_t *)self;
+	cir_storage_err_t ret = CBUFFER_STORAGE_SUCCESS;
+	uint32_t i;
+
+	storage->lock(storage);
+	for (i = 0; i < count && ret == CBUFFER_STORAGE_SUCCESS; i++) {
+		ret = push_one_element(storage, buf + i*self->elt_size);
+	}
+	storage->unlock(storage);
+	return ret;
+}
+
+cir_storage_err_t cir_storage_sync(cir_storage_t *self)
+{
+	cir_storage_flash_t *storage = (cir_storage_flash_t *)self;
+	cir_storage_err_t ret = CBUFFER_STORAGE_SUCCESS;
+
+	storage->lock(storage);
+	if (wb_flush(storage) != 0) {
+		ret = CBUFFER_STORAGE_WRITE_ERROR;
+	}
+	storage->unlock(storage);
+	return ret;
+}
+
+
 /* Must be called with the storage mutex locked */
 static cir_storage_err_t clear_one_element(cir_storage_flash_t * storage)
 {
@@ -290,6 +615,12 @@ static cir_storage_err_t clear_one_element(cir_storage_flash_t * storage)
 
 	elt_status_t elt_status = { ELT_READ };
 
+	/* The element must be in flash before it is marked as read */
+	if (wb_flush_element(storage, READ_PTR(storage)) != 0) {
+		ret = CBUFFER_STORAGE_ERROR;
+		goto exit;
+	}
+
 	/* Mark the element as read */
 	if (storage->write(storage, READ_PTR(storage),sizeof(elt_status), (uint8_t *)&elt_status) != 0) {
 		ret = CBUFFER_STORAGE_ERROR;
@@ -310,9 +641,11 @@ static cir_storage_err_t clear_one_element(cir_storage_flash_t * storage)
 			goto exit;
 		}
 		READ_PTR(storage) = BASE_PTR(storage,READ_BLOCK(storage));
+		write_checkpoint(storage);
 	} else {
 		/* Advance the read pointer of one element */
 		READ_PTR(storage) += sizeof(elt_status) + storage->parent.elt_size;
+		count_checkpoint(storage);
 	}
 
 exit:
@@ -330,6 +663,11 @@ static cir_storage_err_t read_one_element(cir_storage_flash_t *storage, uint8_t
 		goto exit;
 	}
 
+	if (wb_flush_element(storage, READ_PTR(storage)) != 0) {
+		ret = CBUFFER_STORAGE_ERROR;
+		goto exit;
+	}
+
 	if (storage->read(storage, READ_PTR(storage) + sizeof(elt_status_t),
 		              storage->parent.elt_size, buf) != 0) {
 		ret = CBUFFER_STORAGE_ERROR;
@@ -360,6 +698,36 @@ exit:
 	return ret;
 }
 
+cir_storage_err_t cir_storage_pop_n(cir_storage_t *self, uint8_t *buf, uint32_t count, uint32_t *popped)
+{
+	cir_storage_flash_t *storage = (cir_storage_flash_t *)self;
+	cir_storage_err_t ret = CBUFFER_STORAGE_SUCCESS;
+	uint32_t n = 0;
+
+	storage->lock(storage);
+
+	while (n < count) {
+		ret = read_one_element(storage, buf + n*self->elt_size);
+		if (ret != CBUFFER_STORAGE_SUCCESS) {
+			break;
+		}
+		ret = clear_one_element(storage);
+		if (ret != CBUFFER_STORAGE_SUCCESS) {
+			break;
+		}
+		n++;
+	}
+	/* Running out of elements is not an error once some were popped */
+	if (ret == CBUFFER_STORAGE_EMPTY_ERROR && n > 0) {
+		ret = CBUFFER_STORAGE_SUCCESS;
+	}
+
+	storage->unlock(storage);
+	if (popped) {
+		*popped = n;
+	}
+	return ret;
+}
 
 cir_storage_err_t cir_storage_peek(cir_storage_t * self, uint8_t *buf)
 {
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * RAM backed NOR flash simulation backend for the circular storage, used to
+ * test and benchmark the library on a host.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "cir_storage.h"
+#include "cir_storage_backend.h"
+#include "cir_storage_flash_sim.h"
+
+static int32_t sim_read(cir_storage_flash_t *storage, uint32_t address,
+			uint32_t data_size, uint8_t *data)
+{
+	cir_storage_flash_sim_t *sim = (cir_storage_flash_sim_t *)storage;
+
+	if (address + data_size > storage->parent.buffer_size) {
+		return -1;
+	}
+	memcpy(data, sim->flash + address, data_size);
+	sim->reads++;
+	sim->bytes_read += data_size;
+	return 0;
+}
+
+static int32_t sim_write(cir_storage_flash_t *storage, uint32_t address,
+			 uint32_t data_size, uint8_t *data)
+{
+	cir_storage_flash_sim_t *sim = (cir_storage_flash_sim_t *)storage;
+	uint32_t i;
+
+	if (address + data_size > storage->parent.buffer_size) {
+		return -1;
+	}
+	if (sim->fail_writes) {
+		sim->fail_writes--;
+		return -1;
+	}
+	for (i = 0; i < data_size; i++) {
+		uint8_t *cell = sim->flash + address + i;
+		/* Programming can only clear bits */
+		if ((*cell & data[i]) != data[i]) {
+			return -1;
+		}
+		*cell = data[i];
+		/* Like the SPI driver, split programs on page boundaries */
+		if (i == 0 || (address + i) % sim->page_size == 0) {
+			sim->programs++;
+		}
+	}
+	sim->bytes_written += data_size;
+	return 0;
+}
+
+static int32_t sim_erase(cir_storage_flash_t *storage, uint32_t first_block,
+			 uint32_t block_count)
+{
+	cir_storage_flash_sim_t *sim = (cir_storage_flash_sim_t *)storage;
+
+	if ((first_block + block_count) * storage->block_size
+		> storage->parent.buffer_size) {
+		return -1;
+	}
+	memset(sim->flash + first_block * storage->block_size, 0xFF,
+	       block_count * storage->block_size);
+	sim->erases += block_count;
+	return 0;
+}
+
+static void sim_lock(cir_storage_flash_t *storage)
+{
+}
+
+static void sim_unlock(cir_storage_flash_t *storage)
+{
+}
+
+int32_t cir_storage_flash_sim_init(cir_storage_flash_sim_t *sim,
+				   uint8_t *flash,
+				   uint32_t elt_size,
+				   uint32_t block_size,
+				   uint32_t block_count,
+				   uint32_t page_size,
+				   uint8_t *wb_buf,
+				   uint32_t wb_size,
+				   uint32_t checkpoint)
+{
+	memset(sim, 0, sizeof(*sim));
+	sim->flash = flash;
+	sim->page_size = page_size;
+	sim->storage.parent.buffer_size = block_count * block_size;
+	sim->storage.parent.elt_size = elt_size;
+	sim->storage.block_first = 0;
+	sim->storage.block_last = block_count - 1;
+	sim->storage.block_size = block_size;
+	sim->storage.read = sim_read;
+	sim->storage.write = sim_write;
+	sim->storage.erase = sim_erase;
+	sim->storage.lock = sim_lock;
+	sim->storage.unlock = sim_unlock;
+	sim->storage.wb_buf = wb_buf;
+	sim->storage.wb_size = wb_size;
+	sim->storage.cp_block = CIR_STORAGE_NO_CHECKPOINT;
+	if (checkpoint) {
+		sim->storage.block_last--;
+		sim->storage.cp_block = block_count - 1;
+		sim->storage.cp_interval = checkpoint;
+	}
+
+	return cir_storage_flash_init(&sim->storage);
+}
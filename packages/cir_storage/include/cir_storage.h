@@ -81,6 +81,29 @@ typedef struct _cir_storage_t {
  */
 cir_storage_err_t cir_storage_push(cir_storage_t *self, uint8_t *buf);
 
+/**
+ * Push several elements in the circular buffer.
+ * With a write-back buffer, consecutive elements are programmed together.
+ * @param self the pointer on the circular buffer.
+ * @param buf pointer to the data to push, count elements laid out back to back.
+ * @param count number of elements to push.
+ * @return cbuffer_storage_err_t error code.
+ *  CBUFFER_STORAGE_ERROR: Writing step failed, only the elements preceding
+ *                         the failing one are pushed.
+ *  CBUFFER_STORAGE_SUCCESS: circular buffer push succeed.
+ */
+cir_storage_err_t cir_storage_push_n(cir_storage_t *self, uint8_t *buf, uint32_t count);
+
+/**
+ * Write the elements held in the write-back buffer, if any, to the flash.
+ * @param self the pointer on the circular buffer.
+ * @return cbuffer_storage_err_t error code.
+ *  CBUFFER_STORAGE_WRITE_ERROR: Writing step failed, buffered elements are
+ *                               kept and written again by a later sync.
+ *  CBUFFER_STORAGE_SUCCESS: circular buffer sync succeed.
+ */
+cir_storage_err_t cir_storage_sync(cir_storage_t *self);
+
 /**
  * Pop the oldest element from the circular buffer
  * Popped element is removed from the circular buffer.
@@ -94,6 +117,20 @@ cir_storage_err_t cir_storage_push(cir_storage_t *self, uint8_t *buf);
  */
 cir_storage_err_t cir_storage_pop(cir_storage_t *self, uint8_t *buf);
 
+/**
+ * Pop up to count of the oldest elements from the circular buffer.
+ * Popped elements are removed from the circular buffer.
+ * @param self the pointer on the circular buffer.
+ * @param buf pointer to the buffer to fill, large enough for count elements.
+ * @param count maximum number of elements to pop.
+ * @param popped filled with the number of elements popped, may be NULL.
+ * @return cbuffer_storage_err_t error code.
+ *  CBUFFER_STORAGE_EMPTY_ERROR: circular buffer is empty. Pop is not possible.
+ *  CBUFFER_STORAGE_ERROR: Reading or clearing step failed.
+ *  CBUFFER_STORAGE_SUCCESS: at least one element was popped.
+ */
+cir_storage_err_t cir_storage_pop_n(cir_storage_t *self, uint8_t *buf, uint32_t count, uint32_t *popped);
+
 /**
  * Read bytes from the circular buffer.
  * @param self the pointer on the circular buffer.
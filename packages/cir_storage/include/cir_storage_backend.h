@@ -51,10 +51,26 @@ typedef struct {
 
 typedef struct _cir_storage_flash_t cir_storage_flash_t;
 
+/** cp_block value of a storage without checkpoints */
+#define CIR_STORAGE_NO_CHECKPOINT 0xFFFFFFFF
+
 /**
  * Circular storage information.
- * This structure shall be filled by the backend (except wp and rp)
- * and passed to the @ref cir_storage_flash_init "generic init function".
+ * This structure shall be filled by the backend (except wp, rp, wb_addr,
+ * wb_len, cp_slot and cp_count) and passed to the @ref cir_storage_flash_init "generic init function".
+ *
+ * When wb_buf is set, pushed elements are gathered in this RAM buffer and
+ * programmed together when it is full, when the write pointer switches block,
+ * when a buffered element is read and on cir_storage_sync(). Buffered elements
+ * are lost on reset, so backends should schedule a cir_storage_sync() from the
+ * wb_dirty() callback, which is called again when programming the buffer
+ * fails: the buffered elements are kept until they are in flash. Its size
+ * should be the flash page size.
+ *
+ * When cp_block is set, the read and write pointers are appended to this block,
+ * which must not belong to the storage, on each block switch and every
+ * cp_interval pointer moves. The storage is then mounted from the last
+ * checkpoint instead of scanning all the blocks, as long as it is consistent.
  */
 typedef struct _cir_storage_flash_t {
 	cir_storage_t parent; /*!< Circular buffer handle */
@@ -69,6 +85,15 @@ typedef struct _cir_storage_flash_t {
 	int32_t (*erase)(cir_storage_flash_t *, uint32_t, uint32_t);          /*!< Erase function */
 	void (*lock)(cir_storage_flash_t *);   /*!< Lock function */
 	void (*unlock)(cir_storage_flash_t *); /*!< Unlock function */
+	uint8_t *wb_buf;      /*!< Write-back buffer, NULL to write through */
+	uint32_t wb_size;     /*!< Write-back buffer size (in bytes) */
+	uint32_t wb_addr;     /*!< Flash address of the buffered elements */
+	uint32_t wb_len;      /*!< Number of buffered bytes */
+	void (*wb_dirty)(cir_storage_flash_t *); /*!< Called when the write-back buffer gets its first element or fails to be programmed, may be NULL */
+	uint32_t cp_block;    /*!< Index of the checkpoint block, or CIR_STORAGE_NO_CHECKPOINT */
+	uint32_t cp_interval; /*!< Pointer moves between two checkpoints, 0 to only checkpoint on block switch */
+	uint32_t cp_slot;     /*!< Next free checkpoint slot */
+	uint32_t cp_count;    /*!< Pointer moves since the last checkpoint */
 } cir_storage_flash_t;
 
 /**
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __CIR_STORAGE_FLASH_SIM_H
+#define __CIR_STORAGE_FLASH_SIM_H
+
+#include <stdint.h>
+
+#include "cir_storage_backend.h"
+
+/**
+ * @addtogroup cbuffer
+ * @{
+ */
+
+/**
+ * RAM simulation of a NOR flash circular storage.
+ *
+ * Writes can only clear bits and may not cross a page boundary in a single
+ * program operation, erases set a whole block back to 0xFF. The operation
+ * counters allow to evaluate the flash traffic of the circular storage on a
+ * host, without any hardware.
+ */
+typedef struct _cir_storage_flash_sim_t {
+	cir_storage_flash_t storage;
+	uint8_t *flash;          /*!< RAM image of the flash */
+	uint32_t page_size;      /*!< Program page size (in bytes) */
+	uint32_t reads;          /*!< Number of read operations */
+	uint32_t programs;       /*!< Number of page program operations */
+	uint32_t erases;         /*!< Number of block erase operations */
+	uint32_t bytes_read;     /*!< Number of bytes read */
+	uint32_t bytes_written;  /*!< Number of bytes programmed */
+	uint32_t fail_writes;    /*!< Number of next writes to fail, to test errors */
+} cir_storage_flash_sim_t;
+
+/**
+ * Set up a simulated NOR flash circular storage.
+ *
+ * The flash image is kept as is, so that an existing storage can be mounted
+ * again. Fill it with 0xFF to start with an erased flash.
+ *
+ * @param sim         the storage to set up
+ * @param flash       RAM image of the flash, block_count * block_size bytes
+ * @param elt_size    the size of each element
+ * @param block_size  the size of an erase block
+ * @param block_count the number of blocks used
+ * @param page_size   the size of a program page
+ * @param wb_buf      write-back buffer, NULL to write through
+ * @param wb_size     size of wb_buf
+ * @param checkpoint  non zero to use the last block for checkpoints, every
+ *                    checkpoint pointer moves
+ *
+ * @return -1  if an error occurs,
+ *          0  if no error
+ */
+int32_t cir_storage_flash_sim_init(cir_storage_flash_sim_t *sim,
+				   uint8_t *flash,
+				   uint32_t elt_size,
+				   uint32_t block_size,
+				   uint32_t block_count,
+				   uint32_t page_size,
+				   uint8_t *wb_buf,
+				   uint32_t wb_size,
+				   uint32_t checkpoint);
+
+/**
+ * @}
+ */
+#endif /* __CIR_STORAGE_FLASH_SIM_H */
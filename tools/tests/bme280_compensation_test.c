@@ -0,0 +1,414 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************
+ * Host test of the BME280 fixed-point compensation: the integer pipeline
+ * (t_fine computed once, then pressure and humidity) is checked against the
+ * double precision formulas of the datasheet, and the cost per sample of
+ * both is measured.
+ *
+ * Calibration sets are drawn around the coefficients of real parts, each
+ * coefficient spread over +/-50% (+/-20% for the 32 bits pressure formula).
+ * For each set the ADC values are swept over the operating range of the
+ * sensor: -40..85 DegC, 300..1100 hPa and 0..100 %rH. Pressure and humidity
+ * are compared to the double formulas fed with the same t_fine, the error of
+ * t_fine itself shows in the temperature error.
+ *
+ * Compile with (from the top directory), with and without the 64 bits
+ * pressure compensation:
+ * gcc -O2 [-DCONFIG_BME280_ENABLE_INT64] -Ibsp/src/drivers/sensor \
+ *     bsp/src/drivers/sensor/bme280_compensate.c \
+ *     tools/tests/bme280_compensation_test.c -lm -o bme280_compensation_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#include "bme280_compensate.h"
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, \
+			       __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static int failures;
+
+#define CAL_SETS        2000
+#define T_STEPS         64
+#define P_STEPS         64
+#define H_STEPS         64
+
+/* Maximum error against the double formulas */
+#define T_TOLERANCE     0.011           /* DegC, output is in 0.01 DegC */
+#ifdef CONFIG_BME280_ENABLE_INT64
+#define P_TOLERANCE     0.05            /* Pa */
+#define CAL_SPREAD      0.5
+#else
+/* The 32 bits datasheet formula truncates a lot and its intermediate values
+ * overflow when the coefficients are too far from the usual ones */
+#define P_TOLERANCE     10.0            /* Pa */
+#define CAL_SPREAD      0.2
+#endif
+#define H_TOLERANCE     0.02            /* %rH */
+
+#define BENCH_SAMPLES   2000000
+
+/* Coefficients read from a BME280, each one is spread around this value */
+static const struct bme280_calibration_param_t typical_cal = {
+	.dig_T1 = 27504, .dig_T2 = 26435, .dig_T3 = -1000,
+	.dig_P1 = 36477, .dig_P2 = -10685, .dig_P3 = 3024,
+	.dig_P4 = 2855, .dig_P5 = 140, .dig_P6 = -7,
+	.dig_P7 = 15500, .dig_P8 = -14600, .dig_P9 = 6000,
+	.dig_H1 = 75, .dig_H2 = 370, .dig_H3 = 0,
+	.dig_H4 = 313, .dig_H5 = 50, .dig_H6 = 30,
+};
+
+/* Double precision reference, as given in the datasheet */
+
+static double ref_t_fine(const struct bme280_calibration_param_t *cal,
+			 int32_t adc_t)
+{
+	double var1, var2;
+
+	var1 = (((double)adc_t) / 16384.0 - ((double)cal->dig_T1) / 1024.0) *
+	       ((double)cal->dig_T2);
+	var2 = ((((double)adc_t) / 131072.0 -
+		 ((double)cal->dig_T1) / 8192.0) *
+		(((double)adc_t) / 131072.0 -
+		 ((double)cal->dig_T1) / 8192.0)) * ((double)cal->dig_T3);
+	return var1 + var2;
+}
+
+static double ref_p(const struct bme280_calibration_param_t *cal,
+		    int32_t adc_p, double t_fine)
+{
+	double var1, var2, p;
+
+	var1 = (t_fine / 2.0) - 64000.0;
+	var2 = var1 * var1 * ((double)cal->dig_P6) / 32768.0;
+	var2 = var2 + var1 * ((double)cal->dig_P5) * 2.0;
+	var2 = (var2 / 4.0) + (((double)cal->dig_P4) * 65536.0);
+	var1 = (((double)cal->dig_P3) * var1 * var1 / 524288.0 +
+		((double)cal->dig_P2) * var1) / 524288.0;
+	var1 = (1.0 + var1 / 32768.0) * ((double)cal->dig_P1);
+	if (var1 == 0.0)
+		return 0;
+	p = 1048576.0 - (double)adc_p;
+	p = (p - (var2 / 4096.0)) * 6250.0 / var1;
+	var1 = ((double)cal->dig_P9) * p * p / 2147483648.0;
+	var2 = p * ((double)cal->dig_P8) / 32768.0;
+	return p + (var1 + var2 + ((double)cal->dig_P7)) / 16.0;
+}
+
+static double ref_h(const struct bme280_calibration_param_t *cal,
+		    int32_t adc_h, double t_fine)
+{
+	double h = t_fine - 76800.0;
+
+	h = (adc_h - (((double)cal->dig_H4) * 64.0 +
+		      ((double)cal->dig_H5) / 16384.0 * h)) *
+	    (((double)cal->dig_H2) / 65536.0 *
+	     (1.0 + ((double)cal->dig_H6) / 67108864.0 * h *
+	      (1.0 + ((double)cal->dig_H3) / 67108864.0 * h)));
+	h = h * (1.0 - ((double)cal->dig_H1) * h / 524288.0);
+	if (h > 100.0)
+		h = 100.0;
+	else if (h < 0.0)
+		h = 0.0;
+	return h;
+}
+
+/* v spread over +/-CAL_SPREAD, clamped to the range of the register */
+static int32_t spread(int32_t v, int32_t min, int32_t max)
+{
+	double r = v * (1.0 - CAL_SPREAD +
+			2.0 * CAL_SPREAD * rand() / RAND_MAX);
+
+	return r < min ? min : r > max ? max : (int32_t)r;
+}
+
+static void random_cal(struct bme280_calibration_param_t *cal, int first)
+{
+	const struct bme280_calibration_param_t *t = &typical_cal;
+
+	*cal = *t;
+	if (first)
+		return;
+	cal->dig_T1 = spread(t->dig_T1, 0, UINT16_MAX);
+	cal->dig_T2 = spread(t->dig_T2, INT16_MIN, INT16_MAX);
+	cal->dig_T3 = spread(t->dig_T3, INT16_MIN, INT16_MAX);
+	cal->dig_P1 = spread(t->dig_P1, 0, UINT16_MAX);
+	cal->dig_P2 = spread(t->dig_P2, INT16_MIN, INT16_MAX);
+	cal->dig_P3 = spread(t->dig_P3, INT16_MIN, INT16_MAX);
+	cal->dig_P4 = spread(t->dig_P4, INT16_MIN, INT16_MAX);
+	cal->dig_P5 = spread(t->dig_P5, INT16_MIN, INT16_MAX);
+	cal->dig_P6 = spread(t->dig_P6, INT16_MIN, INT16_MAX);
+	cal->dig_P7 = spread(t->dig_P7, INT16_MIN, INT16_MAX);
+	cal->dig_P8 = spread(t->dig_P8, INT16_MIN, INT16_MAX);
+	cal->dig_P9 = spread(t->dig_P9, INT16_MIN, INT16_MAX);
+	cal->dig_H1 = spread(t->dig_H1, 0, UINT8_MAX);
+	cal->dig_H2 = spread(t->dig_H2, INT16_MIN, INT16_MAX);
+	cal->dig_H3 = rand() % 8;
+	cal->dig_H4 = spread(t->dig_H4, INT16_MIN, INT16_MAX);
+	cal->dig_H5 = spread(t->dig_H5, INT16_MIN, INT16_MAX);
+	cal->dig_H6 = spread(t->dig_H6, INT8_MIN, INT8_MAX);
+}
+
+/* Smallest ADC value in [lo, hi] for which f is above target, f increasing */
+static int32_t invert(double (*f)(const struct bme280_calibration_param_t *,
+				  int32_t, double),
+		      const struct bme280_calibration_param_t *cal,
+		      double t_fine, int32_t lo, int32_t hi, double target,
+		      int decreasing)
+{
+	while (lo < hi) {
+		int32_t mid = lo + (hi - lo) / 2;
+		double v = f(cal, mid, t_fine);
+
+		if (decreasing ? v <= target : v >= target)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+static double ref_t_fine_arg(const struct bme280_calibration_param_t *cal,
+			     int32_t adc_t, double unused)
+{
+	return ref_t_fine(cal, adc_t);
+}
+
+struct stats {
+	double max_t, max_p, max_h;
+	unsigned long samples;
+};
+
+static void check_cal(const struct bme280_calibration_param_t *cal,
+		      struct stats *st)
+{
+	int32_t t_lo, t_hi, t_zero, t_span;
+	int i, j;
+
+	/* t_fine is 5120 times the temperature. It is a parabola of adc_t,
+	 * search on its increasing side: 0 DegC is close to 16 * T1 and
+	 * T2 / 16384 is the slope of t_fine. */
+	t_zero = 16 * (int32_t)cal->dig_T1;
+	t_span = (int32_t)(200.0 * 5120 * 16384 / cal->dig_T2);
+	t_lo = t_zero > t_span ? t_zero - t_span : 0;
+	t_hi = t_zero + t_span < 0xFFFFF ? t_zero + t_span : 0xFFFFF;
+	t_lo = invert(ref_t_fine_arg, cal, 0, t_lo, t_hi, -40.0 * 5120, 0);
+	t_hi = invert(ref_t_fine_arg, cal, 0, t_lo, t_hi, 85.0 * 5120, 0);
+
+	for (i = 0; i <= T_STEPS; i++) {
+		int32_t adc_t = t_lo + (int64_t)(t_hi - t_lo) * i / T_STEPS;
+		int32_t t_fine = bme280_compensate_t_fine(cal, adc_t);
+		double rt_fine = ref_t_fine(cal, adc_t);
+		double err;
+		int32_t p_lo, p_hi, h_hi;
+
+		err = fabs(bme280_compensate_t(t_fine) / 100.0 -
+			   rt_fine / 5120.0);
+		if (err > st->max_t)
+			st->max_t = err;
+		CHECK(err <= T_TOLERANCE);
+
+		/* Pressure decreases with the ADC value */
+		p_lo = invert(ref_p, cal, rt_fine, 0, 0xFFFFF, 110000.0, 1);
+		p_hi = invert(ref_p, cal, rt_fine, 0, 0xFFFFF, 30000.0, 1);
+		for (j = 0; j <= P_STEPS; j++) {
+			int32_t adc_p = p_lo + (int64_t)(p_hi - p_lo) * j /
+					P_STEPS;
+			double p = bme280_compensate_p(cal, adc_p, t_fine) /
+				   256.0;
+
+			err = fabs(p - ref_p(cal, adc_p, t_fine));
+			if (err > st->max_p)
+				st->max_p = err;
+			if (err > P_TOLERANCE)
+				printf("adc_p %d adc_t %d: %f Pa, expected %f\n",
+				       adc_p, adc_t, p,
+				       ref_p(cal, adc_p, t_fine));
+			CHECK(err <= P_TOLERANCE);
+		}
+
+		h_hi = invert(ref_h, cal, rt_fine, 0, 0xFFFF, 100.0, 0);
+		for (j = 0; j <= H_STEPS; j++) {
+			int32_t adc_h = (int64_t)h_hi * j / H_STEPS;
+			double h = bme280_compensate_h(cal, adc_h, t_fine) /
+				   1024.0;
+
+			err = fabs(h - ref_h(cal, adc_h, t_fine));
+			if (err > st->max_h)
+				st->max_h = err;
+			CHECK(err <= H_TOLERANCE);
+		}
+		st->samples++;
+	}
+}
+
+static void test_parse(void)
+{
+	/* press 0x65 0x5a 0xc0, temp 0x7e 0xed 0x00, hum 0x6e 0x8f */
+	static const uint8_t frame[BME280_DATA_FRAME_LEN] = {
+		0x65, 0x5a, 0xc0, 0x7e, 0xed, 0x00, 0x6e, 0x8f
+	};
+	struct bme280_uncomp_data raw;
+
+	bme280_parse_data_frame(frame, &raw);
+	CHECK(raw.adc_p == 0x655ac);
+	CHECK(raw.adc_t == 0x7eed0);
+	CHECK(raw.adc_h == 0x6e8f);
+}
+
+static double now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+static inline unsigned long long cycles(void)
+{
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static volatile double sink_d;
+static volatile uint32_t sink_u;
+
+static void bench(const struct bme280_calibration_param_t *cal)
+{
+	static uint8_t frames[256][BME280_DATA_FRAME_LEN];
+	unsigned long long c0, c1;
+	double t0, t1;
+	long i;
+
+	for (i = 0; i < 256; i++) {
+		frames[i][0] = 0x60 + (i & 7);
+		frames[i][1] = i;
+		frames[i][2] = 0xc0;
+		frames[i][3] = 0x7e + (i >> 6);
+		frames[i][4] = i * 3;
+		frames[i][5] = 0x00;
+		frames[i][6] = 0x60 + (i & 15);
+		frames[i][7] = i * 7;
+	}
+
+	t0 = now_us();
+	c0 = cycles();
+	for (i = 0; i < BENCH_SAMPLES; i++) {
+		struct bme280_uncomp_data raw;
+		int32_t t_fine;
+
+		bme280_parse_data_frame(frames[i & 255], &raw);
+		t_fine = bme280_compensate_t_fine(cal, raw.adc_t);
+		sink_u = bme280_compensate_t(t_fine);
+		sink_u = bme280_compensate_p(cal, raw.adc_p, t_fine);
+		sink_u = bme280_compensate_h(cal, raw.adc_h, t_fine);
+	}
+	c1 = cycles();
+	t1 = now_us();
+	printf("fixed-point T+P+H: %.1f ns/sample", (t1 - t0) * 1e3 /
+	       BENCH_SAMPLES);
+	if (c1 != c0)
+		printf(", %.0f cycles/sample", (double)(c1 - c0) /
+		       BENCH_SAMPLES);
+	printf("\n");
+
+	t0 = now_us();
+	c0 = cycles();
+	for (i = 0; i < BENCH_SAMPLES; i++) {
+		struct bme280_uncomp_data raw;
+		double t_fine;
+
+		bme280_parse_data_frame(frames[i & 255], &raw);
+		t_fine = ref_t_fine(cal, raw.adc_t);
+		sink_d = t_fine / 5120.0;
+		sink_d = ref_p(cal, raw.adc_p, t_fine);
+		sink_d = ref_h(cal, raw.adc_h, t_fine);
+	}
+	c1 = cycles();
+	t1 = now_us();
+	printf("double T+P+H:      %.1f ns/sample", (t1 - t0) * 1e3 /
+	       BENCH_SAMPLES);
+	if (c1 != c0)
+		printf(", %.0f cycles/sample", (double)(c1 - c0) /
+		       BENCH_SAMPLES);
+	printf(" (hardware FPU, software double on target is much slower)\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct bme280_calibration_param_t cal;
+	struct stats st;
+	int i;
+
+	srand(280);
+	memset(&st, 0, sizeof(st));
+
+	test_parse();
+	for (i = 0; i < CAL_SETS; i++) {
+		random_cal(&cal, i == 0);
+		check_cal(&cal, &st);
+	}
+	printf("%d calibration sets, %lu temperatures, %s pressure\n",
+	       CAL_SETS, st.samples,
+#ifdef CONFIG_BME280_ENABLE_INT64
+	       "64 bits"
+#else
+	       "32 bits"
+#endif
+	       );
+	printf("max error: %.4f DegC, %.4f Pa, %.4f %%rH\n",
+	       st.max_t, st.max_p, st.max_h);
+
+	bench(&typical_cal);
+
+	if (failures) {
+		printf("FAILED: %d checks\n", failures);
+		return 1;
+	}
+	printf("PASSED\n");
+	return 0;
+}
@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ *****************************************************************************
+ * Host test of the BMI160 FIFO demultiplexer: FIFO dumps are decoded in one
+ * pass and checked against the per sensor parsing the driver used to do, and
+ * the decoding throughput of both is measured.
+ *
+ * Dumps are generated with accel, gyro and mag in headered mode at different
+ * ODRs. FIFO dumps recorded on target (raw bytes read from the FIFO data
+ * register) can be given as arguments, they are then checked and measured
+ * the same way.
+ *
+ * Compile with (from the top directory):
+ * gcc -O2 -Ibsp/src/drivers/sensor bsp/src/drivers/sensor/bmi160_fifo.c \
+ *     tools/tests/bmi160_fifo_test.c -o bmi160_fifo_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "bmi160_fifo.h"
+#include "bmi160_regs.h"
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, \
+			       __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static int failures;
+
+#define DUMP_SIZE       1024
+#define MAX_SAMPLES     (DUMP_SIZE / 7 + 1)
+
+struct dump {
+	uint8_t data[DUMP_SIZE + 64];
+	uint16_t len;
+	/* Expected content, as generated */
+	uint16_t count[BMI160_FIFO_SENSOR_COUNT];
+	uint32_t time[BMI160_FIFO_SENSOR_COUNT][MAX_SAMPLES];
+};
+
+/* Sample storage for one sensor */
+struct output {
+	struct bmi160_fifo_samples s;
+	int16_t x[MAX_SAMPLES], y[MAX_SAMPLES], z[MAX_SAMPLES];
+	uint16_t r[MAX_SAMPLES];
+	uint32_t time[MAX_SAMPLES];
+};
+
+static void output_init(struct output *o, uint32_t period)
+{
+	memset(o, 0, sizeof(*o));
+	o->s.x = o->x;
+	o->s.y = o->y;
+	o->s.z = o->z;
+	o->s.r = o->r;
+	o->s.time = o->time;
+	o->s.size = MAX_SAMPLES;
+	o->s.period = period;
+}
+
+static const uint8_t raw_size[BMI160_FIFO_SENSOR_COUNT] = { 6, 6, 8 };
+
+/*
+ * Build a dump the way the sensor fills its FIFO: one frame per sensortime
+ * tick where at least one sensor samples, data of the sensors in mag, gyro,
+ * accel order, then a sensortime frame and over-read bytes. A skip frame and
+ * an input config frame can be inserted to check control frames.
+ */
+static void make_dump(struct dump *d, const uint32_t period[], uint32_t start,
+		      uint16_t max_len, int control_frames)
+{
+	uint32_t tick = 0;
+	uint32_t t, last = 0;
+	int s, mask;
+
+	memset(d, 0, sizeof(*d));
+	for (s = 0; s < BMI160_FIFO_SENSOR_COUNT; s++)
+		if (period[s] && (!tick || period[s] < tick))
+			tick = period[s];
+
+	if (control_frames) {
+		d->data[d->len++] = FIFO_HEAD_SKIP_FRAME;
+		d->data[d->len++] = 3;
+	}
+
+	for (t = (start + tick - 1) / tick * tick;; t += tick) {
+		mask = 0;
+		for (s = 0; s < BMI160_FIFO_SENSOR_COUNT; s++)
+			if (period[s] && t % period[s] == 0)
+				mask |= 1 << s;
+		if (!mask)
+			continue;
+		uint16_t size = 1;
+		for (s = 0; s < BMI160_FIFO_SENSOR_COUNT; s++)
+			if (mask & (1 << s))
+				size += raw_size[s];
+		/* Keep room for the sensortime frame */
+		if (d->len + size + 4 > max_len)
+			break;
+		if (control_frames && d->len > max_len / 2) {
+			d->data[d->len++] = FIFO_HEAD_INPUT_CONFIG;
+			d->data[d->len++] = 0x01;
+			control_frames = 0;
+		}
+		d->data[d->len++] = 0x80 | (mask << 2);
+		for (s = BMI160_FIFO_SENSOR_COUNT - 1; s >= 0; s--) {
+			if (!(mask & (1 << s)))
+				continue;
+			for (int i = 0; i < raw_size[s]; i++)
+				d->data[d->len++] = rand();
+			d->time[s][d->count[s]++] = t & BMI160_SENSORTIME_MASK;
+		}
+		last = t;
+	}
+
+	/* Sensortime read a bit after the last frame */
+	t = (last + rand() % tick) & BMI160_SENSORTIME_MASK;
+	d->data[d->len++] = FIFO_HEAD_SENSOR_TIME;
+	d->data[d->len++] = t;
+	d->data[d->len++] = t >> 8;
+	d->data[d->len++] = t >> 16;
+	while (d->len < max_len)
+		d->data[d->len++] = FIFO_HEAD_OVER_READ_LSB;
+}
+
+/*
+ * Per sensor parsing, as done by the driver before the demultiplexer: the
+ * whole dump is walked for each sensor, skipping the data of the others.
+ */
+static int legacy_parse(const uint8_t *data, uint16_t len, int type,
+			int32_t out[][3])
+{
+	uint16_t i = 0;
+	int n = 0;
+	int mask, s;
+
+	while (i < len) {
+		uint8_t head = data[i++];
+		switch (head) {
+		case FIFO_HEAD_A: mask = 1; break;
+		case FIFO_HEAD_G: mask = 2; break;
+		case FIFO_HEAD_G_A: mask = 3; break;
+		case FIFO_HEAD_M: mask = 4; break;
+		case FIFO_HEAD_M_A: mask = 5; break;
+		case FIFO_HEAD_M_G: mask = 6; break;
+		case FIFO_HEAD_M_G_A: mask = 7; break;
+		case FIFO_HEAD_SKIP_FRAME:
+		case FIFO_HEAD_INPUT_CONFIG:
+			i++;
+			continue;
+		default:
+			return n;
+		}
+		int size = 0;
+		for (s = 0; s < BMI160_FIFO_SENSOR_COUNT; s++)
+			if (mask & (1 << s))
+				size += raw_size[s];
+		if (i + size > len)
+			return n;
+		for (s = BMI160_FIFO_SENSOR_COUNT - 1; s >= 0; s--) {
+			if (!(mask & (1 << s)))
+				continue;
+			if (s != type) {
+				i += raw_size[s];
+				continue;
+			}
+			const uint8_t *p = &data[i];
+			if (s == BMI160_FIFO_MAG) {
+				out[n][0] = (((int32_t)(int8_t)p[1]) << 5) |
+					    ((p[0] & 0xF8) >> 3);
+				out[n][1] = (((int32_t)(int8_t)p[3]) << 5) |
+					    ((p[2] & 0xF8) >> 3);
+				out[n][2] = (((int32_t)(int8_t)p[5]) << 7) |
+					    ((p[4] & 0xFE) >> 1);
+			} else {
+				out[n][0] = (((int32_t)(int8_t)p[1]) << 8) |
+					    p[0];
+				out[n][1] = (((int32_t)(int8_t)p[3]) << 8) |
+					    p[2];
+				out[n][2] = (((int32_t)(int8_t)p[5]) << 8) |
+					    p[4];
+			}
+			n++;
+			i += raw_size[s];
+		}
+	}
+	return n;
+}
+
+/* Demultiplex a dump and compare with the per sensor parsing */
+static void check_against_legacy(const uint8_t *data, uint16_t len,
+				 const uint32_t period[])
+{
+	static struct output out[BMI160_FIFO_SENSOR_COUNT];
+	static int32_t ref[MAX_SAMPLES][3];
+	struct bmi160_fifo_demux demux = {};
+	int s, i, n;
+
+	for (s = 0; s < BMI160_FIFO_SENSOR_COUNT; s++) {
+		output_init(&out[s], period ? period[s] : 0);
+		demux.out[s] = &out[s].s;
+	}
+	bmi160_fifo_demux(&demux, data, len);
+
+	for (s = 0; s < BMI160_FIFO_SENSOR_COUNT; s++) {
+		n = legacy_parse(data, len, s, ref);
+		CHECK(n == out[s].s.count);
+		for (i = 0; i < n && i < out[s].s.count; i++) {
+			CHECK(ref[i][0] == out[s].x[i]);
+			CHECK(ref[i][1] == out[s].y[i]);
+			CHECK(ref[i][2] == out[s].z[i]);
+		}
+	}
+}
+
+static const uint32_t periods[][BMI160_FIFO_SENSOR_COUNT] = {
+	/* accel 100Hz, gyro 200Hz, mag 25Hz */
+	{ 256, 128, 1024 },
+	/* accel 1600Hz only */
+	{ 16, 0, 0 },
+	/* accel and gyro 800Hz, mag 100Hz */
+	{ 32, 32, 256 },
+	/* gyro 25Hz, mag 12.5Hz */
+	{ 0, 1024, 2048 },
+};
+
+static void test_generated(void)
+{
+	static struct dump d;
+	static struct output out[BMI160_FIFO_SENSOR_COUNT];
+	struct bmi160_fifo_demux demux;
+	unsigned int p;
+	int s, i, run;
+
+	for (run = 0; run < 200; run++) {
+		p = run % (sizeof(periods) / sizeof(periods[0]));
+		/* Start close to the sensortime wrap around on some runs */
+		make_dump(&d, periods[p],
+			  run & 1 ? BMI160_SENSORTIME_MASK - 4096 :
+			  rand() % 0x100000, 64 + rand() % (DUMP_SIZE - 64),
+			  run % 3 == 0);
+
+		memset(&demux, 0, sizeof(demux));
+		for (s = 0; s < BMI160_FIFO_SENSOR_COUNT; s++) {
+			output_init(&out[s], periods[p][s]);
+			demux.out[s] = &out[s].s;
+		}
+		/* Everything up to the sensortime frame is consumed */
+		CHECK(bmi160_fifo_demux(&demux, d.data, d.len) <= d.len);
+		CHECK(demux.sensortime_valid);
+		CHECK(demux.skipped == (run % 3 == 0 ? 3 : 0));
+
+		for (s = 0; s < BMI160_FIFO_SENSOR_COUNT; s++) {
+			CHECK(out[s].s.count == d.count[s]);
+			for (i = 0; i < d.count[s]; i++)
+				if (out[s].time[i] != d.time[s][i]) {
+					CHECK(out[s].time[i] == d.time[s][i]);
+					break;
+				}
+		}
+		check_against_legacy(d.data, d.len, periods[p]);
+	}
+}
+
+/* A dump cut in the middle of a frame leaves the frame for the next read */
+static void test_truncated(void)
+{
+	static struct dump d;
+	static struct output out;
+	struct bmi160_fifo_demux demux = {};
+	uint16_t used;
+
+	make_dump(&d, periods[1], 0, 200, 0);
+	output_init(&out, periods[1][0]);
+	demux.out[BMI160_FIFO_ACCEL] = &out.s;
+
+	/* 7 bytes per frame: stop after 10 frames and 3 bytes */
+	used = bmi160_fifo_demux(&demux, d.data, 73);
+	CHECK(used == 70);
+	CHECK(out.s.count == 10);
+	CHECK(!demux.sensortime_valid);
+	/* Stamped forward from last_time, which is 0 */
+	CHECK(out.time[9] == 10 * 16);
+
+	/* Output full: stop before the frame which does not fit */
+	output_init(&out, periods[1][0]);
+	out.s.size = 4;
+	used = bmi160_fifo_demux(&demux, d.data, d.len);
+	CHECK(used == 28);
+	CHECK(out.s.count == 4);
+	out.s.count = 0;
+	used += bmi160_fifo_demux(&demux, d.data + used, d.len - used);
+	CHECK(used == 56);
+}
+
+/* Samples of sensors without output are dropped */
+static void test_dropped(void)
+{
+	static struct dump d;
+	static struct output out;
+	struct bmi160_fifo_demux demux = {};
+
+	make_dump(&d, periods[0], 0, DUMP_SIZE, 0);
+	output_init(&out, periods[0][BMI160_FIFO_GYRO]);
+	demux.out[BMI160_FIFO_GYRO] = &out.s;
+	bmi160_fifo_demux(&demux, d.data, d.len);
+	CHECK(out.s.count == d.count[BMI160_FIFO_GYRO]);
+	CHECK(out.time[out.s.count - 1] ==
+	      d.time[BMI160_FIFO_GYRO][out.s.count - 1]);
+}
+
+static double elapsed_us(struct timeval *t0)
+{
+	struct timeval t1;
+
+	gettimeofday(&t1, NULL);
+	return (t1.tv_sec - t0->tv_sec) * 1e6 + t1.tv_usec - t0->tv_usec;
+}
+
+static void bench(const uint8_t *data, uint16_t len, const uint32_t period[])
+{
+	static struct output out[BMI160_FIFO_SENSOR_COUNT];
+	static int32_t ref[MAX_SAMPLES][3];
+	struct bmi160_fifo_demux demux = {};
+	struct timeval t0;
+	int loops = 20000000 / len;
+	double single, legacy;
+	int s, i;
+
+	for (s = 0; s < BMI160_FIFO_SENSOR_COUNT; s++) {
+		output_init(&out[s], period ? period[s] : 0);
+		demux.out[s] = &out[s].s;
+	}
+
+	gettimeofday(&t0, NULL);
+	for (i = 0; i < loops; i++) {
+		for (s = 0; s < BMI160_FIFO_SENSOR_COUNT; s++)
+			out[s].s.count = 0;
+		bmi160_fifo_demux(&demux, data, len);
+	}
+	single = elapsed_us(&t0);
+
+	gettimeofday(&t0, NULL);
+	for (i = 0; i < loops; i++)
+		for (s = 0; s < BMI160_FIFO_SENSOR_COUNT; s++)
+			legacy_parse(data, len, s, ref);
+	legacy = elapsed_us(&t0);
+
+	printf("  single pass: %6.1f MB/s, per sensor walks: %6.1f MB/s\n",
+	       (double)len * loops / single, (double)len * loops / legacy);
+}
+
+static int load_dump(const char *path, struct dump *d)
+{
+	FILE *f = fopen(path, "rb");
+
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	memset(d, 0, sizeof(*d));
+	d->len = fread(d->data, 1, DUMP_SIZE, f);
+	fclose(f);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static struct dump d;
+	int i;
+
+	srand(1);
+	test_generated();
+	test_truncated();
+	test_dropped();
+	printf("generated dumps: %s\n", failures ? "FAILED" : "PASSED");
+
+	printf("accel 100Hz, gyro 200Hz, mag 25Hz:\n");
+	make_dump(&d, periods[0], 0, DUMP_SIZE, 0);
+	bench(d.data, d.len, periods[0]);
+	printf("accel and gyro 800Hz, mag 100Hz:\n");
+	make_dump(&d, periods[2], 0, DUMP_SIZE, 0);
+	bench(d.data, d.len, periods[2]);
+
+	for (i = 1; i < argc; i++) {
+		if (load_dump(argv[i], &d)) {
+			failures++;
+			continue;
+		}
+		printf("%s (%u bytes):\n", argv[i], d.len);
+		check_against_legacy(d.data, d.len, NULL);
+		bench(d.data, d.len, NULL);
+	}
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ *****************************************************************************
+ * Host benchmark of the circular storage library on a simulated NOR flash.
+ *
+ * Compile with (from the top directory):
+ * gcc -O2 -Ipackages/cir_storage/include packages/cir_storage/cir_storage.c \
+ *     packages/cir_storage/cir_storage_flash_sim.c \
+ *     tools/tests/cir_storage_bench.c -o cir_storage_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cir_storage.h"
+#include "cir_storage_flash_sim.h"
+
+#define BLOCK_SIZE   4096
+#define BLOCK_COUNT  16
+#define PAGE_SIZE    256
+#define BATCH        16
+#define NB_ELEMENTS  100000
+
+/* Rough SPI NOR timings (in us) used to estimate the flash bound throughput:
+ * command overhead including flash wake up, page program, sector erase, and
+ * transfer time of one byte */
+#define T_OP         20.0
+#define T_PROGRAM    300.0
+#define T_ERASE      40000.0
+#define T_BYTE       0.25
+
+static uint8_t flash[BLOCK_SIZE * BLOCK_COUNT];
+static uint8_t wb_buf[PAGE_SIZE];
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Elements start with their sequence number, followed by a pattern */
+static void fill_element(uint8_t *elt, uint32_t elt_size, uint32_t seq)
+{
+	uint32_t i;
+
+	memcpy(elt, &seq, sizeof(seq));
+	for (i = sizeof(seq); i < elt_size; i++)
+		elt[i] = seq + i;
+}
+
+static int check_element(const uint8_t *elt, uint32_t elt_size, uint32_t seq)
+{
+	uint32_t i;
+
+	if (memcmp(elt, &seq, sizeof(seq)))
+		return -1;
+	for (i = sizeof(seq); i < elt_size; i++)
+		if (elt[i] != (uint8_t)(seq + i))
+			return -1;
+	return 0;
+}
+
+struct counters {
+	double time;
+	uint32_t reads;
+	uint32_t programs;
+	uint32_t erases;
+	uint32_t bytes;
+};
+
+static void reset_counters(cir_storage_flash_sim_t *sim)
+{
+	sim->reads = sim->programs = sim->erases = 0;
+	sim->bytes_read = sim->bytes_written = 0;
+}
+
+static void add_counters(struct counters *c, cir_storage_flash_sim_t *sim,
+			 double start)
+{
+	c->time += now() - start;
+	c->reads += sim->reads;
+	c->programs += sim->programs;
+	c->erases += sim->erases;
+	c->bytes += sim->bytes_read + sim->bytes_written;
+}
+
+static void report(const char *name, struct counters *c, uint32_t count)
+{
+	double flash_us = (c->reads + c->programs) * T_OP +
+			  c->programs * T_PROGRAM + c->erases * T_ERASE +
+			  c->bytes * T_BYTE;
+
+	printf("  %-5s %10.0f elt/s (host) %8.0f elt/s (flash) "
+	       "%5.2f programs/elt %5.2f reads/elt %4u erases\n", name,
+	       count / c->time, count / (flash_us / 1e6),
+	       (double)c->programs / count, (double)c->reads / count,
+	       c->erases);
+}
+
+/* Push then pop NB_ELEMENTS, the storage never holds more than a block */
+static int bench(uint32_t elt_size, int write_back, int batch)
+{
+	static uint8_t elts[BATCH * 256];
+	cir_storage_flash_sim_t sim;
+	cir_storage_t *storage = &sim.storage.parent;
+	uint32_t pushed = 0, popped = 0, n;
+	struct counters push = { 0 }, pop = { 0 };
+	double t;
+	int i;
+
+	memset(flash, 0xFF, sizeof(flash));
+	if (cir_storage_flash_sim_init(&sim, flash, elt_size, BLOCK_SIZE,
+				       BLOCK_COUNT, PAGE_SIZE,
+				       write_back ? wb_buf : NULL,
+				       sizeof(wb_buf), 0) != 0) {
+		printf("init failed\n");
+		return -1;
+	}
+
+	while (popped < NB_ELEMENTS) {
+		for (i = 0; i < BATCH; i++)
+			fill_element(elts + i * elt_size, elt_size, pushed + i);
+
+		reset_counters(&sim);
+		t = now();
+		if (batch) {
+			cir_storage_push_n(storage, elts, BATCH);
+		} else {
+			for (i = 0; i < BATCH; i++)
+				cir_storage_push(storage, elts + i * elt_size);
+		}
+		add_counters(&push, &sim, t);
+		pushed += BATCH;
+
+		memset(elts, 0, sizeof(elts));
+		reset_counters(&sim);
+		t = now();
+		if (batch) {
+			if (cir_storage_pop_n(storage, elts, BATCH, &n)
+			    != CBUFFER_STORAGE_SUCCESS || n != BATCH) {
+				printf("pop_n failed\n");
+				return -1;
+			}
+		} else {
+			for (i = 0; i < BATCH; i++)
+				if (cir_storage_pop(storage, elts + i * elt_size)
+				    != CBUFFER_STORAGE_SUCCESS) {
+					printf("pop failed\n");
+					return -1;
+				}
+		}
+		add_counters(&pop, &sim, t);
+		for (i = 0; i < BATCH; i++, popped++)
+			if (check_element(elts + i * elt_size, elt_size,
+					  popped)) {
+				printf("element %u corrupted\n", popped);
+				return -1;
+			}
+	}
+
+	printf("%s%s, %u bytes elements\n", batch ? "push_n/pop_n" : "push/pop",
+	       write_back ? " + write-back" : "", elt_size);
+	report("push", &push, pushed);
+	report("pop", &pop, popped);
+	return 0;
+}
+
+/* Buffered elements must survive a sync and a new mount */
+static int check_remount(uint32_t elt_size)
+{
+	cir_storage_flash_sim_t sim;
+	uint8_t elt[256];
+	uint32_t i;
+
+	memset(flash, 0xFF, sizeof(flash));
+	cir_storage_flash_sim_init(&sim, flash, elt_size, BLOCK_SIZE,
+				   BLOCK_COUNT, PAGE_SIZE, wb_buf,
+				   sizeof(wb_buf), 0);
+	for (i = 0; i < 1000; i++) {
+		fill_element(elt, elt_size, i);
+		cir_storage_push(&sim.storage.parent, elt);
+	}
+	cir_storage_sync(&sim.storage.parent);
+
+	cir_storage_flash_sim_init(&sim, flash, elt_size, BLOCK_SIZE,
+				   BLOCK_COUNT, PAGE_SIZE, NULL, 0, 0);
+	for (i = 0; i < 1000; i++) {
+		if (cir_storage_pop(&sim.storage.parent, elt)
+		    != CBUFFER_STORAGE_SUCCESS ||
+		    check_element(elt, elt_size, i)) {
+			printf("remount: element %u lost\n", i);
+			return -1;
+		}
+	}
+	if (cir_storage_pop(&sim.storage.parent, elt)
+	    != CBUFFER_STORAGE_EMPTY_ERROR) {
+		printf("remount: unexpected element\n");
+		return -1;
+	}
+	return 0;
+}
+
+/* Writes fail now and then: every acknowledged element must be read back, in
+ * order, once the flash works again */
+static int check_write_errors(uint32_t elt_size)
+{
+	cir_storage_flash_sim_t sim;
+	cir_storage_t *storage = &sim.storage.parent;
+	uint8_t elt[256];
+	uint32_t pushed = 0, popped = 0, i;
+
+	memset(flash, 0xFF, sizeof(flash));
+	cir_storage_flash_sim_init(&sim, flash, elt_size, BLOCK_SIZE,
+				   BLOCK_COUNT, PAGE_SIZE, wb_buf,
+				   sizeof(wb_buf), 50);
+	for (i = 0; i < 3000; i++) {
+		if (i % 97 == 0)
+			sim.fail_writes = 1 + i % 3;
+		fill_element(elt, elt_size, pushed);
+		/* A refused element is pushed again */
+		if (cir_storage_push(storage, elt) == CBUFFER_STORAGE_SUCCESS)
+			pushed++;
+		/* Pop 3 of 4 times, so that the storage never wraps, a
+		 * buffered element must be flushed first */
+		if (i % 4 &&
+		    cir_storage_pop(storage, elt) == CBUFFER_STORAGE_SUCCESS) {
+			if (check_element(elt, elt_size, popped)) {
+				printf("write errors: element %u corrupted\n",
+				       popped);
+				return -1;
+			}
+			popped++;
+		}
+	}
+	sim.fail_writes = 0;
+	if (cir_storage_sync(storage) != CBUFFER_STORAGE_SUCCESS) {
+		printf("write errors: sync failed\n");
+		return -1;
+	}
+
+	/* Remount, without the RAM buffer */
+	cir_storage_flash_sim_init(&sim, flash, elt_size, BLOCK_SIZE,
+				   BLOCK_COUNT, PAGE_SIZE, NULL, 0, 50);
+	for (; popped < pushed; popped++) {
+		if (cir_storage_pop(storage, elt) != CBUFFER_STORAGE_SUCCESS ||
+		    check_element(elt, elt_size, popped)) {
+			printf("write errors: element %u lost\n", popped);
+			return -1;
+		}
+	}
+	if (cir_storage_pop(storage, elt) != CBUFFER_STORAGE_EMPTY_ERROR) {
+		printf("write errors: unexpected element\n");
+		return -1;
+	}
+	return 0;
+}
+
+/* Mount a storage holding data, from its checkpoint then with a full scan */
+static int bench_mount(uint32_t block_count)
+{
+	uint32_t elt_size = 16;
+	uint32_t size = block_count * BLOCK_SIZE;
+	uint8_t *image = malloc(size);
+	uint8_t *copy = malloc(size);
+	cir_storage_flash_sim_t sim;
+	block_pointer_t wp, rp;
+	uint32_t pushed, popped, i;
+	double t, full_time, cp_time;
+	uint32_t full_reads, cp_reads;
+	uint8_t elt[16];
+	int ret = -1;
+
+	if (!image || !copy)
+		goto exit;
+	memset(image, 0xFF, size);
+	cir_storage_flash_sim_init(&sim, image, elt_size, BLOCK_SIZE,
+				   block_count, PAGE_SIZE, NULL, 0, 64);
+
+	/* Wrap around once and leave the pointers in the middle of blocks */
+	pushed = (block_count + block_count / 2) * (BLOCK_SIZE / 20) + 7;
+	for (i = 0; i < pushed; i++) {
+		fill_element(elt, elt_size, i);
+		cir_storage_push(&sim.storage.parent, elt);
+	}
+	for (i = 0; i < block_count * (BLOCK_SIZE / 20) / 3; i++)
+		cir_storage_pop(&sim.storage.parent, elt);
+	memcpy(&popped, elt, sizeof(popped));
+	popped++;
+	wp = sim.storage.wp;
+	rp = sim.storage.rp;
+
+	/* Full scan, forced by erasing the checkpoints */
+	memcpy(copy, image, size);
+	memset(copy + (block_count - 1) * BLOCK_SIZE, 0xFF, BLOCK_SIZE);
+	t = now();
+	cir_storage_flash_sim_init(&sim, copy, elt_size, BLOCK_SIZE,
+				   block_count, PAGE_SIZE, NULL, 0, 64);
+	full_time = now() - t;
+	full_reads = sim.reads;
+	if (sim.storage.wp.offset != wp.offset ||
+	    sim.storage.rp.offset != rp.offset) {
+		printf("full scan: wrong pointers\n");
+		goto exit;
+	}
+
+	t = now();
+	cir_storage_flash_sim_init(&sim, image, elt_size, BLOCK_SIZE,
+				   block_count, PAGE_SIZE, NULL, 0, 64);
+	cp_time = now() - t;
+	cp_reads = sim.reads;
+	if (sim.storage.wp.offset != wp.offset ||
+	    sim.storage.rp.offset != rp.offset) {
+		printf("checkpoint: wrong pointers\n");
+		goto exit;
+	}
+	if (cir_storage_pop(&sim.storage.parent, elt) != CBUFFER_STORAGE_SUCCESS
+	    || check_element(elt, elt_size, popped)) {
+		printf("checkpoint: wrong element\n");
+		goto exit;
+	}
+
+	printf("  %5u KB: full scan %6u reads %8.2f ms, checkpoint %3u reads "
+	       "%6.2f ms (flash), host %.3f / %.3f ms\n",
+	       size / 1024, full_reads,
+	       (full_reads * T_OP + full_reads * 8 * T_BYTE) / 1000,
+	       cp_reads, (cp_reads * T_OP + cp_reads * 8 * T_BYTE) / 1000,
+	       full_time * 1000, cp_time * 1000);
+	ret = 0;
+exit:
+	free(image);
+	free(copy);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	static const uint32_t mount_blocks[] = { 16, 64, 256, 1024, 2048 };
+	static const uint32_t elt_sizes[] = { 16, 60 };
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < sizeof(elt_sizes) / sizeof(elt_sizes[0]); i++) {
+		ret |= bench(elt_sizes[i], 0, 0);
+		ret |= bench(elt_sizes[i], 0, 1);
+		ret |= bench(elt_sizes[i], 1, 1);
+		ret |= check_remount(elt_sizes[i]);
+		ret |= check_write_errors(elt_sizes[i]);
+	}
+	printf("mount time\n");
+	for (i = 0; i < sizeof(mount_blocks) / sizeof(mount_blocks[0]); i++)
+		ret |= bench_mount(mount_blocks[i]);
+	printf("%s\n", ret ? "FAILED" : "OK");
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
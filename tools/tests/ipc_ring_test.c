@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ *****************************************************************************
+ * Host test and benchmark of the IPC descriptor ring.
+ *
+ * One thread plays the sending core and another one the receiving core: the
+ * doorbell mailbox is modelled by a pending flag and a semaphore, the
+ * receiving thread acknowledging it before draining the ring as the mailbox
+ * interrupt does. Ordering and lost doorbells are checked, then the ring is
+ * timed against the synchronous mailbox handshake it replaces (one request
+ * at a time, the sender spinning until the receiver acknowledges it).
+ *
+ * Compile with (from the top directory):
+ * gcc -O2 -pthread -Ibsp/include bsp/src/util/spsc_ring.c \
+ *     bsp/src/infra/ipc_ring.c tools/tests/ipc_ring_test.c -o ipc_ring_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <time.h>
+
+#include "infra/ipc_ring.h"
+#include "infra/ipc_requests.h"
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, \
+			       __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static int failures;
+
+#define MESSAGES        200000
+#define BURST           8
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Doorbell mailbox: the interrupt fires once while the status is pending */
+static volatile int mbx_pending;
+static sem_t mbx_irq;
+
+static void mbx_ring(void)
+{
+	if (!__atomic_exchange_n(&mbx_pending, 1, __ATOMIC_SEQ_CST))
+		sem_post(&mbx_irq);
+}
+
+static int mbx_wait(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += 2;
+	while (sem_timedwait(&mbx_irq, &ts))
+		if (errno != EINTR)
+			return -1;
+	__atomic_store_n(&mbx_pending, 0, __ATOMIC_SEQ_CST);
+	return 0;
+}
+
+static struct ipc_ring ring;
+static uint64_t sent_ns[MESSAGES];
+static uint64_t recv_ns[MESSAGES];
+static unsigned int interrupts;
+static unsigned int full;
+static unsigned int received;
+static unsigned int out_of_order;
+
+static void test_single_thread(void)
+{
+	struct ipc_ring_desc desc;
+	int i, n;
+
+	memset(&ring, 0, sizeof(ring));
+	CHECK(ipc_ring_post(&ring, IPC_MSG_TYPE_MESSAGE, NULL) == -1);
+	ipc_ring_init(&ring);
+	CHECK(ipc_ring_get(&ring, &desc) == -1);
+
+	/* Only the first descriptor of a burst needs the doorbell */
+	CHECK(ipc_ring_post(&ring, IPC_MSG_TYPE_MESSAGE, (void *)1) == 1);
+	CHECK(ipc_ring_post(&ring, IPC_MSG_TYPE_FREE, (void *)2) == 0);
+	CHECK(ipc_ring_get(&ring, &desc) == 0);
+	CHECK(desc.request == IPC_MSG_TYPE_MESSAGE && desc.ptr == (void *)1);
+	CHECK(ipc_ring_post(&ring, IPC_MSG_TYPE_MESSAGE, (void *)3) == 0);
+	CHECK(ipc_ring_get(&ring, &desc) == 0);
+	CHECK(desc.request == IPC_MSG_TYPE_FREE && desc.ptr == (void *)2);
+	CHECK(ipc_ring_get(&ring, &desc) == 0);
+	CHECK(desc.ptr == (void *)3);
+	CHECK(ipc_ring_get(&ring, &desc) == -1);
+	CHECK(ipc_ring_post(&ring, IPC_MSG_TYPE_MESSAGE, (void *)4) == 1);
+	CHECK(ipc_ring_get(&ring, &desc) == 0);
+
+	/* Fill up, then drain across the end of the storage several times */
+	for (n = 0; ipc_ring_post(&ring, IPC_MSG_TYPE_MESSAGE,
+				  (void *)(uintptr_t)n) >= 0; n++) ;
+	CHECK(n >= IPC_RING_SIZE / (sizeof(desc) + SPSC_RING_HDR_SIZE) - 1);
+	for (i = 0; i < n; i++)
+		CHECK(!ipc_ring_get(&ring, &desc) &&
+		      desc.ptr == (void *)(uintptr_t)i);
+	for (i = 0; i < 1000; i++) {
+		int ret = ipc_ring_post(&ring, i, (void *)(uintptr_t)i);
+
+		CHECK(ret == 1);
+		CHECK(!ipc_ring_get(&ring, &desc) && desc.request == i);
+	}
+	printf("ring holds %d descriptors\n", n);
+}
+
+static void *ring_receiver(void *arg)
+{
+	struct ipc_ring_desc desc;
+	unsigned int expected = 0;
+
+	while (expected < MESSAGES) {
+		if (mbx_wait()) {
+			printf("receiver: lost doorbell after %u messages\n",
+			       expected);
+			break;
+		}
+		interrupts++;
+		while (!ipc_ring_get(&ring, &desc)) {
+			unsigned int seq = (uintptr_t)desc.ptr;
+
+			if (seq != expected ||
+			    desc.request != IPC_MSG_TYPE_MESSAGE)
+				out_of_order++;
+			recv_ns[seq % MESSAGES] = now_ns();
+			expected = seq + 1;
+		}
+	}
+	received = expected;
+	return NULL;
+}
+
+static void ring_send(unsigned int seq)
+{
+	int ret;
+
+	sent_ns[seq] = now_ns();
+	while ((ret = ipc_ring_post(&ring, IPC_MSG_TYPE_MESSAGE,
+				    (void *)(uintptr_t)seq)) < 0) {
+		full++;
+		sched_yield();
+	}
+	if (ret > 0)
+		mbx_ring();
+}
+
+/* Synchronous handshake: one request in the mailbox at a time */
+static volatile uintptr_t mbx_data;
+static volatile int mbx_ack;
+
+static void *sync_receiver(void *arg)
+{
+	unsigned int expected = 0;
+
+	while (expected < MESSAGES) {
+		if (mbx_wait())
+			break;
+		interrupts++;
+		if (mbx_data != expected)
+			out_of_order++;
+		recv_ns[expected] = now_ns();
+		expected++;
+		__atomic_store_n(&mbx_ack, 1, __ATOMIC_RELEASE);
+	}
+	received = expected;
+	return NULL;
+}
+
+static void sync_send(unsigned int seq)
+{
+	sent_ns[seq] = now_ns();
+	mbx_data = seq;
+	mbx_ring();
+	while (!__atomic_load_n(&mbx_ack, __ATOMIC_ACQUIRE))
+		sched_yield();
+	mbx_ack = 0;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Send MESSAGES requests in bursts of the given size */
+static void run(const char *name, void *(*receiver)(void *),
+		void (*send)(unsigned int), int burst)
+{
+	static uint64_t lat[MESSAGES];
+	pthread_t thread;
+	uint64_t t0, t1, ts, in_send = 0, sum = 0;
+	unsigned int i;
+
+	memset(&ring, 0, sizeof(ring));
+	ipc_ring_init(&ring);
+	mbx_pending = 0;
+	mbx_ack = 0;
+	interrupts = full = received = out_of_order = 0;
+	sem_init(&mbx_irq, 0, 0);
+	pthread_create(&thread, NULL, receiver, NULL);
+
+	t0 = now_ns();
+	for (i = 0; i < MESSAGES; i++) {
+		ts = now_ns();
+		send(i);
+		in_send += now_ns() - ts;
+		/* Let the sender do something else between bursts */
+		if (i % burst == burst - 1)
+			sched_yield();
+	}
+	pthread_join(thread, NULL);
+	t1 = now_ns();
+	sem_destroy(&mbx_irq);
+
+	CHECK(received == MESSAGES);
+	CHECK(out_of_order == 0);
+	for (i = 0; i < MESSAGES; i++) {
+		lat[i] = recv_ns[i] - sent_ns[i];
+		sum += lat[i];
+	}
+	qsort(lat, MESSAGES, sizeof(*lat), cmp_u64);
+	printf("%s, burst %d: %.0f msg/s, send %.2f us, latency avg %.1f us "
+	       "p99 %.1f us, %.3f irq/msg, %u full\n",
+	       name, burst, MESSAGES * 1e9 / (t1 - t0),
+	       in_send / 1e3 / MESSAGES, sum / 1e3 / MESSAGES,
+	       lat[MESSAGES * 99 / 100] / 1e3,
+	       (double)interrupts / MESSAGES, full);
+}
+
+int main(void)
+{
+	test_single_thread();
+
+	run("sync", sync_receiver, sync_send, 1);
+	run("ring", ring_receiver, ring_send, 1);
+	run("sync", sync_receiver, sync_send, BURST);
+	run("ring", ring_receiver, ring_send, BURST);
+	run("ring", ring_receiver, ring_send, MESSAGES);
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,634 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+
+ *****************************************************************************
+ * Host loopback test and benchmark of the IPC UART reception.
+ *
+ * A stream of frames is encoded as the BLE core sends them and fed to the
+ * framing state machine in FIFO-sized chunks, as the UART interrupt reads
+ * them. Wakeups and allocated frames are posted to a model of the BLE
+ * service queue, whose handler drains the ring as the service does: every
+ * frame must be delivered once, intact and in order, and at most one wakeup
+ * may be queued at a time. Empty, oversized and ring full cases are checked,
+ * the stream is then run from a separate "interrupt" thread, and the frames/s
+ * are compared with the previous reception path allocating a buffer and a
+ * message per frame.
+ *
+ * Compile with (from the top directory):
+ * gcc -O2 -pthread -fcommon -Wall -Itools/tests/zephyr_stub -Ibsp/include \
+ *     -Iframework/include -Ibsp/include/machine/soc/intel/quark_se/arc \
+ *     -Ibsp/include/machine/soc/intel/quark_se \
+ *     tools/tests/ipc_uart_rx_test.c -o ipc_uart_rx_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+/* Keep the OS timers apart from the POSIX ones */
+#define timer_create os_timer_create
+#define timer_delete os_timer_delete
+#include "../../bsp/src/util/spsc_ring.c"
+#include "../../bsp/src/drivers/ipc/ipc_uart_rx.c"
+#undef timer_create
+#undef timer_delete
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, \
+			       __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static int failures;
+
+#define FIFO_SIZE       16
+#define MAX_FRAME       400
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Stubs of the OS layer
+ */
+
+static int live_blocks;
+
+void *balloc(uint32_t size, OS_ERR_TYPE *err)
+{
+	__atomic_add_fetch(&live_blocks, 1, __ATOMIC_RELAXED);
+	if (err)
+		*err = E_OS_OK;
+	return malloc(size ? size : 1);
+}
+
+OS_ERR_TYPE bfree(void *buffer)
+{
+	__atomic_sub_fetch(&live_blocks, 1, __ATOMIC_RELAXED);
+	free(buffer);
+	return E_OS_OK;
+}
+
+/*
+ * Frame stream sent by the BLE core: the payload of frame n is derived from n
+ */
+
+struct stream {
+	uint8_t *data;
+	size_t size;
+	uint32_t frames;
+};
+
+static uint8_t frame_byte(uint32_t seq, int i)
+{
+	return (uint8_t)(seq * 31 + i * 7);
+}
+
+static void stream_build(struct stream *s, uint32_t frames, int min_len,
+			 int max_len, unsigned int seed)
+{
+	struct ipc_uart_header hdr;
+	size_t pos = 0;
+	uint32_t n;
+	int i;
+
+	srand(seed);
+	s->data = malloc(frames * (sizeof(hdr) + max_len));
+	for (n = 0; n < frames; n++) {
+		hdr.len = min_len + rand() % (max_len - min_len + 1);
+		hdr.channel = RPC_CHANNEL;
+		hdr.src_cpu_id = 2;
+		/* First payload bytes carry the sequence number */
+		if (hdr.len >= 4)
+			memcpy(&s->data[pos + sizeof(hdr)], &n, 4);
+		for (i = 4; i < hdr.len; i++)
+			s->data[pos + sizeof(hdr) + i] = frame_byte(n, i);
+		memcpy(&s->data[pos], &hdr, sizeof(hdr));
+		pos += sizeof(hdr) + hdr.len;
+	}
+	s->size = pos;
+	s->frames = frames;
+}
+
+/*
+ * Model of the BLE service queue: wakeups and allocated frames
+ */
+
+#define QUEUE_DEPTH     4096
+#define EV_WAKEUP       NULL
+
+struct event {
+	uint8_t *frame;
+	uint16_t len;
+};
+
+static struct event queue[QUEUE_DEPTH];
+static uint32_t q_head, q_tail;
+static int wakeups_queued;
+static int max_wakeups_queued;
+static pthread_mutex_t q_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t q_cond = PTHREAD_COND_INITIALIZER;
+
+static void post(uint8_t *frame, uint16_t len)
+{
+	pthread_mutex_lock(&q_lock);
+	/* The service queue is not allowed to overflow */
+	while (q_head - q_tail == QUEUE_DEPTH)
+		pthread_cond_wait(&q_cond, &q_lock);
+	if (frame == EV_WAKEUP && ++wakeups_queued > max_wakeups_queued)
+		max_wakeups_queued = wakeups_queued;
+	queue[q_head % QUEUE_DEPTH].frame = frame;
+	queue[q_head % QUEUE_DEPTH].len = len;
+	q_head++;
+	pthread_cond_broadcast(&q_cond);
+	pthread_mutex_unlock(&q_lock);
+}
+
+static int get(struct event *ev, bool wait)
+{
+	pthread_mutex_lock(&q_lock);
+	while (wait && q_tail == q_head)
+		pthread_cond_wait(&q_cond, &q_lock);
+	if (q_tail == q_head) {
+		pthread_mutex_unlock(&q_lock);
+		return -1;
+	}
+	*ev = queue[q_tail % QUEUE_DEPTH];
+	q_tail++;
+	pthread_cond_broadcast(&q_cond);
+	if (ev->frame == EV_WAKEUP)
+		wakeups_queued--;
+	pthread_mutex_unlock(&q_lock);
+	return 0;
+}
+
+/*
+ * Receiving side
+ */
+
+static struct ipc_uart_rx rx;
+static uint8_t __attribute__((aligned(4))) ring_buf[4096];
+static uint32_t expected;
+static uint32_t corrupted;
+
+static void check_frame(const uint8_t *p, int len)
+{
+	uint32_t seq = expected;
+	int i;
+
+	if (len >= 4) {
+		memcpy(&seq, p, 4);
+		if (seq != expected)
+			corrupted++;
+	}
+	for (i = 4; i < len; i++)
+		if (p[i] != frame_byte(seq, i)) {
+			corrupted++;
+			break;
+		}
+	expected++;
+}
+
+/* Same as the BLE service RPC callin handler */
+static void handle_event(struct event *ev)
+{
+	struct ipc_uart_header hdr;
+	uint8_t *p;
+
+	if (ev->frame == EV_WAKEUP) {
+		ipc_uart_rx_rearm(&rx);
+		while ((p = ipc_uart_rx_get(&rx, &hdr)) != NULL) {
+			check_frame(p, hdr.len);
+			ipc_uart_rx_release(&rx);
+		}
+		return;
+	}
+	check_frame(ev->frame, ev->len);
+	ipc_uart_rx_free(&rx, ev->frame);
+}
+
+/* Same as the UART interrupt: returns the number of bytes consumed */
+static size_t isr(const uint8_t *data, size_t size, int fifo)
+{
+	size_t done = 0;
+	int cnt, ev;
+
+	while (done < size) {
+		cnt = fifo;
+		if (cnt > rx.size)
+			cnt = rx.size;
+		if (cnt > size - done)
+			cnt = size - done;
+		memcpy(rx.ptr, &data[done], cnt);
+		done += cnt;
+
+		ev = ipc_uart_rx_recv(&rx, cnt);
+		if (ev & IPC_UART_RX_ALLOC)
+			post(rx.frame, rx.hdr.len);
+		else if (ev & IPC_UART_RX_NOTIFY)
+			post(EV_WAKEUP, 0);
+	}
+	return done;
+}
+
+static void reset(uint32_t ring_size)
+{
+	CHECK(ipc_uart_rx_init(&rx, ring_buf, ring_size) == 0);
+	q_head = q_tail = 0;
+	wakeups_queued = max_wakeups_queued = 0;
+	expected = 0;
+	corrupted = 0;
+}
+
+static void drain_queue(void)
+{
+	struct event ev;
+
+	while (get(&ev, false) == 0)
+		handle_event(&ev);
+}
+
+/* Four frames of this length fill a ring of 256 bytes */
+#define FILL_LEN        (64 - SPSC_RING_HDR_SIZE - sizeof(struct rx_record))
+
+static bool in_ring(const uint8_t *p)
+{
+	return p >= ring_buf && p < ring_buf + rx.ring.size;
+}
+
+static int feed_header(uint16_t len)
+{
+	struct ipc_uart_header hdr = { .len = len, .channel = RPC_CHANNEL };
+
+	memcpy(rx.ptr, &hdr, sizeof(hdr));
+	return ipc_uart_rx_recv(&rx, sizeof(hdr));
+}
+
+static int feed_frame(uint16_t len)
+{
+	int ev = feed_header(len);
+
+	memset(rx.ptr, 0, len);
+	return ev | ipc_uart_rx_recv(&rx, len);
+}
+
+static void test_framing(void)
+{
+	struct ipc_uart_header hdr = { .len = 5, .channel = RPC_CHANNEL };
+	uint8_t frame[sizeof(hdr) + 5] = { 0 };
+	struct ipc_uart_header got;
+	struct ipc_uart_rx_stats stats;
+	uint8_t *p;
+	int ev, i;
+
+	reset(256);
+	CHECK(ipc_uart_rx_init(&rx, ring_buf, 100) == -1);
+	CHECK(ipc_uart_rx_init(&rx, ring_buf + 1, 256) == -1);
+	reset(256);
+
+	/* Byte per byte: start on the first byte, done on the last one */
+	memcpy(frame, &hdr, sizeof(hdr));
+	memcpy(&frame[sizeof(hdr)], "hello", 5);
+	memcpy(rx.ptr, frame, 1);
+	CHECK(ipc_uart_rx_recv(&rx, 1) == IPC_UART_RX_START);
+	memcpy(rx.ptr, &frame[1], 3);
+	CHECK(ipc_uart_rx_recv(&rx, 3) == 0);
+	CHECK(rx.size == 5);
+	CHECK(in_ring(rx.ptr));
+	memcpy(rx.ptr, &frame[4], 5);
+	ev = ipc_uart_rx_recv(&rx, 5);
+	CHECK(ev == (IPC_UART_RX_DONE | IPC_UART_RX_NOTIFY));
+
+	/* Second frame in the same burst: no new wakeup */
+	memcpy(rx.ptr, frame, sizeof(hdr));
+	ev = ipc_uart_rx_recv(&rx, sizeof(hdr));
+	memcpy(rx.ptr, &frame[4], 5);
+	ev |= ipc_uart_rx_recv(&rx, 5);
+	CHECK(ev == (IPC_UART_RX_START | IPC_UART_RX_DONE));
+
+	ipc_uart_rx_rearm(&rx);
+	p = ipc_uart_rx_get(&rx, &got);
+	CHECK(p && got.len == 5 && got.channel == RPC_CHANNEL &&
+	      !memcmp(p, "hello", 5));
+	ipc_uart_rx_release(&rx);
+	CHECK(ipc_uart_rx_get(&rx, &got) != NULL);
+	ipc_uart_rx_release(&rx);
+	CHECK(ipc_uart_rx_get(&rx, &got) == NULL);
+
+	/* Empty frame, complete with its header */
+	hdr.len = 0;
+	memcpy(rx.ptr, &hdr, sizeof(hdr));
+	CHECK(ipc_uart_rx_recv(&rx, sizeof(hdr)) ==
+	      (IPC_UART_RX_START | IPC_UART_RX_DONE | IPC_UART_RX_NOTIFY));
+	ipc_uart_rx_rearm(&rx);
+	CHECK(ipc_uart_rx_get(&rx, &got) != NULL && got.len == 0);
+	ipc_uart_rx_release(&rx);
+
+	/* Oversized frame: allocated, then queued in the ring */
+	hdr.len = SPSC_RING_MAX_RECORD(256);
+	ev = feed_header(hdr.len);
+	CHECK(!in_ring(rx.ptr));
+	CHECK(ipc_uart_rx_recv(&rx, hdr.len) ==
+	      (IPC_UART_RX_DONE | IPC_UART_RX_NOTIFY));
+	ipc_uart_rx_rearm(&rx);
+	p = ipc_uart_rx_get(&rx, &got);
+	CHECK(p && got.len == hdr.len && !in_ring(p));
+	ipc_uart_rx_release(&rx);
+	CHECK(live_blocks == 0);
+
+	ipc_uart_rx_get_stats(&rx, &stats, false);
+	CHECK(stats.frames == 4 && stats.allocated == 1 &&
+	      stats.overflows == 0 && stats.notified == 3);
+
+	/* Ring full: the third frame is allocated and queued once drained */
+	CHECK(ipc_uart_rx_init(&rx, ring_buf, 256) == 0);
+	CHECK(feed_frame(100) & IPC_UART_RX_NOTIFY);
+	CHECK(feed_frame(100) == (IPC_UART_RX_START | IPC_UART_RX_DONE));
+	feed_header(100);
+	CHECK(!in_ring(rx.ptr));
+	ipc_uart_rx_rearm(&rx);
+	CHECK(ipc_uart_rx_get(&rx, &got) != NULL);
+	ipc_uart_rx_release(&rx);
+	CHECK(ipc_uart_rx_recv(&rx, 100) ==
+	      (IPC_UART_RX_DONE | IPC_UART_RX_NOTIFY));
+
+	while (ipc_uart_rx_get(&rx, &got))
+		ipc_uart_rx_release(&rx);
+	ipc_uart_rx_get_stats(&rx, &stats, false);
+	CHECK(live_blocks == 0);
+	CHECK(stats.frames == 3 && stats.allocated == 1 &&
+	      stats.overflows == 0 && stats.notified == 2);
+
+	/* Still full at the end: delivered apart, and so is the next one */
+	CHECK(ipc_uart_rx_init(&rx, ring_buf, 256) == 0);
+	for (i = 0; i < 4; i++)
+		feed_frame(FILL_LEN);
+	feed_header(5);
+	CHECK(!in_ring(rx.ptr));
+	p = rx.frame;
+	CHECK(ipc_uart_rx_recv(&rx, 5) ==
+	      (IPC_UART_RX_DONE | IPC_UART_RX_ALLOC));
+	ipc_uart_rx_rearm(&rx);
+	while (ipc_uart_rx_get(&rx, &got))
+		ipc_uart_rx_release(&rx);
+	feed_header(5);
+	CHECK(!in_ring(rx.ptr));
+	CHECK(ipc_uart_rx_recv(&rx, 5) ==
+	      (IPC_UART_RX_DONE | IPC_UART_RX_ALLOC));
+	ipc_uart_rx_free(&rx, p);
+	ipc_uart_rx_free(&rx, rx.frame);
+	CHECK(feed_frame(5) & IPC_UART_RX_NOTIFY);
+	ipc_uart_rx_rearm(&rx);
+	CHECK(ipc_uart_rx_get(&rx, &got) != NULL && got.len == 5);
+	ipc_uart_rx_release(&rx);
+	CHECK(live_blocks == 0);
+
+	ipc_uart_rx_get_stats(&rx, &stats, true);
+	CHECK(stats.frames == 5 && stats.allocated == 2 &&
+	      stats.overflows == 2 && stats.notified == 2);
+	ipc_uart_rx_get_stats(&rx, &stats, false);
+	CHECK(stats.frames == 0 && stats.allocated == 0 &&
+	      stats.overflows == 0 && stats.notified == 0);
+}
+
+/* Stream in random chunks, the service running between random bursts */
+static void test_loopback(uint32_t ring_size, int max_len)
+{
+	struct stream s;
+	struct ipc_uart_rx_stats stats;
+	size_t pos = 0, burst;
+
+	reset(ring_size);
+	stream_build(&s, 20000, 0, max_len, ring_size + max_len);
+	while (pos < s.size) {
+		burst = 1 + rand() % 600;
+		if (burst > s.size - pos)
+			burst = s.size - pos;
+		pos += isr(&s.data[pos], burst, 1 + rand() % FIFO_SIZE);
+		if (rand() % 4 == 0)
+			drain_queue();
+	}
+	drain_queue();
+
+	ipc_uart_rx_get_stats(&rx, &stats, false);
+	CHECK(expected == s.frames);
+	CHECK(corrupted == 0);
+	CHECK(max_wakeups_queued == 1);
+	CHECK(live_blocks == 0);
+	CHECK(ipc_uart_rx_get(&rx, &(struct ipc_uart_header){}) == NULL);
+	printf("ring %4u, frames up to %3d: %u in ring, %u allocated, "
+	       "%u apart, %.2f frames/wakeup\n", ring_size, max_len,
+	       stats.frames, stats.allocated, stats.overflows,
+	       (double)stats.frames / stats.notified);
+	free(s.data);
+}
+
+/*
+ * Interrupt and service in separate threads
+ */
+
+static struct stream thread_stream;
+
+static void *isr_thread(void *arg)
+{
+	size_t pos = 0;
+
+	while (pos < thread_stream.size) {
+		size_t burst = 1 + rand() % 64;
+
+		if (burst > thread_stream.size - pos)
+			burst = thread_stream.size - pos;
+		pos += isr(&thread_stream.data[pos], burst, FIFO_SIZE);
+	}
+	return NULL;
+}
+
+static void test_threads(void)
+{
+	pthread_t thread;
+	struct event ev;
+
+	reset(512);
+	stream_build(&thread_stream, 200000, 0, 300, 7);
+	pthread_create(&thread, NULL, isr_thread, NULL);
+	while (expected < thread_stream.frames && get(&ev, true) == 0)
+		handle_event(&ev);
+	pthread_join(thread, NULL);
+	drain_queue();
+
+	CHECK(expected == thread_stream.frames);
+	CHECK(corrupted == 0);
+	CHECK(max_wakeups_queued == 1);
+	CHECK(live_blocks == 0);
+	free(thread_stream.data);
+}
+
+/*
+ * Benchmark against the previous reception path: one buffer allocated by
+ * the interrupt for each frame, then one message to pass it to the service
+ */
+
+struct legacy_rx {
+	struct ipc_uart_header hdr;
+	uint8_t *ptr;
+	uint16_t size;
+	uint8_t state;
+};
+
+struct legacy_callin {
+	uint8_t msg[10];
+	uint8_t *p_data;
+	uint16_t len;
+};
+
+static uint32_t legacy_frames;
+
+static size_t legacy_isr(struct legacy_rx *l, const uint8_t *data,
+			 size_t size)
+{
+	size_t done = 0;
+	int cnt;
+
+	while (done < size) {
+		cnt = FIFO_SIZE;
+		if (cnt > l->size)
+			cnt = l->size;
+		if (cnt > size - done)
+			cnt = size - done;
+		memcpy(l->ptr, &data[done], cnt);
+		done += cnt;
+		l->state |= 1;
+		l->ptr += cnt;
+		l->size -= cnt;
+		if (l->size)
+			continue;
+		if (l->state == 1) {
+			l->ptr = balloc(l->hdr.len, NULL);
+			l->size = l->hdr.len;
+			l->state = 2;
+			if (l->size)
+				continue;
+		}
+		struct legacy_callin *rpc = balloc(sizeof(*rpc), NULL);
+
+		memset(rpc, 0, sizeof(*rpc));
+		rpc->p_data = l->ptr - l->hdr.len;
+		rpc->len = l->hdr.len;
+		post((uint8_t *)rpc, sizeof(*rpc));
+		l->ptr = (uint8_t *)&l->hdr;
+		l->size = sizeof(l->hdr);
+		l->state = 0;
+	}
+	return done;
+}
+
+static void legacy_drain(void)
+{
+	struct event ev;
+
+	while (get(&ev, false) == 0) {
+		struct legacy_callin *rpc = (void *)ev.frame;
+
+		check_frame(rpc->p_data, rpc->len);
+		bfree(rpc->p_data);
+		bfree(rpc);
+		legacy_frames++;
+	}
+}
+
+#define BENCH_FRAMES    1000000
+
+static void bench(int min_len, int max_len, int burst_frames)
+{
+	struct stream s;
+	struct legacy_rx l = { .ptr = (uint8_t *)&l.hdr, .size = sizeof(l.hdr) };
+	size_t pos, burst = 0;
+	uint64_t t0, t_ring, t_legacy;
+	uint32_t n;
+
+	stream_build(&s, BENCH_FRAMES, min_len, max_len, 3);
+	/* Bursts of about burst_frames frames between two service runs */
+	burst = burst_frames * (sizeof(struct ipc_uart_header) +
+				(min_len + max_len) / 2);
+
+	reset(1024);
+	t0 = now_ns();
+	for (pos = 0; pos < s.size; ) {
+		n = s.size - pos < burst ? s.size - pos : burst;
+		pos += isr(&s.data[pos], n, FIFO_SIZE);
+		drain_queue();
+	}
+	t_ring = now_ns() - t0;
+	CHECK(expected == s.frames && corrupted == 0);
+
+	reset(1024);
+	legacy_frames = 0;
+	t0 = now_ns();
+	for (pos = 0; pos < s.size; ) {
+		n = s.size - pos < burst ? s.size - pos : burst;
+		pos += legacy_isr(&l, &s.data[pos], n);
+		legacy_drain();
+	}
+	t_legacy = now_ns() - t0;
+	CHECK(legacy_frames == s.frames && corrupted == 0);
+	CHECK(live_blocks == 0);
+
+	printf("frames %3d-%3d, burst %2d: ring %.0f frames/s, "
+	       "alloc per frame %.0f frames/s\n", min_len, max_len,
+	       burst_frames, BENCH_FRAMES * 1e9 / t_ring,
+	       BENCH_FRAMES * 1e9 / t_legacy);
+	free(s.data);
+}
+
+int main(void)
+{
+	test_framing();
+	test_loopback(4096, 300);
+	test_loopback(256, 300);
+	test_loopback(1024, 64);
+	test_threads();
+
+	bench(20, 64, 1);
+	bench(20, 64, 8);
+	bench(100, 250, 8);
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
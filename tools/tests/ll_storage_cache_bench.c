@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ *****************************************************************************
+ * Host unit test and benchmark of the ll_storage read cache on a simulated
+ * SPI NOR flash.
+ *
+ * Compile with (from the top directory):
+ * gcc -O2 -Iframework/src/services/ll_storage_service \
+ *     framework/src/services/ll_storage_service/ll_storage_cache.c \
+ *     tools/tests/ll_storage_cache_bench.c -o ll_storage_cache_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ll_storage_cache.h"
+
+#define FLASH_SIZE   0x200000
+#define NB_FLASHES   2
+
+/* SPI NOR read timings (in us) of one spi_flash_read() call: wake up,
+ * command and sleep, then transfer time of one byte */
+#define T_OP         75.0
+#define T_BYTE       1.0
+
+static uint8_t flash[NB_FLASHES][FLASH_SIZE];
+static unsigned int nb_reads, nb_bytes;
+
+static int failures;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, \
+			       __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static int sim_read(void *priv, uint16_t flash_id, uint32_t address,
+		    uint32_t len, uint8_t *buf)
+{
+	if (flash_id >= NB_FLASHES || (address & 3) || (len & 3) ||
+	    address + len > FLASH_SIZE)
+		return -1;
+	memcpy(buf, &flash[flash_id][address], len);
+	nb_reads++;
+	nb_bytes += len;
+	return 0;
+}
+
+static uint32_t rand_state = 1;
+
+static uint32_t rnd(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return rand_state >> 8;
+}
+
+static uint8_t buf[0x10000 + 4];
+
+struct cache_cfg {
+	int nb_lines;
+	int line_size;
+};
+
+static struct ll_storage_cache cache;
+static struct ll_storage_cache_line lines[255];
+static uint8_t *data;
+
+static void setup(const struct cache_cfg *cfg)
+{
+	free(data);
+	data = malloc(cfg->nb_lines * cfg->line_size + 1);
+	ll_storage_cache_init(&cache, lines, data, cfg->nb_lines,
+			      cfg->line_size, sim_read, NULL);
+	nb_reads = nb_bytes = 0;
+}
+
+/* Reads, writes and erases checked against the flash content */
+static void test_coherency(const struct cache_cfg *cfg)
+{
+	uint32_t address, len, i;
+	uint16_t id;
+	int op;
+
+	setup(cfg);
+	for (op = 0; op < 200000; op++) {
+		id = rnd() % NB_FLASHES;
+		/* Most accesses in a small window to get hits */
+		address = (rnd() % 8192) & ~3;
+		if (rnd() % 8 == 0)
+			address = (rnd() % (FLASH_SIZE - 0x2000)) & ~3;
+		len = 1 + rnd() % (rnd() % 16 ? 300 : 5000);
+
+		switch (rnd() % 8) {
+		case 0:
+			/* Write: flash first, then invalidate */
+			for (i = 0; i < len; i++)
+				flash[id][address + i] = rnd();
+			ll_storage_cache_invalidate(&cache, id, address, len);
+			break;
+		case 1:
+			if (rnd() % 8)
+				break;
+			/* Erase of a 4kB block */
+			address &= ~0xfff;
+			memset(&flash[id][address], 0xff, 4096);
+			ll_storage_cache_invalidate(&cache, id, address, 4096);
+			break;
+		default:
+			CHECK(ll_storage_cache_read(&cache, id, address, len,
+						    buf) == 0);
+			if (memcmp(buf, &flash[id][address], len)) {
+				CHECK(!"read mismatch");
+				return;
+			}
+		}
+	}
+
+	/* Errors of the flash are reported and nothing is cached */
+	CHECK(ll_storage_cache_read(&cache, NB_FLASHES, 0, 16, buf) != 0);
+	CHECK(ll_storage_cache_read(&cache, NB_FLASHES, 0, 16, buf) != 0);
+	CHECK(ll_storage_cache_read(&cache, 0, 0, 16, buf) == 0);
+	CHECK(!memcmp(buf, flash[0], 16));
+}
+
+/* Read patterns of the ll_storage clients */
+enum pattern {
+	PROPERTIES,     /* Small records of a few hot blocks */
+	OTA,            /* Package header read again between 2kB chunks */
+	LOG_DUMP,       /* Sequential 128B reads */
+	RANDOM,         /* Small reads anywhere, no locality */
+	NB_PATTERNS
+};
+
+static const char *pattern_names[] = {
+	"properties", "ota", "log dump", "random"
+};
+
+static void next_read(enum pattern p, int n, uint32_t *address,
+		      uint32_t *len)
+{
+	switch (p) {
+	case PROPERTIES:
+		/* 3 blocks of 2kB, records of 16 to 64 bytes, the first
+		 * records of each block are the most read */
+		*address = (rnd() % 3) * 2048 +
+			   ((rnd() % 32) * (rnd() % 32) / 32) * 64;
+		*len = 16 + (rnd() % 13) * 4;
+		break;
+	case OTA:
+		if (n % 4 == 0) {
+			*address = 0;
+			*len = 48;
+		} else {
+			*address = 4096 + (n - n / 4) * 2048 % 0x100000;
+			*len = 2048;
+		}
+		break;
+	case LOG_DUMP:
+		*address = n * 128;
+		*len = 128;
+		break;
+	default:
+		*address = (rnd() % (FLASH_SIZE / 2)) & ~3;
+		*len = 4 + (rnd() % 32) * 4;
+		break;
+	}
+}
+
+static void bench(const struct cache_cfg *cfg, enum pattern p)
+{
+	struct ll_storage_cache_stats stats;
+	uint32_t address, len;
+	double t;
+	int n;
+	const int nb = 10000;
+
+	setup(cfg);
+	rand_state = 7;
+	for (n = 0; n < nb; n++) {
+		next_read(p, n, &address, &len);
+		if (ll_storage_cache_read(&cache, 1, address, len, buf) ||
+		    memcmp(buf, &flash[1][address], len)) {
+			CHECK(!"bench read failed");
+			return;
+		}
+	}
+	ll_storage_cache_get_stats(&cache, &stats, true);
+	t = nb_reads * T_OP + nb_bytes * T_BYTE;
+	printf("  %-11s %3dx%-4d %6u flash reads %8u bytes %7.1f us/read"
+	       "  hits %5.1f%%  evictions %6u\n",
+	       pattern_names[p], cfg->nb_lines, cfg->line_size, nb_reads,
+	       nb_bytes, t / nb,
+	       stats.hits + stats.misses ?
+	       100.0 * stats.hits / (stats.hits + stats.misses) : 0.0,
+	       stats.evictions);
+}
+
+int main(void)
+{
+	static const struct cache_cfg cfgs[] = {
+		{ 0, 64 }, { 8, 256 }, { 16, 128 }, { 32, 64 }, { 64, 64 }, { 1, 64 },
+	};
+	unsigned int i;
+	int p;
+
+	for (i = 0; i < sizeof(flash); i++)
+		((uint8_t *)flash)[i] = rnd();
+
+	for (i = 0; i < sizeof(cfgs) / sizeof(cfgs[0]); i++)
+		test_coherency(&cfgs[i]);
+
+	printf("Simulated read time per request (T_OP %.0fus, T_BYTE %.1fus)\n",
+	       T_OP, T_BYTE);
+	for (p = 0; p < NB_PATTERNS; p++)
+		for (i = 0; i < sizeof(cfgs) / sizeof(cfgs[0]) - 1; i++)
+			bench(&cfgs[i], p);
+
+	free(data);
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+
+ *****************************************************************************
+ * Host test of the packing of RPC buffers in IPC UART frames.
+ *
+ * Packing and unpacking are checked on TX queues built as nble_driver does,
+ * including the MTU limit and malformed frames. Bursts of GATT notification
+ * sized buffers are then sent through a model of the UART driver, which
+ * only accepts a new frame once the previous one is sent, without and with
+ * packing: frames, TX done interrupts and bytes on the wire are counted.
+ *
+ * Compile with (from the top directory):
+ * gcc -O2 -fcommon -Wall -Itools/tests/zephyr_stub -Ibsp/include \
+ *     -Iframework/include -Ibsp/include/machine/soc/intel/quark_se/arc \
+ *     -Ibsp/include/machine/soc/intel/quark_se \
+ *     tools/tests/nble_rpc_pack_test.c -o nble_rpc_pack_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../bsp/src/util/list.c"
+#include "../../framework/src/services/ble_service/nble_rpc_pack.c"
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, \
+			       __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static int failures;
+
+/* Size of the IPC UART frame header */
+#define FRAME_HDR_SIZE  4
+
+/*
+ * Stubs of the OS layer
+ */
+
+static int live_blocks;
+
+void *balloc(uint32_t size, OS_ERR_TYPE *err)
+{
+	live_blocks++;
+	if (err)
+		*err = E_OS_OK;
+	return malloc(size);
+}
+
+OS_ERR_TYPE bfree(void *buffer)
+{
+	live_blocks--;
+	free(buffer);
+	return E_OS_OK;
+}
+
+/* Same as rpc_alloc_cb() and rpc_transmit_cb() */
+static void queue_buffer(list_head_t *q, uint16_t len, uint8_t seed)
+{
+	struct rpc_tx_elt *p_elt;
+	int i;
+
+	p_elt = balloc(len + offsetof(struct rpc_tx_elt, data), NULL);
+	p_elt->length = len;
+	for (i = 0; i < len; i++)
+		p_elt->data[i] = seed + i;
+	list_add(q, &p_elt->l);
+}
+
+static void free_queue(list_head_t *q)
+{
+	list_t *l;
+
+	while ((l = list_get(q)) != NULL)
+		bfree(container_of(l, struct rpc_tx_elt, l));
+}
+
+static uint8_t next_seed;
+static int delivered;
+static int bad_content;
+
+static void check_buffer(uint8_t *data, uint16_t len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		if (data[i] != (uint8_t)(next_seed + i)) {
+			bad_content++;
+			break;
+		}
+	next_seed += 17;
+	delivered++;
+}
+
+static void test_pack(void)
+{
+	list_head_t q;
+	uint8_t frame[64];
+	uint16_t len;
+	int count;
+
+	list_init(&q);
+
+	/* Nothing or a single buffer: left in the queue */
+	CHECK(nble_rpc_pack(&q, frame, sizeof(frame), &count) == 0);
+	CHECK(count == 0);
+	queue_buffer(&q, 10, 0);
+	CHECK(nble_rpc_pack(&q, frame, sizeof(frame), &count) == 0);
+	queue_buffer(&q, 53, 17);
+	CHECK(nble_rpc_pack(&q, frame, sizeof(frame), &count) == 0);
+	CHECK(count == 0 && live_blocks == 2);
+	free_queue(&q);
+
+	/* Packed up to the MTU, exactly */
+	queue_buffer(&q, 10, 0);
+	queue_buffer(&q, 20, 17);
+	queue_buffer(&q, 28, 34);
+	queue_buffer(&q, 1, 51);
+	len = nble_rpc_pack(&q, frame, sizeof(frame), &count);
+	CHECK(len == 3 * NBLE_RPC_PACK_HDR_SIZE + 58 && len == sizeof(frame));
+	CHECK(count == 3 && live_blocks == 1);
+	CHECK(q.head != NULL && q.head == q.tail);
+
+	next_seed = 0;
+	delivered = 0;
+	CHECK(nble_rpc_unpack(frame, len, check_buffer) == 3);
+	CHECK(delivered == 3 && bad_content == 0);
+	free_queue(&q);
+
+	/* Empty buffers are kept */
+	queue_buffer(&q, 0, 0);
+	queue_buffer(&q, 0, 0);
+	len = nble_rpc_pack(&q, frame, sizeof(frame), &count);
+	CHECK(len == 2 * NBLE_RPC_PACK_HDR_SIZE && count == 2);
+	CHECK(nble_rpc_unpack(frame, len, check_buffer) == 2);
+	CHECK(live_blocks == 0 && list_empty(&q));
+}
+
+static void test_unpack_malformed(void)
+{
+	uint8_t frame[8] = { 3, 0, 'a', 'b', 'c', 2, 0, 'd' };
+
+	delivered = 0;
+	/* Truncated length, truncated buffer, length past the end */
+	CHECK(nble_rpc_unpack(frame, 6, check_buffer) == -1);
+	CHECK(nble_rpc_unpack(frame, 8, check_buffer) == -1);
+	frame[0] = 200;
+	CHECK(nble_rpc_unpack(frame, 5, check_buffer) == -1);
+	CHECK(delivered == 0);
+	CHECK(nble_rpc_unpack(frame, 0, check_buffer) == 0);
+}
+
+/*
+ * Model of nble_driver over the IPC UART: the first buffer of a burst is
+ * sent right away, the next ones are queued and sent from the TX done
+ * interrupt of the previous frame, packed if the MTU allows it.
+ */
+
+struct link_stats {
+	unsigned int frames;
+	unsigned int messages;
+	unsigned int bytes;
+};
+
+static uint8_t pack_frame[1024];
+
+static void send_next(list_head_t *q, uint16_t mtu, struct link_stats *s)
+{
+	struct rpc_tx_elt *p_elt;
+	uint16_t len = 0;
+	int count;
+	list_t *l;
+
+	if (mtu)
+		len = nble_rpc_pack(q, pack_frame, mtu, &count);
+	if (len) {
+		CHECK(nble_rpc_unpack(pack_frame, len, check_buffer) == count);
+	} else {
+		l = list_get(q);
+		if (l == NULL)
+			return;
+		p_elt = container_of(l, struct rpc_tx_elt, l);
+		len = p_elt->length;
+		count = 1;
+		check_buffer(p_elt->data, len);
+		bfree(p_elt);
+	}
+	s->frames++;
+	s->messages += count;
+	s->bytes += FRAME_HDR_SIZE + len;
+}
+
+static void run_bursts(const char *name, uint16_t mtu, int bursts, int burst)
+{
+	struct link_stats s = { 0 };
+	list_head_t q;
+	int b, i;
+
+	list_init(&q);
+	srand(1);
+	next_seed = 0;
+	delivered = 0;
+	for (b = 0; b < bursts; b++) {
+		/* Buffers queued while the first one is on the wire */
+		queue_buffer(&q, 16 + rand() % 9, next_seed);
+		send_next(&q, mtu, &s);
+		for (i = 1; i < burst; i++)
+			queue_buffer(&q, 16 + rand() % 9,
+				     next_seed + 17 * (i - 1));
+		while (!list_empty(&q))
+			send_next(&q, mtu, &s);
+	}
+	CHECK(delivered == bursts * burst && bad_content == 0);
+	CHECK(live_blocks == 0);
+	printf("%-9s burst %2d: %5u frames, %5u TX done irqs, %6u bytes, "
+	       "%.2f msgs/frame, %.1f bytes/msg\n", name, burst, s.frames,
+	       s.frames, s.bytes, (double)s.messages / s.frames,
+	       (double)s.bytes / s.messages);
+}
+
+int main(void)
+{
+	test_pack();
+	test_unpack_malformed();
+
+	run_bursts("single", 0, 1000, 1);
+	run_bursts("mtu 128", 128, 1000, 1);
+	run_bursts("single", 0, 1000, 4);
+	run_bursts("mtu 128", 128, 1000, 4);
+	run_bursts("single", 0, 1000, 16);
+	run_bursts("mtu 128", 128, 1000, 16);
+	run_bursts("mtu 256", 256, 1000, 16);
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,765 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ *****************************************************************************
+ * Host test and benchmark of the opencore algo engine: frames are fed through
+ * FeedSensData2Algo() to a feed using the per sample exec and to the same
+ * feed using exec_batch, the frames seen by the algorithm are compared, and
+ * the engine throughput is measured for accel + gyro at 100, 200 and 400Hz
+ * with the demo algorithm.
+ *
+ * The engine resamples with the plan of BuildResamplePlan(): for a matrix of
+ * sensor and demanded rates, the frames it hands to the algorithm are checked
+ * against the engine as it was before, which worked the rates out in place.
+ *
+ * Compile with (from the top directory):
+ * OC=framework/src/sensors/sensor_core/open_core
+ * gcc -O2 -Itools/tests/zephyr_stub -Ibsp/include -Iframework/include \
+ *     -Ibsp/include/machine/soc/intel/quark_se/arc \
+ *     -Iframework/include/sensors/sensor_core/ipc \
+ *     -Iframework/include/sensors/sensor_core/open_core \
+ *     -I$OC/opencore_src bsp/src/util/list.c \
+ *     tools/tests/opencore_engine_test.c -o opencore_engine_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "../../framework/src/sensors/sensor_core/open_core/opencore_src/opencore_algo_engine.c"
+#include "../../framework/src/sensors/sensor_core/open_core/opencore_src/opencore_method.c"
+#include "../../framework/src/sensors/sensor_core/open_core/algo_support_src/opencore_demo.c"
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, \
+			       __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static int failures;
+
+/* Sensor core state normally defined by opencore_main.c */
+list_head_t feed_list;
+list_head_t exposed_sensor_list;
+list_head_t phy_sensor_list_int;
+list_head_t phy_sensor_list_poll;
+list_head_t phy_sensor_poll_active_list;
+list_head_t phy_sensor_poll_active_array[PHY_TYPE_KEY_LENGTH *
+					 PHY_ID_KEY_LENGTH];
+uint8_t read_out_fifo_flag;
+
+/* Services used by the engine */
+static int events;
+
+uint32_t get_uptime_ms(void)
+{
+	return 0;
+}
+
+IPC_ERR_TYPE ipc_2svc_send(struct ia_cmd *cmd)
+{
+	events++;
+	return 0;
+}
+
+IPC_ERR_TYPE ipc_2core_send(struct ia_cmd *cmd)
+{
+	return 0;
+}
+
+void *balloc(uint32_t size, OS_ERR_TYPE *err)
+{
+	return malloc(size);
+}
+
+OS_ERR_TYPE bfree(void *buffer)
+{
+	free(buffer);
+	return E_OS_OK;
+}
+
+struct message *message_alloc(int size, OS_ERR_TYPE *err)
+{
+	return malloc(size);
+}
+
+int port_send_message(struct message *msg)
+{
+	return 0;
+}
+
+uint16_t port_alloc(void *queue)
+{
+	return 0;
+}
+
+void port_set_handler(uint16_t port_id, void (*handler)(struct message *,
+							 void *), void *param)
+{
+}
+
+OS_ERR_TYPE mutex_lock(T_MUTEX mutex, int timeout)
+{
+	return E_OS_OK;
+}
+
+void mutex_unlock(T_MUTEX mutex)
+{
+}
+
+void *AllocFromDss(uint32_t size)
+{
+	return malloc(size);
+}
+
+int FreeInDss(void *buf)
+{
+	free(buf);
+	return 0;
+}
+
+void FreeRawDataNode(raw_data_node_t *raw_data)
+{
+	free(raw_data);
+}
+
+/* Feeds with several demands match their data synchronously by default */
+static int min_delay_ret;
+
+int CheckMinDelayBuffer(feed_general_t *feed)
+{
+	return min_delay_ret;
+}
+
+int phy_sensor_enable(sensor_t sensor, bool enable)
+{
+	return 0;
+}
+
+int phy_sensor_data_read(sensor_t sensor, struct sensor_data *sensor_data)
+{
+	return 0;
+}
+
+int phy_sensor_get_odr_value(sensor_t sensor, uint16_t *odr_value)
+{
+	return 0;
+}
+
+int phy_sensor_set_odr_value(sensor_t sensor, uint16_t odr_value)
+{
+	return 0;
+}
+
+int phy_sensor_fifo_read(sensor_t sensor, uint8_t *buffer, uint16_t buff_len)
+{
+	return 0;
+}
+
+/* Physical accel and gyro, sampled at the same rate */
+#define DRAIN_FRAMES 80
+
+static sensor_handle_t accel, gyro;
+static short accel_cali[3] = { 10, -20, 30 };
+static int gyro_cali[3] = { -1000, 2000, 3000 };
+static uint8_t accel_feed_buf[sizeof(struct accel_phy_data)];
+static uint8_t gyro_feed_buf[sizeof(struct gyro_phy_data)];
+static struct accel_phy_data accel_fifo[DRAIN_FRAMES];
+static struct gyro_phy_data gyro_fifo[DRAIN_FRAMES];
+
+static void sensor_init(sensor_handle_t *h, phy_sensor_type_t type,
+			int frame_size, void *cali, void *feed_buf, void *fifo)
+{
+	memset(h, 0, sizeof(*h));
+	h->type = type;
+	h->id = 0;
+	h->sensor_data_frame_size = frame_size;
+	h->clb_data_buffer = cali;
+	h->feed_data_buffer = feed_buf;
+	h->buffer = fifo;
+	h->fifo_length = DRAIN_FRAMES;
+	h->fifo_use_flag = 1;
+	list_add(&phy_sensor_poll_active_list, &h->links.poll.poll_active_link);
+	list_add(&phy_sensor_poll_active_array[GetHashKey(type, 0)],
+		 &h->links.poll.poll_active_array_link);
+}
+
+static void set_freq(int freq)
+{
+	accel.freq = freq * 10;
+	gyro.freq = freq * 10;
+}
+
+/* A fifo drain of both sensors, then the engine processing */
+static int16_t seq;
+
+static void fill(int accel_frames, int gyro_frames)
+{
+	for (int i = 0; i < accel_frames; i++) {
+		accel_fifo[i].ax = seq + i;
+		accel_fifo[i].ay = (seq + i) * 3;
+		accel_fifo[i].az = -(seq + i);
+	}
+	for (int i = 0; i < gyro_frames; i++) {
+		gyro_fifo[i].gx = (seq + i) * 7;
+		gyro_fifo[i].gy = -(seq + i) * 5;
+		gyro_fifo[i].gz = seq + i;
+	}
+	seq += accel_frames > gyro_frames ? accel_frames : gyro_frames;
+}
+
+static void queue(int accel_frames, int gyro_frames)
+{
+	sensor_handle_t *h[2] = { &accel, &gyro };
+	int frames[2] = { accel_frames, gyro_frames };
+
+	for (int s = 0; s < 2; s++) {
+		raw_data_node_t *node = AllocFromDss(sizeof(raw_data_node_t));
+		node->block = NULL;
+		node->buffer = h[s]->buffer;
+		node->raw_data_count = frames[s];
+		list_add(&h[s]->raw_data_head[h[s]->head_for_algo ? 0 : 1],
+			 &node->raw_data_node);
+	}
+}
+
+static void drain(int frames)
+{
+	fill(frames, frames);
+	queue(frames, frames);
+	FeedSensData2Algo();
+}
+
+/* Feed recording what the algorithm sees */
+static uint32_t sum[2];
+static int seen[2];
+
+static void record(int s, int x, int y, int z)
+{
+	sum[s] = sum[s] * 31 + x;
+	sum[s] = sum[s] * 31 + y;
+	sum[s] = sum[s] * 31 + z;
+	seen[s]++;
+}
+
+static int check_exec(void **sensor_data, feed_general_t *feed)
+{
+	for (int i = 0; i < feed->demand_length; i++) {
+		if (!sensor_data[i])
+			continue;
+		if (feed->demand[i].type == SENSOR_ACCELEROMETER) {
+			short *a = sensor_data[i];
+			record(0, a[0], a[1], a[2]);
+		} else {
+			int *g = sensor_data[i];
+			record(1, g[0], g[1], g[2]);
+		}
+	}
+	return 0;
+}
+
+static int check_exec_batch(sensor_data_batch_t *batch, feed_general_t *feed)
+{
+	for (int i = 0; i < feed->demand_length; i++) {
+		for (int k = 0; k < batch[i].count; k++) {
+			void *f = batch[i].frames + k * batch[i].frame_size;
+			if (feed->demand[i].type == SENSOR_ACCELEROMETER) {
+				short *a = f;
+				record(0, a[0], a[1], a[2]);
+			} else {
+				int *g = f;
+				record(1, g[0], g[1], g[2]);
+			}
+		}
+	}
+	return 0;
+}
+
+static sensor_data_demand_t check_demand[2];
+
+static feed_general_t check_feed = {
+	.type = BASIC_ALGO_DEMO,
+	.demand = check_demand,
+	.ctl_api = {
+		.exec = check_exec,
+	},
+};
+
+static void demand_init(sensor_data_demand_t *demand, int n, int freq)
+{
+	memset(demand, 0, n * sizeof(*demand));
+	for (int i = 0; i < n; i++) {
+		int frame_size = i == 0 ? sizeof(struct accel_phy_data) :
+				 sizeof(struct gyro_phy_data);
+		demand[i].type = i == 0 ? SENSOR_ACCELEROMETER :
+				 SENSOR_GYROSCOPE;
+		demand[i].id = 0;
+		demand[i].freq = freq;
+		demand[i].match_buffer_repo = MATCH_BUFFER_LIMIT_SIZE /
+					      frame_size;
+		demand[i].match_buffer = calloc(demand[i].match_buffer_repo,
+						frame_size);
+	}
+}
+
+static void demand_free(sensor_data_demand_t *demand, int n)
+{
+	for (int i = 0; i < n; i++)
+		free(demand[i].match_buffer);
+}
+
+/* Both paths hand the same calibrated frames, in the same order */
+static void run_check(int demands, int sensor_freq, int demand_freq,
+		      bool batch, uint32_t *sums, int *count)
+{
+	demand_init(check_demand, demands, demand_freq);
+	check_feed.demand_length = demands;
+	check_feed.ctl_api.exec_batch = batch ? check_exec_batch : NULL;
+	check_feed.stat_flag = ON;
+	list_add(&feed_list, &check_feed.link);
+	set_freq(sensor_freq);
+	BuildResamplePlan(&check_feed);
+	memset(sum, 0, sizeof(sum));
+	memset(seen, 0, sizeof(seen));
+	seq = 0;
+
+	for (int d = 0; d < 20; d++)
+		drain(10 + d * 3);
+
+	list_remove(&feed_list, &check_feed.link);
+	demand_free(check_demand, demands);
+	memcpy(sums, sum, sizeof(sum));
+	memcpy(count, seen, sizeof(seen));
+}
+
+static void test_paths(void)
+{
+	static const int cases[][3] = {
+		/* demands, sensor freq, demand freq */
+		{ 1, 100, 100 },
+		{ 1, 200, 100 },
+		{ 1, 400, 100 },
+		{ 2, 100, 100 },
+		{ 2, 200, 200 },
+		{ 2, 400, 400 },
+	};
+
+	for (unsigned int c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+		uint32_t s1[2], s2[2];
+		int n1[2], n2[2];
+		run_check(cases[c][0], cases[c][1], cases[c][2], false, s1, n1);
+		run_check(cases[c][0], cases[c][1], cases[c][2], true, s2, n2);
+		CHECK(n1[0] > 0 && (cases[c][0] == 1 || n1[1] > 0));
+		CHECK(n1[0] == n2[0] && n1[1] == n2[1]);
+		CHECK(s1[0] == s2[0] && s1[1] == s2[1]);
+	}
+}
+
+/*
+ * The per sample path of the engine before the resampling plan, which worked
+ * the common multiples, strides and sensor handles out on every call
+ */
+static void legacy_handle_match_buffer(feed_general_t *feed)
+{
+	sensor_data_demand_t *demand = feed->demand;
+	uint8_t demand_length = feed->demand_length;
+	uint8_t not_ready = 0;
+	uint16_t cm_time_consume = 1;
+	uint8_t match_times = 0;
+	int vernier_length = 0;
+	uint16_t cm_multi_freq = 1;
+	int8_t scale[demand_length];
+
+	for (int i = 0; i < demand_length; i++) {
+		if (demand[i].freq == 0 || (demand[i].flag & IGNORE) != 0)
+			continue;
+		cm_time_consume = GetCommonMultiple(cm_time_consume,
+				ValueRound((float)1000 / demand[i].freq));
+	}
+	for (int i = 0; i < demand_length; i++) {
+		if (demand[i].freq == 0 || (demand[i].flag & IGNORE) != 0)
+			continue;
+		int window = cm_time_consume /
+			     ValueRound((float)1000 / demand[i].freq);
+		if (demand[i].match_data_count < window) {
+			not_ready++;
+		} else {
+			int temp = demand[i].match_data_count / window;
+			if (match_times == 0 || temp < match_times)
+				match_times = temp;
+		}
+	}
+	if (not_ready != 0)
+		return;
+
+	memset(scale, 0, sizeof(scale));
+	for (int i = 0; i < demand_length; i++)
+		if (demand[i].freq != 0)
+			cm_multi_freq = GetCommonMultiple(cm_multi_freq,
+							  demand[i].freq);
+	for (int i = 0; i < demand_length; i++) {
+		if (demand[i].freq == 0)
+			continue;
+		scale[i] = cm_multi_freq / demand[i].freq;
+		int count = match_times * (cm_time_consume /
+				ValueRound((float)1000 / demand[i].freq));
+		if (vernier_length == 0 || vernier_length < count * scale[i])
+			vernier_length = count * scale[i];
+	}
+
+	for (int v = 0; v < vernier_length; v++) {
+		void *ptr[demand_length];
+		int act = 0;
+
+		memset(ptr, 0, sizeof(ptr));
+		for (int i = 0; i < demand_length; i++) {
+			if (demand[i].freq == 0)
+				continue;
+			sensor_handle_t *phy_sensor = GetActivePollSensStruct(
+				demand[i].type, demand[i].id);
+			if (phy_sensor == NULL || scale[i] == 0 ||
+			    demand[i].match_buffer == NULL)
+				continue;
+			if (v % scale[i] != 0 ||
+			    demand[i].get_idx == demand[i].put_idx)
+				continue;
+			void *ptr_from = demand[i].match_buffer +
+				phy_sensor->sensor_data_frame_size *
+				demand[i].get_idx;
+			AddCaliData(demand[i].type, phy_sensor, ptr_from);
+			ptr[i] = ptr_from;
+			demand[i].get_idx++;
+			demand[i].match_data_count--;
+			if (demand[i].get_idx >= demand[i].match_buffer_repo)
+				demand[i].get_idx = 0;
+			act++;
+		}
+		if (act != 0 && feed->ctl_api.exec != NULL)
+			HandleAlgo(feed, ptr);
+	}
+}
+
+static void legacy_feed_directly(feed_general_t *feed)
+{
+	sensor_data_demand_t *demand = feed->demand;
+	uint8_t demand_length = feed->demand_length;
+
+	for (int i = 0; i < demand_length; i++) {
+		if (demand[i].freq == 0)
+			continue;
+		sensor_handle_t *phy_sensor = GetActivePollSensStruct(
+			demand[i].type, demand[i].id);
+		if (phy_sensor == NULL)
+			continue;
+		list_t *node =
+			phy_sensor->raw_data_head[phy_sensor->head_for_algo].head;
+		for (; node != NULL; node = node->next) {
+			raw_data_node_t *raw_data = (raw_data_node_t *)
+				((void *)node - offsetof(raw_data_node_t,
+							 raw_data_node));
+			int raw_count = raw_data->raw_data_count;
+			int gap = ValueRound((float)phy_sensor->freq /
+					     (demand[i].freq * 10));
+			int frame_size = phy_sensor->sensor_data_frame_size;
+			void *ptr[demand_length];
+			int count;
+
+			memset(ptr, 0, sizeof(ptr));
+			for (count = 0;
+			     gap * count + demand[i].raw_data_offset < raw_count;
+			     count++) {
+				int idx = gap * count + demand[i].raw_data_offset;
+				void *ptr_from = phy_sensor->feed_data_buffer;
+				memcpy(ptr_from, raw_data->buffer +
+				       idx * frame_size, frame_size);
+				AddCaliData(demand[i].type, phy_sensor, ptr_from);
+				ptr[i] = ptr_from;
+				if (feed->ctl_api.exec != NULL)
+					HandleAlgo(feed, ptr);
+			}
+			demand[i].raw_data_offset = gap - (raw_count -
+				(gap * (count - 1) + demand[i].raw_data_offset));
+		}
+	}
+}
+
+static void legacy_feed_after_match(feed_general_t *feed, match_t type)
+{
+	sensor_data_demand_t *demand = feed->demand;
+	uint8_t demand_length = feed->demand_length;
+	list_t *node[demand_length];
+	int count[demand_length];
+	uint32_t cm_time_consume = 1;
+	int d_valid_cnt = 0;
+
+	memset(node, 0, sizeof(node));
+	memset(count, 0, sizeof(count));
+	for (int i = 0; i < demand_length; i++) {
+		if (demand[i].freq == 0)
+			continue;
+		cm_time_consume = GetCommonMultiple(cm_time_consume,
+				ValueRound((float)1000 / demand[i].freq));
+	}
+	for (int i = 0; i < demand_length; i++) {
+		if (demand[i].freq == 0)
+			continue;
+		sensor_handle_t *phy_sensor = GetActivePollSensStruct(
+			demand[i].type, demand[i].id);
+		if (phy_sensor != NULL)
+			node[i] = phy_sensor->raw_data_head[
+				phy_sensor->head_for_algo].head;
+		d_valid_cnt++;
+	}
+
+	while (1) {
+		int defect = 0;
+
+		for (int i = 0; i < demand_length; i++) {
+			if (demand[i].freq == 0)
+				continue;
+			sensor_handle_t *phy_sensor = GetActivePollSensStruct(
+				demand[i].type, demand[i].id);
+			if (phy_sensor == NULL || node[i] == NULL) {
+				defect++;
+				continue;
+			}
+			raw_data_node_t *raw_data = (raw_data_node_t *)
+				((void *)node[i] - offsetof(raw_data_node_t,
+							    raw_data_node));
+			int raw_count = raw_data->raw_data_count;
+			int gap = ValueRound((float)phy_sensor->freq /
+					     (demand[i].freq * 10));
+			int frame_size = phy_sensor->sensor_data_frame_size;
+
+			if (type == SYNC) {
+				int target_count = cm_time_consume /
+					ValueRound((float)1000 / demand[i].freq);
+				for (; gap * count[i] + demand[i].raw_data_offset <
+				       raw_count && demand[i].match_data_count <
+				       target_count; count[i]++)
+					CopySensorData2DelayBuf(&demand[i],
+						raw_data->buffer, gap, count[i],
+						frame_size);
+				if (gap * count[i] + demand[i].raw_data_offset >=
+				    raw_count) {
+					demand[i].raw_data_offset = gap -
+						(raw_count - (gap * (count[i] - 1) +
+						 demand[i].raw_data_offset));
+					count[i] = 0;
+					node[i] = node[i]->next;
+				}
+			} else {
+				int n;
+				for (n = 0; gap * n + demand[i].raw_data_offset <
+				     raw_count; n++)
+					CopySensorData2DelayBuf(&demand[i],
+						raw_data->buffer, gap, n,
+						frame_size);
+				demand[i].raw_data_offset = gap - (raw_count -
+					(gap * (n - 1) + demand[i].raw_data_offset));
+				node[i] = node[i]->next;
+			}
+		}
+
+		if (defect == d_valid_cnt && type == ASYNC)
+			break;
+		if (defect > 0 && type == SYNC)
+			break;
+
+		legacy_handle_match_buffer(feed);
+	}
+}
+
+/* FeedSensData2Algo() with the legacy per sample path */
+static void legacy_feed(void)
+{
+	feed_general_t *feed = &check_feed;
+
+	for (list_t *next = phy_sensor_poll_active_list.head; next != NULL;
+	     next = next->next) {
+		sensor_handle_t *phy_sensor = (sensor_handle_t *)((void *)next -
+			offsetof(sensor_handle_t, links.poll.poll_active_link));
+		phy_sensor->head_for_algo = phy_sensor->head_for_algo ? 0 : 1;
+	}
+
+	if (feed->demand_length == 1)
+		legacy_feed_directly(feed);
+	else
+		legacy_feed_after_match(feed, CheckMinDelayBuffer(feed) == 0 ?
+					SYNC : ASYNC);
+
+	for (list_t *next = phy_sensor_poll_active_list.head; next != NULL;
+	     next = next->next) {
+		sensor_handle_t *phy_sensor = (sensor_handle_t *)((void *)next -
+			offsetof(sensor_handle_t, links.poll.poll_active_link));
+		list_head_t *head =
+			&phy_sensor->raw_data_head[phy_sensor->head_for_algo];
+		list_t *node = head->head;
+		while (node != NULL) {
+			list_t *temp = node->next;
+			FreeInDss((void *)node);
+			node = temp;
+		}
+		memset(head, 0, sizeof(*head));
+	}
+}
+
+/* Drains of 200ms, the sensor rates and the demanded rates in Hz */
+static void run_rates(bool plan, int demands, int accel_freq,
+		      int gyro_freq, int accel_demand, int gyro_demand,
+		      bool ignore, uint32_t *sums, int *count)
+{
+	demand_init(check_demand, demands, accel_demand);
+	check_demand[1].freq = gyro_demand;
+	if (ignore)
+		check_demand[1].flag |= IGNORE;
+	check_feed.demand_length = demands;
+	check_feed.ctl_api.exec_batch = NULL;
+	check_feed.stat_flag = ON;
+	list_add(&feed_list, &check_feed.link);
+	accel.freq = accel_freq * 10;
+	gyro.freq = gyro_freq * 10;
+	BuildResamplePlan(&check_feed);
+	memset(sum, 0, sizeof(sum));
+	memset(seen, 0, sizeof(seen));
+	seq = 0;
+
+	for (int d = 0; d < 20; d++) {
+		fill(accel_freq / 5, gyro_freq / 5);
+		queue(accel_freq / 5, gyro_freq / 5);
+		if (plan)
+			FeedSensData2Algo();
+		else
+			legacy_feed();
+	}
+
+	list_remove(&feed_list, &check_feed.link);
+	demand_free(check_demand, demands);
+	memcpy(sums, sum, sizeof(sum));
+	memcpy(count, seen, sizeof(seen));
+}
+
+static void test_rates(void)
+{
+	static const int rates[] = { 25, 50, 100, 200, 400 };
+	static const int div[] = { 1, 2, 4, 5 };
+	int cases = 0, fed = 0;
+
+	for (int a = 0; a < 5; a++)
+	for (int g = 0; g < 5; g++)
+	for (int da = 0; da < 4; da++)
+	for (int dg = 0; dg < 4; dg++)
+	for (int mode = 0; mode < 4; mode++) {
+		/* direct, sync, async, sync with the gyro IGNOREd */
+		int demands = mode == 0 ? 1 : 2;
+		int accel_demand = rates[a] / div[da];
+		int gyro_demand = rates[g] / div[dg];
+		uint32_t s0[2], s1[2];
+		int n0[2], n1[2];
+
+		if (mode == 0 && (g != 0 || dg != 0))
+			continue;
+		min_delay_ret = mode == 2 ? -1 : 0;
+		run_rates(false, demands, rates[a], rates[g], accel_demand,
+			  gyro_demand, mode == 3, s0, n0);
+		run_rates(true, demands, rates[a], rates[g], accel_demand,
+			  gyro_demand, mode == 3, s1, n1);
+		CHECK(n0[0] == n1[0] && n0[1] == n1[1]);
+		CHECK(s0[0] == s1[0] && s0[1] == s1[1]);
+		cases++;
+		if (n0[0] > 0)
+			fed++;
+	}
+	min_delay_ret = 0;
+	printf("resampling plan: %d rate cases, %d feeding the algorithm\n",
+	       cases, fed);
+	CHECK(fed > cases / 2);
+}
+
+static double bench(int freq, bool batch)
+{
+	static exposed_sensor_t *sensor = &demo_exposed_sensor;
+	struct timeval t0, t1;
+	int drains = 20000;
+	double us;
+
+	demand_init(basic_algo_demo_demand, 2, freq);
+	demo_algo.demand_length = 2;
+	demo_algo.ctl_api.exec_batch = batch ? demo_algorithm_exec_batch : NULL;
+	demo_algo.stat_flag = ON;
+	list_add(&feed_list, &demo_algo.link);
+	sensor->stat_flag = SUBSCRIBED;
+	list_add(&exposed_sensor_list, &sensor->link);
+	set_freq(freq);
+	BuildResamplePlan(&demo_algo);
+	events = 0;
+
+	gettimeofday(&t0, NULL);
+	for (int d = 0; d < drains; d++)
+		drain(DRAIN_FRAMES);
+	gettimeofday(&t1, NULL);
+	us = (t1.tv_sec - t0.tv_sec) * 1e6 + t1.tv_usec - t0.tv_usec;
+
+	/* The demo reports once per 100 steps either way */
+	CHECK(events >= drains * DRAIN_FRAMES / 100 - 1);
+
+	list_remove(&exposed_sensor_list, &sensor->link);
+	list_remove(&feed_list, &demo_algo.link);
+	demand_free(basic_algo_demo_demand, 2);
+	return 2.0 * drains * DRAIN_FRAMES / us * 1e6;
+}
+
+int main(void)
+{
+	sensor_init(&accel, SENSOR_ACCELEROMETER, sizeof(struct accel_phy_data),
+		    accel_cali, accel_feed_buf, accel_fifo);
+	sensor_init(&gyro, SENSOR_GYROSCOPE, sizeof(struct gyro_phy_data),
+		    gyro_cali, gyro_feed_buf, gyro_fifo);
+
+	test_paths();
+	printf("exec / exec_batch: %s\n", failures ? "FAILED" : "PASSED");
+
+	test_rates();
+	printf("resampling plan / legacy: %s\n",
+	       failures ? "FAILED" : "PASSED");
+
+	for (int freq = 100; freq <= 400; freq *= 2) {
+		double single = bench(freq, false);
+		double batch = bench(freq, true);
+		printf("accel + gyro %dHz: exec %.2f Msamples/s, "
+		       "exec_batch %.2f Msamples/s\n", freq, single / 1e6,
+		       batch / 1e6);
+	}
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
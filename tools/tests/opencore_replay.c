@@ -0,0 +1,1051 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ *****************************************************************************
+ * Host record/replay harness of the sensor core: the opencore main loop,
+ * algo engine, feeds and the physical sensor layer run unmodified on top of a
+ * simulated driver which plays back accel, gyro, mag and baro traces, and the
+ * run is measured:
+ * - latency from the production of a sample by the sensor to the first
+ *   client event carrying data derived from it,
+ * - host CPU time per second of sensor data,
+ * - high-water marks of balloc and of the DSS slabs, algo engine queue depth,
+ * - samples dropped by the sensors (FIFO overflow, register overwritten before
+ *   being read) and raw data buffers the core failed to allocate.
+ *
+ * The simulated accel, gyro and mag share a 1024 byte hardware FIFO like the
+ * BMI160 and BMM150 of the board, the baro converts when its register is read.
+ * The others sample at the ODR the core sets, using the trace sample in effect
+ * at the time, so a trace can be recorded at any rate. The clock is simulated:
+ * time only moves when the core waits for a command and, by one 32kHz tick,
+ * each time the core reads it, so runs are reproducible. With -s the waits
+ * are also slept, 1 for real time, 10 for 10 times faster, ...
+ *
+ * Traces are text files with one sample per line, lines starting with '#'
+ * are ignored:
+ *   <time ms> accel|gyro|mag|baro <x> [<y> <z>]
+ * in the units of the phy data: mg, m_degree/s, 16LSB/uT and Pa/256. A walk
+ * is generated when no trace is given, -w writes it out as an example.
+ *
+ * Compile with (from the top directory):
+ * OC=framework/src/sensors/sensor_core/open_core
+ * gcc -O2 -Wall -fcommon -Itools/tests/zephyr_stub -Ibsp/include \
+ *     -Iframework/include \
+ *     -Ibsp/include/machine/soc/intel/quark_se/arc \
+ *     -Ibsp/include/machine/soc/intel/quark_se \
+ *     -Iframework/include/sensors/sensor_core/ipc \
+ *     -Iframework/include/sensors/sensor_core/open_core \
+ *     -I$OC/opencore_src bsp/src/util/list.c \
+ *     tools/tests/opencore_replay.c -lm -o opencore_replay
+ *
+ * Usage: opencore_replay [-s speed] [-t seconds] [-w trace] [-v]
+ *                        [-S sensor:hz:report_ms ...] [trace]
+ * sensor is one of accel, gyro, mag, baro or demo; the default subscriptions
+ * are demo, accel:50:200, gyro:50:200, mag:25:40 and baro:10:100.
+ */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "util/compiler.h"
+#include "opencore_algo_support.h"
+
+/* Branch hints, only defined for ARC builds */
+#ifndef _Rarely
+#define _Usually(x) __builtin_expect(!!((x)), 1)
+#define _Rarely(x) __builtin_expect(!!((x)), 0)
+#endif
+
+/*
+ * Feeds and exposed sensors are listed by the linker script on target. Put
+ * them in sections named as C identifiers instead, the host linker then
+ * defines the bounds.
+ */
+#undef define_feedinit
+#define define_feedinit(name) \
+	static void *__feedinit_ ## name __used \
+	__section("openinit_feed") = &name
+#undef define_exposedinit
+#define define_exposedinit(name) \
+	static void *__exposedinit_ ## name __used \
+	__section("openinit_exposed") = &name
+#define _s_feedinit __start_openinit_feed
+#define _e_feedinit __stop_openinit_feed
+#define _s_exposedinit __start_openinit_exposed
+#define _e_exposedinit __stop_openinit_exposed
+
+#include "../../framework/src/sensors/sensor_core/open_core/opencore_src/opencore_main.c"
+#include "../../framework/src/sensors/sensor_core/open_core/opencore_src/opencore_algo_engine.c"
+#include "../../framework/src/sensors/sensor_core/open_core/opencore_src/opencore_support.c"
+#include "../../framework/src/sensors/sensor_core/open_core/opencore_src/opencore_method.c"
+#include "../../framework/src/sensors/sensor_core/open_core/opencore_src/opencore_rawdata.c"
+#include "../../framework/src/sensors/sensor_core/open_core/algo_support_src/opencore_demo.c"
+#include "../../framework/src/sensors/phy_sensor_api/src/phy_sensor_api.c"
+#include "../../framework/src/sensors/phy_sensor_api/src/phy_sensor_drv_api.c"
+#include "../../bsp/src/util/slab.c"
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, \
+			       __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static int failures;
+static int verbose;
+
+/*
+ * Simulated clock, in 32kHz ticks
+ */
+static uint64_t sim_ticks;
+
+uint32_t get_uptime_32k(void)
+{
+	/* A read costs a tick, this bounds the busy wait of the core */
+	return (uint32_t)sim_ticks++;
+}
+
+uint32_t get_uptime_ms(void)
+{
+	return sim_ticks * 1000 / 32768;
+}
+
+static uint64_t sim_us(void)
+{
+	return sim_ticks * 1000000 / 32768;
+}
+
+/*
+ * Simulated sensors
+ */
+#define SIM_FIFO_LEN    1024
+#define SIM_QUEUE_SIZE  256
+#define SIM_PENDING     1024
+
+enum { SIM_ACCEL, SIM_GYRO, SIM_MAG, SIM_BARO, SIM_COUNT };
+
+struct sim_sample {
+	uint32_t time;
+	int32_t v[3];
+};
+
+struct sim_sensor {
+	struct phy_sensor_t phy;
+	const char *name;
+	const uint16_t *odrs;
+	/* Trace */
+	struct sim_sample *trace;
+	uint32_t trace_len;
+	uint32_t trace_size;
+	uint32_t cursor;
+	/* Sampling */
+	bool active;
+	bool fifo;
+	uint32_t period_us;
+	uint64_t next_us;
+	/* Hardware FIFO share of the sensor, production times in us */
+	uint64_t queue_time[SIM_QUEUE_SIZE];
+	int32_t queue[SIM_QUEUE_SIZE][3];
+	uint16_t queue_head;
+	uint16_t queue_count;
+	/* Data register */
+	int32_t reg[3];
+	uint64_t reg_time;
+	bool reg_valid;
+	bool reg_fresh;
+	/* Samples read by the core and not reported to a client yet */
+	uint64_t pending[SIM_PENDING];
+	uint16_t pending_head;
+	uint16_t pending_count;
+	/* Statistics */
+	uint32_t produced;
+	uint32_t delivered;
+	uint32_t dropped;
+	uint32_t reported;
+};
+
+static struct sim_sensor sim[SIM_COUNT];
+static uint16_t sim_fifo_bytes;
+
+/* Supported ODRs in Hz x 10, as the BMI160, BMM150 and BME280 */
+static const uint16_t accel_odrs[] =
+{ 125, 250, 500, 1000, 2000, 4000, 8000, 16000, 0 };
+static const uint16_t gyro_odrs[] =
+{ 250, 500, 1000, 2000, 4000, 8000, 16000, 0 };
+static const uint16_t mag_odrs[] =
+{ 20, 60, 80, 100, 150, 200, 250, 300, 0 };
+static const uint16_t baro_odrs[] =
+{ 10, 20, 50, 100, 200, 500, 1000, 0 };
+
+static struct sim_sensor *sim_of(struct phy_sensor_t *phy)
+{
+	return (struct sim_sensor *)phy;
+}
+
+static const int32_t *sim_trace_value(struct sim_sensor *s, uint32_t ms)
+{
+	static const int32_t zero[3];
+
+	if (!s->trace_len)
+		return zero;
+	while (s->cursor + 1 < s->trace_len &&
+	       s->trace[s->cursor + 1].time <= ms)
+		s->cursor++;
+	return s->trace[s->cursor].v;
+}
+
+/* Drop the oldest sample of the shared FIFO, as in stream mode */
+static void sim_fifo_drop_oldest(void)
+{
+	struct sim_sensor *oldest = NULL;
+
+	for (int i = 0; i < SIM_COUNT; i++) {
+		struct sim_sensor *s = &sim[i];
+		if (s->queue_count && (!oldest ||
+				       s->queue_time[s->queue_head] <
+				       oldest->queue_time[oldest->queue_head]))
+			oldest = s;
+	}
+	oldest->queue_head = (oldest->queue_head + 1) % SIM_QUEUE_SIZE;
+	oldest->queue_count--;
+	oldest->dropped++;
+	sim_fifo_bytes -= oldest->phy.hw_raw_data_len;
+}
+
+static void sim_produce(struct sim_sensor *s)
+{
+	const int32_t *v = sim_trace_value(s, s->next_us / 1000);
+
+	s->produced++;
+	if (s->fifo) {
+		while (sim_fifo_bytes + s->phy.hw_raw_data_len > SIM_FIFO_LEN ||
+		       s->queue_count == SIM_QUEUE_SIZE)
+			sim_fifo_drop_oldest();
+		int i = (s->queue_head + s->queue_count++) % SIM_QUEUE_SIZE;
+		memcpy(s->queue[i], v, sizeof(s->queue[i]));
+		s->queue_time[i] = s->next_us;
+		sim_fifo_bytes += s->phy.hw_raw_data_len;
+	} else {
+		if (s->reg_fresh)
+			s->dropped++;
+		memcpy(s->reg, v, sizeof(s->reg));
+		s->reg_time = s->next_us;
+		s->reg_valid = s->reg_fresh = true;
+	}
+}
+
+/* Sample all the sensors up to now, in time order for the shared FIFO */
+static void sim_update(void)
+{
+	uint64_t now = sim_us();
+
+	for (;;) {
+		struct sim_sensor *next = NULL;
+		for (int i = 0; i < SIM_COUNT; i++) {
+			struct sim_sensor *s = &sim[i];
+			if (s->period_us && (s->active || s->fifo) &&
+			    s->next_us <= now &&
+			    (!next || s->next_us < next->next_us))
+				next = s;
+		}
+		if (!next)
+			return;
+		sim_produce(next);
+		next->next_us += next->period_us;
+	}
+}
+
+static void sim_restart(struct sim_sensor *s)
+{
+	sim_update();
+	s->next_us = sim_us() + s->period_us;
+}
+
+static void sim_deliver(struct sim_sensor *s, uint64_t time)
+{
+	if (s->pending_count == SIM_PENDING) {
+		s->pending_head = (s->pending_head + 1) % SIM_PENDING;
+		s->pending_count--;
+	}
+	s->pending[(s->pending_head + s->pending_count++) % SIM_PENDING] = time;
+	s->delivered++;
+}
+
+/* Convert a sample to the phy data of the sensor */
+static void sim_convert(struct sim_sensor *s, uint8_t *buffer,
+			const int32_t *v)
+{
+	if (s->phy.type == SENSOR_ACCELEROMETER) {
+		struct accel_phy_data d = { v[0], v[1], v[2] };
+		memcpy(buffer, &d, sizeof(d));
+	} else if (s->phy.type == SENSOR_BAROMETER) {
+		struct baro_phy_data d = { v[0] };
+		memcpy(buffer, &d, sizeof(d));
+	} else {
+		struct gyro_phy_data d = { v[0], v[1], v[2] };
+		memcpy(buffer, &d, sizeof(d));
+	}
+}
+
+static int sim_open(struct phy_sensor_t *sensor)
+{
+	return DRV_RC_OK;
+}
+
+static void sim_close(struct phy_sensor_t *sensor)
+{
+}
+
+static int sim_activate(struct phy_sensor_t *sensor, bool enable)
+{
+	struct sim_sensor *s = sim_of(sensor);
+
+	if (enable && !s->active && !s->fifo)
+		sim_restart(s);
+	s->active = enable;
+	return DRV_RC_OK;
+}
+
+static int sim_query_odr(struct phy_sensor_t *sensor, uint16_t odr_target,
+			 uint16_t *odr_support)
+{
+	const uint16_t *odr = sim_of(sensor)->odrs;
+
+	if (!odr_target) {
+		*odr_support = 0;
+		return DRV_RC_OK;
+	}
+	while (odr[1] && *odr < odr_target)
+		odr++;
+	*odr_support = *odr;
+	return DRV_RC_OK;
+}
+
+static int sim_set_odr(struct phy_sensor_t *sensor, uint16_t odr_hz_x10)
+{
+	struct sim_sensor *s = sim_of(sensor);
+
+	sim_query_odr(sensor, odr_hz_x10, &odr_hz_x10);
+	s->period_us = odr_hz_x10 ? 10000000 / odr_hz_x10 : 0;
+	sim_restart(s);
+	return DRV_RC_OK;
+}
+
+static int sim_read(struct phy_sensor_t *sensor, uint8_t *buffer,
+		    uint16_t buff_len)
+{
+	struct sim_sensor *s = sim_of(sensor);
+
+	sim_update();
+	/* Without ODR, a conversion is made on each read (forced mode) */
+	if (!s->period_us && s->active) {
+		s->next_us = sim_us();
+		sim_produce(s);
+	}
+	if (!s->reg_valid || buff_len < sensor->raw_data_len)
+		return 0;
+	sim_convert(s, buffer, s->reg);
+	if (s->reg_fresh)
+		sim_deliver(s, s->reg_time);
+	s->reg_fresh = false;
+	return sensor->raw_data_len;
+}
+
+static int sim_fifo_read(struct phy_sensor_t *sensor, uint8_t *buffer,
+			 uint16_t buff_len)
+{
+	struct sim_sensor *s = sim_of(sensor);
+	int n = 0;
+
+	sim_update();
+	while (s->queue_count && (n + 1) * sensor->raw_data_len <= buff_len) {
+		sim_convert(s, buffer + n * sensor->raw_data_len,
+			    s->queue[s->queue_head]);
+		sim_deliver(s, s->queue_time[s->queue_head]);
+		s->queue_head = (s->queue_head + 1) % SIM_QUEUE_SIZE;
+		s->queue_count--;
+		sim_fifo_bytes -= sensor->hw_raw_data_len;
+		n++;
+	}
+	return n * sensor->raw_data_len;
+}
+
+static int sim_enable_fifo(struct phy_sensor_t *sensor, uint8_t *buffer,
+			   uint16_t len, bool enable)
+{
+	struct sim_sensor *s = sim_of(sensor);
+
+	if (enable && !s->fifo && !s->active)
+		sim_restart(s);
+	sim_update();
+	s->fifo = enable;
+	/* Samples left in the FIFO are lost when it is reconfigured */
+	while (!enable && s->queue_count) {
+		s->queue_head = (s->queue_head + 1) % SIM_QUEUE_SIZE;
+		s->queue_count--;
+		s->dropped++;
+		sim_fifo_bytes -= sensor->hw_raw_data_len;
+	}
+	return DRV_RC_OK;
+}
+
+static void sim_sensor_init(int i, const char *name, phy_sensor_type_t type,
+			    uint8_t raw_data_len, uint8_t hw_raw_data_len,
+			    const uint16_t *odrs)
+{
+	struct sim_sensor *s = &sim[i];
+
+	s->name = name;
+	s->odrs = odrs;
+	s->phy.type = type;
+	s->phy.raw_data_len = raw_data_len;
+	s->phy.hw_raw_data_len = hw_raw_data_len;
+	s->phy.report_mode_mask = PHY_SENSOR_REPORT_MODE_POLL_REG_MASK;
+	if (i != SIM_BARO) {
+		s->phy.hw_fifo_len = SIM_FIFO_LEN;
+		s->phy.report_mode_mask |= PHY_SENSOR_REPORT_MODE_POLL_FIFO_MASK;
+		s->phy.api.fifo_read = sim_fifo_read;
+		s->phy.api.enable_fifo = sim_enable_fifo;
+	}
+	s->phy.api.open = sim_open;
+	s->phy.api.close = sim_close;
+	s->phy.api.activate = sim_activate;
+	s->phy.api.set_odr = sim_set_odr;
+	s->phy.api.query_odr = sim_query_odr;
+	s->phy.api.read = sim_read;
+}
+
+/* Register the sensors found in the trace, accel, gyro and mag share FIFO */
+static void sim_register(void)
+{
+	uint32_t fifo_ids = 0;
+
+	for (int i = 0; i < SIM_COUNT; i++) {
+		if (!sim[i].trace_len)
+			continue;
+		sensor_register(&sim[i].phy);
+		if (sim[i].phy.hw_fifo_len)
+			fifo_ids |= 1 << sim[i].phy.dev_id;
+	}
+	for (int i = 0; i < SIM_COUNT; i++)
+		if (sim[i].phy.dev_id && sim[i].phy.hw_fifo_len)
+			sim[i].phy.fifo_share_bitmap =
+				fifo_ids & ~(1 << sim[i].phy.dev_id);
+}
+
+/*
+ * Traces
+ */
+static struct sim_sensor *sim_by_name(const char *name)
+{
+	for (int i = 0; i < SIM_COUNT; i++)
+		if (!strcmp(sim[i].name, name))
+			return &sim[i];
+	return NULL;
+}
+
+static void trace_add(struct sim_sensor *s, uint32_t time, int32_t x,
+		      int32_t y, int32_t z)
+{
+	if (s->trace_len == s->trace_size) {
+		s->trace_size = s->trace_size ? 2 * s->trace_size : 1024;
+		s->trace = realloc(s->trace,
+				   s->trace_size * sizeof(*s->trace));
+	}
+	s->trace[s->trace_len++] = (struct sim_sample) {
+		time, { x, y, z }
+	};
+}
+
+static int trace_load(const char *file)
+{
+	char line[128], name[16];
+	unsigned int time;
+	int32_t v[3];
+	int n = 0;
+	FILE *f = fopen(file, "r");
+
+	if (!f) {
+		perror(file);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		struct sim_sensor *s;
+		n++;
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		v[1] = v[2] = 0;
+		if (sscanf(line, "%u %15s %d %d %d", &time, name, &v[0], &v[1],
+			   &v[2]) < 3 || !(s = sim_by_name(name)) ||
+		    (s->trace_len && s->trace[s->trace_len - 1].time > time)) {
+			printf("%s:%d: invalid sample\n", file, n);
+			fclose(f);
+			return -1;
+		}
+		trace_add(s, time, v[0], v[1], v[2]);
+	}
+	fclose(f);
+	return 0;
+}
+
+static int trace_save(const char *file)
+{
+	FILE *f = fopen(file, "w");
+
+	if (!f) {
+		perror(file);
+		return -1;
+	}
+	fprintf(f, "# <time ms> <sensor> <x> [<y> <z>]\n");
+	for (int i = 0; i < SIM_COUNT; i++)
+		for (uint32_t j = 0; j < sim[i].trace_len; j++) {
+			struct sim_sample *t = &sim[i].trace[j];
+			if (i == SIM_BARO)
+				fprintf(f, "%u %s %d\n", t->time, sim[i].name,
+					t->v[0]);
+			else
+				fprintf(f, "%u %s %d %d %d\n", t->time,
+					sim[i].name, t->v[0], t->v[1], t->v[2]);
+		}
+	fclose(f);
+	return 0;
+}
+
+/* Walk at 2 steps/s, turning slowly and climbing stairs after half time */
+static void trace_generate(uint32_t seconds)
+{
+	for (uint32_t t = 0; t < seconds * 1000; t += 5) {
+		double step = 2 * M_PI * 2 * t / 1000;
+		double turn = 2 * M_PI * t / 20000;
+		trace_add(&sim[SIM_ACCEL], t, 150 * sin(step),
+			  80 * sin(step / 2), 1000 + 300 * cos(step));
+		trace_add(&sim[SIM_GYRO], t, 20000 * sin(step),
+			  10000 * cos(step), 18000 * cos(turn));
+		if (t % 40 == 0)
+			trace_add(&sim[SIM_MAG], t, 400 * cos(turn),
+				  400 * sin(turn), -600);
+		if (t % 100 == 0)
+			trace_add(&sim[SIM_BARO], t,
+				  256 * (101325 - (t > seconds * 500 ?
+						   (t - seconds * 500) / 100 :
+						   0)), 0, 0);
+	}
+}
+
+static uint32_t trace_duration(void)
+{
+	uint32_t end = 0;
+
+	for (int i = 0; i < SIM_COUNT; i++)
+		if (sim[i].trace_len && sim[i].trace[sim[i].trace_len - 1].time
+		    > end)
+			end = sim[i].trace[sim[i].trace_len - 1].time;
+	return end;
+}
+
+/*
+ * Services used by the sensor core
+ */
+#define LATENCY_BUCKETS 2000
+
+static uint32_t latency_hist[LATENCY_BUCKETS + 1];
+static uint64_t latency_sum;
+static uint64_t latency_max;
+static uint32_t latency_count;
+/* Simulated sensors a client event of a sensor type carries data of */
+static uint8_t event_sources[256];
+static uint32_t events[256];
+static uint32_t sensor_errors;
+
+static void latency_account(struct sim_sensor *s, uint64_t now)
+{
+	while (s->pending_count) {
+		uint64_t l = now - s->pending[s->pending_head];
+		s->pending_head = (s->pending_head + 1) % SIM_PENDING;
+		s->pending_count--;
+		s->reported++;
+		latency_sum += l;
+		latency_count++;
+		if (l > latency_max)
+			latency_max = l;
+		latency_hist[l / 1000 < LATENCY_BUCKETS ?
+			     l / 1000 : LATENCY_BUCKETS]++;
+	}
+}
+
+static uint64_t latency_percentile(int percent)
+{
+	uint64_t n = 0;
+
+	for (int i = 0; i <= LATENCY_BUCKETS; i++) {
+		n += latency_hist[i];
+		if (n * 100 >= (uint64_t)latency_count * percent)
+			return i + 1;
+	}
+	return LATENCY_BUCKETS;
+}
+
+static void event_sources_init(void)
+{
+	for (list_t *next = exposed_sensor_list.head; next; next = next->next) {
+		exposed_sensor_t *e = (exposed_sensor_t *)next;
+		uint8_t mask = 0;
+		for (list_t *node = feed_list.head; node; node = node->next) {
+			feed_general_t *feed = (feed_general_t *)node;
+			if (!(e->depend_flag & (1 << feed->type)))
+				continue;
+			for (int i = 0; i < feed->demand_length; i++)
+				for (int j = 0; j < SIM_COUNT; j++)
+					if (sim[j].phy.type ==
+					    feed->demand[i].type &&
+					    (!(e->stat_flag & DIRECT_RAW) ||
+					     sim[j].phy.type == e->type))
+						mask |= 1 << j;
+		}
+		event_sources[e->type] = mask;
+	}
+}
+
+IPC_ERR_TYPE ipc_2svc_send(struct ia_cmd *cmd)
+{
+	if (cmd->cmd_id == SENSOR_DATA) {
+		struct sensor_data *data = (struct sensor_data *)cmd->param;
+		uint64_t now = sim_us();
+		events[data->sensor.sensor_type]++;
+		for (int i = 0; i < SIM_COUNT; i++)
+			if (event_sources[data->sensor.sensor_type] & (1 << i))
+				latency_account(&sim[i], now);
+	} else if (cmd->cmd_id == RESP_SUBSCRIBE_SENSOR_DATA ||
+		   cmd->cmd_id == RESP_UNSUBSCRIBE_SENSOR_DATA) {
+		struct return_value *rv = (struct return_value *)cmd->param;
+		if (rv->ret != RESP_SUCCESS) {
+			printf("sensor %d: command %d failed\n",
+			       rv->sensor.sensor_type, cmd->cmd_id);
+			sensor_errors++;
+		}
+	}
+	return 0;
+}
+
+/* balloc with accounting of the memory in use */
+struct balloc_head {
+	uint32_t size;
+	uint32_t pad;
+};
+
+static uint32_t balloc_used, balloc_blocks, balloc_max, balloc_max_blocks;
+
+void *balloc(uint32_t size, OS_ERR_TYPE *err)
+{
+	struct balloc_head *h = malloc(sizeof(*h) + size);
+
+	h->size = size;
+	balloc_used += size;
+	balloc_blocks++;
+	if (balloc_used > balloc_max)
+		balloc_max = balloc_used;
+	if (balloc_blocks > balloc_max_blocks)
+		balloc_max_blocks = balloc_blocks;
+	/* Do not let code rely on zeroed memory */
+	memset(h + 1, 0xa5, size);
+	return h + 1;
+}
+
+OS_ERR_TYPE bfree(void *buffer)
+{
+	struct balloc_head *h = (struct balloc_head *)buffer - 1;
+
+	balloc_used -= h->size;
+	balloc_blocks--;
+	free(h);
+	return E_OS_OK;
+}
+
+/* Messages to the algo engine, handled when the core fiber waits */
+#define ENGINE_QUEUE_SIZE 64
+
+static struct message *engine_queue[ENGINE_QUEUE_SIZE];
+static int engine_head, engine_count, engine_max;
+static void (*engine_handler)(struct message *, void *);
+
+struct message *message_alloc(int size, OS_ERR_TYPE *err)
+{
+	return balloc(size, err);
+}
+
+int port_send_message(struct message *msg)
+{
+	if (engine_count == ENGINE_QUEUE_SIZE) {
+		printf("algo engine queue full\n");
+		failures++;
+		bfree(msg);
+		return -1;
+	}
+	engine_queue[(engine_head + engine_count++) % ENGINE_QUEUE_SIZE] = msg;
+	if (engine_count > engine_max)
+		engine_max = engine_count;
+	return 0;
+}
+
+uint16_t port_alloc(void *queue)
+{
+	return 1;
+}
+
+void port_set_handler(uint16_t port_id, void (*handler)(struct message *,
+							 void *), void *param)
+{
+	engine_handler = handler;
+}
+
+static void engine_run(void)
+{
+	while (engine_count) {
+		struct message *msg = engine_queue[engine_head];
+		engine_head = (engine_head + 1) % ENGINE_QUEUE_SIZE;
+		engine_count--;
+		engine_handler(msg, NULL);
+	}
+}
+
+/* Commands to the sensor core */
+#define CMD_QUEUE_SIZE 32
+
+static struct ia_cmd *cmd_queue[CMD_QUEUE_SIZE];
+static int cmd_queue_head, cmd_queue_count;
+static uint64_t run_end_us;
+static unsigned int speed;
+static jmp_buf run_done;
+
+IPC_ERR_TYPE ipc_2core_send(struct ia_cmd *cmd)
+{
+	cmd_queue[(cmd_queue_head + cmd_queue_count++) % CMD_QUEUE_SIZE] = cmd;
+	return 0;
+}
+
+IPC_ERR_TYPE ipc_core_receive(struct ia_cmd **cmd, int timeout)
+{
+	uint64_t now, wait;
+
+	engine_run();
+	if (cmd_queue_count) {
+		*cmd = cmd_queue[cmd_queue_head];
+		cmd_queue_head = (cmd_queue_head + 1) % CMD_QUEUE_SIZE;
+		cmd_queue_count--;
+		return 0;
+	}
+
+	now = sim_us();
+	if (now >= run_end_us)
+		longjmp(run_done, 1);
+	wait = run_end_us - now;
+	if (timeout >= 0 && (uint64_t)timeout * 1000 < wait)
+		wait = (uint64_t)timeout * 1000;
+	if (speed)
+		usleep(wait / speed);
+	sim_ticks += (wait * 32768 + 999999) / 1000000;
+	return -1;
+}
+
+IPC_ERR_TYPE ipc_svc_core_create()
+{
+	return 0;
+}
+
+void task_fiber_start(char *pStack, unsigned stackSize,
+		      nano_fiber_entry_t entry, int arg1, int arg2,
+		      unsigned prio, unsigned options)
+{
+}
+
+void log_printk(uint8_t level, const char *module, const char *format, ...)
+{
+	va_list args;
+
+	if (!verbose)
+		return;
+	printf("%u [%s] ", get_uptime_ms(), module);
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+	printf("\n");
+}
+
+T_MUTEX mutex_create(void)
+{
+	return (T_MUTEX)1;
+}
+
+OS_ERR_TYPE mutex_lock(T_MUTEX mutex, int timeout)
+{
+	return E_OS_OK;
+}
+
+void mutex_unlock(T_MUTEX mutex)
+{
+}
+
+void pm_wakelock_init(struct pm_wakelock *wli)
+{
+}
+
+int pm_wakelock_acquire(struct pm_wakelock *wl)
+{
+	return 0;
+}
+
+int pm_wakelock_release(struct pm_wakelock *wl)
+{
+	return 0;
+}
+
+/*
+ * Replay
+ */
+struct sub {
+	uint8_t type;
+	uint8_t id;
+	uint16_t freq;
+	uint16_t rt;
+};
+
+#define MAX_SUBS 8
+
+static struct sub subs[MAX_SUBS];
+static int sub_count;
+
+static int sub_parse(const char *arg)
+{
+	char name[16];
+	unsigned int freq = 0, rt = 0;
+	struct sim_sensor *s;
+
+	if (sub_count == MAX_SUBS ||
+	    sscanf(arg, "%15[a-z]:%u:%u", name, &freq, &rt) < 1)
+		return -1;
+	if (!strcmp(name, "demo")) {
+		subs[sub_count++] = (struct sub) {
+			SENSOR_ALGO_DEMO, DEFAULT_ID, 0, 0
+		};
+		return 0;
+	}
+	if (!(s = sim_by_name(name)) || !freq || !rt)
+		return -1;
+	subs[sub_count++] = (struct sub) {
+		s->phy.type, 0, freq, rt
+	};
+	return 0;
+}
+
+static void sub_send(struct sub *sub, bool subscribe)
+{
+	struct ia_cmd *cmd = balloc(sizeof(*cmd) + sizeof(struct subscription),
+				    NULL);
+	struct subscription *param = (struct subscription *)cmd->param;
+
+	memset(cmd, 0, sizeof(*cmd) + sizeof(*param));
+	cmd->cmd_id = subscribe ? CMD_SUBSCRIBE_SENSOR_DATA :
+		      CMD_UNSUBSCRIBE_SENSOR_DATA;
+	cmd->length = sizeof(*cmd) + sizeof(*param);
+	param->sensor.sensor_type = sub->type;
+	param->sensor.dev_id = sub->id;
+	param->sampling_interval = sub->freq;
+	param->reporting_interval = sub->rt;
+	ipc_2core_send(cmd);
+}
+
+static void sub_send_all(bool subscribe)
+{
+	for (int i = 0; i < sub_count; i++)
+		sub_send(&subs[i], subscribe);
+}
+
+/* Run the sensor core fiber until the simulated clock reaches end_ms */
+static void run(uint32_t end_ms)
+{
+	run_end_us = (uint64_t)end_ms * 1000;
+	if (!setjmp(run_done))
+		opencore_fiber();
+	engine_run();
+}
+
+static double cpu_us(void)
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e6 +
+	       usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static void usage(void)
+{
+	printf("usage: opencore_replay [-s speed] [-t seconds] [-w trace] "
+	       "[-v]\n"
+	       "                       [-S sensor:hz:report_ms ...] [trace]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *trace = NULL, *out = NULL;
+	uint32_t seconds = 60, duration, produced = 0, dropped = 0;
+	uint32_t dss_fails = 0;
+	uint32_t balloc_idle;
+	double cpu;
+	int opt;
+
+	sim_sensor_init(SIM_ACCEL, "accel", SENSOR_ACCELEROMETER,
+			sizeof(struct accel_phy_data), 7, accel_odrs);
+	sim_sensor_init(SIM_GYRO, "gyro", SENSOR_GYROSCOPE,
+			sizeof(struct gyro_phy_data), 7, gyro_odrs);
+	sim_sensor_init(SIM_MAG, "mag", SENSOR_MAGNETOMETER,
+			sizeof(struct mag_phy_data), 9, mag_odrs);
+	sim_sensor_init(SIM_BARO, "baro", SENSOR_BAROMETER,
+			sizeof(struct baro_phy_data), 3, baro_odrs);
+
+	while ((opt = getopt(argc, argv, "s:t:w:vS:")) != -1) {
+		switch (opt) {
+		case 's':
+			speed = atoi(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'w':
+			out = optarg;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		case 'S':
+			if (sub_parse(optarg))
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind < argc)
+		trace = argv[optind];
+	if (!sub_count) {
+		sub_parse("demo");
+		sub_parse("accel:50:200");
+		sub_parse("gyro:50:200");
+		sub_parse("mag:25:40");
+		sub_parse("baro:10:100");
+	}
+
+	if (trace ? trace_load(trace) : (trace_generate(seconds), 0))
+		return 2;
+	if (out && trace_save(out))
+		return 2;
+	duration = trace_duration();
+	printf("trace %s: %u.%03u s", trace ? trace : "generated",
+	       duration / 1000, duration % 1000);
+	for (int i = 0; i < SIM_COUNT; i++)
+		printf(", %s %u", sim[i].name, sim[i].trace_len);
+	printf(" samples\n");
+
+	sim_register();
+	SensorCoreInit();
+	AlgoEngineInit(NULL);
+	event_sources_init();
+	for (int i = 0; i < sub_count; i++)
+		for (int j = 0; j < SIM_COUNT && !subs[i].id; j++)
+			if (sim[j].phy.type == subs[i].type)
+				subs[i].id = sim[j].phy.dev_id;
+
+	sub_send_all(true);
+	cpu = cpu_us();
+	run(duration);
+	cpu = cpu_us() - cpu;
+	sub_send_all(false);
+	run(duration + 100);
+	balloc_idle = balloc_used;
+
+	printf("sensor  produced  read  dropped  reported\n");
+	for (int i = 0; i < SIM_COUNT; i++) {
+		struct sim_sensor *s = &sim[i];
+		printf("%-6s %9u %5u %8u %9u\n", s->name, s->produced,
+		       s->delivered, s->dropped, s->reported);
+		produced += s->produced;
+		dropped += s->dropped;
+	}
+	for (int i = 0; i < sub_count; i++) {
+		printf("sensor type %d: %u events\n", subs[i].type,
+		       events[subs[i].type]);
+		CHECK(events[subs[i].type] > 0);
+	}
+	if (latency_count)
+		printf("latency: avg %.1f ms, 99%% < %u ms, max %.1f ms\n",
+		       latency_sum / 1000.0 / latency_count,
+		       (uint32_t)latency_percentile(99), latency_max / 1000.0);
+	printf("cpu: %.0f us per second of sensor data\n",
+	       cpu * 1000 / (duration ? duration : 1));
+	printf("balloc: %u bytes in %u blocks at most\n", balloc_max,
+	       balloc_max_blocks);
+	for (int i = 0; i < DSS_SLAB_CNT; i++) {
+		struct slab_stats stats;
+		slab_get_stats(&dss_slab[i], &stats);
+		printf("%s: %u/%u blocks at most, %u failed allocations\n",
+		       dss_slab[i].name, stats.max_used, stats.count,
+		       stats.fails);
+		dss_fails += stats.fails;
+		CHECK(stats.used == 0);
+	}
+	printf("algo engine queue: %d messages at most\n", engine_max);
+	printf("dropped: %u samples, %u raw data buffers not allocated\n",
+	       dropped, dss_fails);
+
+	CHECK(sensor_errors == 0);
+	CHECK(latency_count > 0);
+	/*
+	 * Polled sensors sampling at the polling period lose a sample now
+	 * and then to jitter, more means the core does not keep up
+	 */
+	CHECK(dropped * 1000 <= produced);
+	CHECK(dss_fails == 0);
+
+	/* Match buffers are kept between subscriptions, nothing else */
+	sub_send_all(true);
+	run(duration + 1100);
+	sub_send_all(false);
+	run(duration + 1200);
+	CHECK(balloc_used == balloc_idle);
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
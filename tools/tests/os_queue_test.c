@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ *****************************************************************************
+ * Host test of the priorities of the OS abstraction queues, and measure of the
+ * dispatch latency of urgent messages behind a backlog of bulk messages.
+ *
+ * Compile with (from the top directory):
+ * gcc -O2 -DCONFIG_QUEUE_ELEMENT_POOL_SIZE=100 -DCONFIG_QUEUE_STATS \
+ *     -Itools/tests/zephyr_stub -Ibsp/include -Ibsp/src/os/zephyr \
+ *     bsp/src/os/zephyr/queue.c bsp/src/util/list.c \
+ *     tools/tests/os_queue_test.c -o os_queue_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+/* Not time.h, whose timer functions conflict with os.h */
+#include <sys/time.h>
+
+#include "os/os.h"
+
+/* OS abstraction services used by the queues */
+static uint32_t uptime_32k;
+
+uint32_t get_uptime_32k(void);
+
+uint32_t get_uptime_32k(void)
+{
+	return uptime_32k;
+}
+
+void panic(int err)
+{
+	fprintf(stderr, "panic(%d)\n", err);
+	abort();
+}
+
+void error_management(OS_ERR_TYPE *err, OS_ERR_TYPE localErr)
+{
+	if (err)
+		*err = localErr;
+	else if (localErr != E_OS_OK)
+		panic(localErr);
+}
+
+/* The test is single threaded: semaphores are simple counters */
+static int32_t sema_count[QUEUE_POOL_SIZE];
+static int sema_used;
+
+T_SEMAPHORE semaphore_create(uint32_t initialCount)
+{
+	sema_count[sema_used] = initialCount;
+	return &sema_count[sema_used++];
+}
+
+void semaphore_delete(T_SEMAPHORE semaphore)
+{
+}
+
+void semaphore_give(T_SEMAPHORE semaphore, OS_ERR_TYPE *err)
+{
+	(*(int32_t *)semaphore)++;
+	*err = E_OS_OK;
+}
+
+OS_ERR_TYPE semaphore_take(T_SEMAPHORE semaphore, int timeout)
+{
+	if (*(int32_t *)semaphore == 0)
+		return E_OS_ERR_BUSY;
+	(*(int32_t *)semaphore)--;
+	return E_OS_OK;
+}
+
+struct msg {
+	uint8_t prio;
+	int seq;
+	uint32_t date;
+};
+
+static int failures;
+
+#define CHECK(cond) do {						     \
+		if (!(cond)) {						     \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+			       # cond);					     \
+			failures++;					     \
+		}							     \
+} while (0)
+
+static struct msg *get(T_QUEUE q)
+{
+	T_QUEUE_MESSAGE m = NULL;
+	OS_ERR_TYPE err;
+
+	queue_get_message(q, &m, OS_NO_WAIT, &err);
+	return err == E_OS_OK ? m : NULL;
+}
+
+/* Messages are dequeued by decreasing priority, in FIFO order within a
+ * priority, and a message sent to the head is dequeued first */
+static void test_ordering(void)
+{
+	static struct msg msgs[64];
+	T_QUEUE q = queue_create(65);
+	struct queue_stats stats;
+	struct msg head = { .prio = 0xff };
+	struct msg *m, *prev = NULL;
+	OS_ERR_TYPE err;
+	int i;
+
+	for (i = 0; i < 64; i++) {
+		msgs[i].prio = rand() % (QUEUE_PRIO_COUNT + 2);
+		msgs[i].seq = i;
+		if (msgs[i].prio == 0) {
+			queue_send_message(q, &msgs[i], &err);
+		} else {
+			queue_send_message_prio(q, &msgs[i], msgs[i].prio, &err);
+			/* Saturated priority */
+			if (msgs[i].prio >= QUEUE_PRIO_COUNT)
+				msgs[i].prio = QUEUE_PRIO_COUNT - 1;
+		}
+		CHECK(err == E_OS_OK);
+		if (i == 32) {
+			queue_send_message_head(q, &head, &err);
+			CHECK(err == E_OS_OK);
+		}
+	}
+
+	queue_get_stats(q, &stats, false);
+	CHECK(stats.depth == 65 && stats.high_watermark == 65);
+
+	CHECK(get(q) == &head);
+	for (i = 0; i < 64; i++) {
+		m = get(q);
+		CHECK(m != NULL);
+		if (!m)
+			break;
+		if (prev)
+			CHECK(m->prio < prev->prio ||
+			      (m->prio == prev->prio && m->seq > prev->seq));
+		prev = m;
+	}
+	CHECK(get(q) == NULL);
+
+	queue_get_stats(q, &stats, true);
+	CHECK(stats.depth == 0);
+	CHECK(stats.count[0] + stats.count[1] + stats.count[2] +
+	      stats.count[3] == 65);
+	queue_get_stats(q, &stats, false);
+	CHECK(stats.high_watermark == 0 && stats.count[3] == 0);
+	queue_delete(q);
+}
+
+/*
+ * A consumer needs one 32kHz tick to process each message. Bulk messages
+ * arrive in bursts keeping a backlog in the queue, and an urgent message is
+ * sent every few ticks. Return the worst latency of urgent messages, with or
+ * without using priorities.
+ */
+static uint32_t simulate(bool use_prio, uint32_t *avg)
+{
+	static struct msg bulk[80];
+	static struct msg urgent[4];
+	T_QUEUE q = queue_create(QUEUE_ELEMENT_POOL_SIZE);
+	uint32_t max = 0, total = 0, count = 0;
+	int next_bulk = 0, next_urgent = 0, pending = 0, t;
+	OS_ERR_TYPE err;
+	struct msg *m;
+
+	uptime_32k = 0;
+	for (t = 0; t < 100000; t++) {
+		uptime_32k++;
+		/* Burst of bulk data every 64 ticks */
+		if (t % 64 == 0) {
+			int i;
+			for (i = 0; i < 60 && pending < 80; i++, pending++) {
+				queue_send_message(q, &bulk[next_bulk], &err);
+				next_bulk = (next_bulk + 1) % 80;
+			}
+		}
+		if (t % 16 == 5 && pending < 80) {
+			struct msg *u = &urgent[next_urgent];
+			next_urgent = (next_urgent + 1) % 4;
+			u->prio = 1;
+			u->date = uptime_32k;
+			if (use_prio)
+				queue_send_message_prio(q, u, 2, &err);
+			else
+				queue_send_message(q, u, &err);
+			pending++;
+		}
+		m = get(q);
+		if (!m)
+			continue;
+		pending--;
+		if (m->prio) {
+			uint32_t latency = uptime_32k - m->date;
+			total += latency;
+			count++;
+			if (latency > max)
+				max = latency;
+			m->prio = 0;
+		}
+	}
+	while (get(q)) ;
+	queue_delete(q);
+	*avg = total / count;
+	return max;
+}
+
+/* Cost of a send/get pair */
+static void bench(void)
+{
+	static struct msg msgs[QUEUE_PRIO_COUNT];
+	T_QUEUE q = queue_create(16);
+	struct timeval t0, t1;
+	OS_ERR_TYPE err;
+	int i;
+
+	gettimeofday(&t0, NULL);
+	for (i = 0; i < 1000000; i++) {
+		queue_send_message_prio(q, &msgs[i % QUEUE_PRIO_COUNT],
+					i % QUEUE_PRIO_COUNT, &err);
+		if (i & 1) {
+			get(q);
+			get(q);
+		}
+	}
+	gettimeofday(&t1, NULL);
+	printf("send + get: %.1f ns\n",
+	       ((t1.tv_sec - t0.tv_sec) * 1e6 + t1.tv_usec - t0.tv_usec) /
+	       1000);
+	queue_delete(q);
+}
+
+int main(void)
+{
+	uint32_t max, avg;
+
+	srand(1);
+	test_ordering();
+	printf("ordering: %s\n", failures ? "FAILED" : "PASSED");
+
+	max = simulate(false, &avg);
+	printf("urgent latency (32k ticks), FIFO:     avg %u max %u\n", avg, max);
+	max = simulate(true, &avg);
+	printf("urgent latency (32k ticks), priority: avg %u max %u\n", avg, max);
+	CHECK(max <= 2);
+
+	bench();
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ *****************************************************************************
+ * Host test of the batched return of messages freed on behalf of another
+ * CPU. The port layer runs as the ARC core; the Quark core is played by the
+ * IPC stubs, which queue the returned lists and release them later with
+ * message_free_list(), as the Quark IPC interrupt does. Batch threshold,
+ * timer, piggybacked lists, shared messages and statistics are checked,
+ * then random traffic is run and every message must be released exactly
+ * once. The number of IPC requests is compared with one per freed message.
+ *
+ * Compile with (from the top directory):
+ * gcc -O2 -fcommon -Wall -Itools/tests/zephyr_stub -Ibsp/include \
+ *     -Iframework/include -Ibsp/include/machine/soc/intel/quark_se/arc \
+ *     -Ibsp/include/machine/soc/intel/quark_se \
+ *     tools/tests/port_remote_free_test.c -o port_remote_free_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONFIG_PORT_IS_MASTER
+#define CONFIG_PORT_MULTI_CPU_SUPPORT
+#define CONFIG_PORT_REMOTE_FREE_BATCH 8
+#define CONFIG_PORT_REMOTE_FREE_DELAY_MS 10
+
+#include "../../bsp/src/infra/port.c"
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, \
+			       __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static int failures;
+
+/*
+ * Stubs of the OS layer
+ */
+
+#define BLOCK_LIVE      0x4c495645
+#define BLOCK_FREED     0x46524545
+
+struct block_hdr {
+	uint32_t magic;
+	uint32_t pad;
+};
+
+static int live_blocks;
+static int double_frees;
+static int bulk_calls;
+
+void *balloc(uint32_t size, OS_ERR_TYPE *err)
+{
+	struct block_hdr *hdr = malloc(sizeof(*hdr) + size);
+
+	hdr->magic = BLOCK_LIVE;
+	live_blocks++;
+	if (err)
+		*err = E_OS_OK;
+	return &hdr[1];
+}
+
+/* Blocks are never reused so that a second release is always detected */
+OS_ERR_TYPE bfree(void *buffer)
+{
+	struct block_hdr *hdr = ((struct block_hdr *)buffer) - 1;
+
+	if (hdr->magic != BLOCK_LIVE) {
+		double_frees++;
+		return E_OS_ERR;
+	}
+	hdr->magic = BLOCK_FREED;
+	live_blocks--;
+	return E_OS_OK;
+}
+
+OS_ERR_TYPE bfree_bulk(void **buffers, int count)
+{
+	int i;
+
+	bulk_calls++;
+	for (i = 0; i < count; i++)
+		bfree(buffers[i]);
+	return E_OS_OK;
+}
+
+void queue_send_message_head(T_QUEUE queue, T_QUEUE_MESSAGE message,
+			     OS_ERR_TYPE *err)
+{
+	*err = E_OS_OK;
+}
+
+void queue_send_message_prio(T_QUEUE queue, T_QUEUE_MESSAGE message,
+			     uint8_t prio, OS_ERR_TYPE *err)
+{
+	*err = E_OS_OK;
+}
+
+void queue_get_message(T_QUEUE queue, T_QUEUE_MESSAGE *message,
+		       int timeout, OS_ERR_TYPE *err)
+{
+	*message = NULL;
+}
+
+static int timer_running;
+
+T_TIMER timer_create(T_ENTRY_POINT callback, void *privData, uint32_t delay,
+		     bool repeat, bool startup, OS_ERR_TYPE *err)
+{
+	return (T_TIMER)callback;
+}
+
+void timer_start(T_TIMER tmr, uint32_t delay, OS_ERR_TYPE *err)
+{
+	CHECK(!timer_running);
+	CHECK(delay == CONFIG_PORT_REMOTE_FREE_DELAY_MS);
+	timer_running = 1;
+	*err = E_OS_OK;
+}
+
+static void timer_fire(void)
+{
+	if (timer_running) {
+		timer_running = 0;
+		remote_free_timeout(NULL);
+	}
+}
+
+void panic(int err)
+{
+	printf("panic %d\n", err);
+	abort();
+}
+
+void log_printk(uint8_t level, const char *module, const char *format, ...)
+{
+}
+
+/*
+ * Quark side of the IPC: requests are queued and handled later
+ */
+
+#define REQUESTS        4096
+
+static struct {
+	int type;
+	struct message *msg;
+} requests[REQUESTS];
+static int req_head, req_tail;
+static int ipc_requests;
+static int free_requests;
+
+static void ipc_post(int type, struct message *msg)
+{
+	CHECK(req_head - req_tail < REQUESTS);
+	requests[req_head % REQUESTS].type = type;
+	requests[req_head % REQUESTS].msg = msg;
+	req_head++;
+	ipc_requests++;
+	if (type != IPC_MSG_TYPE_MESSAGE)
+		free_requests++;
+}
+
+static int stub_send(struct message *msg)
+{
+	ipc_post(IPC_MSG_TYPE_MESSAGE, msg);
+	return E_OS_OK;
+}
+
+static void stub_free(struct message *msg)
+{
+	ipc_post(IPC_MSG_TYPE_FREE, msg);
+}
+
+static void stub_free_list(struct message *list)
+{
+	ipc_post(IPC_MSG_TYPE_FREE_LIST, list);
+}
+
+static int list_length(struct message *list)
+{
+	int n = 0;
+
+	for (; list; list = free_list_next(list))
+		n++;
+	return n;
+}
+
+/* Handle the pending requests on Quark, the messages sent by ARC are
+ * consumed and returned in lists of at most 4 */
+static void quark_run(int max)
+{
+	struct message *list = NULL;
+	int n = 0;
+
+	while (req_tail != req_head && max--) {
+		int type = requests[req_tail % REQUESTS].type;
+		struct message *msg = requests[req_tail % REQUESTS].msg;
+
+		req_tail++;
+		switch (type) {
+		case IPC_MSG_TYPE_MESSAGE:
+			free_list_set_next(msg, list);
+			list = msg;
+			if (++n == 4) {
+				message_free_list(list);
+				list = NULL;
+				n = 0;
+			}
+			break;
+		case IPC_MSG_TYPE_FREE:
+			message_free_local(msg);
+			break;
+		case IPC_MSG_TYPE_FREE_LIST:
+			message_free_list(msg);
+			break;
+		}
+	}
+	if (list)
+		message_free_list(list);
+}
+
+static uint16_t arc_port;
+static uint16_t quark_port;
+
+/* Message sent by Quark to ARC */
+static struct message *quark_msg(void)
+{
+	struct message *msg = message_alloc(sizeof(*msg) + 8, NULL);
+
+	MESSAGE_SRC(msg) = quark_port;
+	MESSAGE_DST(msg) = arc_port;
+	return msg;
+}
+
+/* Shared message sent by Quark to two ARC ports */
+static struct message *quark_shared_msg(void)
+{
+	struct message *msg = message_alloc_shared(sizeof(*msg) + 8, NULL);
+
+	MESSAGE_SRC(msg) = quark_port;
+	MESSAGE_DST(msg) = arc_port;
+	SHARED_HDR(msg)->refs = 2;
+	return msg;
+}
+
+/* Message sent by ARC to Quark */
+static void arc_send(void)
+{
+	struct message *msg = message_alloc(sizeof(*msg) + 8, NULL);
+
+	MESSAGE_SRC(msg) = arc_port;
+	MESSAGE_DST(msg) = quark_port;
+	CHECK(port_send_message(msg) == E_OS_OK);
+}
+
+static void test_policy(void)
+{
+	struct port_remote_free_stats stats;
+	struct message *msgs[8];
+	int i;
+
+	/* A full list is returned at once */
+	for (i = 0; i < 8; i++)
+		msgs[i] = quark_msg();
+	for (i = 0; i < 7; i++)
+		message_free(msgs[i]);
+	CHECK(ipc_requests == 0);
+	CHECK(timer_running);
+	port_get_remote_free_stats(CPU_ID_QUARK, &stats, false);
+	CHECK(stats.pending == 7 && stats.deferred == 7 && stats.lists == 0);
+	message_free(msgs[7]);
+	CHECK(ipc_requests == 1);
+	CHECK(requests[0].type == IPC_MSG_TYPE_FREE_LIST);
+	CHECK(list_length(requests[0].msg) == 8);
+	quark_run(REQUESTS);
+	CHECK(live_blocks == 0);
+	CHECK(bulk_calls == 1);
+
+	/* The timer returns what is left */
+	timer_fire();
+	CHECK(ipc_requests == 1);
+	message_free(quark_msg());
+	message_free(quark_msg());
+	CHECK(timer_running);
+	timer_fire();
+	CHECK(ipc_requests == 2);
+	CHECK(list_length(requests[1].msg) == 2);
+	quark_run(REQUESTS);
+	CHECK(live_blocks == 0);
+
+	/* A message sent to Quark carries the pending list along */
+	message_free(quark_msg());
+	arc_send();
+	CHECK(ipc_requests == 4);
+	CHECK(requests[2].type == IPC_MSG_TYPE_FREE_LIST);
+	CHECK(requests[3].type == IPC_MSG_TYPE_MESSAGE);
+	quark_run(REQUESTS);
+	CHECK(live_blocks == 0);
+
+	/* Shared messages are returned one at a time */
+	msgs[0] = quark_shared_msg();
+	message_free(msgs[0]);
+	message_free(msgs[0]);
+	CHECK(ipc_requests == 6);
+	CHECK(requests[4].type == IPC_MSG_TYPE_FREE);
+	quark_run(REQUESTS);
+	CHECK(live_blocks == 0);
+
+	port_get_remote_free_stats(CPU_ID_QUARK, &stats, true);
+	CHECK(stats.deferred == 11 && stats.lists == 3);
+	CHECK(stats.on_threshold == 1 && stats.on_timer == 1);
+	CHECK(stats.on_send == 1 && stats.pending == 0);
+	port_get_remote_free_stats(CPU_ID_QUARK, &stats, false);
+	CHECK(stats.deferred == 0 && stats.lists == 0);
+	timer_fire();
+}
+
+#define INBOX           64
+#define ITERATIONS      500000
+
+static void test_churn(void)
+{
+	struct port_remote_free_stats stats;
+	struct message *inbox[INBOX];
+	int held = 0;
+	int frees = 0;
+	int i;
+
+	free_requests = 0;
+	srand(1);
+	for (i = 0; i < ITERATIONS; i++) {
+		int op = rand() % 100;
+
+		if (op < 40 && held < INBOX - 1) {
+			if (rand() % 16) {
+				inbox[held++] = quark_msg();
+			} else {
+				/* Delivered to two ports, freed twice */
+				inbox[held] = quark_shared_msg();
+				inbox[held + 1] = inbox[held];
+				held += 2;
+			}
+		} else if (op < 80 && held) {
+			int n = rand() % held;
+
+			message_free(inbox[n]);
+			inbox[n] = inbox[--held];
+			frees++;
+		} else if (op < 85) {
+			arc_send();
+		} else if (op < 98) {
+			quark_run(rand() % 8);
+		} else {
+			timer_fire();
+		}
+		CHECK(req_head - req_tail < REQUESTS);
+	}
+	while (held) {
+		message_free(inbox[--held]);
+		frees++;
+	}
+
+	port_get_remote_free_stats(CPU_ID_QUARK, &stats, false);
+	printf("%d frees: %d IPC requests, %u returned in %u lists "
+	       "(%u full, %u timer, %u along a message), %u pending\n",
+	       frees, free_requests, stats.deferred, stats.lists,
+	       stats.on_threshold, stats.on_timer, stats.on_send,
+	       stats.pending);
+	timer_fire();
+	quark_run(REQUESTS);
+	CHECK(live_blocks == 0);
+	CHECK(double_frees == 0);
+	port_get_remote_free_stats(CPU_ID_QUARK, &stats, false);
+	CHECK(stats.pending == 0);
+}
+
+int main(void)
+{
+	static char queue;
+
+	set_cpu_id(CPU_ID_ARC);
+	arc_port = port_alloc(&queue);
+	quark_port = port_alloc(NULL);
+	port_set_cpu_id(quark_port, CPU_ID_QUARK);
+	set_cpu_message_sender(CPU_ID_QUARK, stub_send);
+	set_cpu_free_handler(CPU_ID_QUARK, stub_free);
+	set_cpu_free_list_handler(CPU_ID_QUARK, stub_free_list);
+
+	test_policy();
+	test_churn();
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ *****************************************************************************
+ * Host unit test and benchmark of the properties storage on a simulated
+ * embedded flash.
+ *
+ * Compile with (from the top directory):
+ * gcc -O2 -Ibsp/include -Iprojects/curie_hello/include \
+ *     tools/tests/properties_storage_test.c -o properties_storage_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Replace the target assert, panic and logging with host versions */
+#define __INC_assert_h__
+#include <assert.h>
+#define __PANIC_H__
+#define __LOG_H
+static void panic(int err)
+{
+	printf("panic(%d)\n", err);
+	abort();
+}
+#define pr_warning(module, format, ...) do {} while (0)
+#define CONFIG_QUARK_SE_PROPERTIES_STORAGE_COMPACT_WATERMARK 512
+
+#include "../../bsp/src/machine/soc/intel/quark_se/quark/properties_storage_soc_flash.c"
+
+/* Simulated embedded flash: writes can only clear bits */
+static uint32_t flash[EMBEDDED_FLASH_NB_BLOCKS * EMBEDDED_FLASH_BLOCK_SIZE / 4];
+static unsigned int nb_reads, nb_writes, nb_erases;
+
+DRIVER_API_RC soc_flash_read(uint32_t address, unsigned int len,
+			     unsigned int *retlen, uint32_t *data)
+{
+	assert((address & 3) == 0 && address + len * 4 <= sizeof(flash));
+	memcpy(data, &flash[address / 4], len * 4);
+	*retlen = len;
+	nb_reads++;
+	return DRV_RC_OK;
+}
+
+DRIVER_API_RC soc_flash_write(uint32_t address, unsigned int len,
+			      unsigned int *retlen, uint32_t *data)
+{
+	unsigned int i;
+
+	assert((address & 3) == 0 && address + len * 4 <= sizeof(flash));
+	for (i = 0; i < len; i++)
+		flash[address / 4 + i] &= data[i];
+	*retlen = len;
+	nb_writes++;
+	return DRV_RC_OK;
+}
+
+DRIVER_API_RC soc_flash_block_erase(unsigned int start_block,
+				    unsigned int block_count)
+{
+	assert(start_block + block_count <= EMBEDDED_FLASH_NB_BLOCKS);
+	memset(&flash[start_block * EMBEDDED_FLASH_BLOCK_SIZE / 4], 0xff,
+	       block_count * EMBEDDED_FLASH_BLOCK_SIZE);
+	nb_erases += block_count;
+	return DRV_RC_OK;
+}
+
+#define NB_KEYS      PROPERTIES_STORAGE_MAX_NB_PROPERTIES
+#define MAX_LEN      48
+#define NB_OPS       200000
+
+/* Reference model of the store content */
+static struct {
+	uint32_t key;
+	uint16_t len;
+	bool persistent;
+	bool present;
+	uint8_t data[MAX_LEN];
+} model[NB_KEYS];
+
+static int failures;
+
+#define CHECK(cond) do {						     \
+		if (!(cond)) {						     \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+			       # cond);					     \
+			failures++;					     \
+		}							     \
+} while (0)
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void check_model(void)
+{
+	int i;
+	uint8_t buf[PROPERTIES_STORAGE_MAX_VALUE_LEN];
+	uint16_t len;
+	bool persistent = false;
+
+	for (i = 0; i < NB_KEYS; i++) {
+		properties_storage_status_t ret = properties_storage_get(
+			model[i].key, buf, sizeof(buf), &len);
+		if (!model[i].present) {
+			CHECK(ret == PROPERTIES_STORAGE_KEY_NOT_FOUND_ERROR);
+			continue;
+		}
+		CHECK(ret == PROPERTIES_STORAGE_SUCCESS);
+		CHECK(len == model[i].len);
+		CHECK(!memcmp(buf, model[i].data, model[i].len));
+		ret = properties_storage_get_info(model[i].key, &len,
+						  &persistent);
+		CHECK(ret == PROPERTIES_STORAGE_SUCCESS);
+		CHECK(persistent == model[i].persistent);
+	}
+}
+
+/* Random set/get/delete sequence checked against the model, with periodic
+ * reboots rebuilding the RAM index from flash. With background set, the
+ * compaction runs between operations, deletes are served between its steps
+ * and it is often interrupted by a reboot */
+static void test_random(bool background)
+{
+	int i, op;
+
+	properties_storage_format_all();
+	/* Sequential keys collide in the low bits, spread ones in the high
+	 * bits: mix both */
+	for (i = 0; i < NB_KEYS; i++) {
+		model[i].key = i & 1 ? 0x100 + i : (uint32_t)i << 24;
+		model[i].present = false;
+	}
+
+	for (op = 0; op < 20000; op++) {
+		i = rand() % NB_KEYS;
+		switch (rand() % 4) {
+		case 0:
+			if (model[i].present) {
+				CHECK(properties_storage_delete(model[i].key) ==
+				      PROPERTIES_STORAGE_SUCCESS);
+				model[i].present = false;
+			} else {
+				CHECK(properties_storage_delete(model[i].key) ==
+				      PROPERTIES_STORAGE_KEY_NOT_FOUND_ERROR);
+			}
+			break;
+		case 1:
+		case 2: {
+			/* A key keeps its partition while it exists */
+			bool persistent = model[i].present ?
+					  model[i].persistent : rand() & 1;
+			uint16_t len = rand() % MAX_LEN;
+			int j;
+
+			for (j = 0; j < len; j++)
+				model[i].data[j] = rand();
+			CHECK(properties_storage_set(model[i].key,
+						     model[i].data, len,
+						     persistent) ==
+			      PROPERTIES_STORAGE_SUCCESS);
+			model[i].len = len;
+			model[i].persistent = persistent;
+			model[i].present = true;
+			break;
+		}
+		default:
+			check_model();
+			break;
+		}
+		if (background) {
+			int steps = rand() % 8;
+			while (steps-- && properties_storage_compact_step()) {
+				int j = rand() % NB_KEYS;
+				if (rand() % 4 || !model[j].present)
+					continue;
+				CHECK(properties_storage_delete(model[j].key) ==
+				      PROPERTIES_STORAGE_SUCCESS);
+				model[j].present = false;
+			}
+		}
+		if (op % 1000 == 999 || (background && rand() % 32 == 0)) {
+			properties_storage_init();
+			check_model();
+		}
+	}
+}
+
+/* Index full: the next new key is refused, existing keys can be updated */
+static void test_full(void)
+{
+	uint8_t v = 0x5a;
+	uint32_t k;
+
+	properties_storage_format_all();
+	for (k = 0; k < NB_KEYS; k++)
+		CHECK(properties_storage_set(k * 7919, &v, 1, false) ==
+		      PROPERTIES_STORAGE_SUCCESS);
+	CHECK(properties_storage_set(0xdead, &v, 1, false) ==
+	      PROPERTIES_STORAGE_BOUNDS_ERROR);
+	CHECK(properties_storage_set(7919, &v, 1, false) ==
+	      PROPERTIES_STORAGE_SUCCESS);
+	CHECK(properties_storage_delete(7919) == PROPERTIES_STORAGE_SUCCESS);
+	CHECK(properties_storage_set(0xdead, &v, 1, false) ==
+	      PROPERTIES_STORAGE_SUCCESS);
+}
+
+/* A store nearly full of live entries: the background compaction must stop
+ * once the obsolete entries are reclaimed instead of recycling the blocks */
+static void test_compact_full(void)
+{
+	uint8_t buf[116] = { 0 };
+	unsigned int steps = 0, erases;
+	uint16_t len;
+	bool persistent;
+	uint32_t k;
+
+	properties_storage_format_all();
+	/* The first value of key 0 is obsolete */
+	CHECK(properties_storage_set(0, buf, sizeof(buf), false) ==
+	      PROPERTIES_STORAGE_SUCCESS);
+	for (k = 0; k < 29; k++)
+		CHECK(properties_storage_set(k, buf, sizeof(buf), false) ==
+		      PROPERTIES_STORAGE_SUCCESS);
+
+	erases = nb_erases;
+	while (steps < 1000 && properties_storage_compact_step())
+		steps++;
+	CHECK(steps < 1000);
+	CHECK(nb_erases - erases <= FACTORY_RESET_NON_PERSISTENT_NB_BLOCKS);
+	CHECK(!properties_storage_compact_step());
+	for (k = 0; k < 29; k++)
+		CHECK(properties_storage_get_info(k, &len, &persistent) ==
+		      PROPERTIES_STORAGE_SUCCESS);
+}
+
+/* Statistics must account for every byte of the partitions */
+static void test_stats(void)
+{
+	struct properties_storage_stats stats;
+	struct properties_storage_block_stats blocks[8];
+	int p, i;
+
+	for (p = 0; p < 2; p++) {
+		uint32_t live = 0, total = 0;
+		properties_storage_get_stats(p, &stats, blocks, 8);
+		for (i = 0; i < stats.nb_blocks; i++) {
+			live += blocks[i].live_bytes;
+			total += blocks[i].live_bytes + blocks[i].obsolete_bytes +
+				 blocks[i].free_bytes;
+		}
+		CHECK(total <= stats.nb_blocks *
+		      (EMBEDDED_FLASH_BLOCK_SIZE - BLOCK_HEADER_SIZE));
+		for (i = 0; i < NB_KEYS; i++)
+			if (model[i].present && model[i].persistent == p)
+				live -= NEXT_MULTIPLE_OF_4(PROPERTY_HEADER_SIZE +
+							   model[i].len);
+		CHECK(live == 0);
+	}
+}
+
+/* Worst case and average cost of set() in flash operations, with and without
+ * the background compaction */
+static void bench_set_latency(bool background)
+{
+	uint8_t buf[64] = { 0 };
+	struct properties_storage_stats start, stats;
+	struct properties_storage_block_stats blocks[8];
+	unsigned int max_erases = 0, max_writes = 0, w, e;
+	int i;
+
+	properties_storage_format_all();
+	properties_storage_get_stats(false, &start, blocks, 0);
+	for (i = 0; i < NB_OPS / 10; i++) {
+		w = nb_writes;
+		e = nb_erases;
+		properties_storage_set(i % 16, buf, 8 + rand() % 56, false);
+		if (nb_erases - e > max_erases)
+			max_erases = nb_erases - e;
+		if (nb_writes - w > max_writes)
+			max_writes = nb_writes - w;
+		if (background)
+			while (properties_storage_compact_step()) ;
+	}
+	properties_storage_get_stats(false, &stats, blocks, 8);
+	printf("set %s: worst %u writes %u erases, %u sync compactions, "
+	       "write amplification %.2f\n",
+	       background ? "with compaction job" : "without compaction job",
+	       max_writes, max_erases,
+	       stats.sync_compactions - start.sync_compactions,
+	       (double)(stats.user_bytes - start.user_bytes +
+			stats.copied_bytes - start.copied_bytes) /
+	       (stats.user_bytes - start.user_bytes));
+	for (i = 0; i < stats.nb_blocks; i++)
+		printf("  block %d: seq %u live %u obsolete %u free %u "
+		       "erases %u\n", i, blocks[i].seq, blocks[i].live_bytes,
+		       blocks[i].obsolete_bytes, blocks[i].free_bytes,
+		       blocks[i].erase_count);
+}
+
+static void bench(void)
+{
+	uint8_t buf[16] = { 0 };
+	uint16_t len;
+	int i;
+	double t;
+
+	properties_storage_format_all();
+	for (i = 0; i < NB_KEYS; i++)
+		properties_storage_set(i, buf, sizeof(buf), false);
+
+	nb_reads = 0;
+	t = now();
+	for (i = 0; i < NB_OPS; i++)
+		properties_storage_get(i % NB_KEYS, buf, sizeof(buf), &len);
+	t = now() - t;
+	printf("get:    %6.1f ns/op, %.2f flash reads/op\n",
+	       t * 1e9 / NB_OPS, (double)nb_reads / NB_OPS);
+
+	nb_reads = 0;
+	t = now();
+	for (i = 0; i < NB_OPS; i++)
+		properties_storage_get(NB_KEYS + i, buf, sizeof(buf), &len);
+	t = now() - t;
+	printf("miss:   %6.1f ns/op\n", t * 1e9 / NB_OPS);
+
+	nb_reads = nb_writes = nb_erases = 0;
+	t = now();
+	for (i = 0; i < NB_OPS; i++)
+		properties_storage_set(i % NB_KEYS, buf, sizeof(buf), false);
+	t = now() - t;
+	printf("set:    %6.1f ns/op, %.2f reads/op, %.2f writes/op, "
+	       "%.4f erases/op\n", t * 1e9 / NB_OPS,
+	       (double)nb_reads / NB_OPS, (double)nb_writes / NB_OPS,
+	       (double)nb_erases / NB_OPS);
+
+	t = now();
+	for (i = 0; i < 1000; i++)
+		properties_storage_init();
+	t = now() - t;
+	printf("init:   %6.1f us\n", t * 1e6 / 1000);
+}
+
+int main(void)
+{
+	memset(flash, 0xff, sizeof(flash));
+	srand(1);
+	properties_storage_init();
+
+	test_random(false);
+	test_stats();
+	test_random(true);
+	test_stats();
+	test_full();
+	test_compact_full();
+	printf("%d properties, %d buckets: %s\n", NB_KEYS, PROPERTY_INDEX_SIZE,
+	       failures ? "FAILED" : "PASSED");
+	if (failures)
+		return 1;
+
+	bench();
+	bench_set_latency(false);
+	bench_set_latency(true);
+	return 0;
+}
@@ -0,0 +1,488 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ *****************************************************************************
+ * Host test of the batched subscriptions of the sensor service, built for
+ * the host sensor service platform. The cfw, port and timer layers are
+ * replaced by stubs delivering each event synchronously to fake clients.
+ * Shared events, batch sizes, the latency timer, statistics and memory
+ * release are checked, then the number of messages and the time to deliver
+ * 100 Hz samples to 4 clients are compared with one event per sample and
+ * per client.
+ *
+ * Compile with (from the top directory):
+ * gcc -O2 -fcommon -DSENSOR_SERVICE=HOST_SENSOR_SERVICE -Wall \
+ *     -Itools/tests/zephyr_stub -Ibsp/include -Iframework/include \
+ *     -Ibsp/include/machine/soc/intel/quark_se/arc \
+ *     -Iframework/include/sensors/sensor_core/ipc \
+ *     -Iframework/src/services/sensor_service bsp/src/util/list.c \
+ *     framework/src/services/sensor_service/sensor_svc_list.c \
+ *     framework/src/services/sensor_service/sensor_svc_batch.c \
+ *     tools/tests/sensor_svc_batch_test.c -o sensor_svc_batch_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <sys/time.h>
+
+#include "sensor_svc.h"
+#include "sensor_svc_list.h"
+#include "sensor_svc_batch.h"
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, \
+			       __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static int failures;
+
+/*
+ * Stubs of the OS, port and cfw layers
+ */
+
+uint16_t ss_svc_port_id = 1;
+
+static uint32_t now_ms;
+static int live_blocks;
+static int messages;            /* Messages allocated */
+static int timer_created;
+static uint32_t timer_delay;
+
+/* Allocation header of the messages, holding the shared references */
+struct msg_hdr {
+	int refs;
+	int pad;
+};
+
+void *balloc(uint32_t size, OS_ERR_TYPE *err)
+{
+	live_blocks++;
+	return malloc(size);
+}
+
+OS_ERR_TYPE bfree(void *buffer)
+{
+	live_blocks--;
+	free(buffer);
+	return E_OS_OK;
+}
+
+void log_printk(uint8_t level, const char *module, const char *format, ...)
+{
+}
+
+uint32_t get_uptime_ms(void)
+{
+	return now_ms;
+}
+
+static T_ENTRY_POINT timer_cb;
+
+T_TIMER timer_create(T_ENTRY_POINT callback, void *privData, uint32_t delay,
+		     bool repeat, bool startup, OS_ERR_TYPE *err)
+{
+	timer_created++;
+	timer_cb = callback;
+	return (T_TIMER)&timer_cb;
+}
+
+void timer_start(T_TIMER tmr, uint32_t delay, OS_ERR_TYPE *err)
+{
+	timer_delay = delay;
+}
+
+static struct message *msg_alloc(int size)
+{
+	struct msg_hdr *hdr = balloc(sizeof(*hdr) + size, NULL);
+
+	messages++;
+	hdr->refs = 1;
+	memset(&hdr[1], 0, size);
+	return (struct message *)&hdr[1];
+}
+
+static void msg_release(struct message *msg)
+{
+	struct msg_hdr *hdr = ((struct msg_hdr *)msg) - 1;
+
+	if (--hdr->refs == 0)
+		bfree(hdr);
+}
+
+struct message *message_alloc_shared(int size, OS_ERR_TYPE *err)
+{
+	struct message *msg = msg_alloc(size);
+
+	msg->flags.f_is_shared = 1;
+	return msg;
+}
+
+struct cfw_message *cfw_alloc_message(int size)
+{
+	return (struct cfw_message *)msg_alloc(size);
+}
+
+void cfw_msg_free(struct cfw_message *msg)
+{
+	msg_release(&msg->m);
+}
+
+struct cfw_message *cfw_clone_message(struct cfw_message *msg)
+{
+	struct cfw_message *ret = (struct cfw_message *)
+				  msg_alloc(CFW_MESSAGE_LEN(msg));
+
+	memcpy(ret, msg, CFW_MESSAGE_LEN(msg));
+	ret->m.flags.f_is_shared = 0;
+	return ret;
+}
+
+/*
+ * Fake clients, receiving the events synchronously
+ */
+
+#define CLIENTS 4
+
+struct client {
+	cfw_service_conn_t conn;
+	conn_handle_t handle;
+	client_arbit_info_list_t *l;
+	int events;
+	int samples;
+	int batch_events;
+	int last_nr;            /* Samples of the last batch */
+	uint32_t next_ts;       /* Timestamp of the next expected sample */
+	void *last_conn;
+	void *last_priv;
+};
+
+static struct client clients[CLIENTS];
+static int flush_reqs;
+
+static void deliver(struct cfw_message *msg, uint16_t port)
+{
+	if (port == ss_svc_port_id) {
+		CHECK(CFW_MESSAGE_ID(msg) == MSG_ID_SS_BATCH_FLUSH_REQ);
+		flush_reqs++;
+		cfw_msg_free(msg);
+		return;
+	}
+	CHECK(port >= 10 && port < 10 + CLIENTS);
+	struct client *c = &clients[port - 10];
+
+	c->events++;
+	c->last_conn = msg->conn;
+	c->last_priv = msg->priv;
+	if (CFW_MESSAGE_ID(msg) == MSG_ID_SENSOR_SERVICE_SUBSCRIBE_BATCH_EVT) {
+		sensor_service_subscribe_batch_event_t *p_evt =
+			(sensor_service_subscribe_batch_event_t *)msg;
+		sensor_service_batch_sample_t *s = p_evt->samples;
+		uint16_t len = 0;
+
+		CHECK(CFW_MESSAGE_LEN(msg) ==
+		      sizeof(*p_evt) + p_evt->data_length);
+		for (int i = 0; i < p_evt->sample_nr; i++) {
+			CHECK(s->timestamp == c->next_ts);
+			CHECK(s->data[0] == (uint8_t)s->timestamp);
+			c->next_ts = s->timestamp + 10;
+			len += SS_BATCH_SAMPLE_SIZE(s->data_length);
+			s = SS_BATCH_NEXT_SAMPLE(s);
+		}
+		CHECK(len == p_evt->data_length);
+		c->samples += p_evt->sample_nr;
+		c->last_nr = p_evt->sample_nr;
+		c->batch_events++;
+	} else {
+		c->samples++;
+	}
+	cfw_msg_free(msg);
+}
+
+int _cfw_send_message(struct cfw_message *msg)
+{
+	deliver(msg, CFW_MESSAGE_DST(msg));
+	return 0;
+}
+
+int port_send_shared_message(struct message *msg, uint16_t dst_port_id)
+{
+	struct msg_hdr *hdr = ((struct msg_hdr *)msg) - 1;
+
+	CHECK(msg->flags.f_is_shared);
+	/* The reference itself is a message */
+	messages++;
+	hdr->refs++;
+	deliver((struct cfw_message *)msg, dst_port_id);
+	return E_OS_OK;
+}
+
+#define SENSOR GET_SENSOR_HANDLE(SENSOR_ACCELEROMETER, 0)
+
+static ss_sensor_dev_list_t *setup(void)
+{
+	ss_sensor_dev_list_t *p_list =
+		ss_sensor_list_add(SENSOR_ACCELEROMETER, 0);
+
+	memset(clients, 0, sizeof(clients));
+	for (int i = 0; i < CLIENTS; i++) {
+		struct client *c = &clients[i];
+
+		c->handle.client_port = 10 + i;
+		c->conn.server_handle = &c->handle;
+		c->l = ss_arbit_info_list_add(p_list, &c->conn, c);
+	}
+	return p_list;
+}
+
+static void subscribe(ss_sensor_dev_list_t *p_list, int i, uint8_t count,
+		      uint16_t latency)
+{
+	client_arbit_info_list_t *l = clients[i].l;
+
+	ss_batch_detach(l);
+	l->arbit_info.conn_status = SUBSCRIBE_EVENT;
+	l->arbit_info.subscribe_data_param.batch_count = count;
+	l->arbit_info.subscribe_data_param.batch_latency = latency;
+	memset(&l->stats, 0, sizeof(l->stats));
+	if (count)
+		CHECK(ss_batch_attach(p_list, l) == SS_STATUS_SUCCESS);
+}
+
+/* One sample of `len` bytes, as received from the sensor core */
+static void feed(uint8_t len)
+{
+	uint8_t data[128];
+
+	memset(data, (uint8_t)now_ms, len);
+	ss_batch_add_sample(SENSOR, 0, now_ms, data, len);
+	now_ms += 10;
+}
+
+static void test_shared(void)
+{
+	ss_sensor_dev_list_t *p_list = setup();
+	int before;
+
+	now_ms = 1000;
+	for (int i = 0; i < CLIENTS; i++)
+		clients[i].next_ts = now_ms;
+	subscribe(p_list, 0, 10, 500);
+	subscribe(p_list, 1, 10, 500);
+	subscribe(p_list, 2, 4, 500);
+	subscribe(p_list, 3, 10, 500);
+	/* Identical parameters share one batch */
+	CHECK(clients[0].l->batch == clients[1].l->batch);
+	CHECK(clients[0].l->batch == clients[3].l->batch);
+	CHECK(clients[0].l->batch != clients[2].l->batch);
+	/* Client 1 shares the event of client 0, client 3 gets a copy */
+	clients[1].l->priv_from_client = &clients[0];
+
+	before = messages;
+	for (int i = 0; i < 40; i++)
+		feed(6);
+	CHECK(clients[0].events == 4 && clients[0].samples == 40);
+	CHECK(clients[1].events == 4 && clients[1].samples == 40);
+	CHECK(clients[2].events == 10 && clients[2].samples == 40);
+	CHECK(clients[3].events == 4 && clients[3].samples == 40);
+	/* 4 shared events + 8 references + 4 copies, and 10 plain events */
+	CHECK(messages - before == 4 + 8 + 4 + 10);
+	/* Shared events carry no connection, single client ones do */
+	CHECK(clients[0].last_conn == NULL);
+	CHECK(clients[0].last_priv == &clients[0]);
+	CHECK(clients[1].last_priv == &clients[0]);
+	CHECK(clients[3].last_conn == &clients[3].conn);
+	CHECK(clients[3].last_priv == &clients[3]);
+	CHECK(clients[2].last_conn == &clients[2].conn);
+	CHECK(clients[2].last_priv == &clients[2]);
+
+	CHECK(clients[0].l->stats.events == 4);
+	CHECK(clients[0].l->stats.samples == 40);
+	CHECK(clients[0].l->stats.latency_max == 90);
+	CHECK(clients[0].l->stats.latency_sum == 4 * 90);
+	CHECK(clients[2].l->stats.latency_max == 30);
+	CHECK(clients[0].l->stats.start_ms == 1090);
+
+	for (int i = 0; i < CLIENTS; i++)
+		ss_batch_detach(clients[i].l);
+	ss_sensor_list_delete(SENSOR);
+	CHECK(live_blocks == 0);
+}
+
+static void test_latency(void)
+{
+	ss_sensor_dev_list_t *p_list = setup();
+	ss_subscription_stats_t stats;
+
+	now_ms = 5000;
+	clients[0].next_ts = now_ms;
+	clients[1].next_ts = now_ms;
+	subscribe(p_list, 0, 50, 100);
+	subscribe(p_list, 1, 50, 35);
+
+	feed(6);
+	CHECK(timer_created == 1 && timer_delay == 35);
+	feed(6);
+	feed(6);
+	/* The timer asks the service to send the late batches */
+	timer_cb(NULL);
+	CHECK(flush_reqs == 1);
+	now_ms = 5040;
+	ss_batch_flush_expired();
+	CHECK(clients[0].events == 0);
+	CHECK(clients[1].events == 1 && clients[1].samples == 3);
+	CHECK(timer_delay == 60);
+	now_ms = 5100;
+	ss_batch_flush_expired();
+	CHECK(clients[0].events == 1 && clients[0].samples == 3);
+
+	CHECK(ss_get_subscription_stats(SENSOR, &clients[1].conn, &stats) ==
+	      SS_STATUS_SUCCESS);
+	CHECK(stats.events == 1 && stats.latency_max == 40);
+	CHECK(ss_get_subscription_stats(SENSOR, NULL, &stats) ==
+	      SS_STATUS_ERROR);
+
+	/* A change of data type closes the pending batch */
+	clients[0].next_ts = now_ms;
+	clients[1].next_ts = now_ms;
+	feed(6);
+	ss_batch_add_sample(SENSOR, 1, now_ms, "x", 1);
+	CHECK(clients[0].events == 2 && clients[0].samples == 4);
+	CHECK(clients[1].events == 2 && clients[1].samples == 4);
+
+	/* Pending samples are dropped with the last client */
+	for (int i = 0; i < CLIENTS; i++)
+		ss_batch_detach(clients[i].l);
+	ss_sensor_list_delete(SENSOR);
+	CHECK(live_blocks == 0);
+}
+
+static void test_capacity(void)
+{
+	ss_sensor_dev_list_t *p_list = setup();
+
+	now_ms = 0;
+	clients[0].next_ts = now_ms;
+	subscribe(p_list, 0, 100, 0);
+	/* 108 bytes per sample, 4 fit in SS_BATCH_MAX_SIZE */
+	for (int i = 0; i < 8; i++)
+		feed(100);
+	CHECK(clients[0].events == 2 && clients[0].samples == 8);
+	CHECK(clients[0].last_nr == 4);
+	ss_sensor_list_delete(SENSOR);
+	CHECK(live_blocks == 0);
+}
+
+static double elapsed_us(struct timeval *t0)
+{
+	struct timeval t1;
+
+	gettimeofday(&t1, NULL);
+	return (t1.tv_sec - t0->tv_sec) * 1e6 + (t1.tv_usec - t0->tv_usec);
+}
+
+/* One event per sample and per client, as before batching */
+static void feed_single(uint8_t len)
+{
+	uint8_t data[128];
+
+	memset(data, (uint8_t)now_ms, len);
+	for (int i = 0; i < CLIENTS; i++) {
+		sensor_service_subscribe_data_event_t *p_msg =
+			(sensor_service_subscribe_data_event_t *)
+			cfw_alloc_message(sizeof(*p_msg) + len);
+
+		p_msg->handle = SENSOR;
+		CFW_MESSAGE_ID(&p_msg->head) =
+			MSG_ID_SENSOR_SERVICE_SUBSCRIBE_DATA_EVT;
+		CFW_MESSAGE_DST(&p_msg->head) = 10 + i;
+		p_msg->sensor_data_header.data_length = len;
+		p_msg->sensor_data_header.timestamp = now_ms;
+		memcpy(p_msg->sensor_data_header.data, data, len);
+		cfw_send_message(p_msg);
+	}
+	now_ms += 10;
+}
+
+static void bench(uint8_t count)
+{
+	ss_sensor_dev_list_t *p_list = setup();
+	const int samples = 200000;
+	double us_batch, us_single;
+	int msg_batch, msg_single;
+	struct timeval t0;
+
+	now_ms = 0;
+	for (int i = 0; i < CLIENTS; i++) {
+		clients[i].next_ts = now_ms;
+		subscribe(p_list, i, count, 1000);
+		/* Same private data, the clients share the events */
+		clients[i].l->priv_from_client = NULL;
+	}
+	messages = 0;
+	gettimeofday(&t0, NULL);
+	for (int i = 0; i < samples; i++)
+		feed(6);
+	us_batch = elapsed_us(&t0);
+	msg_batch = messages;
+
+	messages = 0;
+	gettimeofday(&t0, NULL);
+	for (int i = 0; i < samples; i++)
+		feed_single(6);
+	us_single = elapsed_us(&t0);
+	msg_single = messages;
+
+	printf("batch %2d, %d clients: %.1f messages, %.0f ns per sample; "
+	       "single events: %.1f messages, %.0f ns\n",
+	       count, CLIENTS, (double)msg_batch / samples,
+	       us_batch * 1e3 / samples, (double)msg_single / samples,
+	       us_single * 1e3 / samples);
+	ss_sensor_list_delete(SENSOR);
+	CHECK(live_blocks == 0);
+}
+
+int main(void)
+{
+	test_shared();
+	test_latency();
+	test_capacity();
+	printf("sensor_svc_batch: %s\n", failures ? "FAILED" : "PASSED");
+
+	bench(10);
+	bench(25);
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
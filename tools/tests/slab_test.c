@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ *****************************************************************************
+ * Host test of the slab allocator: allocation and release order, invalid
+ * releases, statistics and sample block references are checked, and
+ * alloc/free pairs are timed against a bit by bit scan of the free block
+ * mask as the sensor core buffer pool used to do.
+ *
+ * Compile with (from the top directory):
+ * gcc -O2 -Itools/tests/zephyr_stub -Ibsp/include bsp/src/util/slab.c \
+ *     tools/tests/slab_test.c -o slab_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "util/slab.h"
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, \
+			       __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static int failures;
+
+#define BLOCK_SIZE      16
+#define BLOCKS          100
+
+static uint8_t buf[BLOCK_SIZE * SLAB_MAX_BLOCKS] __attribute__((aligned(4)));
+static uint32_t map[SLAB_MAP_WORDS(SLAB_MAX_BLOCKS)];
+static struct slab slab;
+
+static void test_init(void)
+{
+	CHECK(slab_init(&slab, "t", buf + 1, BLOCK_SIZE, BLOCKS, map) == -1);
+	CHECK(slab_init(&slab, "t", buf, 0, BLOCKS, map) == -1);
+	CHECK(slab_init(&slab, "t", buf, 6, BLOCKS, map) == -1);
+	CHECK(slab_init(&slab, "t", buf, BLOCK_SIZE, 0, map) == -1);
+	CHECK(slab_init(&slab, "t", buf, BLOCK_SIZE, SLAB_MAX_BLOCKS + 1,
+			map) == -1);
+	CHECK(slab_init(&slab, "t", buf, BLOCK_SIZE, BLOCKS, map) == 0);
+}
+
+static void test_alloc_free(void)
+{
+	uint8_t *block[BLOCKS];
+	struct slab_stats stats;
+	int i;
+
+	slab_init(&slab, "t", buf, BLOCK_SIZE, BLOCKS, map);
+
+	/* Blocks are handed out lowest first, until the slab is full */
+	for (i = 0; i < BLOCKS; i++) {
+		block[i] = slab_alloc(&slab);
+		CHECK(block[i] == buf + i * BLOCK_SIZE);
+	}
+	CHECK(slab_alloc(&slab) == NULL);
+
+	/* The lowest released block is reused first */
+	CHECK(slab_free(&slab, block[70]) == 0);
+	CHECK(slab_free(&slab, block[33]) == 0);
+	CHECK(slab_free(&slab, block[99]) == 0);
+	CHECK(slab_alloc(&slab) == block[33]);
+	CHECK(slab_alloc(&slab) == block[70]);
+	CHECK(slab_alloc(&slab) == block[99]);
+
+	/* Invalid releases leave the slab untouched */
+	CHECK(slab_free(&slab, block[5] + 4) == -1);
+	CHECK(slab_free(&slab, buf + BLOCKS * BLOCK_SIZE) == -1);
+	CHECK(slab_free(&slab, NULL) == -1);
+	CHECK(slab_free(&slab, block[5]) == 0);
+	CHECK(slab_free(&slab, block[5]) == -1);
+
+	slab_get_stats(&slab, &stats);
+	CHECK(stats.block_size == BLOCK_SIZE && stats.count == BLOCKS);
+	CHECK(stats.used == BLOCKS - 1 && stats.max_used == BLOCKS);
+	CHECK(stats.allocs == BLOCKS + 3 && stats.fails == 1);
+
+	for (i = 0; i < BLOCKS; i++)
+		if (i != 5)
+			CHECK(slab_free(&slab, block[i]) == 0);
+	slab_get_stats(&slab, &stats);
+	CHECK(stats.used == 0);
+
+	CHECK(slab_contains(&slab, buf));
+	CHECK(slab_contains(&slab, buf + BLOCKS * BLOCK_SIZE - 1));
+	CHECK(!slab_contains(&slab, buf + BLOCKS * BLOCK_SIZE));
+}
+
+/* Random alloc/free sequence checked against a reference state */
+static void test_random(void)
+{
+	static bool used[SLAB_MAX_BLOCKS];
+	int count = SLAB_MAX_BLOCKS, n = 0;
+
+	memset(used, 0, sizeof(used));
+	slab_init(&slab, "t", buf, BLOCK_SIZE, count, map);
+	srand(1);
+	for (int step = 0; step < 200000; step++) {
+		if (rand() % 3 != 0) {
+			uint8_t *b = slab_alloc(&slab);
+			int lowest = 0;
+
+			while (lowest < count && used[lowest])
+				lowest++;
+			if (lowest == count) {
+				CHECK(b == NULL);
+				continue;
+			}
+			CHECK(b == buf + lowest * BLOCK_SIZE);
+			used[lowest] = true;
+			n++;
+		} else if (n) {
+			int i = rand() % count;
+
+			while (!used[i])
+				i = (i + 1) % count;
+			CHECK(slab_free(&slab, buf + i * BLOCK_SIZE) == 0);
+			used[i] = false;
+			n--;
+		}
+	}
+}
+
+static void test_sample_block(void)
+{
+	struct sample_block *sb, *other;
+	struct slab_stats stats;
+
+	slab_init(&slab, "t", buf, SAMPLE_BLOCK_SIZE(24), 2, map);
+	sb = sample_block_alloc(&slab);
+	CHECK(sb != NULL && sb->refs == 1 && sb->len == 0);
+	CHECK(sample_block_capacity(sb) >= 24);
+	CHECK(((uintptr_t)sb->data & 3) == 0);
+
+	/* Shared by two consumers, released with the last reference */
+	CHECK(sample_block_get(sb) == sb && sb->refs == 2);
+	other = sample_block_alloc(&slab);
+	CHECK(other != NULL && other != sb);
+	CHECK(sample_block_alloc(&slab) == NULL);
+	sample_block_put(sb);
+	slab_get_stats(&slab, &stats);
+	CHECK(stats.used == 2);
+	sample_block_put(sb);
+	slab_get_stats(&slab, &stats);
+	CHECK(stats.used == 1);
+	CHECK(sample_block_alloc(&slab) == sb);
+}
+
+/* Bit by bit scan of a free block mask, as the sensor core pool did */
+static volatile uint32_t scan_mask;
+
+static void *scan_alloc(int count)
+{
+	for (int i = 0; i < count; i++) {
+		if ((scan_mask & (1U << i)) == 0) {
+			scan_mask |= 1U << i;
+			return buf + BLOCK_SIZE * i;
+		}
+	}
+	return NULL;
+}
+
+static void scan_free(void *p, int count)
+{
+	for (int i = 0; i < count; i++) {
+		if (p == buf + BLOCK_SIZE * i) {
+			scan_mask &= ~(1U << i);
+			return;
+		}
+	}
+}
+
+static double elapsed_us(struct timeval *t0)
+{
+	struct timeval t1;
+
+	gettimeofday(&t1, NULL);
+	return (t1.tv_sec - t0->tv_sec) * 1e6 + t1.tv_usec - t0->tv_usec;
+}
+
+/* Alloc/free pairs with all blocks but the last one taken */
+static void bench(int count)
+{
+	int loops = 2000000;
+	struct timeval t0;
+	void *p;
+	double us_slab, us_scan;
+
+	slab_init(&slab, "t", buf, BLOCK_SIZE, count, map);
+	for (int i = 0; i < count - 1; i++)
+		slab_alloc(&slab);
+	gettimeofday(&t0, NULL);
+	for (int i = 0; i < loops; i++) {
+		p = slab_alloc(&slab);
+		slab_free(&slab, p);
+	}
+	us_slab = elapsed_us(&t0);
+
+	scan_mask = (1U << (count - 1)) - 1;
+	gettimeofday(&t0, NULL);
+	for (int i = 0; i < loops; i++) {
+		p = scan_alloc(count);
+		scan_free(p, count);
+	}
+	us_scan = elapsed_us(&t0);
+
+	printf("%2d blocks: slab %.1f ns, bit scan %.1f ns per alloc/free\n",
+	       count, us_slab * 1e3 / loops, us_scan * 1e3 / loops);
+}
+
+int main(void)
+{
+	test_init();
+	test_alloc_free();
+	test_random();
+	test_sample_block();
+	printf("slab: %s\n", failures ? "FAILED" : "PASSED");
+
+	bench(12);
+	bench(32);
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,585 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+ *****************************************************************************
+ * Host unit test and benchmark of the SPI NOR flash driver on a simulated
+ * MX25U1635E and W25Q16DV.
+ *
+ * The SBA bus, the OS services and the flash are simulated with a virtual
+ * clock: the throughput reported is the one of the command sequences issued
+ * by the driver with the bus timings below, not the one of the host.
+ *
+ * The chip drivers are built apart, their headers defining the same
+ * macros with different values.
+ *
+ * Compile with (from the top directory):
+ * gcc -O2 -fcommon -Wall -Wno-address-of-packed-member \
+ *     -DCONFIG_SPI_FLASH_MX25U1635E -Itools/tests/zephyr_stub -Ibsp/include \
+ *     -Iframework/include -Ibsp/include/machine/soc/intel/quark_se/arc \
+ *     -Ibsp/include/machine/soc/intel/quark_se \
+ *     tools/tests/spi_flash_sim_test.c bsp/src/drivers/mtd/spi_flash_mx25.c \
+ *     bsp/src/drivers/mtd/spi_flash_w25qxxdv.c -o spi_flash_sim_test
+ *
+ * -Wno-address-of-packed-member: struct td_device is packed, which only
+ * matters on a 64-bit host.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../bsp/src/drivers/mtd/spi_flash.c"
+#include "drivers/spi_flash/spi_flash_mx25.h"
+#include "drivers/spi_flash/spi_flash_w25qxxdv.h"
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, \
+			       __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static int failures;
+
+/* Bus timings: 8MHz SPI clock, cost of a transfer and of a bus session
+ * (submission, completion interrupt and task wake up) */
+#define NS_PER_BYTE     1000
+#define NS_PER_SEGMENT  4000
+#define NS_PER_SESSION  25000
+
+#define SIM_FLASH_SIZE  0x200000
+
+/* Simulated flash */
+struct sim_chip {
+	const char *name;
+	const struct spi_flash_info *info;
+	uint32_t ns_page_program;
+	uint32_t ns_sector_erase;
+};
+
+static struct {
+	const struct sim_chip *chip;
+	uint8_t mem[SIM_FLASH_SIZE];
+	bool deep_powerdown;
+	bool wel;
+	uint64_t busy_until;
+	uint8_t secr;
+	int fail_program_at;    /* Program operation that fails, -1 if none */
+	bool hang;              /* Program/erase operations never complete */
+	unsigned int programs;
+	unsigned int errors;    /* Commands ignored by the flash */
+} sim;
+
+/* Virtual clock and counters */
+static uint64_t now_ns;
+static uint64_t sleep_ns;
+static unsigned int sessions, segments, wakeups;
+
+static bool sim_busy(void)
+{
+	return now_ns < sim.busy_until;
+}
+
+/* One chip select assertion: tx bytes are sent, then rx bytes are read */
+static void sim_transfer(const uint8_t *tx, uint32_t tx_len, uint8_t *rx,
+			 uint32_t rx_len)
+{
+	const struct spi_flash_info *info = sim.chip->info;
+	uint8_t cmd = tx_len ? tx[0] : 0;
+	uint32_t addr = 0, i;
+	uint8_t status;
+
+	now_ns += NS_PER_SEGMENT + (uint64_t)(tx_len + rx_len) * NS_PER_BYTE;
+	segments++;
+	if (rx_len)
+		memset(rx, 0xa5, rx_len);
+
+	if (tx_len >= 4)
+		addr = (tx[1] << 16) | (tx[2] << 8) | tx[3];
+
+	if (cmd == info->cmd_release_deep_powerdown) {
+		sim.deep_powerdown = false;
+		wakeups++;
+		return;
+	}
+	if (sim.deep_powerdown) {
+		sim.errors++;
+		return;
+	}
+	if (cmd == info->cmd_deep_powerdown) {
+		sim.deep_powerdown = true;
+	} else if (cmd == info->cmd_read_id) {
+		for (i = 0; i < rx_len && i < 3; i++)
+			rx[i] = info->rdid >> (8 * i);
+	} else if (cmd == info->cmd_read_status) {
+		status = sim_busy() ? info->status_wip_bit : 0;
+		if (sim.wel)
+			status |= info->status_wel_bit;
+		if (rx_len)
+			rx[0] = status;
+	} else if (cmd == info->cmd_read_security) {
+		if (rx_len)
+			rx[0] = sim.secr;
+	} else if (sim_busy()) {
+		/* Only status reads are allowed during program/erase */
+		sim.errors++;
+	} else if (cmd == info->cmd_write_en) {
+		sim.wel = true;
+	} else if (cmd == info->cmd_read) {
+		for (i = 0; i < rx_len; i++)
+			rx[i] = sim.mem[(addr + i) % SIM_FLASH_SIZE];
+	} else if (cmd == info->cmd_page_program) {
+		if (!sim.wel) {
+			sim.errors++;
+			return;
+		}
+		sim.wel = false;
+		sim.secr = 0;
+		if (sim.fail_program_at == (int)sim.programs++)
+			sim.secr = info->status_secr_pfail_bit;
+		/* Bytes wrap around within the page */
+		for (i = 4; i < tx_len; i++)
+			sim.mem[(addr & ~0xff) | ((addr + i - 4) & 0xff)] &= tx[i];
+		sim.busy_until = sim.hang ? UINT64_MAX :
+				 now_ns + sim.chip->ns_page_program;
+	} else if (cmd == info->cmd_sector_erase) {
+		if (!sim.wel) {
+			sim.errors++;
+			return;
+		}
+		sim.wel = false;
+		sim.secr = 0;
+		memset(&sim.mem[addr & ~(info->sector_size - 1)], 0xff,
+		       info->sector_size);
+		sim.busy_until = sim.hang ? UINT64_MAX :
+				 now_ns + sim.chip->ns_sector_erase;
+	} else {
+		sim.errors++;
+	}
+}
+
+uint32_t get_uptime_32k(void)
+{
+	return now_ns * 32768 / 1000000000;
+}
+
+/* SBA: chains are executed synchronously */
+DRIVER_API_RC sba_exec_chain(sba_request_t *head, SBA_PRIORITY prio)
+{
+	sba_request_t *seg;
+
+	now_ns += NS_PER_SESSION;
+	sessions++;
+	head->status = 0;
+	for (seg = head; seg; seg = seg->chain)
+		sim_transfer(seg->tx_buff, seg->tx_len, seg->rx_buff,
+			     seg->rx_len);
+	head->callback(head);
+	return DRV_RC_OK;
+}
+
+DRIVER_API_RC sba_exec_dev_request(struct sba_device *dev,
+				   struct sba_request *req)
+{
+	req->chain = NULL;
+	return sba_exec_chain(req, SBA_PRIO_NORMAL);
+}
+
+/* OS services: one semaphore per handle, timers expire on the virtual
+ * clock when their semaphore is taken */
+struct sim_sem {
+	int count;
+};
+
+struct sim_timer {
+	T_ENTRY_POINT callback;
+	void *priv;
+	uint64_t expiry;
+	bool running;
+};
+
+static struct sim_timer *timer;
+static int mutex_locked;
+
+T_SEMAPHORE semaphore_create(uint32_t count)
+{
+	struct sim_sem *sem = calloc(1, sizeof(*sem));
+
+	sem->count = count;
+	return sem;
+}
+
+void semaphore_delete(T_SEMAPHORE sem)
+{
+	free(sem);
+}
+
+void semaphore_give(T_SEMAPHORE sem, OS_ERR_TYPE *err)
+{
+	((struct sim_sem *)sem)->count++;
+}
+
+OS_ERR_TYPE semaphore_take(T_SEMAPHORE sem, int timeout)
+{
+	struct sim_sem *s = sem;
+
+	if (s->count == 0 && timer && timer->running &&
+	    timer->expiry <= now_ns + (uint64_t)timeout * 1000000) {
+		/* The task sleeps until the timer expires */
+		sleep_ns += timer->expiry - now_ns;
+		now_ns = timer->expiry;
+		timer->running = false;
+		timer->callback(timer->priv);
+	}
+	if (s->count == 0)
+		return E_OS_ERR_TIMEOUT;
+	s->count--;
+	return E_OS_OK;
+}
+
+T_MUTEX mutex_create(void)
+{
+	return calloc(1, 1);
+}
+
+void mutex_delete(T_MUTEX mutex)
+{
+	free(mutex);
+}
+
+OS_ERR_TYPE mutex_lock(T_MUTEX mutex, int timeout)
+{
+	CHECK(mutex_locked == 0);
+	mutex_locked++;
+	return E_OS_OK;
+}
+
+void mutex_unlock(T_MUTEX mutex)
+{
+	mutex_locked--;
+}
+
+T_TIMER timer_create(T_ENTRY_POINT callback, void *priv, uint32_t delay,
+		     bool repeat, bool startup, OS_ERR_TYPE *err)
+{
+	timer = calloc(1, sizeof(*timer));
+	timer->callback = callback;
+	timer->priv = priv;
+	return timer;
+}
+
+void timer_start(T_TIMER tmr, uint32_t delay, OS_ERR_TYPE *err)
+{
+	struct sim_timer *t = tmr;
+
+	t->expiry = now_ns + (uint64_t)delay * 1000000;
+	t->running = true;
+	if (err)
+		*err = E_OS_OK;
+}
+
+void timer_delete(T_TIMER tmr)
+{
+	free(tmr);
+	timer = NULL;
+}
+
+void *balloc(uint32_t size, OS_ERR_TYPE *err)
+{
+	return malloc(size);
+}
+
+OS_ERR_TYPE bfree(void *buffer)
+{
+	free(buffer);
+	return E_OS_OK;
+}
+
+void pm_wakelock_init(struct pm_wakelock *wl)
+{
+	wl->lock = 0;
+}
+
+int pm_wakelock_acquire(struct pm_wakelock *wl)
+{
+	CHECK(wl->lock == 0);
+	wl->lock = 1;
+	return 0;
+}
+
+int pm_wakelock_release(struct pm_wakelock *wl)
+{
+	CHECK(wl->lock == 1);
+	wl->lock = 0;
+	return 0;
+}
+
+void log_printk(uint8_t level, const char *module, const char *format, ...)
+{
+}
+
+/* Devices */
+static struct sba_master_cfg_data bus_cfg = { .bus_id = SBA_SPI_MASTER_0 };
+static struct td_device bus_dev = { .priv = &bus_cfg };
+static struct sba_device flash;
+static struct td_device *dev = &flash.dev;
+
+static const struct sim_chip chips[] = {
+	{ "MX25U1635E", &spi_flash_mx25u1635e_driver.info, 500000, 35000000 },
+	{ "W25Q16DV", &spi_flash_w25qxxdv_driver.info, 700000, 45000000 },
+};
+
+static uint32_t rand_state = 1;
+
+static uint32_t rnd(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return rand_state >> 8;
+}
+
+static uint8_t buf[0x10000], ref[0x10000];
+
+static void start_chip(const struct sim_chip *chip)
+{
+	memset(&sim, 0, sizeof(sim));
+	sim.chip = chip;
+	sim.fail_program_at = -1;
+	sim.deep_powerdown = true;
+	memset(sim.mem, 0xff, sizeof(sim.mem));
+
+	flash.dev.driver = (struct driver *)((char *)chip->info -
+					     offsetof(struct spi_flash_driver,
+						      info));
+	flash.parent = &bus_dev;
+	flash.addr.cs = SPI_SE_1;
+	CHECK(spi_flash_init(dev) == 0);
+	CHECK(sim.deep_powerdown);
+}
+
+static void stop_chip(void)
+{
+	struct driver_data *flash_dev = dev->priv;
+
+	timer_delete(flash_dev->spi_timer);
+	semaphore_delete(flash_dev->spi_sync_sem);
+	semaphore_delete(flash_dev->spi_timer_sem);
+	mutex_delete(flash_dev->device_mtx);
+	bfree(flash_dev);
+}
+
+/* The flash is asleep and the device free between two calls */
+#define CHECK_IDLE() \
+	do { \
+		CHECK(sim.deep_powerdown); \
+		CHECK(mutex_locked == 0); \
+		CHECK(sim.errors == 0); \
+	} while (0)
+
+static void test_functional(void)
+{
+	struct spi_flash_session session;
+	struct spi_flash_iovec iov[9];
+	unsigned int retlen, i, off, len;
+	uint32_t address = 0x1234;
+
+	/* Erase, program and read back at an unaligned address */
+	CHECK(spi_flash_sector_erase(dev, 1, 17) == DRV_RC_OK);
+	CHECK_IDLE();
+	for (i = 0; i < 0x10000; i++)
+		ref[i] = rnd();
+	CHECK(spi_flash_write_byte(dev, address, 0x10000 - 0x300, &retlen,
+				   ref) == DRV_RC_OK);
+	CHECK(retlen == 0x10000 - 0x300);
+	CHECK(!memcmp(&sim.mem[address], ref, retlen));
+	CHECK(sim.mem[address - 1] == 0xff);
+	CHECK(sim.mem[address + retlen] == 0xff);
+	CHECK_IDLE();
+
+	memset(buf, 0, sizeof(buf));
+	CHECK(spi_flash_read_byte(dev, address, 0x10000 - 0x300, &retlen,
+				  buf) == DRV_RC_OK);
+	CHECK(retlen == 0x10000 - 0x300);
+	CHECK(!memcmp(buf, ref, retlen));
+	CHECK_IDLE();
+
+	/* Scatter-gather read, with empty buffers, in one session */
+	memset(buf, 0, sizeof(buf));
+	for (i = 0, off = 0; i < 9; i++) {
+		len = (i == 2 || i == 8) ? 0 : 1 + rnd() % 3000;
+		iov[i].buf = &buf[off];
+		iov[i].len = len;
+		off += len;
+	}
+	CHECK(spi_flash_session_open(dev, &session) == DRV_RC_OK);
+	CHECK(!sim.deep_powerdown);
+	CHECK(spi_flash_session_readv(&session, address + 5, iov, 9,
+				      &retlen) == DRV_RC_OK);
+	CHECK(retlen == off);
+	CHECK(!memcmp(buf, ref + 5, off));
+	CHECK(spi_flash_session_readv(&session, SIM_FLASH_SIZE - 8, iov, 9,
+				      &retlen) == DRV_RC_OUT_OF_MEM);
+	CHECK(retlen == 0);
+	spi_flash_session_close(&session);
+	CHECK_IDLE();
+
+	/* Program failure: only the pages programmed before are counted */
+	CHECK(spi_flash_sector_erase(dev, 32, 1) == DRV_RC_OK);
+	sim.fail_program_at = sim.programs + 3;
+	CHECK(spi_flash_write_byte(dev, 32 * 4096 + 0x80, 0x800, &retlen,
+				   ref) == DRV_RC_CHECK_FAIL);
+	CHECK(retlen == 0x80 + 2 * 0x100);
+	sim.fail_program_at = -1;
+	CHECK_IDLE();
+
+	/* A flash that never completes is reported */
+	sim.hang = true;
+	CHECK(spi_flash_write_byte(dev, 33 * 4096, 0x10, &retlen, ref) ==
+	      DRV_RC_TIMEOUT);
+	CHECK(retlen == 0);
+	sim.busy_until = 0;
+	CHECK(spi_flash_sector_erase(dev, 40, 1) == DRV_RC_TIMEOUT);
+	sim.hang = false;
+	sim.busy_until = 0;
+	CHECK_IDLE();
+
+	/* Write enable is checked before the page program */
+	sim.busy_until = UINT64_MAX;
+	CHECK(spi_flash_write_byte(dev, 34 * 4096, 0x10, &retlen, ref) ==
+	      DRV_RC_FAIL);
+	CHECK(retlen == 0);
+	CHECK(sim.mem[34 * 4096] == 0xff);
+	sim.busy_until = 0;
+	sim.errors = 0;
+	CHECK_IDLE();
+
+	/* Parameters */
+	CHECK(spi_flash_read_byte(dev, 0, 0, &retlen, buf) ==
+	      DRV_RC_INVALID_OPERATION);
+	CHECK(spi_flash_write_byte(dev, SIM_FLASH_SIZE - 4, 8, &retlen,
+				   buf) == DRV_RC_OUT_OF_MEM);
+	CHECK_IDLE();
+}
+
+struct bench {
+	uint64_t ns;
+	uint64_t sleep_ns;
+	unsigned int sessions;
+};
+
+static void bench_start(struct bench *b)
+{
+	b->ns = now_ns;
+	b->sleep_ns = sleep_ns;
+	b->sessions = sessions;
+}
+
+static void bench_end(struct bench *b, const char *what, unsigned int bytes)
+{
+	uint64_t ns = now_ns - b->ns;
+
+	printf("  %-34s %7.1f kB/s  %5.1f%% asleep  %6u bus sessions\n", what,
+	       bytes * 1e6 / ns, 100.0 * (sleep_ns - b->sleep_ns) / ns,
+	       sessions - b->sessions);
+}
+
+#define BENCH_LEN   0x10000
+#define CHUNK       256
+
+static void test_throughput(void)
+{
+	struct spi_flash_session session;
+	struct spi_flash_iovec iov[BENCH_LEN / CHUNK];
+	struct bench b;
+	unsigned int retlen, i;
+	DRIVER_API_RC ret = DRV_RC_OK;
+
+	bench_start(&b);
+	for (i = 0; i < BENCH_LEN; i += CHUNK)
+		ret |= spi_flash_read_byte(dev, i, CHUNK, &retlen, buf + i);
+	bench_end(&b, "read, one call per 256B", BENCH_LEN);
+	CHECK(ret == DRV_RC_OK);
+
+	bench_start(&b);
+	for (i = 0; i < BENCH_LEN / CHUNK; i++) {
+		iov[i].buf = buf + i * CHUNK;
+		iov[i].len = CHUNK;
+	}
+	ret |= spi_flash_session_open(dev, &session);
+	ret |= spi_flash_session_readv(&session, 0, iov, BENCH_LEN / CHUNK,
+				       &retlen);
+	spi_flash_session_close(&session);
+	bench_end(&b, "read, session readv of 256B", BENCH_LEN);
+	CHECK(ret == DRV_RC_OK && retlen == BENCH_LEN);
+
+	bench_start(&b);
+	ret |= spi_flash_read_byte(dev, 0, BENCH_LEN, &retlen, buf);
+	bench_end(&b, "read, one call", BENCH_LEN);
+	CHECK(ret == DRV_RC_OK);
+
+	CHECK(spi_flash_sector_erase(dev, 0, 2 * BENCH_LEN / 4096) ==
+	      DRV_RC_OK);
+
+	bench_start(&b);
+	for (i = 0; i < BENCH_LEN; i += CHUNK)
+		ret |= spi_flash_write_byte(dev, i, CHUNK, &retlen, ref + i);
+	bench_end(&b, "program, one call per page", BENCH_LEN);
+	CHECK(ret == DRV_RC_OK && !memcmp(sim.mem, ref, BENCH_LEN));
+
+	bench_start(&b);
+	ret |= spi_flash_session_open(dev, &session);
+	ret |= spi_flash_session_write(&session, BENCH_LEN, BENCH_LEN, &retlen,
+				       ref);
+	spi_flash_session_close(&session);
+	bench_end(&b, "program, session", BENCH_LEN);
+	CHECK(ret == DRV_RC_OK && !memcmp(sim.mem + BENCH_LEN, ref, BENCH_LEN));
+
+	bench_start(&b);
+	ret |= spi_flash_sector_erase(dev, 0, 16);
+	bench_end(&b, "sector erase", BENCH_LEN);
+	CHECK(ret == DRV_RC_OK);
+	CHECK_IDLE();
+}
+
+int main(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(chips) / sizeof(chips[0]); i++) {
+		printf("%s\n", chips[i].name);
+		start_chip(&chips[i]);
+		test_functional();
+		test_throughput();
+		stop_chip();
+	}
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+
+ *****************************************************************************
+ * Host test of the Test Command engine lookup and batches.
+ *
+ * Test commands are registered as on the targets, the linker script sorting
+ * their section. The dichotomic lookup is checked against the original
+ * linear lookup for all the prefixes of the registered groups and names,
+ * then both are timed. Batches are checked with synchronous and asynchronous
+ * handlers.
+ *
+ * Compile with (from the top directory):
+ * gcc -O2 -Wall -Itools/tests/zephyr_stub -Ibsp/include -Iframework/include \
+ *     -Ibsp/include/machine/soc/intel/quark_se/arc \
+ *     -Ibsp/include/machine/soc/intel/quark_se \
+ *     tools/tests/tcmd_engine_test.c -Wl,-T,tools/tests/tcmd_engine_test.ld \
+ *     -o tcmd_engine_test
+ */
+
+#define CONFIG_TCMD 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Keep the OS timers apart from the POSIX ones */
+#define timer_create os_timer_create
+#define timer_delete os_timer_delete
+#include "../../bsp/src/infra/tcmd/engine.c"
+#undef timer_create
+#undef timer_delete
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, \
+			       __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static int failures;
+
+/*
+ * Stubs of the OS layer
+ */
+
+static int live_blocks;
+
+void *balloc(uint32_t size, OS_ERR_TYPE *err)
+{
+	live_blocks++;
+	if (err)
+		*err = E_OS_OK;
+	return malloc(size);
+}
+
+OS_ERR_TYPE bfree(void *buffer)
+{
+	live_blocks--;
+	free(buffer);
+	return E_OS_OK;
+}
+
+/*
+ * Registered test commands
+ */
+
+static void run_ok(int argc, char **argv, struct tcmd_handler_ctx *ctx)
+{
+	TCMD_RSP_FINAL(ctx, NULL);
+}
+
+/* Completed later by the test */
+static struct tcmd_handler_ctx *async_ctx;
+
+static void run_async(int argc, char **argv, struct tcmd_handler_ctx *ctx)
+{
+	TCMD_RSP_PROVISIONAL(ctx, "started");
+	async_ctx = ctx;
+}
+
+DECLARE_TEST_COMMAND(ble, off, run_ok);
+DECLARE_TEST_COMMAND(ble, on, run_ok);
+DECLARE_TEST_COMMAND(ble, rpc_stats, run_ok);
+DECLARE_TEST_COMMAND(ble, scan, run_async);
+DECLARE_TEST_COMMAND(blea, a, run_ok);
+DECLARE_TEST_COMMAND(ble_x, on, run_ok);
+DECLARE_TEST_COMMAND(i2c, read, run_ok);
+DECLARE_TEST_COMMAND(i2c, write, run_ok);
+DECLARE_TEST_COMMAND(l, x, run_ok);
+DECLARE_TEST_COMMAND(led, ctl, run_ok);
+DECLARE_TEST_COMMAND(led, off, run_ok);
+DECLARE_TEST_COMMAND(led, on, run_ok);
+DECLARE_TEST_COMMAND(led, onoff, run_ok);
+
+/* Groups of 8 commands, for a table the size of the project ones */
+#define DECLARE_GROUP(g) \
+	DECLARE_TEST_COMMAND(g, get, run_ok); \
+	DECLARE_TEST_COMMAND(g, info, run_ok); \
+	DECLARE_TEST_COMMAND(g, read, run_ok); \
+	DECLARE_TEST_COMMAND(g, reset, run_ok); \
+	DECLARE_TEST_COMMAND(g, set, run_ok); \
+	DECLARE_TEST_COMMAND(g, start, run_ok); \
+	DECLARE_TEST_COMMAND(g, stop, run_ok); \
+	DECLARE_TEST_COMMAND(g, write, run_ok)
+
+DECLARE_GROUP(adc);
+DECLARE_GROUP(batt);
+DECLARE_GROUP(flash);
+DECLARE_GROUP(gpio);
+DECLARE_GROUP(mem);
+DECLARE_GROUP(nfc);
+DECLARE_GROUP(pwm);
+DECLARE_GROUP(sensor);
+DECLARE_GROUP(spi);
+DECLARE_GROUP(system);
+DECLARE_GROUP(uart);
+DECLARE_GROUP(usb);
+
+/* The original lookup, relying on the section order only */
+static const struct tcmd_handler *find_command_ref(const char *	group,
+						   const char *	name)
+{
+	const struct tcmd_handler *cmd = __test_cmds_start;
+	const struct tcmd_handler *result = NULL;
+	int grp_len = strlen(group);
+	int name_len = strlen(name);
+	bool exact_match = false;
+
+	while ((!result || !exact_match) && (cmd < __test_cmds_end)) {
+		if ((strncmp(group, cmd->group, grp_len) == 0)
+		    && (strncmp(name, cmd->name, name_len) == 0)) {
+			if ((grp_len == strlen(cmd->group))
+			    && (name_len == strlen(cmd->name))) {
+				exact_match = true;
+				result = cmd;
+			} else {
+				/* only keep the first partial match */
+				if (!result)
+					result = cmd;
+			}
+		}
+		cmd++;
+	}
+	return result;
+}
+
+static int check_lookups(void)
+{
+	const struct tcmd_handler *cmd;
+	char group[16];
+	char name[16];
+	int g, n, count = 0;
+
+	for (cmd = __test_cmds_start; cmd < __test_cmds_end; cmd++) {
+		CHECK(cmd->group_len == strlen(cmd->group));
+		CHECK(cmd->name_len == strlen(cmd->name));
+		for (g = 0; g <= cmd->group_len + 1; g++) {
+			for (n = 0; n <= cmd->name_len + 1; n++) {
+				snprintf(group, sizeof(group), "%.*s%s", g,
+					 cmd->group,
+					 g > cmd->group_len ? "z" : "");
+				snprintf(name, sizeof(name), "%.*s%s", n,
+					 cmd->name,
+					 n > cmd->name_len ? "z" : "");
+				CHECK(find_command(group, name) ==
+				      find_command_ref(group, name));
+				count++;
+			}
+		}
+		CHECK(find_command(cmd->group, cmd->name) == cmd);
+	}
+	CHECK(find_command("zz", "a") == NULL);
+	CHECK(find_command("", "") == __test_cmds_start);
+	return count;
+}
+
+static void test_lookup(void)
+{
+	int count;
+
+	CHECK(__test_cmds_end - __test_cmds_start == 110);
+	CHECK(commands_sorted());
+	count = check_lookups();
+	printf("%d lookups checked\n", count);
+	CHECK(!strcmp(find_command("bl", "o")->name, "off"));
+	CHECK(!strcmp(find_command("ble", "rpc")->name, "rpc_stats"));
+	CHECK(!strcmp(find_command("ble_", "o")->group, "ble_x"));
+	CHECK(!strcmp(find_command("le", "on")->name, "on"));
+	CHECK(find_command("led", "on") == find_command_ref("led", "on"));
+	CHECK(find_command("bleb", "a") == NULL);
+
+	/* Linker script without SORT() */
+	cmds_sorted = 0;
+	check_lookups();
+	cmds_sorted = -1;
+}
+
+static void bench_lookup(void)
+{
+	const struct tcmd_handler *cmd;
+	const struct tcmd_handler *(*find[2])(const char *, const char *) = {
+		find_command_ref, find_command
+	};
+	const char *names[2] = { "linear", "sorted" };
+	struct timespec t0, t1;
+	volatile uintptr_t sink = 0;
+	int i, f;
+
+	for (f = 0; f < 2; f++) {
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (i = 0; i < 10000; i++)
+			for (cmd = __test_cmds_start; cmd < __test_cmds_end;
+			     cmd++)
+				sink += (uintptr_t)find[f](cmd->group,
+							   cmd->name);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		printf("%s lookup: %.1f ns per command\n", names[f],
+		       ((t1.tv_sec - t0.tv_sec) * 1e9 +
+			(t1.tv_nsec - t0.tv_nsec)) /
+		       (10000.0 * (__test_cmds_end - __test_cmds_start)));
+	}
+}
+
+/*
+ * Batches
+ */
+
+#define MAX_RESPONSES 32
+
+struct logged_response {
+	char group[16];
+	char name[16];
+	unsigned int cii;
+	char buffer[80];
+	int type;
+};
+
+static struct logged_response log_rsp[MAX_RESPONSES];
+static int log_count;
+static int caller_data;
+
+static void log_response(const struct tcmd_response *response)
+{
+	struct logged_response *l = &log_rsp[log_count];
+
+	CHECK(response->data == &caller_data);
+	if (log_count == MAX_RESPONSES)
+		return;
+	snprintf(l->group, sizeof(l->group), "%s", response->group);
+	snprintf(l->name, sizeof(l->name), "%s", response->name);
+	snprintf(l->buffer, sizeof(l->buffer), "%s", response->buffer);
+	l->cii = response->cii;
+	l->type = response->type;
+	log_count++;
+}
+
+static void check_response(int i, const char *group, const char *name,
+			   const char *buffer, int type)
+{
+	struct logged_response *l = &log_rsp[i];
+
+	if (i >= log_count) {
+		printf("response %d missing\n", i);
+		failures++;
+		return;
+	}
+	if (strcmp(l->group, group) || strcmp(l->name, name) ||
+	    strcmp(l->buffer, buffer) || l->type != type) {
+		printf("response %d: got %s %s %s %d, expected %s %s %s %d\n",
+		       i, l->group, l->name, l->buffer, l->type, group, name,
+		       buffer, type);
+		failures++;
+	}
+}
+
+#define PROV TCMD_RSP_TYPE_PROVISIONAL
+#define FINAL TCMD_RSP_TYPE_FINAL
+#define ERR TCMD_RSP_TYPE_ERROR
+
+static void send_batch(const char *commands)
+{
+	char *buffer = strdup(commands);
+
+	log_count = 0;
+	tcmd_send_batch(buffer, log_response, &caller_data);
+	/* The buffer is not used once the last command has been sent */
+	memset(buffer, 'x', strlen(commands));
+	free(buffer);
+}
+
+static void test_batch(void)
+{
+	/* Single commands behave as with tcmd_send */
+	send_batch("  tcmd vers");
+	CHECK(log_count == 3);
+	/* The acknowledgement echoes the command as sent */
+	check_response(0, "tcmd", "vers", "ACK", PROV);
+	check_response(1, "tcmd", "version", TCMD_ENGINE_VERSION, PROV);
+	check_response(2, "tcmd", "version", "OK", FINAL);
+	send_batch("ble off;");
+	CHECK(log_count == 2);
+	check_response(1, "ble", "off", "OK", FINAL);
+	send_batch(" ; \r\n");
+	CHECK(log_count == 1);
+	check_response(0, "", "", TCMD_ERROR_MSG_NOT_FOUND, ERR);
+
+	/* Streamed responses, only the last one of the batch is final */
+	send_batch("tcmd version; ble off ;; nope x\n led on 1,2 off 3;");
+	CHECK(log_count == 8);
+	check_response(0, "tcmd", "version", "ACK", PROV);
+	check_response(2, "tcmd", "version", "OK", PROV);
+	check_response(3, "ble", "off", "ACK", PROV);
+	check_response(4, "ble", "off", "OK", PROV);
+	check_response(5, "nope", "x", TCMD_ERROR_MSG_NOT_FOUND, PROV);
+	check_response(6, "led", "on", "ACK", PROV);
+	check_response(7, "led", "on", "OK", FINAL);
+	CHECK(log_rsp[3].cii == log_rsp[0].cii + 1);
+	CHECK(log_rsp[6].cii == log_rsp[0].cii + 3);
+	CHECK(live_blocks == 0);
+
+	/* A command completing after the others ends the batch */
+	send_batch("ble scan; ble on; nope");
+	CHECK(log_count == 5);
+	check_response(0, "ble", "scan", "ACK", PROV);
+	check_response(1, "ble", "scan", "started", PROV);
+	check_response(3, "ble", "on", "OK", PROV);
+	check_response(4, "nope", "", TCMD_ERROR_MSG_NOT_FOUND, PROV);
+	CHECK(live_blocks == 2);
+	TCMD_RSP_ERROR(async_ctx, "Timeout");
+	CHECK(log_count == 7);
+	check_response(5, "ble", "scan", "Timeout", PROV);
+	check_response(6, "ble", "scan", "ERROR", ERR);
+	CHECK(live_blocks == 0);
+
+	/* The help output is sorted by group */
+	send_batch("help");
+	check_response(1, "help", "", "adc: get info read reset set start stop "
+		       "write", PROV);
+	check_response(3, "help", "", "ble: off on rpc_stats scan", PROV);
+	check_response(4, "help", "", "ble_x: on", PROV);
+	check_response(5, "help", "", "blea: a", PROV);
+	CHECK(live_blocks == 0);
+}
+
+int main(void)
+{
+	test_lookup();
+	bench_lookup();
+	test_batch();
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2016, Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ * may be used to endorse or promote products derived from this software without
+ * specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+
+
+ *****************************************************************************
+ * Host test of the timer wheel used by the zephyr OS port: thousands of
+ * timers are started and stopped at random against a simulated millisecond
+ * clock, starting close to the 32-bit roll over. Each timer must expire
+ * exactly once, in order, never early and never after the first check past
+ * its expiration date. Adding and removing timers is then timed.
+ *
+ * Compile with (from the top directory):
+ * gcc -O2 -Wall -Ibsp/include bsp/src/util/timer_wheel.c \
+ *     tools/tests/timer_wheel_test.c -o timer_wheel_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/time.h>
+
+#include "util/timer_wheel.h"
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, \
+			       __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static int failures;
+
+#define NB_TIMERS 2000
+
+static struct timer_wheel wheel;
+static struct timer_wheel_node nodes[NB_TIMERS];
+static bool active[NB_TIMERS];
+
+/* Small linear congruential generator, to stay deterministic */
+static uint32_t rand_state;
+static uint32_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return rand_state >> 8;
+}
+
+static uint32_t check_expired(uint32_t now)
+{
+	struct timer_wheel_node *node;
+	uint32_t last = 0, fired = 0;
+	int i;
+
+	while ((node = timer_wheel_get_expired(&wheel, now)) != NULL) {
+		CHECK(active[node - nodes]);
+		/* Never early */
+		CHECK((int32_t)(node->expiration - now) <= 0);
+		/* In order */
+		CHECK(fired == 0 || (int32_t)(node->expiration - last) >= 0);
+		last = node->expiration;
+		fired++;
+		timer_wheel_remove(&wheel, node);
+		active[node - nodes] = false;
+	}
+	/* Never late: nothing due is left in the wheel */
+	for (i = 0; i < NB_TIMERS; i++)
+		CHECK(!active[i] || (int32_t)(nodes[i].expiration - now) > 0);
+	return fired;
+}
+
+/* Random starts and stops with delays up to max_delay ms */
+static void test_expiration(uint32_t seed, uint32_t max_delay)
+{
+	/* Start close to the 32-bit roll over to check it is handled */
+	uint32_t now = 0xFFFF0000;
+	uint32_t started = 0, stopped = 0, fired = 0;
+	uint32_t next, step;
+	int i;
+
+	rand_state = seed;
+	memset(active, 0, sizeof(active));
+	timer_wheel_init(&wheel, now);
+	CHECK(!timer_wheel_next_expiration(&wheel, &next));
+
+	for (step = 0; step < 20 * NB_TIMERS; step++) {
+		i = next_rand() % NB_TIMERS;
+		if (!active[i]) {
+			/* mix of short (sensor polling) and long timers */
+			nodes[i].expiration = now + 1 +
+					      next_rand() %
+					      ((i & 1) ? 50 : max_delay);
+			timer_wheel_add(&wheel, &nodes[i]);
+			active[i] = true;
+			started++;
+		} else if ((next_rand() & 3) == 0) {
+			timer_wheel_remove(&wheel, &nodes[i]);
+			active[i] = false;
+			stopped++;
+		}
+
+		now += next_rand() % 3;
+		fired += check_expired(now);
+	}
+
+	/* Drain the wheel by jumping to each next expiration */
+	while (timer_wheel_next_expiration(&wheel, &next)) {
+		CHECK((int32_t)(next - now) > 0);
+		now = next;
+		step = check_expired(now);
+		CHECK(step > 0);
+		fired += step;
+	}
+
+	for (i = 0; i < NB_TIMERS; i++)
+		CHECK(!active[i]);
+	/* Each timer started expired or was stopped, once */
+	CHECK(started == stopped + fired);
+	printf("seed %u, delays up to %u ms: %u started, %u stopped, "
+	       "%u expired\n", seed, max_delay, started, stopped, fired);
+}
+
+static double elapsed_us(struct timeval *t0)
+{
+	struct timeval t1;
+
+	gettimeofday(&t1, NULL);
+	return (t1.tv_sec - t0->tv_sec) * 1e6 + (t1.tv_usec - t0->tv_usec);
+}
+
+static void bench(void)
+{
+	double us_add, us_remove;
+	struct timeval t0;
+	int i;
+
+	rand_state = 2;
+	timer_wheel_init(&wheel, 0);
+
+	gettimeofday(&t0, NULL);
+	for (i = 0; i < NB_TIMERS; i++) {
+		nodes[i].expiration = 1 + next_rand() % 600000;
+		timer_wheel_add(&wheel, &nodes[i]);
+	}
+	us_add = elapsed_us(&t0);
+
+	gettimeofday(&t0, NULL);
+	for (i = 0; i < NB_TIMERS; i++)
+		timer_wheel_remove(&wheel, &nodes[i]);
+	us_remove = elapsed_us(&t0);
+
+	printf("%d timers: add %.1f ns remove %.1f ns\n", NB_TIMERS,
+	       us_add * 1e3 / NB_TIMERS, us_remove * 1e3 / NB_TIMERS);
+}
+
+int main(void)
+{
+	test_expiration(1, 200000);
+	test_expiration(3, 1000);
+	/* Long timers cascade through the upper levels */
+	test_expiration(5, 1 << 28);
+	printf("timer_wheel: %s\n", failures ? "FAILED" : "PASSED");
+
+	bench();
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}